@@ -0,0 +1,41 @@
+// Counter based random numbers (PCG RXS-M-XS 32). Every sequence is keyed by pixel, frame and sample index, so it
+// can be reproduced without carrying state between invocations or frames.
+// Also compiled as C++ by include/engine/util/Rng.hpp, keep to uint arithmetic, function style casts and the RNG_*
+// macros so both sides produce the same numbers.
+
+#ifndef RNG_FUNC
+#define RNG_FUNC
+#define RNG_INOUT(type) inout type
+#endif
+
+// Sample indices of the training pass start here, so training and rendering do not share sequences
+#define RNG_TRAIN_SAMPLE_OFFSET 0x80000000u
+
+RNG_FUNC uint RngPermute(uint state)
+{
+	const uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+RNG_FUNC uint RngHash(uint value)
+{
+	return RngPermute((value * 747796405u) + 2891336453u);
+}
+
+// Start state of the sequence of one sample
+RNG_FUNC uint RngSeed(uint pixelX, uint pixelY, uint frameIndex, uint sampleIndex)
+{
+	return RngHash(pixelX + RngHash(pixelY + RngHash(frameIndex + RngHash(sampleIndex))));
+}
+
+RNG_FUNC uint RngNextUint(RNG_INOUT(uint) state)
+{
+	state = (state * 747796405u) + 2891336453u;
+	return RngPermute(state);
+}
+
+// Uniform in [0, 1), 24 bits so the value is exact in float
+RNG_FUNC float RngNextFloat(RNG_INOUT(uint) state)
+{
+	return float(RngNextUint(state) >> 8u) * (1.0 / 16777216.0);
+}
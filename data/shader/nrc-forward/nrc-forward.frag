@@ -1,6 +1,9 @@
 #version 460
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_EXT_debug_printf : enable
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../common/rng.glsl"
 
 // Inputs
 layout(location = 0) in vec3 pixelWorldPos;
@@ -23,77 +26,70 @@ layout(set = 1, binding = 1) uniform volumeData_t
     float g;
     int noNnSpp;
     int withNnSpp;
+    uint frameIndex;
+    vec4 boundsMin; // w unused
+    vec4 boundsMax; // w unused
+    uint useLightCache;
 } volumeData;
 
-layout(set = 2, binding = 0) uniform dir_light_t
-{
-    vec3 color;
-    float zenith;
-    vec3 dir;
-    float azimuth;
-    float strength;
-} dir_light;
-
-// NN buffers
-layout(std430, set = 3, binding = 0) readonly buffer Weights0
-{
-    float matWeights0[4096]; // 64 x 64
-};
-
-layout(std430, set = 3, binding = 1) readonly buffer Weights1
-{
-    float matWeights1[4096]; // 64 x 64
-};
-
-layout(std430, set = 3, binding = 2) readonly buffer Weights2
+// cpu::MajorantGrid, min and max density of every brick without densityFactor
+layout(std430, set = 1, binding = 2) readonly buffer MajorantGrid
 {
-    float matWeights2[4096]; // 64 x 64
+    uvec4 majorantVoxelCount; // xyz, brick size in w
+    uvec4 majorantBrickCount;
+    vec2 majorantMinMax[];
 };
 
-layout(std430, set = 3, binding = 3) readonly buffer Weights3
+// cpu::OccupancyGrid, one bit per brick of the majorant grid and per macro cell
+layout(std430, set = 1, binding = 3) readonly buffer OccupancyGrid
 {
-    float matWeights3[4096]; // 64 x 64
+    uvec4 occupancyBrickCount; // xyz, macro cell size in bricks in w
+    uvec4 occupancyMacroCount; // xyz, first word of the macro cell bits in w
+    uint occupancyBits[];
 };
 
-layout(std430, set = 3, binding = 4) readonly buffer Weights4
+// cpu::LightTransmittanceCache, optical depth toward the lights at the cell centers of a grid over the volume bounds
+// without densityFactor
+layout(std430, set = 1, binding = 4) readonly buffer LightTransmittanceCache
 {
-    float matWeights4[4096]; // 64 x 64
+    uvec4 lightCacheCellCount; // xyz, cells per light in w
+    float lightCacheDepth[]; // DirLight, then PointLight
 };
 
-layout(std430, set = 3, binding = 5) readonly buffer Weights5
+// cpu::SparseBrickVolume, atlas slot of every brick of densityTex or SPARSE_EMPTY_PAGE, densityTex is the atlas of
+// the stored bricks with their apron
+layout(std430, set = 1, binding = 5) readonly buffer SparseBrickVolume
 {
-    float matWeights5[192]; // 64 x 3
+    uvec4 sparseVoxelCount; // xyz, brick size in w, 0 if densityTex is dense
+    uvec4 sparseBrickCount; // xyz, w unused
+    uvec4 sparseAtlasBrickCount; // xyz, brick size with the apron in w
+    uint sparsePageTable[];
 };
 
-layout(std430, set = 3, binding = 18) readonly buffer Biases0
-{
-    float matBiases0[64];
-};
-
-layout(std430, set = 3, binding = 19) readonly buffer Biases1
-{
-    float matBiases1[64];
-};
-
-layout(std430, set = 3, binding = 20) readonly buffer Biases2
-{
-    float matBiases2[64];
-};
-
-layout(std430, set = 3, binding = 21) readonly buffer Biases3
+layout(set = 2, binding = 0) uniform dir_light_t
 {
-    float matBiases3[64];
-};
+    vec3 color;
+    float zenith;
+    vec3 dir;
+    float azimuth;
+    float strength;
+} dir_light;
 
-layout(std430, set = 3, binding = 22) readonly buffer Biases4
+// NN parameter arena: params, gradients, momentum 1 (see MlpTopology and NeuralRadianceCache)
+layout(std430, set = 3, binding = 0) readonly buffer NrcArena
 {
-    float matBiases4[64];
+    float arena[];
 };
 
-layout(std430, set = 3, binding = 23) readonly buffer Biases5
+// OneBlob kernel over the distance between bin and angle (see OneBlobEncoder), sampleCount 0 means analytic
+layout(std430, set = 3, binding = 3) readonly buffer OneBlobTable
 {
-    float matBiases5[3];
-};
+    uint sampleCount;
+    float samplesPerBin;
+    float cutoff;
+    uint padding;
+    float kernel[];
+} oneBlobTable;
 
 layout(set = 4, binding = 0) uniform PointLight
 {
@@ -116,14 +112,14 @@ layout(set = 5, binding = 3) uniform HdrEnvMapData
 
 layout(set = 6, binding = 0) uniform MrheData
 {
-    float learningRate;
-    float weightDecay;
     uint levelCount;
     uint hashTableSize;
+    uint hashTableMask;
     uint featureCount;
     uint minRes;
     uint maxRes;
-    uint resolutions[16];
+    uvec4 resolutions[4];
+    uvec4 addressing[4];
 } mrhe;
 
 layout(std430, set = 6, binding = 1) readonly buffer MRHashTable
@@ -135,37 +131,72 @@ layout(std430, set = 6, binding = 1) readonly buffer MRHashTable
 layout(location = 0) out vec4 outColor;
 
 // Constants
-const vec3 skySize = vec3(125.0, 85.0, 153.0) / 2.0;
-const vec3 skyPos = vec3(0.0);
+layout(constant_id = 10) const uint MLP_INPUT_WIDTH = 64;
+layout(constant_id = 11) const uint MLP_WIDTH = 64;
+layout(constant_id = 12) const uint MLP_OUTPUT_WIDTH = 3;
+layout(constant_id = 13) const uint MLP_HIDDEN_LAYERS = 5;
+layout(constant_id = 14) const uint MLP_MAX_WIDTH = 64;
+
+// Direction encoding (DirEncoding)
+layout(constant_id = 15) const uint DIR_ENCODING = 1;
+#define DIR_ENCODING_ONEBLOB_16 0
+#define DIR_ENCODING_ONEBLOB_32 1
+#define POS_FEATURE_COUNT 32
+
+// cpu::TransmittanceEstimator
+layout(constant_id = 16) const uint TRANSMITTANCE_ESTIMATOR = 0;
+#define TRANSMITTANCE_FIXED_STEP 0
+#define TRANSMITTANCE_RATIO 1
+#define TRANSMITTANCE_RESIDUAL_RATIO 2
+#define MAX_TRACKING_STEPS 256
+#define MAX_LEAP_STEPS 64
+#define LEAP_EPSILON 0.001
+
+// Paths leap over the empty bricks of the occupancy grid
+layout(constant_id = 17) const uint EMPTY_SPACE_SKIPPING = 0;
+
+const uint MLP_LAYER_COUNT = MLP_HIDDEN_LAYERS + 1;
+const uint MLP_WEIGHT_COUNT = (MLP_INPUT_WIDTH * MLP_WIDTH) + ((MLP_HIDDEN_LAYERS - 1) * MLP_WIDTH * MLP_WIDTH) + (MLP_WIDTH * MLP_OUTPUT_WIDTH);
+
+// Volume bounds of VolumeData, the density texture spans the box
+vec3 GetVolumeSize()
+{
+    return volumeData.boundsMax.xyz - volumeData.boundsMin.xyz;
+}
+
+vec3 get_sky_uvw(vec3 pos)
+{
+    return (pos - volumeData.boundsMin.xyz) / GetVolumeSize();
+}
+
+// Slab test, distances along rd where the ray enters (x) and leaves (y) the volume bounds. The entry is clamped to 0
+// so rays from inside enter at their origin. The ray misses the box if x > y.
+vec2 IntersectVolumeBounds(const vec3 ro, const vec3 rd)
+{
+    const vec3 invDir = 1.0 / mix(rd, vec3(1e-20), equal(rd, vec3(0.0)));
+    const vec3 tLow = (volumeData.boundsMin.xyz - ro) * invDir;
+    const vec3 tHigh = (volumeData.boundsMax.xyz - ro) * invDir;
+    const vec3 tMin = min(tLow, tHigh);
+    const vec3 tMax = max(tLow, tHigh);
+    return vec2(max(0.0, max(tMin.x, max(tMin.y, tMin.z))), min(tMax.x, min(tMax.y, tMax.z)));
+}
 
 #define PI 3.14159265359
 
 #define MAX_RAY_DISTANCE 100000.0
-#define MIN_RAY_DISTANCE 0.125
 
 #define SAMPLE_COUNT 40
 
-// Random
-float preRand = volumeData.random.x * fragUV.x;
-float prePreRand = volumeData.random.y * fragUV.y;
-
-float rand(vec2 co)
-{
-    return fract(sin(dot(co, vec2(12.9898, 78.233))) * 43758.5453);
-}
+// MRHE::Addressing
+#define MRHE_HASHED 0
+#define MRHE_DENSE 1
 
-float myRand()
-{
-    float result = rand(vec2(preRand, prePreRand));
-    prePreRand = preRand;
-    preRand = result;
-    return result;
-}
+// Random, seeded per sample in TracePathMultiple
+uint rngState;
 
 float RandFloat(float maxVal)
 {
-    float f = myRand();
-    return f * maxVal;
+    return RngNextFloat(rngState) * maxVal;
 }
 
 // MRHE helper
@@ -181,21 +212,39 @@ uint HashFunc(const uvec3 pos)
 {
     const uvec3 primes = uvec3(1, 19349663, 83492791);
     uint hash = (pos.x * primes.x) + (pos.y * primes.y) + (pos.z * primes.z);
-    hash %= mrhe.hashTableSize;
+    hash &= mrhe.hashTableMask;
     return hash;
 }
 
+uint GetMrheResolution(const uint level)
+{
+    return mrhe.resolutions[level / 4][level % 4];
+}
+
+// Table entry of a grid vertex, dense levels index their (res + 1)^3 grid directly
+uint GetMrheEntryIndex(const uint level, const uint res, const vec3 gridPos)
+{
+    if (mrhe.addressing[level / 4][level % 4] == MRHE_DENSE)
+    {
+        const uint side = res + 1;
+        const uvec3 clampedPos = uvec3(clamp(gridPos, vec3(0.0), vec3(float(res))));
+        return clampedPos.x + (clampedPos.y * side) + (clampedPos.z * side * side);
+    }
+
+    return HashFunc(uvec3(gridPos));
+}
+
 float mrheFeatures[32]; // 16 * 2
 
 // Encode pos
 void EncodePosMrhe(const vec3 pos)
 {
-    const vec3 normPos = (pos / skySize) + vec3(0.5);
+    const vec3 normPos = get_sky_uvw(pos);
 
     for (uint level = 0; level < mrhe.levelCount; level++)
     {
         // Get level resolution
-        const uint res = mrhe.resolutions[level];
+        const uint res = GetMrheResolution(level);
         const vec3 resPos = normPos * float(res);
 
         // Get all 8 neighbours
@@ -218,41 +267,41 @@ void EncodePosMrhe(const vec3 pos)
         vec2 neighbourFeatures[8];
         for (uint neigh = 0; neigh < 8; neigh++)
         {
-            const uint entryIndex = HashFunc(uvec3(neighbours[neigh]));
+            const uint entryIndex = GetMrheEntryIndex(level, res, neighbours[neigh]);
             neighbourFeatures[neigh] = vec2(GetMrheFeature(level, entryIndex, 0), GetMrheFeature(level, entryIndex, 1));
         }
 
-        // Linearly interpolate neightbour features
-        vec3 lerpFactors = pos - neighbours[0];
+        // Trilinearly interpolate neighbour features (neighbour index is x * 4 + y * 2 + z)
+        vec3 lerpFactors = resPos - floorPos;
 
-        vec2 zLerpFeatures[4];
+        vec2 xLerpFeatures[4];
         for (uint i = 0; i < 4; i++)
         {
-            zLerpFeatures[i] =
-            (neighbourFeatures[i] * (1.0 - lerpFactors.z)) +
-            (neighbourFeatures[4 + i] * lerpFactors.z);
+            xLerpFeatures[i] =
+            (neighbourFeatures[i] * (1.0 - lerpFactors.x)) +
+            (neighbourFeatures[4 + i] * lerpFactors.x);
         }
 
         vec2 yLerpFeatures[2];
         for (uint i = 0; i < 2; i++)
         {
             yLerpFeatures[i] =
-            (zLerpFeatures[i] * (1.0 - lerpFactors.y)) +
-            (zLerpFeatures[2 + i] * lerpFactors.y);
+            (xLerpFeatures[i] * (1.0 - lerpFactors.y)) +
+            (xLerpFeatures[2 + i] * lerpFactors.y);
         }
 
-        vec2 xLerpFeatures =
-        (yLerpFeatures[0] * (1.0 - lerpFactors.x)) +
-        (yLerpFeatures[1] * lerpFactors.x);
+        vec2 zLerpFeatures =
+        (yLerpFeatures[0] * (1.0 - lerpFactors.z)) +
+        (yLerpFeatures[1] * lerpFactors.z);
 
         // Store in feature array
-        mrheFeatures[(level * mrhe.featureCount) + 0] = xLerpFeatures.x;
-        mrheFeatures[(level * mrhe.featureCount) + 1] = xLerpFeatures.y;
+        mrheFeatures[(level * mrhe.featureCount) + 0] = zLerpFeatures.x;
+        mrheFeatures[(level * mrhe.featureCount) + 1] = zLerpFeatures.y;
     }
 }
 
 // Encode dir
-float oneBlobFeatures[32];
+float dirFeatures[32]; // Up to 32, zero padded to the input width
 
 float NormGauss(const float x, const float m, const float sigma)
 {
@@ -262,241 +311,174 @@ float NormGauss(const float x, const float m, const float sigma)
     return result;
 }
 
-void EncodeDirOneBlob(const vec3 dir)
+// Linear interpolation in the table, no exp
+float LookupOneBlobKernel(const float distance)
 {
-    // Theta and phi in [0, 1]
-    const float theta = (atan(dir.z, dir.x) / PI) + 0.5;
-    const float phi = (atan(length(dir.xz), dir.y) / PI) + 0.5;
+    const float absDistance = abs(distance);
+    if (absDistance >= oneBlobTable.cutoff)
+        return 0.0;
+
+    const float x = absDistance * oneBlobTable.samplesPerBin;
+    const uint i = uint(x);
+    return mix(oneBlobTable.kernel[i], oneBlobTable.kernel[i + 1], x - float(i));
+}
 
-    const float sigma = 1.0 / 4.0; // sqrt(16.0)
-    for (uint i = 0; i < 16; i++)
+// Theta and phi in [0, 1] are spread over binCount bins each, bin i is centered at (i + 0.5) / binCount
+void EncodeDirOneBlob(const vec3 dir, const uint binCount)
+{
+    const float theta = ((((atan(dir.z, dir.x) / PI) * 0.5) + 0.5) * float(binCount)) - 0.5;
+    const float phi = ((atan(length(dir.xz), dir.y) / PI) * float(binCount)) - 0.5;
+
+    if (oneBlobTable.sampleCount > 0)
+    {
+        for (uint i = 0; i < binCount; i++)
+        {
+            const float fI = float(i);
+            dirFeatures[i] = LookupOneBlobKernel(fI - theta);
+            dirFeatures[i + binCount] = LookupOneBlobKernel(fI - phi);
+        }
+        return;
+    }
+
+    const float sigma = 1.0 / 4.0;
+    for (uint i = 0; i < binCount; i++)
     {
         const float fI = float(i);
-        oneBlobFeatures[i] = NormGauss(fI, theta, sigma);
-        oneBlobFeatures[i + 16] = NormGauss(fI, phi, sigma);
+        dirFeatures[i] = NormGauss(fI, theta, sigma);
+        dirFeatures[i + binCount] = NormGauss(fI, phi, sigma);
     }
 }
 
-// NN helper
-float Sigmoid(float x)
+// Real spherical harmonics basis of the given degree (degree^2 coefficients), dir has to be normalized
+void EncodeDirSh(const vec3 dir, const uint degree)
 {
-    return 1.0 / (1.0 + exp(-x));
-}
+    const float x = dir.x;
+    const float y = dir.y;
+    const float z = dir.z;
+    const float x2 = x * x;
+    const float y2 = y * y;
+    const float z2 = z * z;
 
-float Relu(float x)
-{
-    return max(0.0, x);
-}
+    dirFeatures[0] = 0.28209479177387814;
+    if (degree <= 1)
+        return;
 
-float nr0[64];
-float nr1[64];
-float nr2[64];
-float nr3[64];
-float nr4[64];
-float nr5[64];
-float nr6[3];
+    dirFeatures[1] = -0.48860251190291987 * y;
+    dirFeatures[2] = 0.48860251190291987 * z;
+    dirFeatures[3] = -0.48860251190291987 * x;
+    if (degree <= 2)
+        return;
 
-float GetWeight0(uint row, uint col)
-{
-    uint linearIndex = row * 64 + col;
-    return matWeights0[linearIndex];
-}
+    dirFeatures[4] = 1.0925484305920792 * x * y;
+    dirFeatures[5] = -1.0925484305920792 * y * z;
+    dirFeatures[6] = (0.94617469575755997 * z2) - 0.31539156525251999;
+    dirFeatures[7] = -1.0925484305920792 * x * z;
+    dirFeatures[8] = 0.54627421529603959 * (x2 - y2);
+    if (degree <= 3)
+        return;
 
-float GetWeight1(uint row, uint col)
-{
-    uint linearIndex = row * 64 + col;
-    return matWeights1[linearIndex];
+    dirFeatures[9] = 0.59004358992664352 * y * ((-3.0 * x2) + y2);
+    dirFeatures[10] = 2.8906114426405538 * x * y * z;
+    dirFeatures[11] = 0.45704579946446572 * y * (1.0 - (5.0 * z2));
+    dirFeatures[12] = 0.3731763325901154 * z * ((5.0 * z2) - 3.0);
+    dirFeatures[13] = 0.45704579946446572 * x * (1.0 - (5.0 * z2));
+    dirFeatures[14] = 1.4453057213202769 * z * (x2 - y2);
+    dirFeatures[15] = 0.59004358992664352 * x * ((-x2) + (3.0 * y2));
 }
 
-float GetWeight2(uint row, uint col)
+uint GetDirFeatureCount()
 {
-    uint linearIndex = row * 64 + col;
-    return matWeights2[linearIndex];
+    if (DIR_ENCODING == DIR_ENCODING_ONEBLOB_16)
+        return 16;
+    if (DIR_ENCODING == DIR_ENCODING_ONEBLOB_32)
+        return 32;
+    return DIR_ENCODING * DIR_ENCODING;
 }
 
-float GetWeight3(uint row, uint col)
+void EncodeDir(const vec3 dir)
 {
-    uint linearIndex = row * 64 + col;
-    return matWeights3[linearIndex];
+    if (DIR_ENCODING == DIR_ENCODING_ONEBLOB_16)
+        EncodeDirOneBlob(dir, 8);
+    else if (DIR_ENCODING == DIR_ENCODING_ONEBLOB_32)
+        EncodeDirOneBlob(dir, 16);
+    else
+        EncodeDirSh(normalize(dir), DIR_ENCODING);
 }
 
-float GetWeight4(uint row, uint col)
+// NN helper
+float Sigmoid(float x)
 {
-    uint linearIndex = row * 64 + col;
-    return matWeights4[linearIndex];
+    return 1.0 / (1.0 + exp(-x));
 }
 
-float GetWeight5(uint row, uint col)
+float Relu(float x)
 {
-    uint linearIndex = row * 64 + col;
-    return matWeights5[linearIndex];
+    return max(0.0, x);
 }
 
-void ApplyWeights0()
-{
-    for (uint outRow = 0; outRow < 64; outRow++)
-    {
-        float sum = 0.0;
-
-        for (uint inCol = 0; inCol < 64; inCol++)
-        {
-            float inVal = nr0[inCol];
-            float weightVal = GetWeight0(outRow, inCol);
-            sum += inVal * weightVal;
-        }
-
-        nr1[outRow] = sum + matBiases0[outRow];
-    }
-}
+// Ping pong activations
+float nnIn[MLP_MAX_WIDTH];
+float nnOut[MLP_MAX_WIDTH];
 
-void ApplyWeights1()
+uint GetLayerInCount(const uint layer)
 {
-    for (uint outRow = 0; outRow < 64; outRow++)
-    {
-        float sum = 0.0;
-
-        for (uint inCol = 0; inCol < 64; inCol++)
-        {
-            float inVal = nr1[inCol];
-            float weightVal = GetWeight1(outRow, inCol);
-            sum += inVal * weightVal;
-        }
-
-        nr2[outRow] = sum + matBiases1[outRow];
-    }
+    return layer == 0 ? MLP_INPUT_WIDTH : MLP_WIDTH;
 }
 
-void ApplyWeights2()
+uint GetLayerOutCount(const uint layer)
 {
-    for (uint outRow = 0; outRow < 64; outRow++)
-    {
-        float sum = 0.0;
-
-        for (uint inCol = 0; inCol < 64; inCol++)
-        {
-            float inVal = nr2[inCol];
-            float weightVal = GetWeight2(outRow, inCol);
-            sum += inVal * weightVal;
-        }
-
-        nr3[outRow] = sum + matBiases2[outRow];
-    }
+    return layer == MLP_LAYER_COUNT - 1 ? MLP_OUTPUT_WIDTH : MLP_WIDTH;
 }
 
-void ApplyWeights3()
+uint GetWeightOffset(const uint layer)
 {
-    for (uint outRow = 0; outRow < 64; outRow++)
-    {
-        float sum = 0.0;
-
-        for (uint inCol = 0; inCol < 64; inCol++)
-        {
-            float inVal = nr3[inCol];
-            float weightVal = GetWeight3(outRow, inCol);
-            sum += inVal * weightVal;
-        }
-
-        nr4[outRow] = sum + matBiases3[outRow];
-    }
+    return layer == 0 ? 0 : (MLP_INPUT_WIDTH * MLP_WIDTH) + ((layer - 1) * MLP_WIDTH * MLP_WIDTH);
 }
 
-void ApplyWeights4()
+uint GetBiasOffset(const uint layer)
 {
-    for (uint outRow = 0; outRow < 64; outRow++)
-    {
-        float sum = 0.0;
-
-        for (uint inCol = 0; inCol < 64; inCol++)
-        {
-            float inVal = nr4[inCol];
-            float weightVal = GetWeight4(outRow, inCol);
-            sum += inVal * weightVal;
-        }
-
-        nr5[outRow] = sum + matBiases4[outRow];
-    }
+    return MLP_WEIGHT_COUNT + (layer * MLP_WIDTH);
 }
 
-void ApplyWeights5()
+void ApplyLayer(const uint layer)
 {
-    for (uint outRow = 0; outRow < 3; outRow++)
+    const uint inCount = GetLayerInCount(layer);
+    const uint outCount = GetLayerOutCount(layer);
+    const uint weightOffset = GetWeightOffset(layer);
+    const uint biasOffset = GetBiasOffset(layer);
+
+    for (uint outRow = 0; outRow < outCount; outRow++)
     {
         float sum = 0.0;
 
-        for (uint inCol = 0; inCol < 64; inCol++)
+        for (uint inCol = 0; inCol < inCount; inCol++)
         {
-            float inVal = nr5[inCol];
-            float weightVal = GetWeight5(outRow, inCol);
-            sum += inVal * weightVal;
+            sum += nnIn[inCol] * arena[weightOffset + (outRow * inCount) + inCol];
         }
 
-        nr6[outRow] = sum + matBiases5[outRow];
+        nnOut[outRow] = Relu(sum + arena[biasOffset + outRow]);
     }
-}
-
-void ActivateNr1()
-{
-    for (uint i = 0; i < 64; i++)
-    {
-        //nr1[i] = Sigmoid(nr1[i]);
-        nr1[i] = Relu(nr1[i]);
-    }
-}
-
-void ActivateNr2()
-{
-    for (uint i = 0; i < 64; i++)
-    {
-        //nr2[i] = Sigmoid(nr2[i]);
-        nr2[i] = Relu(nr2[i]);
-    }
-}
 
-void ActivateNr3()
-{
-    for (uint i = 0; i < 64; i++)
+    for (uint i = 0; i < outCount; i++)
     {
-        //nr3[i] = Sigmoid(nr3[i]);
-        nr3[i] = Relu(nr3[i]);
+        nnIn[i] = nnOut[i];
     }
 }
 
-void ActivateNr4()
-{
-    for (uint i = 0; i < 64; i++)
-    {
-        //nr4[i] = Sigmoid(nr4[i]);
-        nr4[i] = Relu(nr4[i]);
-    }
-}
-
-void ActivateNr5()
+void EncodeRay(vec3 pos, const vec3 dir)
 {
-    for (uint i = 0; i < 64; i++)
-    {
-        //nr5[i] = Sigmoid(nr5[i]);
-        nr5[i] = Relu(nr5[i]);
-    }
-}
+    EncodePosMrhe(pos);
+    EncodeDir(dir);
 
-void ActivateNr6()
-{
-    for (uint i = 0; i < 3; i++)
+    for (uint i = 0; i < POS_FEATURE_COUNT; i++)
     {
-        //nr6[i] = Sigmoid(nr6[i]);
-        nr6[i] = Relu(nr6[i]);
+        nnIn[i] = mrheFeatures[i];
     }
-}
 
-void EncodeRay(vec3 pos, const vec3 dir)
-{
-    EncodePosMrhe(pos);
-    EncodeDirOneBlob(dir);
-
-    for (uint i = 0; i < 32; i++)
+    const uint dirFeatureCount = GetDirFeatureCount();
+    for (uint i = 0; i < MLP_INPUT_WIDTH - POS_FEATURE_COUNT; i++)
     {
-        nr0[i] = mrheFeatures[i];
-        nr0[i + 32] = oneBlobFeatures[i];
+        nnIn[i + POS_FEATURE_COUNT] = i < dirFeatureCount ? dirFeatures[i] : 0.0;
     }
 }
 
@@ -504,64 +486,24 @@ vec3 Forward(vec3 ro, const vec3 rd)
 {
     EncodeRay(ro, rd);
 
-    //debugPrintfEXT("%f, %f, %f, %f, %f\n", nr0[0], nr0[1], nr0[2], nr0[3], nr0[4]);
-
-    ApplyWeights0();
-    ActivateNr1();
-
-    ApplyWeights1();
-    ActivateNr2();
-
-    ApplyWeights2();
-    ActivateNr3();
-
-    ApplyWeights3();
-    ActivateNr4();
-
-    ApplyWeights4();
-    ActivateNr5();
-
-    ApplyWeights5();
-    //debugPrintfEXT("%f, %f, %f\n", nr6[0], nr6[1], nr6[2]);
-    ActivateNr6();
+    for (uint layer = 0; layer < MLP_LAYER_COUNT; layer++)
+    {
+        ApplyLayer(layer);
+    }
 
     vec3 outputCol;
-    outputCol.x = max(0.0, nr6[0]);
-    outputCol.y = max(0.0, nr6[1]);
-    outputCol.z = max(0.0, nr6[2]);
+    outputCol.x = max(0.0, nnIn[0]);
+    outputCol.y = max(0.0, nnIn[1]);
+    outputCol.z = max(0.0, nnIn[2]);
 
     return outputCol;
 }
 
 // Path trace helper
-float sky_sdf(vec3 pos)
-{
-    vec3 d = abs(pos - skyPos) - skySize / 2;
-    return length(max(d, 0)) + min(max(d.x, max(d.y, d.z)), 0);
-}
-
 vec3[2] find_entry_exit(vec3 ro, vec3 rd)
 {
-    // rd should be normalized
-
-    float dist;
-    do
-    {
-        dist = sky_sdf(ro);
-        ro  += dist * rd;
-    } while (dist > MIN_RAY_DISTANCE && dist < MAX_RAY_DISTANCE);
-    vec3 entry = ro;
-
-    ro += rd * length(2 * skySize);//ro += rd * MAX_RAY_DISTANCE * 2;
-    rd *= -1.0;
-    do
-    {
-        dist = sky_sdf(ro);
-        ro += dist * rd;
-    } while (dist > MIN_RAY_DISTANCE && dist < MAX_RAY_DISTANCE);
-    vec3 exit = ro;
-
-    return vec3[2]( entry, exit );
+    const vec2 entryExit = IntersectVolumeBounds(ro, rd);
+    return vec3[2](ro + (rd * entryExit.x), ro + (rd * entryExit.y));
 }
 
 void gen_sample_points(vec3 start_pos, vec3 end_pos, out vec3 samples[SAMPLE_COUNT])
@@ -571,14 +513,36 @@ void gen_sample_points(vec3 start_pos, vec3 end_pos, out vec3 samples[SAMPLE_COU
     samples[i] = start_pos + dir * (float(i) / float(SAMPLE_COUNT));
 }
 
-vec3 get_sky_uvw(vec3 pos)
+#define SPARSE_EMPTY_PAGE 0xffffffff
+
+// Linear sample of the dense volume at uvw, bricks of the atlas have the neighbouring voxels in their apron
+float SampleDensityTex(const vec3 uvw)
 {
-    return ((pos - skyPos) / skySize) + vec3(0.5);
+    if (sparseVoxelCount.w == 0)
+        return texture(densityTex, uvw).x;
+
+    // All 8 texels of the filter in the border
+    const vec3 voxelPos = uvw * vec3(sparseVoxelCount.xyz);
+    if (any(lessThan(voxelPos, vec3(-0.5))) || any(greaterThanEqual(voxelPos, vec3(sparseVoxelCount.xyz) + 0.5)))
+        return 0.0;
+
+    const float brickSize = float(sparseVoxelCount.w);
+    const uvec3 brick = uvec3(clamp(floor(voxelPos / brickSize), vec3(0.0), vec3(sparseBrickCount.xyz - 1u)));
+    const uint page = sparsePageTable[brick.x + (sparseBrickCount.x * (brick.y + (sparseBrickCount.y * brick.z)))];
+    if (page == SPARSE_EMPTY_PAGE)
+        return 0.0;
+
+    const uvec3 slot = uvec3(
+        page % sparseAtlasBrickCount.x,
+        (page / sparseAtlasBrickCount.x) % sparseAtlasBrickCount.y,
+        page / (sparseAtlasBrickCount.x * sparseAtlasBrickCount.y));
+    const vec3 atlasPos = vec3(slot * sparseAtlasBrickCount.w) + (voxelPos - (vec3(brick) * brickSize)) + 1.0;
+    return texture(densityTex, atlasPos / vec3(sparseAtlasBrickCount.xyz * sparseAtlasBrickCount.w)).x;
 }
 
 float getDensity(vec3 pos)
 {
-    return volumeData.densityFactor * texture(densityTex, get_sky_uvw(pos)).x;
+    return volumeData.densityFactor * SampleDensityTex(get_sky_uvw(pos));
 }
 
 float hg_phase_func(const float cos_theta)
@@ -638,7 +602,7 @@ vec3 NewRayDir(vec3 oldRayDir)
     return normalize(newRayDir);
 }
 
-float GetTransmittance(const vec3 start, const vec3 end, const uint count)
+float GetTransmittanceFixedStep(const vec3 start, const vec3 end, const uint count)
 {
     const vec3 dir = end - start;
     const float stepSize = length(dir) / float(count);
@@ -661,6 +625,197 @@ float GetTransmittance(const vec3 start, const vec3 end, const uint count)
     return transmittance;
 }
 
+// Ratio tracking through the bricks of the majorant grid. With residual the brick minimum is integrated in closed form
+// and only the density above it is tracked.
+float GetTransmittanceTracked(const vec3 start, const vec3 end, const bool residual)
+{
+    const float segmentLength = length(end - start);
+    if (segmentLength == 0.0)
+    {
+        return 1.0;
+    }
+
+    // Voxel space of the segment, parametrized by t in [0, 1]
+    const vec3 voxelCount = vec3(majorantVoxelCount.xyz);
+    const vec3 gridStart = get_sky_uvw(start) * voxelCount;
+    const vec3 gridDir = (get_sky_uvw(end) * voxelCount) - gridStart;
+    const vec3 invDir = 1.0 / mix(gridDir, vec3(1e-20), equal(gridDir, vec3(0.0)));
+
+    // Clip to the grid
+    const vec3 tLow = -gridStart * invDir;
+    const vec3 tHigh = (voxelCount - gridStart) * invDir;
+    const vec3 tMin = min(tLow, tHigh);
+    const vec3 tMax = max(tLow, tHigh);
+    float t = max(0.0, max(tMin.x, max(tMin.y, tMin.z)));
+    const float tEnd = min(1.0, min(tMax.x, min(tMax.y, tMax.z)));
+    if (t >= tEnd)
+    {
+        return 1.0;
+    }
+
+    // Brick DDA
+    const float brickSize = float(majorantVoxelCount.w);
+    const ivec3 brickCount = ivec3(majorantBrickCount.xyz);
+    ivec3 brick = clamp(ivec3(floor((gridStart + (gridDir * t)) / brickSize)), ivec3(0), brickCount - 1);
+    const ivec3 brickStep = ivec3(sign(invDir));
+    const vec3 tDelta = abs(brickSize * invDir);
+    vec3 tNext = ((vec3(brick + max(brickStep, ivec3(0))) * brickSize) - gridStart) * invDir;
+
+    float transmittance = 1.0;
+    uint stepCount = 0;
+    while (t < tEnd && stepCount < MAX_TRACKING_STEPS)
+    {
+        const float tBrickEnd = min(min(tNext.x, min(tNext.y, tNext.z)), tEnd);
+        const vec2 minMax = majorantMinMax[brick.x + (brickCount.x * (brick.y + (brickCount.y * brick.z)))];
+        const float control = residual ? volumeData.densityFactor * minMax.x : 0.0;
+        const float majorant = (volumeData.densityFactor * minMax.y) - control;
+
+        transmittance *= exp(-control * (tBrickEnd - t) * segmentLength);
+
+        // Tentative collisions against the (residual) majorant, each weighted by its null collision probability
+        if (majorant > 0.0)
+        {
+            float tCollision = t;
+            while (stepCount < MAX_TRACKING_STEPS)
+            {
+                tCollision -= log(1.0 - RandFloat(1.0)) / (majorant * segmentLength);
+                if (tCollision >= tBrickEnd)
+                {
+                    break;
+                }
+
+                stepCount++;
+                const float density = getDensity(start + ((end - start) * tCollision));
+                transmittance *= 1.0 - ((density - control) / majorant);
+            }
+        }
+
+        if (transmittance <= 0.0)
+        {
+            return 0.0;
+        }
+
+        // Next brick
+        t = tBrickEnd;
+        const int axis = tNext.x <= tNext.y && tNext.x <= tNext.z ? 0 : (tNext.y <= tNext.z ? 1 : 2);
+        brick[axis] += brickStep[axis];
+        tNext[axis] += tDelta[axis];
+        if (brick[axis] < 0 || brick[axis] >= brickCount[axis])
+        {
+            break;
+        }
+    }
+
+    return transmittance;
+}
+
+// count only matters for the fixed step estimator
+float GetTransmittance(const vec3 start, const vec3 end, const uint count)
+{
+    if (TRANSMITTANCE_ESTIMATOR == TRANSMITTANCE_RATIO)
+    {
+        return GetTransmittanceTracked(start, end, false);
+    }
+    else if (TRANSMITTANCE_ESTIMATOR == TRANSMITTANCE_RESIDUAL_RATIO)
+    {
+        return GetTransmittanceTracked(start, end, true);
+    }
+
+    return GetTransmittanceFixedStep(start, end, count);
+}
+
+#define LIGHT_CACHE_DIR 0
+#define LIGHT_CACHE_POINT 1
+float GetLightCacheDepth(const uint light, const uvec3 cell)
+{
+    return lightCacheDepth[(light * lightCacheCellCount.w) + cell.x + (lightCacheCellCount.x * (cell.y + (lightCacheCellCount.y * cell.z)))];
+}
+
+// Transmittance toward a light of cpu::LightTransmittanceCache, trilinear between the cell centers
+float GetCachedTransmittance(const uint light, const vec3 pos)
+{
+    const uvec3 cellCount = lightCacheCellCount.xyz;
+    const vec3 cellPos = clamp((get_sky_uvw(pos) * vec3(cellCount)) - 0.5, vec3(0.0), vec3(cellCount - 1u));
+    const uvec3 c0 = uvec3(cellPos);
+    const uvec3 c1 = min(c0 + 1u, cellCount - 1u);
+    const vec3 l = cellPos - vec3(c0);
+
+    const float y0z0 = mix(GetLightCacheDepth(light, c0), GetLightCacheDepth(light, uvec3(c1.x, c0.y, c0.z)), l.x);
+    const float y1z0 = mix(GetLightCacheDepth(light, uvec3(c0.x, c1.y, c0.z)), GetLightCacheDepth(light, uvec3(c1.x, c1.y, c0.z)), l.x);
+    const float y0z1 = mix(GetLightCacheDepth(light, uvec3(c0.x, c0.y, c1.z)), GetLightCacheDepth(light, uvec3(c1.x, c0.y, c1.z)), l.x);
+    const float y1z1 = mix(GetLightCacheDepth(light, uvec3(c0.x, c1.y, c1.z)), GetLightCacheDepth(light, c1), l.x);
+    const float depth = mix(mix(y0z0, y1z0, l.y), mix(y0z1, y1z1, l.y), l.z);
+    return exp(-volumeData.densityFactor * depth);
+}
+
+bool IsBrickOccupied(const uvec3 brick)
+{
+    const uint index = brick.x + (occupancyBrickCount.x * (brick.y + (occupancyBrickCount.y * brick.z)));
+    return (occupancyBits[index >> 5] & (1u << (index & 31u))) != 0u;
+}
+
+bool IsMacroOccupied(const uvec3 macro)
+{
+    const uint index = (occupancyMacroCount.w * 32u) + macro.x + (occupancyMacroCount.x * (macro.y + (occupancyMacroCount.y * macro.z)));
+    return (occupancyBits[index >> 5] & (1u << (index & 31u))) != 0u;
+}
+
+// Distance along dir to the first occupied brick, negative if the ray leaves the grid before. Empty macro cells are
+// passed whole and the bricks of occupied ones one by one, restarting from the exit of every cell.
+float GetEmptyDistance(const vec3 pos, const vec3 dir)
+{
+    // Voxel space of the ray, parametrized by the distance along dir
+    const vec3 voxelCount = vec3(majorantVoxelCount.xyz);
+    const vec3 gridPos = get_sky_uvw(pos) * voxelCount;
+
+    // Most path steps start in an occupied brick, they skip the DDA setup
+    const float brickSize = float(majorantVoxelCount.w);
+    if (all(greaterThanEqual(gridPos, vec3(0.0))) && all(lessThan(gridPos, voxelCount)) && IsBrickOccupied(uvec3(gridPos / brickSize)))
+    {
+        return 0.0;
+    }
+
+    const vec3 gridDir = (dir / GetVolumeSize()) * voxelCount;
+    const vec3 invDir = 1.0 / mix(gridDir, vec3(1e-20), equal(gridDir, vec3(0.0)));
+
+    // Clip to the grid
+    const vec3 tLow = -gridPos * invDir;
+    const vec3 tHigh = (voxelCount - gridPos) * invDir;
+    const vec3 tMin = min(tLow, tHigh);
+    const vec3 tMax = max(tLow, tHigh);
+    float t = max(0.0, max(tMin.x, max(tMin.y, tMin.z)));
+    const float tEnd = min(MAX_RAY_DISTANCE, min(tMax.x, min(tMax.y, tMax.z)));
+
+    const ivec3 brickCount = ivec3(occupancyBrickCount.xyz);
+    const int macroSize = int(occupancyBrickCount.w);
+    const ivec3 exitFace = ivec3(step(vec3(0.0), invDir));
+    for (uint i = 0; i < MAX_LEAP_STEPS && t < tEnd; i++)
+    {
+        const ivec3 brick = clamp(ivec3(floor((gridPos + (gridDir * t)) / brickSize)), ivec3(0), brickCount - 1);
+
+        ivec3 cell = brick;
+        float cellSize = brickSize;
+        if (IsMacroOccupied(uvec3(brick / macroSize)))
+        {
+            if (IsBrickOccupied(uvec3(brick)))
+            {
+                return t;
+            }
+        }
+        else
+        {
+            cell = brick / macroSize;
+            cellSize *= float(macroSize);
+        }
+
+        // Exit of the cell, nudged into the next one
+        const vec3 tExit = ((vec3(cell + exitFace) * cellSize) - gridPos) * invDir;
+        t = max(min(tExit.x, min(tExit.y, tExit.z)), t) + LEAP_EPSILON;
+    }
+
+    return t < tEnd ? t : -1.0;
+}
+
 vec3 TraceDirLight(const vec3 pos, const vec3 dir)
 {
     if (dir_light.strength == 0.0)
@@ -668,7 +823,9 @@ vec3 TraceDirLight(const vec3 pos, const vec3 dir)
         return vec3(0.0);
     }
 
-    const float transmittance = GetTransmittance(pos, find_entry_exit(pos, -normalize(dir_light.dir))[1], 32);
+    const float transmittance = volumeData.useLightCache == 1
+            ? GetCachedTransmittance(LIGHT_CACHE_DIR, pos)
+            : GetTransmittance(pos, find_entry_exit(pos, -normalize(dir_light.dir))[1], 32);
     const float phase = hg_phase_func(dot(dir_light.dir, -dir));
     const vec3 dirLighting = vec3(1.0f) * transmittance * dir_light.strength * phase;
     return dirLighting;
@@ -681,7 +838,9 @@ vec3 TracePointLight(const vec3 pos, const vec3 dir)
         return vec3(0.0);
     }
 
-    const float transmittance = GetTransmittance(pointLight.pos, pos, 32);
+    const float transmittance = volumeData.useLightCache == 1
+            ? GetCachedTransmittance(LIGHT_CACHE_POINT, pos)
+            : GetTransmittance(pointLight.pos, pos, 32);
     const float phase = hg_phase_func(dot(normalize(pointLight.pos - pos), -dir));
     const vec3 pointLighting = pointLight.color * pointLight.strength * transmittance * phase;
     return pointLighting;
@@ -772,6 +931,17 @@ vec4 TracePath(const vec3 rayOrigin, const vec3 rayDir, bool useNN)
 
     for (uint i = 0; i < TRUE_TRACE_SAMPLE_COUNT; i++)
     {
+        // Leap over the empty bricks, no point in them scatters
+        if (EMPTY_SPACE_SKIPPING == 1)
+        {
+            const float emptyDistance = GetEmptyDistance(currentPoint, currentDir);
+            if (emptyDistance < 0.0)
+            {
+                break;
+            }
+            currentPoint += currentDir * emptyDistance;
+        }
+
         const float density = getDensity(currentPoint);
 
         if (density > 0.0)
@@ -827,6 +997,7 @@ vec4 TracePathMultiple(const vec3 rayOrigin, const vec3 rayDir, bool useNN)
     vec4 average = vec4(0.0);
     for (uint i = 0; i < spp; i++)
     {
+        rngState = RngSeed(uint(gl_FragCoord.x), uint(gl_FragCoord.y), volumeData.frameIndex, i);
         average += TracePath(rayOrigin, rayDir, useNN);
     }
     average /= float(spp);
@@ -840,14 +1011,12 @@ void main()
     const vec3 ro = camera.pos;
     const vec3 rd = normalize(pixelWorldPos - ro);
 
-    // SDF
-    const vec3[2] entry_exit = find_entry_exit(ro, rd);
-    const vec3 entry = entry_exit[0];
-    const vec3 exit = entry_exit[1];
+    // Volume bounds
+    const vec2 entryExit = IntersectVolumeBounds(ro, rd);
 
     vec3 envMapColor = SampleHdrEnvMap(rd, false);
 
-    if (sky_sdf(entry) > MAX_RAY_DISTANCE)
+    if (entryExit.x > entryExit.y)
     {
         outColor = vec4(envMapColor, 1.0);
         return;
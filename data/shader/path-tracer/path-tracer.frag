@@ -44,9 +44,6 @@ const vec3 skyPos = vec3(0.0);
 
 #define PI 3.14159265359
 
-#define MAX_RAY_DISTANCE 100000.0
-#define MIN_RAY_DISTANCE 0.125
-
 #define SAMPLE_COUNT 40
 #define SECONDARY_SAMPLE_COUNT 12
 
@@ -86,34 +83,22 @@ float RandFloat(float maxVal)
 
 // --------------- Start: util -----------------
 
-float sky_sdf(vec3 pos)
+// Slab test, distances along rd where the ray enters (x) and leaves (y) the sky box. The entry is clamped to 0 so
+// rays from inside enter at their origin. The ray misses the box if x > y.
+vec2 IntersectSky(const vec3 ro, const vec3 rd)
 {
-	vec3 d = abs(pos - skyPos) - skySize / 2;
-	return length(max(d, 0)) + min(max(d.x, max(d.y, d.z)), 0);
+	const vec3 invDir = 1.0 / mix(rd, vec3(1e-20), equal(rd, vec3(0.0)));
+	const vec3 tLow = (skyPos - (skySize / 2.0) - ro) * invDir;
+	const vec3 tHigh = (skyPos + (skySize / 2.0) - ro) * invDir;
+	const vec3 tMin = min(tLow, tHigh);
+	const vec3 tMax = max(tLow, tHigh);
+	return vec2(max(0.0, max(tMin.x, max(tMin.y, tMin.z))), min(tMax.x, min(tMax.y, tMax.z)));
 }
 
 vec3[2] find_entry_exit(vec3 ro, vec3 rd)
 {
-	// rd should be normalized
-
-	float dist;
-	do
-	{
-		dist = sky_sdf(ro);
-		ro  += dist * rd;
-	} while (dist > MIN_RAY_DISTANCE && dist < MAX_RAY_DISTANCE);
-	vec3 entry = ro;
-
-	ro += rd * length(2 * skySize);//ro += rd * MAX_RAY_DISTANCE * 2;
-	rd *= -1.0;
-	do
-	{
-		dist = sky_sdf(ro);
-		ro += dist * rd;
-	} while (dist > MIN_RAY_DISTANCE && dist < MAX_RAY_DISTANCE);
-	vec3 exit = ro;
-
-	return vec3[2]( entry, exit );
+	const vec2 entryExit = IntersectSky(ro, rd);
+	return vec3[2](ro + (rd * entryExit.x), ro + (rd * entryExit.y));
 }
 
 void gen_sample_points(vec3 start_pos, vec3 end_pos, out vec3 samples[SAMPLE_COUNT])
@@ -363,12 +348,10 @@ void main()
 	outPos = vec4(ro / skySize.y, 1.0);
 	outDir = vec4(theta, phi, 0.0, 1.0);
 
-	// Check sdf collision
-	const vec3[2] entry_exit = find_entry_exit(ro, rd);
-	const vec3 entry = entry_exit[0];
-	const vec3 exit = entry_exit[1];
+	// Check sky box collision
+	const vec2 entryExit = IntersectSky(ro, rd);
 
-	if (sky_sdf(entry) > MAX_RAY_DISTANCE)
+	if (entryExit.x > entryExit.y)
 	{
 		outColor = vec4(vec3(0.0), 1.0);
 		return;
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <engine/cpu/MlpTrainer.hpp>
+#include <engine/util/BoundedQueue.hpp>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+namespace en::cpu
+{
+    // Host side version of the split nrc-train.comp: producer threads generate and encode training samples in chunks
+    // of CHUNK_SIZE rays while the trainer thread only assembles full batches and runs MlpTrainer on them. Chunks are
+    // preallocated and circulate between a free and a filled BoundedQueue, so neither side locks or allocates.
+    template<typename Topology>
+    class AsyncTrainer
+    {
+    public:
+        static constexpr size_t CHUNK_SIZE = 256;
+
+        // Fills one chunk: input[feature * CHUNK_SIZE + ray], target[channel * CHUNK_SIZE + ray]. Called concurrently
+        // by all producers, producerIndex tells them apart.
+        using Generator = std::function<void(size_t producerIndex, float* input, float* target)>;
+
+        struct Stats
+        {
+            size_t chunkCount; // Chunks trained on
+            double trainerWaitSeconds; // Trainer found no filled chunk
+            double producerWaitSeconds; // Summed over producers, found no free chunk
+        };
+
+        // chunkCount has to be a power of two, producers start right away
+        AsyncTrainer(MlpTrainer<Topology>& trainer, size_t producerCount, size_t chunkCount, const Generator& generator) :
+                m_Trainer(trainer),
+                m_Generator(generator),
+                m_Chunks(chunkCount),
+                m_FreeChunks(chunkCount),
+                m_FilledChunks(chunkCount),
+                m_Stop(false),
+                m_ProducerWaitNs(0),
+                m_Stats({ .chunkCount = 0, .trainerWaitSeconds = 0.0, .producerWaitSeconds = 0.0 })
+        {
+            for (size_t i = 0; i < chunkCount; i++)
+            {
+                m_Chunks[i].input.resize(Topology::INPUT_WIDTH * CHUNK_SIZE);
+                m_Chunks[i].target.resize(Topology::OUTPUT_WIDTH * CHUNK_SIZE);
+                m_FreeChunks.TryPush(i);
+            }
+
+            for (size_t i = 0; i < producerCount; i++)
+            {
+                m_Producers.emplace_back([this, i]() { ProducerLoop(i); });
+            }
+        }
+
+        ~AsyncTrainer()
+        {
+            m_Stop.store(true, std::memory_order_relaxed);
+            for (std::thread& producer : m_Producers)
+            {
+                producer.join();
+            }
+        }
+
+        AsyncTrainer(const AsyncTrainer&) = delete;
+        AsyncTrainer& operator=(const AsyncTrainer&) = delete;
+
+        // Trains on stepCount batches, batchSize has to be a multiple of CHUNK_SIZE. Returns the loss of the last batch.
+        float Train(size_t stepCount, size_t batchSize)
+        {
+            if (batchSize == 0 || batchSize % CHUNK_SIZE != 0)
+                Log::Error("AsyncTrainer batch size has to be a multiple of CHUNK_SIZE", true);
+
+            m_BatchInput.resize(Topology::INPUT_WIDTH * batchSize);
+            m_BatchTarget.resize(Topology::OUTPUT_WIDTH * batchSize);
+
+            float loss = 0.0f;
+            const size_t chunksPerBatch = batchSize / CHUNK_SIZE;
+            for (size_t step = 0; step < stepCount; step++)
+            {
+                for (size_t slot = 0; slot < chunksPerBatch; slot++)
+                {
+                    size_t chunkIndex;
+                    if (!m_FilledChunks.TryPop(chunkIndex))
+                    {
+                        const auto start = std::chrono::high_resolution_clock::now();
+                        while (!m_FilledChunks.TryPop(chunkIndex))
+                        {
+                            std::this_thread::yield();
+                        }
+                        m_Stats.trainerWaitSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+                    }
+
+                    // Rows of the chunk go to the same rows of the batch at the slot offset
+                    const Chunk& chunk = m_Chunks[chunkIndex];
+                    for (size_t feature = 0; feature < Topology::INPUT_WIDTH; feature++)
+                    {
+                        std::memcpy(&m_BatchInput[(feature * batchSize) + (slot * CHUNK_SIZE)], &chunk.input[feature * CHUNK_SIZE], CHUNK_SIZE * sizeof(float));
+                    }
+                    for (size_t channel = 0; channel < Topology::OUTPUT_WIDTH; channel++)
+                    {
+                        std::memcpy(&m_BatchTarget[(channel * batchSize) + (slot * CHUNK_SIZE)], &chunk.target[channel * CHUNK_SIZE], CHUNK_SIZE * sizeof(float));
+                    }
+
+                    m_FreeChunks.TryPush(chunkIndex);
+                }
+
+                loss = m_Trainer.TrainBatch(m_BatchInput, m_BatchTarget, batchSize);
+                m_Stats.chunkCount += chunksPerBatch;
+            }
+
+            return loss;
+        }
+
+        const Stats& GetStats()
+        {
+            m_Stats.producerWaitSeconds = static_cast<double>(m_ProducerWaitNs.load(std::memory_order_relaxed)) * 1e-9;
+            return m_Stats;
+        }
+
+    private:
+        struct Chunk
+        {
+            std::vector<float> input;
+            std::vector<float> target;
+        };
+
+        MlpTrainer<Topology>& m_Trainer;
+        Generator m_Generator;
+
+        std::vector<Chunk> m_Chunks;
+        BoundedQueue<size_t> m_FreeChunks;
+        BoundedQueue<size_t> m_FilledChunks;
+
+        std::vector<std::thread> m_Producers;
+        std::atomic<bool> m_Stop;
+        std::atomic<uint64_t> m_ProducerWaitNs;
+
+        std::vector<float> m_BatchInput;
+        std::vector<float> m_BatchTarget;
+        Stats m_Stats;
+
+        void ProducerLoop(size_t producerIndex)
+        {
+            while (!m_Stop.load(std::memory_order_relaxed))
+            {
+                size_t chunkIndex;
+                if (!m_FreeChunks.TryPop(chunkIndex))
+                {
+                    const auto start = std::chrono::high_resolution_clock::now();
+                    while (!m_FreeChunks.TryPop(chunkIndex))
+                    {
+                        if (m_Stop.load(std::memory_order_relaxed))
+                            return;
+                        std::this_thread::yield();
+                    }
+                    const auto waitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+                    m_ProducerWaitNs.fetch_add(static_cast<uint64_t>(waitNs), std::memory_order_relaxed);
+                }
+
+                Chunk& chunk = m_Chunks[chunkIndex];
+                m_Generator(producerIndex, chunk.input.data(), chunk.target.data());
+
+                // Never full, there are only chunkCount indices
+                m_FilledChunks.TryPush(chunkIndex);
+            }
+        }
+    };
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <engine/cpu/OneBlobEncoder.hpp>
+#include <engine/graphics/DirEncoding.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace en::cpu
+{
+    // Real spherical harmonics basis up to DEGREE (DEGREE^2 coefficients), same as EncodeDirSh in the shaders.
+    // dir has to be normalized.
+    template<uint32_t DEGREE>
+    inline void EvalShBasis(const glm::vec3& dir, float* coeffs)
+    {
+        static_assert(DEGREE >= 1 && DEGREE <= 4, "EvalShBasis supports degree 1 to 4");
+
+        const float x = dir.x;
+        const float y = dir.y;
+        const float z = dir.z;
+        const float x2 = x * x;
+        const float y2 = y * y;
+        const float z2 = z * z;
+
+        coeffs[0] = 0.28209479177387814f;
+        if constexpr (DEGREE >= 2)
+        {
+            coeffs[1] = -0.48860251190291987f * y;
+            coeffs[2] = 0.48860251190291987f * z;
+            coeffs[3] = -0.48860251190291987f * x;
+        }
+        if constexpr (DEGREE >= 3)
+        {
+            coeffs[4] = 1.0925484305920792f * x * y;
+            coeffs[5] = -1.0925484305920792f * y * z;
+            coeffs[6] = (0.94617469575755997f * z2) - 0.31539156525251999f;
+            coeffs[7] = -1.0925484305920792f * x * z;
+            coeffs[8] = 0.54627421529603959f * (x2 - y2);
+        }
+        if constexpr (DEGREE >= 4)
+        {
+            coeffs[9] = 0.59004358992664352f * y * ((-3.0f * x2) + y2);
+            coeffs[10] = 2.8906114426405538f * x * y * z;
+            coeffs[11] = 0.45704579946446572f * y * (1.0f - (5.0f * z2));
+            coeffs[12] = 0.3731763325901154f * z * ((5.0f * z2) - 3.0f);
+            coeffs[13] = 0.45704579946446572f * x * (1.0f - (5.0f * z2));
+            coeffs[14] = 1.4453057213202769f * z * (x2 - y2);
+            coeffs[15] = 0.59004358992664352f * x * ((-x2) + (3.0f * y2));
+        }
+    }
+
+    // Host side version of EncodeDir in the shaders with the encoding fixed at compile time. Writes INPUT_WIDTH rows,
+    // the rows past FEATURE_COUNT are zero like the padding of the Mlp input in the shaders.
+    template<DirEncoding ENCODING>
+    class DirEncoder
+    {
+    public:
+        static constexpr uint32_t FEATURE_COUNT = GetDirFeatureCount(ENCODING);
+        static constexpr uint32_t INPUT_WIDTH = GetDirInputWidth(ENCODING);
+
+        explicit DirEncoder(const OneBlobEncoder::Config& oneBlobConfig = OneBlobEncoder::DEFAULT_CONFIG) :
+                m_OneBlob(GetOneBlobBinCount(ENCODING), oneBlobConfig)
+        {
+        }
+
+        // features: features[feature * count + ray]
+        void Encode(std::span<const glm::vec3> dirs, std::span<float> features) const
+        {
+            const size_t count = dirs.size();
+            if (features.size() < INPUT_WIDTH * count)
+                Log::Error("DirEncoder::Encode got a feature buffer that is too small for the batch", true);
+
+            if constexpr (IsOneBlob(ENCODING))
+            {
+                m_OneBlob.Encode(dirs, features);
+            }
+            else
+            {
+                float coeffs[FEATURE_COUNT];
+                for (size_t ray = 0; ray < count; ray++)
+                {
+                    const glm::vec3& dir = dirs[ray];
+                    const float invLength = 1.0f / std::sqrt((dir.x * dir.x) + (dir.y * dir.y) + (dir.z * dir.z));
+                    EvalShBasis<GetShDegree(ENCODING)>(glm::vec3(dir.x * invLength, dir.y * invLength, dir.z * invLength), coeffs);
+                    for (size_t feature = 0; feature < FEATURE_COUNT; feature++)
+                    {
+                        features[(feature * count) + ray] = coeffs[feature];
+                    }
+                }
+            }
+
+            std::fill(features.begin() + (FEATURE_COUNT * count), features.begin() + (INPUT_WIDTH * count), 0.0f);
+        }
+
+    private:
+        OneBlobEncoder m_OneBlob; // Unused for spherical harmonics
+    };
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <engine/util/ThreadPool.hpp>
+#include <engine/util/Aabb.hpp>
+#include <engine/util/VolumeView.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+namespace en::cpu
+{
+    // Lights whose shadow rays the cache replaces, in the order of the GPU buffer
+    enum class CachedLight : uint32_t
+    {
+        Dir = 0,
+        Point = 1
+    };
+
+    // Optical depth toward DirLight and PointLight at the cell centers of a grid over the volume bounds, so a shadow
+    // ray is one trilinear fetch instead of tracking the density. The depth is integrated without densityFactor, the
+    // transmittance is exp(-densityFactor * depth), so only moving a light makes its part stale. Fixed steps of half
+    // a voxel through the values of an R8_UNORM Texture3D, computed on a ThreadPool. Uploaded by VolumeData,
+    // GetGpuData gives the buffer content.
+    class LightTransmittanceCache
+    {
+    public:
+        // Std430 header of the LightTransmittanceCache buffer, followed by the depth of every cell for each
+        // CachedLight, x fastest
+        struct GpuHeader
+        {
+            uint32_t cellCountX;
+            uint32_t cellCountY;
+            uint32_t cellCountZ;
+            uint32_t lightCellCount;
+        };
+
+        // density spans bounds and is copied, a cell covers cellSize^3 voxels
+        LightTransmittanceCache(const VolumeView& density, const Aabb& bounds, uint32_t cellSize);
+
+        // dir points from the light into the volume like the dir of DirLight
+        void ComputeDirLight(ThreadPool& threadPool, const glm::vec3& dir);
+        void ComputePointLight(ThreadPool& threadPool, const glm::vec3& pos);
+
+        // Trilinear between the cell centers with clamp to edge like the shaders
+        float GetOpticalDepth(CachedLight light, const glm::vec3& pos) const;
+
+        size_t GetGpuSize() const { return sizeof(GpuHeader) + (m_Depth.size() * sizeof(float)); }
+        std::vector<uint8_t> GetGpuData() const;
+
+        uint32_t GetCellCountX() const { return m_Header.cellCountX; }
+        uint32_t GetCellCountY() const { return m_Header.cellCountY; }
+        uint32_t GetCellCountZ() const { return m_Header.cellCountZ; }
+        std::span<const float> GetOpticalDepths(CachedLight light) const
+        {
+            return std::span<const float>(m_Depth).subspan(static_cast<size_t>(light) * m_Header.lightCellCount, m_Header.lightCellCount);
+        }
+
+    private:
+        Aabb m_Bounds;
+        GpuHeader m_Header;
+
+        // Density with a zero border voxel on every side like in VolumePathTracer
+        uint32_t m_SizeX;
+        uint32_t m_SizeY;
+        uint32_t m_SizeZ;
+        std::vector<float> m_Density;
+        float m_StepSize;
+
+        std::vector<float> m_Depth;
+
+        glm::vec3 GetCellCenter(uint32_t cellX, uint32_t cellY, uint32_t cellZ) const;
+        float GetDensity(const glm::vec3& pos) const;
+        float IntegrateDensity(const glm::vec3& start, const glm::vec3& dir, float length) const;
+    };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <engine/util/VolumeView.hpp>
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+namespace en::cpu
+{
+    // How GetTransmittance of the shaders and VolumePathTracer integrates the density
+    enum class TransmittanceEstimator : uint32_t
+    {
+        FixedStep = 0, // count uniform steps, biased by the step size
+        Ratio = 1, // Ratio tracking against the brick majorants
+        ResidualRatio = 2 // Ratio tracking of the density above the brick minimum, the minimum is integrated in closed form
+    };
+
+    // Minimum and maximum density of the bricks of brickSize^3 voxels of a density volume. The bounds hold for the
+    // trilinearly filtered density anywhere in a brick, so they include the voxels the filter reaches from its faces
+    // and the zero border outside the volume. They hold for every format of the density Texture3D, the minimum of the
+    // R8_UNORM values and the maximum of the unquantized ones. Without densityFactor, the shaders scale it. Uploaded by VolumeData, GetGpuData gives the buffer content.
+    class MajorantGrid
+    {
+    public:
+        // Std430 header of the MajorantGrid buffer, followed by min and max of every brick, x fastest
+        struct GpuHeader
+        {
+            uint32_t voxelCountX;
+            uint32_t voxelCountY;
+            uint32_t voxelCountZ;
+            uint32_t brickSize;
+            uint32_t brickCountX;
+            uint32_t brickCountY;
+            uint32_t brickCountZ;
+            uint32_t padding;
+        };
+
+        // density is read once, it does not have to outlive the grid
+        MajorantGrid(const VolumeView& density, uint32_t brickSize);
+
+        size_t GetGpuSize() const { return sizeof(GpuHeader) + (m_MinMax.size() * sizeof(float)); }
+        std::vector<uint8_t> GetGpuData() const;
+
+        float GetMin(uint32_t brickX, uint32_t brickY, uint32_t brickZ) const { return m_MinMax[GetBrickIndex(brickX, brickY, brickZ) * 2]; }
+        float GetMax(uint32_t brickX, uint32_t brickY, uint32_t brickZ) const { return m_MinMax[(GetBrickIndex(brickX, brickY, brickZ) * 2) + 1]; }
+
+        uint32_t GetVoxelCountX() const { return m_Header.voxelCountX; }
+        uint32_t GetVoxelCountY() const { return m_Header.voxelCountY; }
+        uint32_t GetVoxelCountZ() const { return m_Header.voxelCountZ; }
+        uint32_t GetBrickSize() const { return m_Header.brickSize; }
+        uint32_t GetBrickCountX() const { return m_Header.brickCountX; }
+        uint32_t GetBrickCountY() const { return m_Header.brickCountY; }
+        uint32_t GetBrickCountZ() const { return m_Header.brickCountZ; }
+        std::span<const float> GetMinMax() const { return m_MinMax; }
+
+    private:
+        GpuHeader m_Header;
+        std::vector<float> m_MinMax;
+
+        size_t GetBrickIndex(uint32_t brickX, uint32_t brickY, uint32_t brickZ) const
+        {
+            return brickX + (static_cast<size_t>(brickY) * m_Header.brickCountX)
+                   + (static_cast<size_t>(brickZ) * m_Header.brickCountX * m_Header.brickCountY);
+        }
+    };
+}
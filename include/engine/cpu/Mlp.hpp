@@ -0,0 +1,177 @@
+#pragma once
+
+#include <engine/cpu/MlpKernels.hpp>
+#include <engine/util/Log.hpp>
+#include <vector>
+#include <span>
+#include <random>
+#include <cstring>
+#include <algorithm>
+
+namespace en::cpu
+{
+    // Host side copy of a network described by an MlpTopology, with the same parameter arena layout as the
+    // NeuralRadianceCache buffer. Evaluates whole batches of rays at once instead of one ray per invocation.
+    template<typename Topology>
+    class Mlp
+    {
+    public:
+        using TopologyType = Topology;
+
+        static constexpr size_t INPUT_WIDTH = Topology::INPUT_WIDTH;
+        static constexpr size_t WIDTH = Topology::WIDTH;
+        static constexpr size_t OUTPUT_WIDTH = Topology::OUTPUT_WIDTH;
+        static constexpr size_t MAX_WIDTH = Topology::MAX_WIDTH;
+        static constexpr size_t LAYER_COUNT = Topology::LAYER_COUNT;
+        static constexpr Activation ACTIVATION = Topology::ACTIVATION;
+
+        static constexpr size_t RAY_BLOCK = cpu::RAY_BLOCK;
+        static constexpr size_t RAY_CHUNK = cpu::RAY_CHUNK;
+        static constexpr size_t FUSED_TILE = cpu::FUSED_TILE;
+
+        static constexpr size_t GetLayerInputCount(size_t layer) { return Topology::GetLayerInputCount(layer); }
+        static constexpr size_t GetLayerOutputCount(size_t layer) { return Topology::GetLayerOutputCount(layer); }
+        static constexpr size_t GetFlopsPerRay() { return Topology::FLOPS_PER_RAY; }
+        static constexpr size_t GetWeightCount() { return Topology::WEIGHT_COUNT; }
+        static constexpr size_t GetParamCount() { return Topology::PARAM_COUNT; }
+
+        Mlp() :
+                m_Params(Topology::PARAM_COUNT, 0.0f)
+        {
+        }
+
+        void InitRandom(uint32_t seed)
+        {
+            // Same distribution as NeuralRadianceCache::InitWeightBuffers
+            std::default_random_engine generator(seed);
+            std::normal_distribution<float> distribution(0.0f, 1.0);
+
+            for (float& weight : GetAllWeights())
+            {
+                weight = distribution(generator) * 0.01f;
+            }
+
+            std::span<float> biases = GetAllBiases();
+            std::fill(biases.begin(), biases.end(), 0.0f);
+        }
+
+        void SetLayer(size_t layer, std::span<const float> weights, std::span<const float> biases)
+        {
+            if (layer >= LAYER_COUNT || weights.size() != Topology::GetLayerWeightCount(layer) || biases.size() != GetLayerOutputCount(layer))
+                Log::Error("Mlp::SetLayer got layer data of wrong size", true);
+
+            std::memcpy(GetWeights(layer).data(), weights.data(), weights.size_bytes());
+            std::memcpy(GetBiases(layer).data(), biases.data(), biases.size_bytes());
+        }
+
+        std::span<const float> GetWeights(size_t layer) const { return GetTensor(Topology::GetWeightTensor(layer)); }
+        std::span<const float> GetBiases(size_t layer) const { return GetTensor(Topology::GetBiasTensor(layer)); }
+        std::span<float> GetWeights(size_t layer) { return GetTensor(Topology::GetWeightTensor(layer)); }
+        std::span<float> GetBiases(size_t layer) { return GetTensor(Topology::GetBiasTensor(layer)); }
+
+        // Whole arena, laid out like the gpu buffer. Saving or restoring the network is a single copy of this.
+        std::span<float> GetParams() { return m_Params; }
+        std::span<const float> GetParams() const { return m_Params; }
+
+        std::span<float> GetAllWeights() { return GetParams().first(Topology::WEIGHT_COUNT); }
+        std::span<float> GetAllBiases() { return GetParams().subspan(Topology::WEIGHT_COUNT); }
+        std::span<const float> GetAllWeights() const { return GetParams().first(Topology::WEIGHT_COUNT); }
+        std::span<const float> GetAllBiases() const { return GetParams().subspan(Topology::WEIGHT_COUNT); }
+
+        std::span<float> GetTensor(MlpTensor tensor) { return GetParams().subspan(tensor.offset, tensor.count); }
+        std::span<const float> GetTensor(MlpTensor tensor) const { return GetParams().subspan(tensor.offset, tensor.count); }
+
+        // input: structure of arrays, input[feature * count + ray]
+        // output: structure of arrays, output[channel * count + ray]
+        void Forward(std::span<const float> input, std::span<float> output, size_t count) const
+        {
+            ForwardTiled<RAY_CHUNK, false>(input, output, count);
+        }
+
+        // Same result as Forward. Evaluates one FUSED_TILE of rays through all layers before moving on, every
+        // weight is broadcast once per tile and the tile accumulators are kept in registers.
+        void ForwardFused(std::span<const float> input, std::span<float> output, size_t count) const
+        {
+            ForwardTiled<FUSED_TILE, true>(input, output, count);
+        }
+
+        // Runs all layers on activations already gathered into act (MAX_WIDTH rows of stride floats), keeping
+        // the output of layer l in act[(l + 1) * MAX_WIDTH * stride]. rayCount must be a multiple of RAY_BLOCK.
+        template<size_t LAYER = 0>
+        void ForwardLayersKeep(float* act, size_t stride, size_t rayCount) const
+        {
+            if constexpr (LAYER < LAYER_COUNT)
+            {
+                const size_t layerSize = MAX_WIDTH * stride;
+                GemmBiasAct<GetLayerOutputCount(LAYER), GetLayerInputCount(LAYER), ACTIVATION>(
+                        &m_Params[Topology::GetWeightTensor(LAYER).offset],
+                        &m_Params[Topology::GetBiasTensor(LAYER).offset],
+                        &act[LAYER * layerSize],
+                        stride,
+                        &act[(LAYER + 1) * layerSize],
+                        stride,
+                        rayCount);
+
+                ForwardLayersKeep<LAYER + 1>(act, stride, rayCount);
+            }
+        }
+
+    private:
+        std::vector<float> m_Params;
+
+        template<size_t TILE, bool FUSED>
+        void ForwardTiled(std::span<const float> input, std::span<float> output, size_t count) const
+        {
+            if (input.size() < INPUT_WIDTH * count || output.size() < OUTPUT_WIDTH * count)
+                Log::Error("Mlp::Forward got buffers that are too small for the batch", true);
+
+            // Ping pong activations for one tile of rays. Tiles are padded to RAY_BLOCK so the kernels never need a tail.
+            alignas(64) float bufferA[MAX_WIDTH * TILE];
+            alignas(64) float bufferB[MAX_WIDTH * TILE];
+
+            for (size_t tileStart = 0; tileStart < count; tileStart += TILE)
+            {
+                const size_t tileCount = std::min(TILE, count - tileStart);
+                const size_t paddedCount = FUSED ? TILE : simd::RoundUp(tileCount, RAY_BLOCK);
+
+                // Gather tile of input
+                for (size_t feature = 0; feature < INPUT_WIDTH; feature++)
+                {
+                    float* dst = &bufferA[feature * TILE];
+                    std::memcpy(dst, &input[feature * count + tileStart], tileCount * sizeof(float));
+                    std::fill(dst + tileCount, dst + paddedCount, 0.0f);
+                }
+
+                // Layers
+                const float* result = ForwardLayers<0, TILE, FUSED>(bufferA, bufferB, paddedCount);
+
+                // Scatter tile of output
+                for (size_t channel = 0; channel < OUTPUT_WIDTH; channel++)
+                {
+                    std::memcpy(&output[channel * count + tileStart], &result[channel * TILE], tileCount * sizeof(float));
+                }
+            }
+        }
+
+        template<size_t LAYER, size_t TILE, bool FUSED>
+        const float* ForwardLayers(float* in, float* out, size_t rayCount) const
+        {
+            if constexpr (LAYER == LAYER_COUNT)
+            {
+                return in;
+            }
+            else
+            {
+                const float* weights = &m_Params[Topology::GetWeightTensor(LAYER).offset];
+                const float* biases = &m_Params[Topology::GetBiasTensor(LAYER).offset];
+
+                if constexpr (FUSED)
+                    GemmBiasActTile<GetLayerOutputCount(LAYER), GetLayerInputCount(LAYER), ACTIVATION>(weights, biases, in, TILE, out, TILE);
+                else
+                    GemmBiasAct<GetLayerOutputCount(LAYER), GetLayerInputCount(LAYER), ACTIVATION>(weights, biases, in, TILE, out, TILE, rayCount);
+
+                return ForwardLayers<LAYER + 1, TILE, FUSED>(out, in, rayCount);
+            }
+        }
+    };
+}
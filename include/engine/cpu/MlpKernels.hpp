@@ -0,0 +1,292 @@
+#pragma once
+
+#include <engine/cpu/Simd.hpp>
+#include <engine/graphics/MlpTopology.hpp>
+
+// Register blocked kernels for Mlp and MlpTrainer. Activations are stored structure of arrays,
+// act[neuron * stride + ray]. Layer sizes are template parameters so every trip count is known at compile time.
+namespace en::cpu
+{
+    // Rays processed by one register block of the batched kernels
+    constexpr size_t RAY_BLOCK = 2 * simd::WIDTH;
+    // Rays kept in the scratch activations at once (64 * 128 floats = 32KiB per buffer)
+    constexpr size_t RAY_CHUNK = 128;
+    // Rays pushed through all layers together by the fused path (64 * 32 floats = 8KiB per buffer, stays in L1)
+    constexpr size_t FUSED_TILE = RAY_BLOCK > 32 ? RAY_BLOCK : 32;
+
+    template<Activation ACT>
+    inline simd::Float Activate(simd::Float x)
+    {
+        if constexpr (ACT == Activation::Relu)
+            return simd::Max(x, simd::Zero());
+        else
+            return x;
+    }
+
+    // Derivative of the activation expressed through its output, applied to x
+    template<Activation ACT>
+    inline simd::Float ActivateDeriv(simd::Float x, simd::Float activated)
+    {
+        if constexpr (ACT == Activation::Relu)
+            return simd::MaskPositive(x, activated);
+        else
+            return x;
+    }
+
+    // ROWS output rows x VECS vectors of rays are kept in registers. Every input value is loaded once per row block
+    // and every weight is broadcast once per ray block.
+    template<size_t IN, Activation ACT, size_t ROWS, size_t VECS>
+    inline void GemmBlock(
+            const float* weights,
+            const float* biases,
+            const float* in,
+            size_t inStride,
+            float* out,
+            size_t outStride,
+            size_t ray)
+    {
+        simd::Float acc[ROWS][VECS];
+        NRC_UNROLL
+        for (size_t r = 0; r < ROWS; r++)
+        {
+            NRC_UNROLL
+            for (size_t v = 0; v < VECS; v++)
+            {
+                acc[r][v] = simd::Set1(biases[r]);
+            }
+        }
+
+        for (size_t k = 0; k < IN; k++)
+        {
+            const float* inRow = &in[k * inStride + ray];
+            simd::Float x[VECS];
+            NRC_UNROLL
+            for (size_t v = 0; v < VECS; v++)
+            {
+                x[v] = simd::Load(inRow + v * simd::WIDTH);
+            }
+
+            NRC_UNROLL
+            for (size_t r = 0; r < ROWS; r++)
+            {
+                simd::Float w = simd::Set1(weights[r * IN + k]);
+                NRC_UNROLL
+                for (size_t v = 0; v < VECS; v++)
+                {
+                    acc[r][v] = simd::Fmadd(w, x[v], acc[r][v]);
+                }
+            }
+        }
+
+        NRC_UNROLL
+        for (size_t r = 0; r < ROWS; r++)
+        {
+            NRC_UNROLL
+            for (size_t v = 0; v < VECS; v++)
+            {
+                simd::Store(&out[r * outStride + ray + v * simd::WIDTH], Activate<ACT>(acc[r][v]));
+            }
+        }
+    }
+
+    // out[row * outStride + ray] = act(bias[row] + sum_k weights[row * IN + k] * in[k * inStride + ray])
+    // rayCount must be a multiple of RAY_BLOCK
+    template<size_t OUT, size_t IN, Activation ACT>
+    inline void GemmBiasAct(
+            const float* weights,
+            const float* biases,
+            const float* in,
+            size_t inStride,
+            float* out,
+            size_t outStride,
+            size_t rayCount)
+    {
+        constexpr size_t ROW_BLOCK = 4;
+        constexpr size_t FULL_ROWS = (OUT / ROW_BLOCK) * ROW_BLOCK;
+
+        for (size_t ray = 0; ray < rayCount; ray += RAY_BLOCK)
+        {
+            for (size_t row = 0; row < FULL_ROWS; row += ROW_BLOCK)
+            {
+                GemmBlock<IN, ACT, ROW_BLOCK, 2>(&weights[row * IN], &biases[row], in, inStride, &out[row * outStride], outStride, ray);
+            }
+
+            for (size_t row = FULL_ROWS; row < OUT; row++)
+            {
+                GemmBlock<IN, ACT, 1, 2>(&weights[row * IN], &biases[row], in, inStride, &out[row * outStride], outStride, ray);
+            }
+        }
+    }
+
+    // Same as GemmBiasAct for exactly FUSED_TILE rays, with all rays of the tile in one register block
+    template<size_t OUT, size_t IN, Activation ACT>
+    inline void GemmBiasActTile(
+            const float* weights,
+            const float* biases,
+            const float* in,
+            size_t inStride,
+            float* out,
+            size_t outStride)
+    {
+        // Rows chosen so the block uses about 8 accumulators
+        constexpr size_t VECS = FUSED_TILE / simd::WIDTH;
+        constexpr size_t ROW_BLOCK = VECS >= 8 ? 1 : 8 / VECS;
+        constexpr size_t FULL_ROWS = (OUT / ROW_BLOCK) * ROW_BLOCK;
+
+        for (size_t row = 0; row < FULL_ROWS; row += ROW_BLOCK)
+        {
+            GemmBlock<IN, ACT, ROW_BLOCK, VECS>(&weights[row * IN], &biases[row], in, inStride, &out[row * outStride], outStride, 0);
+        }
+
+        for (size_t row = FULL_ROWS; row < OUT; row++)
+        {
+            GemmBlock<IN, ACT, 1, VECS>(&weights[row * IN], &biases[row], in, inStride, &out[row * outStride], outStride, 0);
+        }
+    }
+
+    // grad[row][col..col+1] += sum_ray error[row][ray] * act[col..col+1][ray]
+    template<size_t IN, size_t ROWS>
+    inline void WeightGradientBlock(
+            const float* error,
+            const float* act,
+            size_t stride,
+            size_t rayCount,
+            float* gradients,
+            size_t col)
+    {
+        simd::Float acc[ROWS][2];
+        NRC_UNROLL
+        for (size_t r = 0; r < ROWS; r++)
+        {
+            acc[r][0] = simd::Zero();
+            acc[r][1] = simd::Zero();
+        }
+
+        for (size_t ray = 0; ray < rayCount; ray += simd::WIDTH)
+        {
+            simd::Float a0 = simd::Load(&act[col * stride + ray]);
+            simd::Float a1 = simd::Load(&act[(col + 1) * stride + ray]);
+
+            NRC_UNROLL
+            for (size_t r = 0; r < ROWS; r++)
+            {
+                simd::Float e = simd::Load(&error[r * stride + ray]);
+                acc[r][0] = simd::Fmadd(e, a0, acc[r][0]);
+                acc[r][1] = simd::Fmadd(e, a1, acc[r][1]);
+            }
+        }
+
+        NRC_UNROLL
+        for (size_t r = 0; r < ROWS; r++)
+        {
+            gradients[r * IN + col] += simd::ReduceAdd(acc[r][0]);
+            gradients[r * IN + col + 1] += simd::ReduceAdd(acc[r][1]);
+        }
+    }
+
+    // Accumulates the weight and bias gradients of one layer over rayCount rays (multiple of simd::WIDTH)
+    template<size_t OUT, size_t IN>
+    inline void WeightGradients(
+            const float* error,
+            const float* act,
+            size_t stride,
+            size_t rayCount,
+            float* weightGradients,
+            float* biasGradients)
+    {
+        static_assert(IN % 2 == 0, "WeightGradients needs an even layer input count");
+
+        constexpr size_t ROW_BLOCK = 4;
+        constexpr size_t FULL_ROWS = (OUT / ROW_BLOCK) * ROW_BLOCK;
+
+        for (size_t row = 0; row < FULL_ROWS; row += ROW_BLOCK)
+        {
+            for (size_t col = 0; col < IN; col += 2)
+            {
+                WeightGradientBlock<IN, ROW_BLOCK>(&error[row * stride], act, stride, rayCount, &weightGradients[row * IN], col);
+            }
+        }
+
+        for (size_t row = FULL_ROWS; row < OUT; row++)
+        {
+            for (size_t col = 0; col < IN; col += 2)
+            {
+                WeightGradientBlock<IN, 1>(&error[row * stride], act, stride, rayCount, &weightGradients[row * IN], col);
+            }
+        }
+
+        for (size_t row = 0; row < OUT; row++)
+        {
+            simd::Float acc = simd::Zero();
+            for (size_t ray = 0; ray < rayCount; ray += simd::WIDTH)
+            {
+                acc = simd::Add(acc, simd::Load(&error[row * stride + ray]));
+            }
+            biasGradients[row] += simd::ReduceAdd(acc);
+        }
+    }
+
+    // prevError[col][ray] = act'(act[col][ray]) * sum_row weights[row][col] * error[row][ray]
+    template<size_t OUT, size_t IN, Activation ACT, size_t COLS>
+    inline void BackpropErrorBlock(
+            const float* weights,
+            const float* error,
+            const float* act,
+            size_t stride,
+            float* prevError,
+            size_t col,
+            size_t ray)
+    {
+        simd::Float acc[COLS][2];
+        NRC_UNROLL
+        for (size_t c = 0; c < COLS; c++)
+        {
+            acc[c][0] = simd::Zero();
+            acc[c][1] = simd::Zero();
+        }
+
+        for (size_t row = 0; row < OUT; row++)
+        {
+            simd::Float e0 = simd::Load(&error[row * stride + ray]);
+            simd::Float e1 = simd::Load(&error[row * stride + ray + simd::WIDTH]);
+
+            NRC_UNROLL
+            for (size_t c = 0; c < COLS; c++)
+            {
+                simd::Float w = simd::Set1(weights[row * IN + col + c]);
+                acc[c][0] = simd::Fmadd(w, e0, acc[c][0]);
+                acc[c][1] = simd::Fmadd(w, e1, acc[c][1]);
+            }
+        }
+
+        NRC_UNROLL
+        for (size_t c = 0; c < COLS; c++)
+        {
+            const float* actRow = &act[(col + c) * stride + ray];
+            float* dst = &prevError[(col + c) * stride + ray];
+            simd::Store(dst, ActivateDeriv<ACT>(acc[c][0], simd::Load(actRow)));
+            simd::Store(dst + simd::WIDTH, ActivateDeriv<ACT>(acc[c][1], simd::Load(actRow + simd::WIDTH)));
+        }
+    }
+
+    // rayCount must be a multiple of RAY_BLOCK
+    template<size_t OUT, size_t IN, Activation ACT>
+    inline void BackpropError(
+            const float* weights,
+            const float* error,
+            const float* act,
+            size_t stride,
+            size_t rayCount,
+            float* prevError)
+    {
+        static_assert(IN % 4 == 0, "BackpropError needs a layer input count that is a multiple of 4");
+
+        for (size_t ray = 0; ray < rayCount; ray += RAY_BLOCK)
+        {
+            for (size_t col = 0; col < IN; col += 4)
+            {
+                BackpropErrorBlock<OUT, IN, ACT, 4>(weights, error, act, stride, prevError, col, ray);
+            }
+        }
+    }
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <engine/cpu/Mlp.hpp>
+#include <engine/cpu/OptimizerKernels.hpp>
+#include <engine/util/ThreadPool.hpp>
+#include <array>
+#include <cmath>
+
+namespace en::cpu
+{
+    // Host side version of nrc-train.comp and nrc-step.comp. Every thread accumulates gradients into its own
+    // buffer, the buffers are tree reduced once per batch and then a single flat momentum or Adam step is applied to
+    // the parameter arena of the Mlp. Reduction and step clear the gradients they consume, so no separate clear pass.
+    template<typename Topology>
+    class MlpTrainer
+    {
+    public:
+        using MlpType = Mlp<Topology>;
+
+        MlpTrainer(MlpType& mlp, ThreadPool& threadPool, float learningRate, float weightDecay, float beta1) :
+                MlpTrainer(mlp, threadPool, OptimizerConfig::Momentum(learningRate, weightDecay, beta1))
+        {
+        }
+
+        MlpTrainer(MlpType& mlp, ThreadPool& threadPool, const OptimizerConfig& config) :
+                m_Mlp(mlp),
+                m_ThreadPool(threadPool),
+                m_Config(config),
+                m_StepIndex(0),
+                m_Momentum1(PARAM_COUNT, 0.0f),
+                m_Momentum2(config.type == OptimizerType::Adam ? PARAM_COUNT : 0, 0.0f)
+        {
+            m_ThreadStates.resize(m_ThreadPool.GetThreadCount());
+            for (ThreadState& state : m_ThreadStates)
+            {
+                state.activations.resize((Topology::LAYER_COUNT + 1) * LAYER_SIZE, 0.0f);
+                state.errors[0].resize(LAYER_SIZE, 0.0f);
+                state.errors[1].resize(LAYER_SIZE, 0.0f);
+                state.gradients.resize(PARAM_COUNT, 0.0f);
+                state.loss = 0.0;
+            }
+        }
+
+        // input: input[feature * count + ray], target: target[channel * count + ray]
+        // Returns the mse loss of the batch (before the step).
+        float TrainBatch(std::span<const float> input, std::span<const float> target, size_t count)
+        {
+            if (input.size() < Topology::INPUT_WIDTH * count || target.size() < Topology::OUTPUT_WIDTH * count)
+                Log::Error("MlpTrainer::TrainBatch got buffers that are too small for the batch", true);
+
+            if (count == 0)
+                return 0.0f;
+
+            for (ThreadState& state : m_ThreadStates)
+            {
+                state.loss = 0.0;
+            }
+
+            // Forward and backprop, no shared writes
+            const size_t chunkCount = (count + CHUNK - 1) / CHUNK;
+            m_ThreadPool.ParallelFor(chunkCount, [&](size_t chunk, size_t threadIndex)
+            {
+                BackpropChunk(m_ThreadStates[threadIndex], input, target, count, chunk * CHUNK);
+            });
+
+            ReduceGradients();
+
+            double loss = 0.0;
+            for (const ThreadState& state : m_ThreadStates)
+            {
+                loss += state.loss;
+            }
+
+            Step(count);
+
+            return static_cast<float>(loss / static_cast<double>(count));
+        }
+
+        static constexpr size_t GetParamCount() { return PARAM_COUNT; }
+
+    private:
+        // Gradients and moments use the parameter arena layout
+        static constexpr size_t PARAM_COUNT = Topology::PARAM_COUNT;
+        static constexpr size_t CHUNK = RAY_CHUNK;
+        static constexpr size_t LAYER_SIZE = Topology::MAX_WIDTH * CHUNK;
+        static constexpr size_t STEP_BLOCK = 4096;
+
+        struct ThreadState
+        {
+            std::vector<float> activations; // LAYER_COUNT + 1 buffers of MAX_WIDTH x CHUNK
+            std::array<std::vector<float>, 2> errors;
+            std::vector<float> gradients;
+            double loss;
+        };
+
+        MlpType& m_Mlp;
+        ThreadPool& m_ThreadPool;
+
+        OptimizerConfig m_Config;
+        uint32_t m_StepIndex;
+
+        std::vector<float> m_Momentum1;
+        std::vector<float> m_Momentum2; // Adam only
+        std::vector<ThreadState> m_ThreadStates;
+
+        void BackpropChunk(
+                ThreadState& state,
+                std::span<const float> input,
+                std::span<const float> target,
+                size_t count,
+                size_t chunkStart)
+        {
+            const size_t rayCount = std::min(CHUNK, count - chunkStart);
+            const size_t paddedCount = simd::RoundUp(rayCount, RAY_BLOCK);
+
+            // Forward, keeping all activations
+            float* act = state.activations.data();
+            for (size_t feature = 0; feature < Topology::INPUT_WIDTH; feature++)
+            {
+                float* dst = &act[feature * CHUNK];
+                std::memcpy(dst, &input[feature * count + chunkStart], rayCount * sizeof(float));
+                std::fill(dst + rayCount, dst + paddedCount, 0.0f);
+            }
+
+            m_Mlp.ForwardLayersKeep(act, CHUNK, paddedCount);
+
+            // Loss and output error (same 2 * (pred - target) as nrc-train.comp). Padded rays get no error.
+            const float* pred = &act[Topology::LAYER_COUNT * LAYER_SIZE];
+            float* error = state.errors[0].data();
+            double loss = 0.0;
+            for (size_t channel = 0; channel < Topology::OUTPUT_WIDTH; channel++)
+            {
+                for (size_t ray = 0; ray < rayCount; ray++)
+                {
+                    const float predVal = pred[channel * CHUNK + ray];
+                    const float diff = predVal - std::min(target[channel * count + chunkStart + ray], 1024.0f);
+                    loss += static_cast<double>(diff * diff) / static_cast<double>(Topology::OUTPUT_WIDTH);
+                    error[channel * CHUNK + ray] = (Topology::ACTIVATION != Activation::Relu || predVal > 0.0f) ? 2.0f * diff : 0.0f;
+                }
+                std::fill(&error[channel * CHUNK + rayCount], &error[channel * CHUNK + paddedCount], 0.0f);
+            }
+            state.loss += loss;
+
+            BackpropLayers<Topology::LAYER_COUNT - 1>(state, paddedCount);
+        }
+
+        template<size_t LAYER>
+        void BackpropLayers(ThreadState& state, size_t paddedCount)
+        {
+            constexpr size_t OUT = Topology::GetLayerOutputCount(LAYER);
+            constexpr size_t IN = Topology::GetLayerInputCount(LAYER);
+            const float* layerInput = &state.activations[LAYER * LAYER_SIZE];
+
+            WeightGradients<OUT, IN>(
+                    state.errors[0].data(),
+                    layerInput,
+                    CHUNK,
+                    paddedCount,
+                    &state.gradients[Topology::GetWeightTensor(LAYER).offset],
+                    &state.gradients[Topology::GetBiasTensor(LAYER).offset]);
+
+            if constexpr (LAYER > 0)
+            {
+                BackpropError<OUT, IN, Topology::ACTIVATION>(
+                        m_Mlp.GetWeights(LAYER).data(),
+                        state.errors[0].data(),
+                        layerInput,
+                        CHUNK,
+                        paddedCount,
+                        state.errors[1].data());
+                std::swap(state.errors[0], state.errors[1]);
+
+                BackpropLayers<LAYER - 1>(state, paddedCount);
+            }
+        }
+
+        void ReduceGradients()
+        {
+            // Pairwise tree, result ends up in thread state 0 and the other states are left cleared
+            const size_t stateCount = m_ThreadStates.size();
+            for (size_t stride = 1; stride < stateCount; stride *= 2)
+            {
+                const size_t pairCount = (stateCount + 2 * stride - 1) / (2 * stride);
+                m_ThreadPool.ParallelFor(pairCount, [&](size_t pair, size_t)
+                {
+                    const size_t dstIndex = pair * 2 * stride;
+                    const size_t srcIndex = dstIndex + stride;
+                    if (srcIndex >= stateCount)
+                        return;
+
+                    float* dst = m_ThreadStates[dstIndex].gradients.data();
+                    float* src = m_ThreadStates[srcIndex].gradients.data();
+
+                    size_t i = 0;
+                    for (; i + simd::WIDTH <= PARAM_COUNT; i += simd::WIDTH)
+                    {
+                        simd::Store(&dst[i], simd::Add(simd::Load(&dst[i]), simd::Load(&src[i])));
+                        simd::Store(&src[i], simd::Zero());
+                    }
+                    for (; i < PARAM_COUNT; i++)
+                    {
+                        dst[i] += src[i];
+                        src[i] = 0.0f;
+                    }
+                });
+            }
+        }
+
+        void Step(size_t count)
+        {
+            // Gradients are turned into deltas like ONE_OVER_PIXEL_COUNT does on the gpu
+            const float gradientScale = -1.0f / static_cast<float>(count);
+            float* params = m_Mlp.GetParams().data();
+            float* gradients = m_ThreadStates[0].gradients.data();
+            float* momentum1 = m_Momentum1.data();
+            float* momentum2 = m_Momentum2.data();
+            m_Config.Advance(++m_StepIndex);
+
+            // Blocks never straddle the weight / bias border, only weights are reset when they blow up
+            constexpr size_t WEIGHT_BLOCKS = (Topology::WEIGHT_COUNT + STEP_BLOCK - 1) / STEP_BLOCK;
+            constexpr size_t BIAS_BLOCKS = (Topology::BIAS_COUNT + STEP_BLOCK - 1) / STEP_BLOCK;
+            m_ThreadPool.ParallelFor(WEIGHT_BLOCKS + BIAS_BLOCKS, [&](size_t block, size_t)
+            {
+                const bool isWeight = block < WEIGHT_BLOCKS;
+                const size_t begin = isWeight ? block * STEP_BLOCK : Topology::WEIGHT_COUNT + ((block - WEIGHT_BLOCKS) * STEP_BLOCK);
+                const size_t end = std::min(begin + STEP_BLOCK, isWeight ? size_t(Topology::WEIGHT_COUNT) : PARAM_COUNT);
+
+                const size_t count = end - begin;
+                if (m_Config.type == OptimizerType::Adam)
+                {
+                    if (isWeight)
+                        AdamStep<true>(&params[begin], &gradients[begin], &momentum1[begin], &momentum2[begin], count, gradientScale, m_Config);
+                    else
+                        AdamStep<false>(&params[begin], &gradients[begin], &momentum1[begin], &momentum2[begin], count, gradientScale, m_Config);
+                }
+                else
+                {
+                    if (isWeight)
+                        MomentumStep<true>(&params[begin], &gradients[begin], &momentum1[begin], count, gradientScale, m_Config);
+                    else
+                        MomentumStep<false>(&params[begin], &gradients[begin], &momentum1[begin], count, gradientScale, m_Config);
+                }
+            });
+        }
+    };
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <engine/util/Aabb.hpp>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+namespace en::cpu
+{
+    // Host side version of EncodePosMrhe / BackpropMrhe in nrc-train.comp. Uses the same table layout as the MRHE
+    // buffers, table[(((level * hashTableSize) + entry) * FEATURE_COUNT) + feature], so tables can be copied over.
+    // Positions are processed simd::WIDTH at a time: hashing and trilinear weights are vectorised, the corner entries
+    // of every level are prefetched before any of them is read. Levels whose grid fits into the table are indexed
+    // densely, like the MRHE addressing modes.
+    class MrheEncoder
+    {
+    public:
+        static constexpr uint32_t FEATURE_COUNT = 2;
+        static constexpr uint32_t MAX_LEVEL_COUNT = 16;
+
+        struct Config
+        {
+            uint32_t levelCount;
+            uint32_t hashTableSize; // Power of two
+            uint32_t minRes;
+            uint32_t maxRes;
+        };
+
+        // Same settings as the MRHE constructor
+        static constexpr Config DEFAULT_CONFIG = { .levelCount = 16, .hashTableSize = 16384, .minRes = 16, .maxRes = 512 };
+
+        // bounds: volume box the positions are normalized to, the volumeData bounds of the shaders
+        explicit MrheEncoder(const Aabb& bounds, const Config& config = DEFAULT_CONFIG);
+
+        // A level is dense if its (res + 1)^3 grid vertices fit into the table, corners are then clamped to the grid
+        static bool IsDenseLevel(uint32_t resolution, uint32_t hashTableSize);
+
+        // Fraction of the grid vertices of a level that share their table entry with another vertex
+        static float MeasureCollisionRate(uint32_t resolution, uint32_t hashTableSize);
+
+        void InitRandom(uint32_t seed);
+
+        // positions: world space like the shader pos. features: features[(level * FEATURE_COUNT + feature) * count + ray],
+        // which is the input layout of Mlp, so the features can be the first GetOutputWidth() input rows.
+        void Encode(std::span<const glm::vec3> positions, std::span<float> features) const;
+
+        // Adds d(loss)/d(table) to tableGradients (GetParamCount() floats), given featureGradients in the layout of
+        // Encode's output
+        void Backward(std::span<const glm::vec3> positions, std::span<const float> featureGradients, std::span<float> tableGradients) const;
+
+        std::span<float> GetTable() { return m_Table; }
+        std::span<const float> GetTable() const { return m_Table; }
+
+        const Aabb& GetBounds() const { return m_Bounds; }
+        const Config& GetConfig() const { return m_Config; }
+        uint32_t GetResolution(uint32_t level) const { return m_Resolutions[level]; }
+        bool IsDenseLevel(uint32_t level) const { return IsDenseLevel(m_Resolutions[level], m_Config.hashTableSize); }
+        uint32_t GetOutputWidth() const { return m_Config.levelCount * FEATURE_COUNT; }
+        size_t GetParamCount() const { return m_Table.size(); }
+
+    private:
+        Aabb m_Bounds;
+        Config m_Config;
+        std::vector<uint32_t> m_Resolutions;
+        std::vector<float> m_Table;
+
+        struct BlockCorners;
+
+        void ComputeCorners(const glm::vec3* positions, size_t count, BlockCorners& corners) const;
+    };
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <engine/cpu/Mlp.hpp>
+
+namespace en::cpu
+{
+    // Host side copy of the NRC network, same layout as the NeuralRadianceCache buffers
+    using NrcMlp = Mlp<NrcTopology>;
+
+    extern template class Mlp<NrcTopology>;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <engine/cpu/NrcMlp.hpp>
+#include <engine/cpu/MlpTrainer.hpp>
+
+namespace en::cpu
+{
+    using NrcTrainer = MlpTrainer<NrcTopology>;
+
+    extern template class MlpTrainer<NrcTopology>;
+}
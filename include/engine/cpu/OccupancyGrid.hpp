@@ -0,0 +1,78 @@
+#pragma once
+
+#include <engine/cpu/MajorantGrid.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace en::cpu
+{
+    // Two level occupancy of the bricks of a MajorantGrid. A brick is occupied if its maximum density times
+    // densityFactor reaches EMPTY_DENSITY, a macro cell of macroSize^3 bricks if any of its bricks is. Paths leap over
+    // the empty cells with a DDA. Changing densityFactor only flips the bricks whose maximum lies between the old and
+    // the new cutoff. Uploaded by VolumeData, GetGpuData gives the buffer content.
+    class OccupancyGrid
+    {
+    public:
+        // Air below this, a ray along the diagonal of the cloud box loses about 1% to it
+        static constexpr float EMPTY_DENSITY = 0.0001f;
+
+        // Std430 header of the OccupancyGrid buffer, followed by one bit per brick and one bit per macro cell, x fastest
+        struct GpuHeader
+        {
+            uint32_t brickCountX;
+            uint32_t brickCountY;
+            uint32_t brickCountZ;
+            uint32_t macroSize;
+            uint32_t macroCountX;
+            uint32_t macroCountY;
+            uint32_t macroCountZ;
+            uint32_t macroWordOffset;
+        };
+
+        OccupancyGrid(const MajorantGrid& majorantGrid, uint32_t macroSize, float densityFactor);
+
+        // Returns the number of bricks that changed their occupancy
+        size_t SetDensityFactor(float densityFactor);
+        float GetDensityFactor() const { return m_DensityFactor; }
+
+        size_t GetGpuSize() const { return sizeof(GpuHeader) + (m_Words.size() * sizeof(uint32_t)); }
+        std::vector<uint8_t> GetGpuData() const;
+
+        bool IsBrickOccupied(uint32_t brickX, uint32_t brickY, uint32_t brickZ) const
+        {
+            return GetBit(brickX + (m_Header.brickCountX * (brickY + (m_Header.brickCountY * brickZ))));
+        }
+
+        bool IsMacroOccupied(uint32_t macroX, uint32_t macroY, uint32_t macroZ) const
+        {
+            return GetBit((m_Header.macroWordOffset * 32) + macroX + (m_Header.macroCountX * (macroY + (m_Header.macroCountY * macroZ))));
+        }
+
+        uint32_t GetBrickCountX() const { return m_Header.brickCountX; }
+        uint32_t GetBrickCountY() const { return m_Header.brickCountY; }
+        uint32_t GetBrickCountZ() const { return m_Header.brickCountZ; }
+        uint32_t GetMacroSize() const { return m_Header.macroSize; }
+        size_t GetOccupiedBrickCount() const { return m_OccupiedBrickCount; }
+
+    private:
+        GpuHeader m_Header;
+        float m_DensityFactor;
+
+        // Brick maxima in ascending order with their brick index, the bricks at and above the cutoff are occupied
+        std::vector<float> m_SortedMax;
+        std::vector<uint32_t> m_SortedBricks;
+
+        std::vector<uint32_t> m_MacroOccupiedCounts;
+        size_t m_OccupiedBrickCount;
+
+        // Brick bits, then macro cell bits from macroWordOffset
+        std::vector<uint32_t> m_Words;
+
+        static float GetCutoff(float densityFactor);
+        size_t GetCutoffIndex(float cutoff) const;
+        void SetBrickOccupied(uint32_t brickIndex, bool occupied);
+
+        bool GetBit(size_t index) const { return (m_Words[index / 32] & (1u << (index % 32))) != 0; }
+    };
+}
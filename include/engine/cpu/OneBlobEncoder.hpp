@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+namespace en::cpu
+{
+    // Host side version of EncodeDirOneBlob in nrc-train.comp and nrc-forward.frag. Theta and phi are mapped onto
+    // binCount bins each, every feature is a gaussian of the distance between its bin and the angle, so the kernel is
+    // tabulated once over that distance and linearly interpolated. Bins further than the cutoff are 0 without a lookup.
+    // The table is also uploaded by NeuralRadianceCache, GetGpuData gives the buffer content.
+    class OneBlobEncoder
+    {
+    public:
+        static constexpr float SIGMA = 1.0f / 4.0f; // Same as the shaders
+
+        struct Config
+        {
+            uint32_t samplesPerBin; // Table resolution, 0 disables the table
+            float errorBound; // Kernel values below this are treated as 0
+        };
+
+        // Std430 header of the OneBlobTable buffer, followed by sampleCount floats
+        struct GpuHeader
+        {
+            uint32_t sampleCount;
+            float samplesPerBin;
+            float cutoff;
+            uint32_t padding;
+        };
+
+        // Resolution such that the interpolation error stays below errorBound as well
+        static Config ForErrorBound(float errorBound);
+
+        static constexpr Config ANALYTIC_CONFIG = { .samplesPerBin = 0, .errorBound = 0.0f };
+
+        static const Config DEFAULT_CONFIG;
+
+        explicit OneBlobEncoder(uint32_t binCount = 16, const Config& config = DEFAULT_CONFIG);
+
+        // NormGauss of the shaders
+        static float Kernel(float distance);
+
+        // Tabulated kernel, or the analytic one if the table is disabled
+        float LookupKernel(float distance) const;
+
+        // features: features[feature * count + ray] with theta in the first binCount and phi in the second
+        // binCount rows, which matches the direction part of the Mlp input
+        void Encode(std::span<const glm::vec3> dirs, std::span<float> features) const;
+
+        // Same layout as Encode, evaluates every kernel like the shaders do without the table
+        void EncodeAnalytic(std::span<const glm::vec3> dirs, std::span<float> features) const;
+
+        // Largest difference between LookupKernel and Kernel, sampled well below the table spacing
+        float MeasureMaxError() const;
+
+        std::vector<uint8_t> GetGpuData() const;
+
+        const Config& GetConfig() const { return m_Config; }
+        float GetCutoff() const { return m_Cutoff; }
+        size_t GetSampleCount() const { return m_Table.size(); }
+        uint32_t GetBinCount() const { return m_BinCount; }
+        uint32_t GetOutputWidth() const { return 2 * m_BinCount; }
+
+    private:
+        uint32_t m_BinCount;
+        Config m_Config;
+        float m_Cutoff;
+        std::vector<float> m_Table; // Kernel at distance i / samplesPerBin
+
+        // Theta and phi in bin units
+        void GetBinPositions(const glm::vec3& dir, float& theta, float& phi) const;
+    };
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <engine/cpu/Simd.hpp>
+#include <engine/graphics/OptimizerConfig.hpp>
+#include <cmath>
+#include <algorithm>
+#include <span>
+#include <bit>
+
+// Host side version of nrc-step.comp. Walks a flat range of the parameter arena once, every element is read and
+// written exactly once (parameter, gradient and moments).
+namespace en::cpu
+{
+    // Gradients and parameters above this magnitude are treated like NaN/Inf, same as IsNanOrInf in nrc-step.comp
+    constexpr float OPTIMIZER_BORDER = 1000.0f;
+
+    inline void MomentumStepScalar(
+            float& param,
+            float& gradient,
+            float& momentum1,
+            float gradientScale,
+            bool clampParam,
+            const OptimizerConfig& config)
+    {
+        float delta = gradient * gradientScale;
+        if (std::isnan(delta))
+            delta = 0.0f;
+        delta = std::clamp(delta, -OPTIMIZER_BORDER, OPTIMIZER_BORDER);
+        delta -= param * config.weightDecay;
+
+        momentum1 = ((1.0f - config.beta1) * delta) + (config.beta1 * momentum1);
+        param += momentum1 * config.learningRate;
+        if (clampParam && !(std::abs(param) <= OPTIMIZER_BORDER))
+            param = 0.0f;
+
+        gradient = 0.0f;
+    }
+
+    // Sanitises the gradient, applies weight decay, updates the momentum and the parameter and clears the gradient.
+    // Parameters leaving [-OPTIMIZER_BORDER, OPTIMIZER_BORDER] are reset to 0 if CLAMP_PARAMS (weights only).
+    // delta = gradient * gradientScale, the gpu accumulates deltas directly so it uses a scale of 1.
+    template<bool CLAMP_PARAMS>
+    inline void MomentumStep(
+            float* params,
+            float* gradients,
+            float* momentum1,
+            size_t count,
+            float gradientScale,
+            const OptimizerConfig& config)
+    {
+        const simd::Float scale = simd::Set1(gradientScale);
+        const simd::Float decay = simd::Set1(config.weightDecay);
+        const simd::Float beta1 = simd::Set1(config.beta1);
+        const simd::Float oneMinusBeta1 = simd::Set1(1.0f - config.beta1);
+        const simd::Float learningRate = simd::Set1(config.learningRate);
+
+        size_t i = 0;
+        for (; i + simd::WIDTH <= count; i += simd::WIDTH)
+        {
+            simd::Float param = simd::Load(&params[i]);
+            simd::Float delta = simd::ClampMagnitude(simd::Mul(simd::Load(&gradients[i]), scale), OPTIMIZER_BORDER);
+            delta = simd::Sub(delta, simd::Mul(param, decay));
+
+            simd::Float momentum = simd::Fmadd(oneMinusBeta1, delta, simd::Mul(beta1, simd::Load(&momentum1[i])));
+            param = simd::Fmadd(momentum, learningRate, param);
+            if constexpr (CLAMP_PARAMS)
+                param = simd::ZeroIfAbove(param, OPTIMIZER_BORDER);
+
+            simd::Store(&params[i], param);
+            simd::Store(&momentum1[i], momentum);
+            simd::Store(&gradients[i], simd::Zero());
+        }
+
+        for (; i < count; i++)
+        {
+            MomentumStepScalar(params[i], gradients[i], momentum1[i], gradientScale, CLAMP_PARAMS, config);
+        }
+    }
+
+    inline void AdamStepScalar(
+            float& param,
+            float& gradient,
+            float& momentum1,
+            float& momentum2,
+            float gradientScale,
+            bool clampParam,
+            const OptimizerConfig& config)
+    {
+        float delta = gradient * gradientScale;
+        if (std::isnan(delta))
+            delta = 0.0f;
+        delta = std::clamp(delta, -OPTIMIZER_BORDER, OPTIMIZER_BORDER);
+        if (!config.decoupledWeightDecay)
+            delta -= param * config.weightDecay;
+
+        momentum1 = (config.beta1 * momentum1) + ((1.0f - config.beta1) * delta);
+        momentum2 = (config.beta2 * momentum2) + ((1.0f - config.beta2) * delta * delta);
+
+        const float decay = config.decoupledWeightDecay ? config.learningRate * config.weightDecay : 0.0f;
+        const float update = (momentum1 * config.beta1Correction) / (std::sqrt(momentum2 * config.beta2Correction) + config.epsilon);
+        param += (update * config.learningRate) - (param * decay);
+        if (clampParam && !(std::abs(param) <= OPTIMIZER_BORDER))
+            param = 0.0f;
+
+        gradient = 0.0f;
+    }
+
+    // Adam / AdamW version of MomentumStep with bias corrected first and second moments. Deltas point downhill,
+    // so the parameter moves along m / (sqrt(v) + epsilon).
+    template<bool CLAMP_PARAMS>
+    inline void AdamStep(
+            float* params,
+            float* gradients,
+            float* momentum1,
+            float* momentum2,
+            size_t count,
+            float gradientScale,
+            const OptimizerConfig& config)
+    {
+        const simd::Float scale = simd::Set1(gradientScale);
+        const simd::Float coupledDecay = simd::Set1(config.decoupledWeightDecay ? 0.0f : config.weightDecay);
+        const simd::Float decoupledDecay = simd::Set1(config.decoupledWeightDecay ? config.learningRate * config.weightDecay : 0.0f);
+        const simd::Float beta1 = simd::Set1(config.beta1);
+        const simd::Float oneMinusBeta1 = simd::Set1(1.0f - config.beta1);
+        const simd::Float beta2 = simd::Set1(config.beta2);
+        const simd::Float oneMinusBeta2 = simd::Set1(1.0f - config.beta2);
+        const simd::Float beta1Correction = simd::Set1(config.beta1Correction);
+        const simd::Float beta2Correction = simd::Set1(config.beta2Correction);
+        const simd::Float epsilon = simd::Set1(config.epsilon);
+        const simd::Float learningRate = simd::Set1(config.learningRate);
+
+        size_t i = 0;
+        for (; i + simd::WIDTH <= count; i += simd::WIDTH)
+        {
+            simd::Float param = simd::Load(&params[i]);
+            simd::Float delta = simd::ClampMagnitude(simd::Mul(simd::Load(&gradients[i]), scale), OPTIMIZER_BORDER);
+            delta = simd::Sub(delta, simd::Mul(param, coupledDecay));
+
+            const simd::Float m1 = simd::Fmadd(oneMinusBeta1, delta, simd::Mul(beta1, simd::Load(&momentum1[i])));
+            const simd::Float m2 = simd::Fmadd(oneMinusBeta2, simd::Mul(delta, delta), simd::Mul(beta2, simd::Load(&momentum2[i])));
+
+            const simd::Float denom = simd::Add(simd::Sqrt(simd::Mul(m2, beta2Correction)), epsilon);
+            const simd::Float update = simd::Div(simd::Mul(m1, beta1Correction), denom);
+            param = simd::Sub(simd::Fmadd(update, learningRate, param), simd::Mul(param, decoupledDecay));
+            if constexpr (CLAMP_PARAMS)
+                param = simd::ZeroIfAbove(param, OPTIMIZER_BORDER);
+
+            simd::Store(&params[i], param);
+            simd::Store(&momentum1[i], m1);
+            simd::Store(&momentum2[i], m2);
+            simd::Store(&gradients[i], simd::Zero());
+        }
+
+        for (; i < count; i++)
+        {
+            AdamStepScalar(params[i], gradients[i], momentum1[i], momentum2[i], gradientScale, CLAMP_PARAMS, config);
+        }
+    }
+
+    // Sparse step of a hash table (sparse mrhe-step.comp). touchedBits holds one bit per entry of featureCount floats,
+    // only set entries are stepped and their bits cleared. Words are walked in order so memory is still streamed and
+    // fully set words go through the vector kernels. Moments of untouched entries are not decayed.
+    // momentum2 is only used by Adam.
+    inline void SparseStep(
+            float* params,
+            float* gradients,
+            float* momentum1,
+            float* momentum2,
+            std::span<uint32_t> touchedBits,
+            size_t featureCount,
+            float gradientScale,
+            const OptimizerConfig& config)
+    {
+        const bool adam = config.type == OptimizerType::Adam;
+
+        for (size_t word = 0; word < touchedBits.size(); word++)
+        {
+            uint32_t bits = touchedBits[word];
+            if (bits == 0)
+                continue;
+            touchedBits[word] = 0;
+
+            if (bits == 0xFFFFFFFFu)
+            {
+                const size_t begin = word * 32 * featureCount;
+                const size_t count = 32 * featureCount;
+                if (adam)
+                    AdamStep<true>(&params[begin], &gradients[begin], &momentum1[begin], &momentum2[begin], count, gradientScale, config);
+                else
+                    MomentumStep<true>(&params[begin], &gradients[begin], &momentum1[begin], count, gradientScale, config);
+                continue;
+            }
+
+            while (bits != 0)
+            {
+                const size_t entry = (word * 32) + std::countr_zero(bits);
+                bits &= bits - 1;
+
+                for (size_t feature = 0; feature < featureCount; feature++)
+                {
+                    const size_t i = (entry * featureCount) + feature;
+                    if (adam)
+                        AdamStepScalar(params[i], gradients[i], momentum1[i], momentum2[i], gradientScale, true, config);
+                    else
+                        MomentumStepScalar(params[i], gradients[i], momentum1[i], gradientScale, true, config);
+                }
+            }
+        }
+    }
+}
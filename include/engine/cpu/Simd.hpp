@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// Fully unrolls the small fixed size loops of register blocked kernels, so accumulators stay in registers at -O2
+#if defined(__clang__)
+#define NRC_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define NRC_UNROLL _Pragma("GCC unroll 16")
+#else
+#define NRC_UNROLL
+#endif
+
+// Thin wrapper around the widest float vector the build targets. CPU kernels are written once against this
+// and pick up AVX-512, AVX2 (+FMA), SSE2 or plain scalar code depending on the compile flags.
+namespace en::cpu::simd
+{
+#if defined(__AVX512F__)
+    constexpr size_t WIDTH = 16;
+    using Float = __m512;
+    using Int = __m512i;
+
+    inline Float Zero() { return _mm512_setzero_ps(); }
+    inline Float Set1(float v) { return _mm512_set1_ps(v); }
+    inline Float Load(const float* p) { return _mm512_loadu_ps(p); }
+    inline void Store(float* p, Float v) { _mm512_storeu_ps(p, v); }
+    inline Float Add(Float a, Float b) { return _mm512_add_ps(a, b); }
+    inline Float Mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+    inline Float Fmadd(Float a, Float b, Float c) { return _mm512_fmadd_ps(a, b, c); }
+    inline Float Sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+    inline Float Max(Float a, Float b) { return _mm512_max_ps(a, b); }
+    inline Float Min(Float a, Float b) { return _mm512_min_ps(a, b); }
+    inline Float Div(Float a, Float b) { return _mm512_div_ps(a, b); }
+    inline Float Sqrt(Float x) { return _mm512_sqrt_ps(x); }
+    inline float ReduceAdd(Float v) { return _mm512_reduce_add_ps(v); }
+    inline Float ClampMagnitude(Float x, float limit)
+    {
+        Float clamped = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-limit)), _mm512_set1_ps(limit));
+        return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, x, _CMP_ORD_Q), clamped);
+    }
+    inline Float ZeroIfAbove(Float x, float limit)
+    {
+        return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(_mm512_abs_ps(x), _mm512_set1_ps(limit), _CMP_LE_OQ), x);
+    }
+    inline Float MaskPositive(Float x, Float a) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_GT_OQ), x); }
+    inline Float Floor(Float x) { return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+    inline Int ToInt(Float x) { return _mm512_cvttps_epi32(x); }
+    inline Int IntSet1(uint32_t v) { return _mm512_set1_epi32(static_cast<int>(v)); }
+    inline Int IntAdd(Int a, Int b) { return _mm512_add_epi32(a, b); }
+    inline Int IntMul(Int a, Int b) { return _mm512_mullo_epi32(a, b); }
+    inline Int IntAnd(Int a, Int b) { return _mm512_and_si512(a, b); }
+    inline void IntStore(uint32_t* p, Int v) { _mm512_storeu_si512(p, v); }
+#elif defined(__AVX2__)
+    constexpr size_t WIDTH = 8;
+    using Float = __m256;
+    using Int = __m256i;
+
+    inline Float Zero() { return _mm256_setzero_ps(); }
+    inline Float Set1(float v) { return _mm256_set1_ps(v); }
+    inline Float Load(const float* p) { return _mm256_loadu_ps(p); }
+    inline void Store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+    inline Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    inline Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+#if defined(__FMA__) || defined(_MSC_VER)
+    inline Float Fmadd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+    inline Float Fmadd(Float a, Float b, Float c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+    inline Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+    inline Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+    inline Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+    inline Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+    inline Float Sqrt(Float x) { return _mm256_sqrt_ps(x); }
+    inline Float ClampMagnitude(Float x, float limit)
+    {
+        Float clamped = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-limit)), _mm256_set1_ps(limit));
+        return _mm256_and_ps(clamped, _mm256_cmp_ps(x, x, _CMP_ORD_Q));
+    }
+    inline Float ZeroIfAbove(Float x, float limit)
+    {
+        Float abs = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+        return _mm256_and_ps(x, _mm256_cmp_ps(abs, _mm256_set1_ps(limit), _CMP_LE_OQ));
+    }
+    inline float ReduceAdd(Float v)
+    {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+        return _mm_cvtss_f32(sum);
+    }
+    inline Float MaskPositive(Float x, Float a) { return _mm256_and_ps(x, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ)); }
+    inline Float Floor(Float x) { return _mm256_floor_ps(x); }
+    inline Int ToInt(Float x) { return _mm256_cvttps_epi32(x); }
+    inline Int IntSet1(uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+    inline Int IntAdd(Int a, Int b) { return _mm256_add_epi32(a, b); }
+    inline Int IntMul(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+    inline Int IntAnd(Int a, Int b) { return _mm256_and_si256(a, b); }
+    inline void IntStore(uint32_t* p, Int v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+#elif defined(__SSE2__) || defined(_M_X64)
+    constexpr size_t WIDTH = 4;
+    using Float = __m128;
+    using Int = __m128i;
+
+    inline Float Zero() { return _mm_setzero_ps(); }
+    inline Float Set1(float v) { return _mm_set1_ps(v); }
+    inline Float Load(const float* p) { return _mm_loadu_ps(p); }
+    inline void Store(float* p, Float v) { _mm_storeu_ps(p, v); }
+    inline Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+    inline Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+    inline Float Fmadd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    inline Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+    inline Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+    inline Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+    inline Float Div(Float a, Float b) { return _mm_div_ps(a, b); }
+    inline Float Sqrt(Float x) { return _mm_sqrt_ps(x); }
+    inline Float ClampMagnitude(Float x, float limit)
+    {
+        Float clamped = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-limit)), _mm_set1_ps(limit));
+        return _mm_and_ps(clamped, _mm_cmpord_ps(x, x));
+    }
+    inline Float ZeroIfAbove(Float x, float limit)
+    {
+        Float abs = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+        return _mm_and_ps(x, _mm_cmple_ps(abs, _mm_set1_ps(limit)));
+    }
+    inline float ReduceAdd(Float v)
+    {
+        __m128 sum = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+        return _mm_cvtss_f32(sum);
+    }
+    inline Float MaskPositive(Float x, Float a) { return _mm_and_ps(x, _mm_cmpgt_ps(a, _mm_setzero_ps())); }
+    inline Float Floor(Float x)
+    {
+        // No roundps before SSE4.1, truncate and step down where that rounded up
+        Float truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+        return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmplt_ps(x, truncated), _mm_set1_ps(1.0f)));
+    }
+    inline Int ToInt(Float x) { return _mm_cvttps_epi32(x); }
+    inline Int IntSet1(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+    inline Int IntAdd(Int a, Int b) { return _mm_add_epi32(a, b); }
+    inline Int IntMul(Int a, Int b)
+    {
+        // No mullo_epi32 before SSE4.1, multiply even and odd lanes separately
+        __m128i even = _mm_mul_epu32(a, b);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+    inline Int IntAnd(Int a, Int b) { return _mm_and_si128(a, b); }
+    inline void IntStore(uint32_t* p, Int v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+#else
+    constexpr size_t WIDTH = 1;
+    using Float = float;
+    using Int = uint32_t;
+
+    inline Float Zero() { return 0.0f; }
+    inline Float Set1(float v) { return v; }
+    inline Float Load(const float* p) { return *p; }
+    inline void Store(float* p, Float v) { *p = v; }
+    inline Float Add(Float a, Float b) { return a + b; }
+    inline Float Mul(Float a, Float b) { return a * b; }
+    inline Float Fmadd(Float a, Float b, Float c) { return (a * b) + c; }
+    inline Float Sub(Float a, Float b) { return a - b; }
+    inline Float Max(Float a, Float b) { return a > b ? a : b; }
+    inline Float Min(Float a, Float b) { return a < b ? a : b; }
+    inline Float Div(Float a, Float b) { return a / b; }
+    inline Float Sqrt(Float x) { return std::sqrt(x); }
+    inline Float ClampMagnitude(Float x, float limit) { return x != x ? 0.0f : (x > limit ? limit : (x < -limit ? -limit : x)); }
+    inline Float ZeroIfAbove(Float x, float limit) { return (x <= limit && x >= -limit) ? x : 0.0f; }
+    inline float ReduceAdd(Float v) { return v; }
+    inline Float MaskPositive(Float x, Float a) { return a > 0.0f ? x : 0.0f; }
+    inline Float Floor(Float x) { return std::floor(x); }
+    inline Int ToInt(Float x) { return static_cast<uint32_t>(static_cast<int32_t>(x)); }
+    inline Int IntSet1(uint32_t v) { return v; }
+    inline Int IntAdd(Int a, Int b) { return a + b; }
+    inline Int IntMul(Int a, Int b) { return a * b; }
+    inline Int IntAnd(Int a, Int b) { return a & b; }
+    inline void IntStore(uint32_t* p, Int v) { *p = v; }
+#endif
+
+    // MaskPositive(x, a) returns x where a > 0 and 0 elsewhere (relu derivative applied to x)
+    // ClampMagnitude(x, limit) clamps x to [-limit, limit] and maps NaN to 0
+    // ZeroIfAbove(x, limit) returns 0 where |x| > limit or x is NaN
+    // Int holds 32 bit lanes, IntMul keeps the low 32 bits (wraps like uint math in the shaders)
+
+    // Prefetch into all cache levels, used for the scattered hash table reads
+    inline void Prefetch(const void* p)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(p, 0, 3);
+#elif defined(_M_X64)
+        _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#endif
+    }
+
+    inline size_t RoundUp(size_t count, size_t multiple)
+    {
+        return ((count + multiple - 1) / multiple) * multiple;
+    }
+
+    // TransposeBlock(src, srcStride, dst, dstStride) transposes a TRANSPOSE_SIZE x TRANSPOSE_SIZE block, element c of
+    // row r of src becomes element r of row c of dst. Rows are stride floats apart and need no alignment.
+#if defined(__AVX2__) || defined(__AVX512F__)
+    constexpr size_t TRANSPOSE_SIZE = 8;
+
+    inline void TransposeBlock(const float* src, size_t srcStride, float* dst, size_t dstStride)
+    {
+        const __m256 r0 = _mm256_loadu_ps(src);
+        const __m256 r1 = _mm256_loadu_ps(src + srcStride);
+        const __m256 r2 = _mm256_loadu_ps(src + (2 * srcStride));
+        const __m256 r3 = _mm256_loadu_ps(src + (3 * srcStride));
+        const __m256 r4 = _mm256_loadu_ps(src + (4 * srcStride));
+        const __m256 r5 = _mm256_loadu_ps(src + (5 * srcStride));
+        const __m256 r6 = _mm256_loadu_ps(src + (6 * srcStride));
+        const __m256 r7 = _mm256_loadu_ps(src + (7 * srcStride));
+
+        // Interleave pairs of rows, then pairs of pairs within each 128 bit lane, then swap the lanes
+        const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+        const __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+        const __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+        const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+        const __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+        const __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+        const __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+        const __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+        const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+        _mm256_storeu_ps(dst, _mm256_permute2f128_ps(s0, s4, 0x20));
+        _mm256_storeu_ps(dst + dstStride, _mm256_permute2f128_ps(s1, s5, 0x20));
+        _mm256_storeu_ps(dst + (2 * dstStride), _mm256_permute2f128_ps(s2, s6, 0x20));
+        _mm256_storeu_ps(dst + (3 * dstStride), _mm256_permute2f128_ps(s3, s7, 0x20));
+        _mm256_storeu_ps(dst + (4 * dstStride), _mm256_permute2f128_ps(s0, s4, 0x31));
+        _mm256_storeu_ps(dst + (5 * dstStride), _mm256_permute2f128_ps(s1, s5, 0x31));
+        _mm256_storeu_ps(dst + (6 * dstStride), _mm256_permute2f128_ps(s2, s6, 0x31));
+        _mm256_storeu_ps(dst + (7 * dstStride), _mm256_permute2f128_ps(s3, s7, 0x31));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    constexpr size_t TRANSPOSE_SIZE = 4;
+
+    inline void TransposeBlock(const float* src, size_t srcStride, float* dst, size_t dstStride)
+    {
+        __m128 r0 = _mm_loadu_ps(src);
+        __m128 r1 = _mm_loadu_ps(src + srcStride);
+        __m128 r2 = _mm_loadu_ps(src + (2 * srcStride));
+        __m128 r3 = _mm_loadu_ps(src + (3 * srcStride));
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(dst, r0);
+        _mm_storeu_ps(dst + dstStride, r1);
+        _mm_storeu_ps(dst + (2 * dstStride), r2);
+        _mm_storeu_ps(dst + (3 * dstStride), r3);
+    }
+#else
+    constexpr size_t TRANSPOSE_SIZE = 1;
+
+    inline void TransposeBlock(const float* src, size_t, float* dst, size_t) { *dst = *src; }
+#endif
+}
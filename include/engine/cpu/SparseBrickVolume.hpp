@@ -0,0 +1,66 @@
+#pragma once
+
+#include <engine/util/VolumeView.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace en::cpu
+{
+    // Density volume split into bricks of brickSize^3 voxels, of which only the ones with density are stored. A page
+    // table holds the atlas slot of every brick or EMPTY_PAGE, the atlas packs the stored bricks with an apron of one
+    // voxel on every side, so the linear sampler of the atlas texture filters across brick borders like the one of
+    // the dense texture. Converted from the dense layout of ReadFileDensity3D and stored with the values of an
+    // R8_UNORM Texture3D. Uploaded by VolumeData, GetGpuData gives the page table buffer and GetAtlas the content of
+    // the atlas texture.
+    class SparseBrickVolume
+    {
+    public:
+        static constexpr uint32_t EMPTY_PAGE = 0xffffffff;
+
+        // Std430 header of the SparseBrickVolume buffer, followed by the page of every brick, x fastest
+        struct GpuHeader
+        {
+            uint32_t voxelCountX;
+            uint32_t voxelCountY;
+            uint32_t voxelCountZ;
+            uint32_t brickSize; // 0 tells the shaders that the density texture is dense
+            uint32_t brickCountX;
+            uint32_t brickCountY;
+            uint32_t brickCountZ;
+            uint32_t padding;
+            uint32_t atlasBrickCountX;
+            uint32_t atlasBrickCountY;
+            uint32_t atlasBrickCountZ;
+            uint32_t atlasBrickSize; // brickSize with the apron
+        };
+
+        // density is read once. A brick is stored if any voxel of it or its apron is not 0 after quantization.
+        SparseBrickVolume(const VolumeView& density, uint32_t brickSize);
+
+        // Linear sampler of the dense texture with clamp to border at uvw, without densityFactor
+        float Sample(const glm::vec3& uvw) const;
+
+        size_t GetGpuSize() const { return sizeof(GpuHeader) + (m_PageTable.size() * sizeof(uint32_t)); }
+        std::vector<uint8_t> GetGpuData() const;
+
+        // Content of the R8_UNORM atlas texture, x fastest
+        std::vector<float> GetAtlas() const;
+
+        uint32_t GetBrickSize() const { return m_Header.brickSize; }
+        size_t GetBrickCount() const { return m_PageTable.size(); }
+        size_t GetStoredBrickCount() const { return m_StoredBrickCount; }
+        uint32_t GetAtlasSizeX() const { return m_Header.atlasBrickCountX * m_Header.atlasBrickSize; }
+        uint32_t GetAtlasSizeY() const { return m_Header.atlasBrickCountY * m_Header.atlasBrickSize; }
+        uint32_t GetAtlasSizeZ() const { return m_Header.atlasBrickCountZ * m_Header.atlasBrickSize; }
+
+    private:
+        GpuHeader m_Header;
+        std::vector<uint32_t> m_PageTable;
+        size_t m_StoredBrickCount;
+
+        // Stored bricks with their apron one after another, x fastest within a brick
+        std::vector<uint8_t> m_Bricks;
+    };
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace en::cpu
+{
+    // Host side version of en::TrainingSampleBuffer, the training sample ring of nrc-train.comp. Traced
+    // (position, direction, target) records are kept for maxAge steps, every batch takes replayRatio of its records
+    // from the ring and only traces the rest.
+    class TrainingSampleRing
+    {
+    public:
+        struct Record
+        {
+            glm::vec3 pos;
+            glm::vec3 dir;
+            glm::vec3 target;
+            uint32_t step; // Step the record was traced in
+        };
+
+        TrainingSampleRing(size_t capacity, float replayRatio, uint32_t maxAge);
+
+        // Records of a batch that have to be traced, less than batchSize * (1 - replayRatio) only while the ring
+        // does not hold enough records of the last maxAge steps
+        size_t GetNewRecordCount(size_t batchSize) const;
+
+        void Push(const glm::vec3& pos, const glm::vec3& dir, const glm::vec3& target);
+
+        // Appends count records of the last maxAge steps, records pushed in the current step are never replayed
+        void Replay(size_t count, std::vector<Record>& batch);
+
+        // Call once per optimizer step
+        void AdvanceStep();
+
+        void SetReplayRatio(float replayRatio);
+
+        size_t GetCapacity() const { return m_Records.size(); }
+        size_t GetSize() const { return m_Size; }
+        float GetReplayRatio() const { return m_ReplayRatio; }
+        uint32_t GetMaxAge() const { return m_MaxAge; }
+        uint32_t GetStep() const { return m_Step; }
+        float GetLastReplayAge() const { return m_LastReplayAge; }
+
+    private:
+        std::vector<Record> m_Records;
+        size_t m_Next; // Slot of the next push
+        size_t m_Size;
+        float m_ReplayRatio;
+        uint32_t m_MaxAge;
+        uint32_t m_Step;
+        float m_LastReplayAge; // Mean age of the last Replay
+
+        // Record by age order, 0 is the oldest
+        const Record& GetOrdered(size_t index) const;
+
+        // First record by age order traced at step or later, steps grow along the ring so this is a binary search
+        size_t FindFirst(uint32_t step) const;
+    };
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+namespace en::cpu
+{
+    // Plans which screen positions a training step samples. The screen is split into regionCountX x regionCountY
+    // regions, every step distributes its samples over them by a mix of uniform and loss proportional weights, and
+    // each region places its samples in jittered strata whose jitter and order change every step. The sample count
+    // follows a per step time budget. Host side of en::TrainingScheduler, GetSampleUV matches GetTrainUV in
+    // nrc-train.comp.
+    class TrainingSchedule
+    {
+    public:
+        TrainingSchedule(
+                uint32_t regionCountX,
+                uint32_t regionCountY,
+                uint32_t minSampleCount,
+                uint32_t maxSampleCount,
+                float timeBudget);
+
+        // Loss sums and sample counts per region of the last step, regions without samples keep their loss
+        void UpdateLoss(std::span<const float> lossSums, std::span<const uint32_t> sampleCounts);
+
+        // Time the last step took, in the unit of the time budget. Scales the sample count towards the budget.
+        void UpdateCost(float time);
+
+        // Distributes the samples of the next step over the regions and draws the jitter
+        void Plan();
+
+        // Screen uv in [0, 1) of a sample of the current plan
+        void GetSampleUV(uint32_t sampleIndex, float& u, float& v) const;
+        uint32_t GetSampleRegion(uint32_t sampleIndex) const;
+
+        void SetTimeBudget(float timeBudget);
+        void SetUniformRatio(float uniformRatio);
+
+        uint32_t GetRegionCountX() const { return m_RegionCountX; }
+        uint32_t GetRegionCountY() const { return m_RegionCountY; }
+        uint32_t GetRegionCount() const { return m_RegionCountX * m_RegionCountY; }
+        uint32_t GetMaxSampleCount() const { return m_MaxSampleCount; }
+        uint32_t GetSampleCount() const { return m_SampleCount; }
+        float GetTimeBudget() const { return m_TimeBudget; }
+        float GetUniformRatio() const { return m_UniformRatio; }
+        float GetRegionLoss(uint32_t region) const { return m_RegionLoss[region]; }
+
+        // First sample of every region, regionCount + 1 entries
+        std::span<const uint32_t> GetRegionOffsets() const { return m_RegionOffsets; }
+        float GetJitterX() const { return m_JitterX; }
+        float GetJitterY() const { return m_JitterY; }
+        uint32_t GetStratumRotation() const { return m_StratumRotation; }
+
+    private:
+        static constexpr float LOSS_SMOOTHING = 0.1f;
+        // Largest change of the sample count per step, keeps the budget control stable under noisy timings
+        static constexpr float MAX_SAMPLE_COUNT_GROWTH = 1.25f;
+        static constexpr float MIN_SAMPLE_COUNT_GROWTH = 0.5f;
+
+        uint32_t m_RegionCountX;
+        uint32_t m_RegionCountY;
+        uint32_t m_MinSampleCount;
+        uint32_t m_MaxSampleCount;
+        float m_TimeBudget;
+        float m_UniformRatio;
+
+        uint32_t m_Step;
+        uint32_t m_SampleCount;
+        std::vector<float> m_RegionLoss; // Smoothed mean loss
+        std::vector<uint32_t> m_RegionOffsets;
+        float m_JitterX;
+        float m_JitterY;
+        uint32_t m_StratumRotation;
+
+        static float RadicalInverse(uint32_t index, uint32_t base);
+    };
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <engine/cpu/MajorantGrid.hpp>
+#include <engine/cpu/OccupancyGrid.hpp>
+#include <engine/cpu/LightTransmittanceCache.hpp>
+#include <engine/cpu/SparseBrickVolume.hpp>
+#include <engine/util/ThreadPool.hpp>
+#include <engine/util/Rng.hpp>
+#include <engine/util/Aabb.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace en::cpu
+{
+    // Host port of the path tracer of nrc-forward.frag without the NN (TracePath, TraceScene, GetTransmittance,
+    // NewRayDir and SampleHdrEnvMap). Takes the inputs of VolumeData, DirLight, PointLight and HdrEnvMap and seeds
+    // every pixel like TracePathMultiple, so it renders the image the shader converges to without a Vulkan device.
+    // Tiles are distributed with ThreadPool::ParallelForStealing.
+    class VolumePathTracer
+    {
+    public:
+        static constexpr uint32_t TILE_SIZE = 16;
+        static constexpr uint32_t MAJORANT_BRICK_SIZE = 8; // Same as VolumeData
+        static constexpr uint32_t OCCUPANCY_MACRO_SIZE = 4; // Same as VolumeData
+        static constexpr uint32_t LIGHT_CACHE_CELL_SIZE = 2; // Same as VolumeData
+
+        struct RenderStats
+        {
+            size_t pathCount; // Pixels that miss the volume do not trace any
+            size_t stepCount; // Iterations of the TracePath loops
+            size_t scatterCount; // Steps with density, they trace the scene lighting and cost most of the frame
+        };
+
+        // density is copied and quantized to 8 bit like an R8_UNORM Texture3D, it spans bounds like in VolumeData
+        VolumePathTracer(const VolumeView& density, const Aabb& bounds, float densityFactor, float g);
+
+        // Same parameters as DirLight, the shaders ignore the color
+        void SetDirLight(float zenith, float azimuth, float strength);
+        void SetPointLight(const glm::vec3& pos, const glm::vec3& color, float strength);
+
+        // hdr4f is the RGBA data of ReadFileHdr4f. Without an env map the sky is black.
+        void SetHdrEnvMap(uint32_t width, uint32_t height, const std::vector<float>& hdr4f, float directStrength, float hpmStrength);
+
+        // Same rays as en::Camera through the full screen quad of nrc-forward.vert, the clip planes do not matter
+        void SetCamera(const glm::vec3& pos, const glm::vec3& viewDir, const glm::vec3& up, float aspectRatio, float fov);
+
+        // FixedStep by default like the shaders, count of GetTransmittance only matters for it
+        void SetTransmittanceEstimator(TransmittanceEstimator estimator);
+
+        // Off by default like in the shaders. Paths then leap over the empty cells of the occupancy grid.
+        void SetEmptySpaceSkipping(bool enabled);
+
+        // Off by default. Shadow rays toward the lights then fetch the optical depth of a LightTransmittanceCache like
+        // the shaders with the cache of VolumeData enabled. Recomputes the part of every light set since the last call,
+        // Render fails while one is stale.
+        void UpdateLightTransmittanceCache(ThreadPool& threadPool);
+        void DisableLightTransmittanceCache();
+
+        // Off by default. Density lookups then go through the page table of sparseVolume like the shaders with a
+        // sparse VolumeData, it has to outlive the tracer and be converted from the same density. nullptr goes back to
+        // the dense lookup.
+        void SetSparseVolume(const SparseBrickVolume* sparseVolume);
+
+        // Renders sampleCount paths per pixel into rgba (width * height RGBA, top row first like WriteEXR expects).
+        // Alpha is the transmittance like in the shader.
+        RenderStats Render(ThreadPool& threadPool, uint32_t width, uint32_t height, uint32_t sampleCount, uint32_t frameIndex, std::vector<float>& rgba) const;
+
+        // Color of one pixel like main of nrc-forward.frag, adds its paths and steps to stats
+        glm::vec4 TracePixel(
+                uint32_t x,
+                uint32_t y,
+                uint32_t width,
+                uint32_t height,
+                uint32_t sampleCount,
+                uint32_t frameIndex,
+                RenderStats& stats) const;
+
+        // Transmittance between two points in the volume with the current estimator
+        float GetTransmittance(const glm::vec3& start, const glm::vec3& end, uint32_t count, Rng& rng) const;
+
+        // Distance along dir to the first occupied brick, negative if the ray leaves the grid before
+        float GetEmptyDistance(const glm::vec3& pos, const glm::vec3& dir) const;
+
+        const MajorantGrid& GetMajorantGrid() const { return m_MajorantGrid; }
+        const OccupancyGrid& GetOccupancyGrid() const { return m_OccupancyGrid; }
+        const LightTransmittanceCache& GetLightTransmittanceCache() const { return m_LightCache; }
+
+    private:
+        static constexpr uint32_t PATH_STEP_COUNT = 32; // TRUE_TRACE_SAMPLE_COUNT
+        static constexpr uint32_t ENV_SAMPLE_COUNT = 8;
+        static constexpr uint32_t MAX_TRACKING_STEPS = 256; // Same as the shaders
+        static constexpr uint32_t MAX_LEAP_STEPS = 64; // Same as the shaders
+
+        Aabb m_Bounds;
+
+        // Density with a zero border voxel on every side, so the trilinear lookup matches the clamp to border sampler
+        uint32_t m_SizeX;
+        uint32_t m_SizeY;
+        uint32_t m_SizeZ;
+        std::vector<float> m_Density;
+        const SparseBrickVolume* m_SparseVolume;
+        float m_DensityFactor;
+        float m_G;
+        MajorantGrid m_MajorantGrid;
+        TransmittanceEstimator m_TransmittanceEstimator;
+        OccupancyGrid m_OccupancyGrid;
+        bool m_EmptySpaceSkipping;
+        LightTransmittanceCache m_LightCache;
+        bool m_LightCacheEnabled;
+        bool m_DirLightCacheStale;
+        bool m_PointLightCacheStale;
+
+        glm::vec3 m_DirLightDir;
+        float m_DirLightStrength;
+
+        glm::vec3 m_PointLightPos;
+        glm::vec3 m_PointLightColor;
+        float m_PointLightStrength;
+
+        uint32_t m_HdrWidth;
+        uint32_t m_HdrHeight;
+        std::vector<float> m_Hdr4f;
+        float m_HdrDirectStrength;
+        float m_HdrHpmStrength;
+
+        glm::vec3 m_CameraPos;
+        glm::vec3 m_CameraForward;
+        glm::vec3 m_CameraRight;
+        glm::vec3 m_CameraUp;
+
+        glm::vec3 GetRayDir(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const;
+        glm::vec3 FindExit(const glm::vec3& pos, const glm::vec3& dir) const;
+
+        float GetDensity(const glm::vec3& pos) const;
+        float GetPhase(float cosTheta) const;
+        glm::vec3 NewRayDir(glm::vec3 oldRayDir, Rng& rng) const;
+        float GetTransmittanceFixedStep(const glm::vec3& start, const glm::vec3& end, uint32_t count) const;
+        float GetTransmittanceTracked(const glm::vec3& start, const glm::vec3& end, bool residual, Rng& rng) const;
+
+        glm::vec3 TraceDirLight(const glm::vec3& pos, const glm::vec3& dir, Rng& rng) const;
+        glm::vec3 TracePointLight(const glm::vec3& pos, const glm::vec3& dir, Rng& rng) const;
+        glm::vec3 SampleHdrEnvMap(const glm::vec3& dir, bool hpm) const;
+        glm::vec3 SampleHdrEnvMap(const glm::vec3& pos, const glm::vec3& dir, uint32_t sampleCount, Rng& rng) const;
+        glm::vec3 TraceScene(const glm::vec3& pos, const glm::vec3& dir, Rng& rng) const;
+
+        // Scattered light in xyz, transmittance in w. Adds the loop iterations and scatter events to stats.
+        glm::vec4 TracePath(const glm::vec3& rayOrigin, const glm::vec3& rayDir, Rng& rng, RenderStats& stats) const;
+    };
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <engine/util/VolumeView.hpp>
+#include <engine/util/ThreadPool.hpp>
+#include <cstdint>
+#include <cstddef>
+
+namespace en::cpu
+{
+    // Single channel texel formats of Texture3D
+    enum class TexelFormat : uint32_t
+    {
+        R8Unorm = 0, // Truncates like the RGBA8 constructors of Texture3D
+        R16Sfloat = 1,
+        R32Sfloat = 2
+    };
+
+    size_t GetTexelSize(TexelFormat format);
+
+    // Writes volume in the texel order of a Texture3D (x fastest) and in format to texels, which holds
+    // GetVoxelCount() * GetTexelSize(format) bytes, e.g. a mapped staging buffer. Parallel over y, each item gathers
+    // rows of x for simd::TRANSPOSE_SIZE slices of z at a time, from the z fastest layout of the density files with
+    // SIMD block transposes.
+    void WriteTexels(ThreadPool& threadPool, const VolumeView& volume, TexelFormat format, void* texels);
+}
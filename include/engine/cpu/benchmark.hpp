@@ -0,0 +1,7 @@
+#pragma once
+
+namespace en::cpu
+{
+    // Runs the host side benchmarks and logs their results. Does not need a Vulkan device.
+    void RunBenchmarks();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+namespace en
+{
+    // Direction part of the NRC input. Selected at compile time, the shaders get it as the DIR_ENCODING
+    // specialization constant (values match the DIR_ENCODING_* defines of nrc-train.comp and nrc-forward.frag).
+    enum class DirEncoding : uint32_t
+    {
+        OneBlob16 = 0, // 8 bins for theta and 8 for phi
+        OneBlob32 = 1, // 16 bins for theta and 16 for phi
+        SphericalHarmonics2 = 2, // Degree 2, 4 coefficients
+        SphericalHarmonics3 = 3, // Degree 3, 9 coefficients
+        SphericalHarmonics4 = 4 // Degree 4, 16 coefficients
+    };
+
+    constexpr uint32_t DIR_ENCODING_SPEC_CONSTANT_ID = 15;
+
+    constexpr bool IsOneBlob(DirEncoding encoding)
+    {
+        return encoding == DirEncoding::OneBlob16 || encoding == DirEncoding::OneBlob32;
+    }
+
+    // Bins per angle, 0 for spherical harmonics
+    constexpr uint32_t GetOneBlobBinCount(DirEncoding encoding)
+    {
+        return encoding == DirEncoding::OneBlob16 ? 8 : (encoding == DirEncoding::OneBlob32 ? 16 : 0);
+    }
+
+    // Number of bands, 0 for one blob
+    constexpr uint32_t GetShDegree(DirEncoding encoding)
+    {
+        return IsOneBlob(encoding) ? 0 : static_cast<uint32_t>(encoding);
+    }
+
+    constexpr uint32_t GetDirFeatureCount(DirEncoding encoding)
+    {
+        return IsOneBlob(encoding) ? 2 * GetOneBlobBinCount(encoding) : GetShDegree(encoding) * GetShDegree(encoding);
+    }
+
+    // Input rows taken by the encoding, zero padded to a multiple of 4 for the host kernels
+    constexpr uint32_t GetDirInputWidth(DirEncoding encoding)
+    {
+        return ((GetDirFeatureCount(encoding) + 3) / 4) * 4;
+    }
+}
@@ -32,6 +32,13 @@ namespace en
 
         VkDescriptorSet GetDescriptorSet() const;
 
+        // Points from the light into the volume
+        const glm::vec3& GetDir() const;
+        float GetStrength() const;
+
+        // Incremented by UpdateBuffer whenever the direction changes, invalidates the light transmittance cache
+        size_t GetDirVersion() const;
+
         void RenderImgui();
 
     private:
@@ -41,6 +48,7 @@ namespace en
         DirLightData m_DirLightData;
         VkDescriptorSet m_DescriptorSet;
         vk::Buffer m_UniformBuffer;
+        size_t m_DirVersion;
 
         void UpdateBuffer();
     };
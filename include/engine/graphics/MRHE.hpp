@@ -1,37 +1,65 @@
 #pragma once
 
 #include <engine/graphics/vulkan/Buffer.hpp>
+#include <engine/graphics/OptimizerConfig.hpp>
+#include <vector>
 
 namespace en
 {
     class MRHE
     {
     public:
+        // How the grid vertices of a level are mapped to table entries, same values as the MRHE_* defines in the shaders
+        enum class Addressing : uint32_t
+        {
+            Hashed = 0,
+            Dense = 1 // (res + 1)^3 fits into the table, vertex index is used directly
+        };
+
+        // Start of the touched entries buffer, doubles as VkDispatchIndirectCommand of the sparse mrhe step
+        struct TouchedEntriesHeader
+        {
+            uint32_t groupCountX;
+            uint32_t groupCountY;
+            uint32_t groupCountZ;
+            uint32_t entryCount;
+        };
+
         static void Init(VkDevice device);
         static void Shutdown(VkDevice device);
         static VkDescriptorSetLayout GetDescriptorSetLayout();
 
         MRHE(float learningRate, float weightDecay);
+        MRHE(const OptimizerConfig& optimizerConfig);
 
         void Destroy();
 
+        // Updates the Adam bias correction, call once per submitted training step
+        void AdvanceOptimizer();
+
         void PrintHashTables() const;
 
         VkDescriptorSet GetDescriptorSet() const;
 
         size_t GetHashTableSize() const;
+        Addressing GetAddressing(uint32_t level) const;
+        float GetCollisionRate(uint32_t level) const;
+        uint32_t GetEntryCount() const;
+        VkBuffer GetTouchedEntriesBuffer() const;
 
     private:
         struct UniformData
         {
-            float learningRate;
-            float weightDecay;
             uint32_t levelCount;
-            uint32_t hashTableSize;
+            uint32_t hashTableSize; // Power of two
+            uint32_t hashTableMask;
             uint32_t featureCount;
             uint32_t minRes;
             uint32_t maxRes;
-            uint32_t resolutions[16];
+            uint32_t padding[2];
+            // uvec4[4] in the shaders, std140 would pad every element of a uint[16] to 16 bytes
+            alignas(16) uint32_t resolutions[16];
+            alignas(16) Addressing addressing[16];
         };
 
         static VkDescriptorSetLayout m_DescSetLayout;
@@ -39,10 +67,21 @@ namespace en
 
         UniformData m_UniformData;
         vk::Buffer m_UniformBuffer;
+        std::vector<float> m_CollisionRates;
         VkDescriptorSet m_DescSet;
 
+        OptimizerConfig m_OptimizerConfig;
+        uint32_t m_StepIndex;
+        vk::Buffer m_OptimizerUniformBuffer;
+
         size_t m_HashTablesSize;
         vk::Buffer m_HashTablesBuffer;
         vk::Buffer m_DeltaHashTablesBuffer;
+        vk::Buffer m_MomentsBuffer; // Momentum 1 and 2, m_HashTablesSize each
+
+        // Sparse step bookkeeping, one list slot and one bit per entry
+        uint32_t m_EntryCount;
+        vk::Buffer m_TouchedEntriesBuffer;
+        vk::Buffer m_TouchedBitsBuffer;
     };
 }
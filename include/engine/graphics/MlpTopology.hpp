@@ -0,0 +1,141 @@
+#pragma once
+
+#include <engine/graphics/DirEncoding.hpp>
+#include <cstdint>
+#include <array>
+
+namespace en
+{
+    enum class Activation
+    {
+        Relu,
+        Linear
+    };
+
+    // Range of one weight matrix or bias vector inside the parameter arena
+    struct MlpTensor
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // Compile time description of a fully connected network with HiddenLayers hidden layers of Width neurons.
+    // All parameters live in one arena: the row major ([out][in]) weights layer after layer, then the biases.
+    // Gradients and optimizer moments use arenas with the same layout.
+    // Buffer sizes, the host kernels and the shader specialization constants are all derived from this.
+    template<uint32_t Width, uint32_t HiddenLayers, Activation Act, uint32_t InputWidth = Width, uint32_t OutputWidth = 3>
+    struct MlpTopology
+    {
+        static_assert(HiddenLayers > 0, "MlpTopology needs at least one hidden layer");
+
+        static constexpr uint32_t INPUT_WIDTH = InputWidth;
+        static constexpr uint32_t WIDTH = Width;
+        static constexpr uint32_t OUTPUT_WIDTH = OutputWidth;
+        static constexpr uint32_t HIDDEN_LAYERS = HiddenLayers;
+        static constexpr uint32_t LAYER_COUNT = HiddenLayers + 1;
+        static constexpr Activation ACTIVATION = Act;
+
+        static constexpr uint32_t MAX_WIDTH =
+                (InputWidth > Width ? InputWidth : Width) > OutputWidth
+                ? (InputWidth > Width ? InputWidth : Width)
+                : OutputWidth;
+
+        static constexpr uint32_t WEIGHT_COUNT = (InputWidth * Width) + ((HiddenLayers - 1) * Width * Width) + (Width * OutputWidth);
+        static constexpr uint32_t BIAS_COUNT = (HiddenLayers * Width) + OutputWidth;
+        static constexpr uint32_t PARAM_COUNT = WEIGHT_COUNT + BIAS_COUNT;
+        static constexpr uint32_t TENSOR_COUNT = 2 * LAYER_COUNT;
+        static constexpr uint32_t FLOPS_PER_RAY = 2 * WEIGHT_COUNT;
+
+        static constexpr uint32_t GetLayerInputCount(uint32_t layer)
+        {
+            return layer == 0 ? INPUT_WIDTH : WIDTH;
+        }
+
+        static constexpr uint32_t GetLayerOutputCount(uint32_t layer)
+        {
+            return layer == LAYER_COUNT - 1 ? OUTPUT_WIDTH : WIDTH;
+        }
+
+        static constexpr uint32_t GetLayerWeightCount(uint32_t layer)
+        {
+            return GetLayerOutputCount(layer) * GetLayerInputCount(layer);
+        }
+
+        static constexpr uint32_t GetWeightOffset(uint32_t layer)
+        {
+            uint32_t offset = 0;
+            for (uint32_t i = 0; i < layer; i++)
+            {
+                offset += GetLayerWeightCount(i);
+            }
+            return offset;
+        }
+
+        // Relative to the start of the biases
+        static constexpr uint32_t GetBiasOffset(uint32_t layer)
+        {
+            uint32_t offset = 0;
+            for (uint32_t i = 0; i < layer; i++)
+            {
+                offset += GetLayerOutputCount(i);
+            }
+            return offset;
+        }
+
+        static constexpr MlpTensor GetWeightTensor(uint32_t layer)
+        {
+            return { .offset = GetWeightOffset(layer), .count = GetLayerWeightCount(layer) };
+        }
+
+        static constexpr MlpTensor GetBiasTensor(uint32_t layer)
+        {
+            return { .offset = WEIGHT_COUNT + GetBiasOffset(layer), .count = GetLayerOutputCount(layer) };
+        }
+
+        // Offset table of the arena, weights of all layers followed by biases of all layers
+        static constexpr std::array<MlpTensor, TENSOR_COUNT> GetTensors()
+        {
+            std::array<MlpTensor, TENSOR_COUNT> tensors{};
+            for (uint32_t layer = 0; layer < LAYER_COUNT; layer++)
+            {
+                tensors[layer] = GetWeightTensor(layer);
+                tensors[LAYER_COUNT + layer] = GetBiasTensor(layer);
+            }
+            return tensors;
+        }
+    };
+
+    // Values of the MLP_* specialization constants (ids MLP_SPEC_CONSTANT_ID to MLP_SPEC_CONSTANT_ID + 4) used by
+    // nrc-train.comp, nrc-step.comp and nrc-forward.frag
+    struct MlpSpecData
+    {
+        uint32_t inputWidth;
+        uint32_t width;
+        uint32_t outputWidth;
+        uint32_t hiddenLayers;
+        uint32_t maxWidth;
+    };
+
+    constexpr uint32_t MLP_SPEC_CONSTANT_ID = 10;
+
+    template<typename Topology>
+    constexpr MlpSpecData MakeMlpSpecData()
+    {
+        // The shaders have no activation constant, their hidden layers are always Relu
+        static_assert(Topology::ACTIVATION == Activation::Relu, "The MLP shaders only implement Activation::Relu");
+
+        return {
+                .inputWidth = Topology::INPUT_WIDTH,
+                .width = Topology::WIDTH,
+                .outputWidth = Topology::OUTPUT_WIDTH,
+                .hiddenLayers = Topology::HIDDEN_LAYERS,
+                .maxWidth = Topology::MAX_WIDTH };
+    }
+
+    // Input of the NRC network: 32 mrhe features followed by the direction encoding
+    constexpr uint32_t NRC_POS_INPUT_WIDTH = 32;
+    constexpr DirEncoding NRC_DIR_ENCODING = DirEncoding::OneBlob32;
+
+    // 5 hidden layers of 64, rgb out
+    using NrcTopology = MlpTopology<64, 5, Activation::Relu, NRC_POS_INPUT_WIDTH + GetDirInputWidth(NRC_DIR_ENCODING), 3>;
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <engine/graphics/vulkan/Buffer.hpp>
+#include <engine/graphics/MlpTopology.hpp>
+#include <engine/graphics/OptimizerConfig.hpp>
+#include <engine/cpu/OneBlobEncoder.hpp>
 #include <array>
 
 namespace en
@@ -8,6 +11,9 @@ namespace en
     class NeuralRadianceCache
     {
     public:
+        using Topology = NrcTopology;
+        static constexpr DirEncoding DIR_ENCODING = NRC_DIR_ENCODING;
+
         struct StatsData
         {
             float mseLoss;
@@ -16,47 +22,67 @@ namespace en
         static void Init(VkDevice device);
         static void Shutdown(VkDevice device);
         static VkDescriptorSetLayout GetDescSetLayout();
+        static MlpSpecData GetMlpSpecData();
+        // Map entries for an MlpSpecData placed at offset inside a pipelines specialization data
+        static std::array<VkSpecializationMapEntry, 5> GetMlpSpecMapEntries(uint32_t offset);
+        // Map entry for the DIR_ENCODING constant, a uint32_t placed at offset
+        static VkSpecializationMapEntry GetDirEncodingSpecMapEntry(uint32_t offset);
 
         NeuralRadianceCache(float learningRate, float weightDecay, float beta1);
+        // oneBlobConfig selects the tabulated direction encoding, ANALYTIC_CONFIG keeps the exp per feature
+        NeuralRadianceCache(
+                const OptimizerConfig& optimizerConfig,
+                const cpu::OneBlobEncoder::Config& oneBlobConfig = cpu::OneBlobEncoder::DEFAULT_CONFIG);
 
         void Destroy();
 
         void ResetStats();
 
+        // Updates the Adam bias correction, call once per submitted training step
+        void AdvanceOptimizer();
+
         VkDescriptorSet GetDescSet() const;
 
         const StatsData& GetStats();
 
         void PrintWeights() const;
 
+        // Checkpointing, the whole parameter arena in MlpTopology layout
+        std::vector<float> DownloadParams() const;
+        void UploadParams(const std::vector<float>& params);
+
     private:
-        struct ConfigData
+        // Regions of the arena buffer, each Topology::PARAM_COUNT floats
+        enum ArenaRegion : uint32_t
         {
-            float learningRate;
-            float weightDecay;
-            float beta1;
+            ARENA_PARAMS = 0,
+            ARENA_GRADIENTS = 1,
+            ARENA_MOMENTUM1 = 2,
+            ARENA_MOMENTUM2 = 3,
+            ARENA_REGION_COUNT = 4
         };
 
+        static constexpr VkDeviceSize ARENA_REGION_SIZE = Topology::PARAM_COUNT * sizeof(float);
+
         static VkDescriptorSetLayout m_DescSetLayout;
         static VkDescriptorPool m_DescPool;
 
-        std::array<vk::Buffer*, 6> m_Weights;
-        std::array<vk::Buffer*, 6> m_DeltaWeights;
-        std::array<vk::Buffer*, 6> m_Momentum1Weights;
-
-        std::array<vk::Buffer*, 6> m_Biases;
-        std::array<vk::Buffer*, 6> m_DeltaBiases;
-        std::array<vk::Buffer*, 6> m_Momentum1Biases;
-
-        ConfigData m_ConfigData;
+        OptimizerConfig m_ConfigData;
+        uint32_t m_StepIndex;
         vk::Buffer m_ConfigUniformBuffer;
 
         StatsData m_StatsData;
         vk::Buffer m_StatsBuffer;
 
+        // Parameters, gradients and optimizer moments of all layers in one allocation
+        vk::Buffer m_ArenaBuffer;
+
+        // OneBlob kernel table, read only
+        std::vector<uint8_t> m_OneBlobData;
+        vk::Buffer m_OneBlobBuffer;
+
         VkDescriptorSet m_DescSet;
 
-        void InitWeightBuffers();
-        void InitBiasBuffers();
+        void InitArena();
     };
 }
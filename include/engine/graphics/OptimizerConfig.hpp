@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+namespace en
+{
+    enum class OptimizerType : uint32_t
+    {
+        Momentum = 0,
+        Adam = 1
+    };
+
+    // Optimizer settings of one parameter group (nrc params, mrhe hash tables). Only 4 byte scalars, so the layout
+    // matches the std140 OptimizerConfig blocks of nrc-step.comp and mrhe-step.comp.
+    struct OptimizerConfig
+    {
+        OptimizerType type;
+        float learningRate;
+        float weightDecay;
+        float beta1;
+        float beta2;
+        float epsilon;
+        uint32_t decoupledWeightDecay; // AdamW, decay is applied to the parameter instead of the gradient
+        // Adam bias correction 1 / (1 - beta^t), updated by Advance
+        float beta1Correction;
+        float beta2Correction;
+
+        static OptimizerConfig Momentum(float learningRate, float weightDecay, float beta1)
+        {
+            return {
+                    .type = OptimizerType::Momentum,
+                    .learningRate = learningRate,
+                    .weightDecay = weightDecay,
+                    .beta1 = beta1,
+                    .beta2 = 0.0f,
+                    .epsilon = 0.0f,
+                    .decoupledWeightDecay = 0,
+                    .beta1Correction = 1.0f,
+                    .beta2Correction = 1.0f };
+        }
+
+        static OptimizerConfig Adam(
+                float learningRate,
+                float weightDecay = 0.0f,
+                bool decoupledWeightDecay = true,
+                float beta1 = 0.9f,
+                float beta2 = 0.99f,
+                float epsilon = 1e-8f)
+        {
+            return {
+                    .type = OptimizerType::Adam,
+                    .learningRate = learningRate,
+                    .weightDecay = weightDecay,
+                    .beta1 = beta1,
+                    .beta2 = beta2,
+                    .epsilon = epsilon,
+                    .decoupledWeightDecay = decoupledWeightDecay ? 1u : 0u,
+                    .beta1Correction = 1.0f,
+                    .beta2Correction = 1.0f };
+        }
+
+        // Sets the bias correction for the step-th update (starting at 1)
+        void Advance(uint32_t step)
+        {
+            if (type != OptimizerType::Adam)
+                return;
+
+            const double t = static_cast<double>(step);
+            beta1Correction = static_cast<float>(1.0 / (1.0 - std::pow(static_cast<double>(beta1), t)));
+            beta2Correction = static_cast<float>(1.0 / (1.0 - std::pow(static_cast<double>(beta2), t)));
+        }
+    };
+}
@@ -20,6 +20,12 @@ namespace en
 
         VkDescriptorSet GetDescriptorSet() const;
 
+        const glm::vec3& GetPos() const;
+        float GetStrength() const;
+
+        // Incremented whenever the position changes, invalidates the light transmittance cache
+        size_t GetPosVersion() const;
+
     private:
         static VkDescriptorSetLayout m_DescSetLayout;
         static VkDescriptorPool m_DescPool;
@@ -34,5 +40,6 @@ namespace en
         UniformData m_UniformData;
         vk::Buffer m_UniformBuffer;
         VkDescriptorSet m_DescSet;
+        size_t m_PosVersion;
     };
 }
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <engine/graphics/vulkan/Buffer.hpp>
+#include <glm/glm.hpp>
+
+namespace en
+{
+    // Ring of traced training samples (set 7 of nrc-train.comp). Every frame each training workgroup either traces
+    // new samples and pushes them, or replays records of the last maxAge frames, with probability replayRatio.
+    // Replayed records that are too old, were never written or lie in the slots this frame can push to are traced
+    // again. The samples of the current step are
+    // also kept in a batch of batchSize records, which hands them from the generate to the optimize dispatch.
+    // With self-training, bootstrapMix of the traced paths stop after selfTrainLength scattering vertices and take
+    // the rest of their radiance from the cache.
+    class TrainingSampleBuffer
+    {
+    public:
+        // Std430 record, frameIndex is the VolumeUniformData::frameIndex the record was traced in
+        struct Record
+        {
+            glm::vec3 pos;
+            uint32_t frameIndex;
+            glm::vec3 dir;
+            uint32_t padding0;
+            glm::vec3 target;
+            uint32_t padding1;
+        };
+
+        struct StatsData
+        {
+            uint32_t writeCursor; // Total records pushed, the slot is writeCursor % capacity
+            uint32_t newCount;
+            uint32_t replayCount;
+            uint32_t replayAgeSum;
+            uint32_t traceStepSum; // Steps of the traced paths, the cost of the traced records
+            uint32_t cacheLookupCount; // Paths terminated into the cache
+        };
+
+        static constexpr uint32_t INVALID_FRAME = 0xFFFFFFFF;
+
+        static void Init(VkDevice device);
+        static void Shutdown(VkDevice device);
+        static VkDescriptorSetLayout GetDescriptorSetLayout();
+
+        TrainingSampleBuffer(uint32_t capacity, uint32_t batchSize, float replayRatio, uint32_t maxAge);
+
+        void Destroy();
+
+        void SetReplayRatio(float replayRatio);
+        void SetMaxAge(uint32_t maxAge);
+        // selfTrainLength 0 traces full paths, bootstrapMix is the fraction of paths that are cut
+        void SetSelfTraining(uint32_t selfTrainLength, float bootstrapMix);
+
+        // Uploads the write cursor before the frame is recorded, the device has to be idle
+        void BeginFrame();
+
+        // Counters of the frames since the last reset, the write cursor is kept
+        void ResetStats();
+        const StatsData& GetStats();
+
+        void RenderImGui();
+
+        VkDescriptorSet GetDescriptorSet() const;
+        uint32_t GetBatchSize() const;
+
+    private:
+        struct UniformData
+        {
+            uint32_t capacity;
+            float replayRatio;
+            uint32_t maxAge;
+            uint32_t selfTrainLength;
+            float bootstrapMix;
+            uint32_t frameCursor; // writeCursor at the start of the frame
+            uint32_t batchSize; // Upper bound of the records pushed per frame
+            uint32_t padding0;
+        };
+
+        static VkDescriptorSetLayout m_DescSetLayout;
+        static VkDescriptorPool m_DescPool;
+
+        UniformData m_UniformData;
+        vk::Buffer m_UniformBuffer;
+
+        StatsData m_StatsData;
+        vk::Buffer m_StatsBuffer;
+
+        vk::Buffer m_RecordBuffer;
+
+        uint32_t m_BatchSize;
+        vk::Buffer m_BatchBuffer;
+
+        VkDescriptorSet m_DescSet;
+    };
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <engine/graphics/vulkan/Buffer.hpp>
+#include <engine/cpu/TrainingSchedule.hpp>
+#include <vector>
+
+namespace en
+{
+    // Screen positions of the nrc-train.comp samples (set 8). Every frame cpu::TrainingSchedule plans the samples
+    // from the region losses the train shader reported, and the train dispatches read their size indirectly from
+    // the schedule buffer, so the batch can follow the time budget without rerecording the command buffer.
+    class TrainingScheduler
+    {
+    public:
+        static constexpr uint32_t REGION_COUNT_X = 16;
+        static constexpr uint32_t REGION_COUNT_Y = 16;
+        static constexpr uint32_t REGION_COUNT = REGION_COUNT_X * REGION_COUNT_Y;
+
+        // Std430 header of the schedule buffer, starts with the indirect dispatch of the train pipelines
+        struct ScheduleHeader
+        {
+            uint32_t groupCountX;
+            uint32_t groupCountY;
+            uint32_t groupCountZ;
+            uint32_t sampleCount;
+            float jitterX;
+            float jitterY;
+            uint32_t stratumRotation;
+            uint32_t padding;
+        };
+
+        static void Init(VkDevice device);
+        static void Shutdown(VkDevice device);
+        static VkDescriptorSetLayout GetDescriptorSetLayout();
+
+        // groupSize is the training workgroup size, trainBudget the training time per frame in milliseconds
+        TrainingScheduler(uint32_t groupSize, uint32_t minSampleCount, uint32_t maxSampleCount, float trainBudget);
+
+        void Destroy();
+
+        // Call after every frame, plans the next one. trainTime is the time the training of the frame took in
+        // milliseconds, 0 keeps the sample count.
+        void Update(float trainTime);
+
+        void RenderImGui();
+
+        VkDescriptorSet GetDescriptorSet() const;
+        VkBuffer GetScheduleBuffer() const;
+        uint32_t GetGroupSize() const;
+        uint32_t GetMaxSampleCount() const;
+        uint32_t GetSampleCount() const;
+
+    private:
+        struct RegionStats
+        {
+            float lossSum;
+            uint32_t sampleCount;
+        };
+
+        static VkDescriptorSetLayout m_DescSetLayout;
+        static VkDescriptorPool m_DescPool;
+
+        uint32_t m_GroupSize;
+        cpu::TrainingSchedule m_Schedule;
+
+        vk::Buffer m_ScheduleBuffer;
+
+        std::vector<RegionStats> m_RegionStats;
+        std::vector<float> m_RegionLossSums;
+        std::vector<uint32_t> m_RegionSampleCounts;
+        vk::Buffer m_RegionStatsBuffer;
+
+        VkDescriptorSet m_DescSet;
+
+        void UploadSchedule();
+    };
+}
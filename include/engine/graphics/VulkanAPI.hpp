@@ -36,6 +36,8 @@ namespace en
         static VkPresentModeKHR GetPresentMode();
 
         static VkPhysicalDevice GetPhysicalDevice();
+        static float GetTimestampPeriod(); // Nanoseconds per timestamp tick
+        static uint32_t GetMaxComputeSharedMemorySize(); // Bytes of shared memory per workgroup
         static uint32_t GetGraphicsQFI();
         static uint32_t GetComputeQFI();
         static uint32_t GetPresentQFI();
@@ -11,26 +11,33 @@
 #include <engine/graphics/PointLight.hpp>
 #include <engine/graphics/HdrEnvMap.hpp>
 #include <engine/graphics/MRHE.hpp>
+#include <engine/graphics/TrainingSampleBuffer.hpp>
+#include <engine/graphics/TrainingScheduler.hpp>
 
 namespace en
 {
     class NrcHpmRenderer
     {
     public:
+        // Rays per training workgroup (see nrc-train.comp)
+        static constexpr uint32_t TRAIN_TILE_SIZE = 32;
+
         NrcHpmRenderer(
                 uint32_t width,
                 uint32_t height,
-                uint32_t trainWidth,
-                uint32_t trainHeight,
                 const Camera& camera,
                 const VolumeData& volumeData,
                 const DirLight& dirLight,
                 const PointLight& pointLight,
                 const HdrEnvMap& hdrEnvMap,
                 const NeuralRadianceCache& nrc,
-                const MRHE& mrhe);
+                const MRHE& mrhe,
+                const TrainingSampleBuffer& trainingSamples,
+                const TrainingScheduler& trainingScheduler);
 
         void Render(VkQueue queue) const;
+        // Gpu time of the training dispatches of the last frame in milliseconds, call after the queue is idle
+        float GetTrainTime() const;
         void Destroy();
 
         void ResizeFrame(uint32_t width, uint32_t height);
@@ -40,12 +47,35 @@ namespace en
         size_t GetImageDataSize() const;
 
     private:
+        // Part of the training step a train pipeline runs, same values as the TRAIN_STAGE_* defines of nrc-train.comp
+        enum class TrainStage : uint32_t
+        {
+            Full = 0, // Generate and optimize in one dispatch
+            Generate = 1, // Trace or replay the samples of the step into the TrainingSampleBuffer batch
+            Optimize = 2 // Forward and backprop over the batch
+        };
+
+        // Whether the training workgroup evaluates the mlp fully fused. Falls back to the unfused mlp when the
+        // topology needs more shared memory than the device has (GetFusedSharedMemorySize).
+        static constexpr bool TRAIN_FUSED_MLP = true;
+        // Floats of the shared weight chunk the fused mlp streams a layer through, at least one row of any layer
+        static constexpr uint32_t TRAIN_FUSED_WEIGHT_COUNT = 2048;
+        static constexpr uint32_t STEP_GROUP_SIZE = 128;
+        // Step only the mrhe entries touched by the training batch instead of all hash table floats. Hashing spreads
+        // a 100 x 100 batch over most of a 16384 entry level, so this only pays off for larger tables.
+        static constexpr bool MRHE_SPARSE_STEP = false;
+        // Generate the training samples in their own dispatch, so the divergent tracing does not stall the mlp tiles
+        static constexpr bool TRAIN_SPLIT_GENERATION = true;
+        // How the shaders integrate the density along shadow and transmittance rays. The tracking estimators are
+        // unbiased but have about 40 times the squared error of 32 fixed steps at equal time (BenchmarkTransmittance).
+        static constexpr cpu::TransmittanceEstimator TRANSMITTANCE_ESTIMATOR = cpu::TransmittanceEstimator::FixedStep;
+        // Leap over the empty bricks of the occupancy grid. The skipped steps have no density and never trace the scene,
+        // so on the CPU tracer it saves no frame time (BenchmarkEmptySpaceSkipping).
+        static constexpr bool EMPTY_SPACE_SKIPPING = false;
+
         uint32_t m_FrameWidth;
         uint32_t m_FrameHeight;
 
-        uint32_t m_TrainWidth;
-        uint32_t m_TrainHeight;
-
         const Camera& m_Camera;
         const VolumeData& m_VolumeData;
         const DirLight& m_DirLight;
@@ -53,6 +83,8 @@ namespace en
         const HdrEnvMap& m_HdrEnvMap;
         const NeuralRadianceCache& m_Nrc;
         const MRHE& m_Mrhe;
+        const TrainingSampleBuffer& m_TrainingSamples;
+        const TrainingScheduler& m_TrainingScheduler;
 
         VkPipelineLayout m_PipelineLayout;
 
@@ -62,6 +94,7 @@ namespace en
         VkPipeline m_RenderPipeline;
 
         vk::Shader m_TrainShader;
+        VkPipeline m_GeneratePipeline; // Only with TRAIN_SPLIT_GENERATION
         VkPipeline m_TrainPipeline;
 
         vk::Shader m_StepShader;
@@ -70,6 +103,8 @@ namespace en
         vk::Shader m_MrheStepShader;
         VkPipeline m_MrheStepPipeline;
 
+        VkQueryPool m_TrainQueryPool; // Timestamps before and after the training
+
         VkImage m_ColorImage;
         VkDeviceMemory m_ColorImageMemory;
         VkImageView m_ColorImageView;
@@ -83,12 +118,16 @@ namespace en
         void CreateRenderRenderPass(VkDevice device);
         void CreateRenderPipeline(VkDevice device);
 
-        void CreateTrainPipeline(VkDevice device);
+        // Bytes of the shared arrays of the fused mlp in nrc-train.comp
+        static uint32_t GetFusedSharedMemorySize();
+        void CreateTrainPipeline(VkDevice device, TrainStage stage, VkPipeline* pipeline);
 
         void CreateStepPipeline(VkDevice device);
 
         void CreateMrheStepPipeline(VkDevice device);
 
+        void CreateTrainQueryPool(VkDevice device);
+
         void CreateColorImage(VkDevice device);
         void CreateFramebuffer(VkDevice device);
 
@@ -7,7 +7,7 @@ namespace en::vk
     class Buffer
     {
     public:
-        static void Copy(const Buffer* src, Buffer* dest, VkDeviceSize size);
+        static void Copy(const Buffer* src, Buffer* dest, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
 
         Buffer(VkDeviceSize size, VkMemoryPropertyFlags memoryProperties, VkBufferUsageFlags usage, const std::vector<uint32_t>& qfis);
 
@@ -3,9 +3,13 @@
 #include <vector>
 #include <array>
 #include <engine/graphics/common.hpp>
+#include <engine/util/VolumeView.hpp>
+#include <engine/util/ThreadPool.hpp>
 
 namespace en::vk
 {
+    class Buffer;
+
     class Texture3D
     {
     public:
@@ -20,6 +24,17 @@ namespace en::vk
                 VkSamplerAddressMode addressMode,
                 VkBorderColor borderColor);
 
+        // Single channel texture of volume in any layout, written straight into the mapped staging buffer on
+        // threadPool. format is VK_FORMAT_R8_UNORM, VK_FORMAT_R16_SFLOAT or VK_FORMAT_R32_SFLOAT, R8_UNORM quantizes
+        // like the RGBA8 constructors. R32_SFLOAT falls back to R16_SFLOAT where the device can not filter it linearly.
+        Texture3D(
+                const VolumeView& volume,
+                VkFormat format,
+                ThreadPool& threadPool,
+                VkFilter filter,
+                VkSamplerAddressMode addressMode,
+                VkBorderColor borderColor);
+
         void Destroy();
 
         uint32_t GetWidth() const;
@@ -36,6 +51,8 @@ namespace en::vk
         uint32_t m_Height;
         uint32_t m_Depth;
         uint32_t m_RealChannelCount;
+        VkFormat m_Format;
+        uint32_t m_TexelSize;
 
         VkImage m_Image;
         VkImageView m_ImageView;
@@ -44,6 +61,7 @@ namespace en::vk
         VkSampler m_Sampler;
 
         void LoadToDevice(void* data, VkFilter filter, VkSamplerAddressMode addressMode, VkBorderColor borderColor);
+        void LoadToDevice(Buffer& stagingBuffer, VkFilter filter, VkSamplerAddressMode addressMode, VkBorderColor borderColor);
         void ChangeLayout(VkImageLayout layout, VkCommandBuffer commandBuffer, VkQueue queue);
         void WriteBufferToImage(VkCommandBuffer commandBuffer, VkQueue queue, VkBuffer buffer);
     };
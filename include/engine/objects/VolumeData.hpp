@@ -4,6 +4,16 @@
 #include <glm/glm.hpp>
 #include <engine/graphics/vulkan/Buffer.hpp>
 #include <engine/graphics/Camera.hpp>
+#include <engine/util/Aabb.hpp>
+#include <engine/util/VolumeView.hpp>
+#include <engine/cpu/MajorantGrid.hpp>
+#include <engine/cpu/OccupancyGrid.hpp>
+#include <engine/cpu/LightTransmittanceCache.hpp>
+#include <engine/cpu/SparseBrickVolume.hpp>
+#include <engine/graphics/DirLight.hpp>
+#include <engine/graphics/PointLight.hpp>
+#include <engine/util/ThreadPool.hpp>
+#include <cstddef>
 
 namespace en
 {
@@ -16,8 +26,20 @@ namespace en
         float g;
         int noNnSpp;
         int withNnSpp;
+        uint32_t frameIndex; // Key of the shader random sequences (data/shader/common/rng.glsl)
+        uint32_t padding0; // std140 aligns the vec4 bounds to 16 bytes
+        glm::vec4 boundsMin; // w unused
+        glm::vec4 boundsMax; // w unused
+        uint32_t useLightCache; // Shadow rays of DirLight and PointLight fetch the LightTransmittanceCache
+        uint32_t padding1[3]; // Rounds the buffer and descriptor range up to the std140 size of the block
     };
 
+    // Offsets of volumeData_t in nrc-forward.frag and nrc-train.comp
+    static_assert(offsetof(VolumeUniformData, boundsMin) == 48);
+    static_assert(offsetof(VolumeUniformData, boundsMax) == 64);
+    static_assert(offsetof(VolumeUniformData, useLightCache) == 80);
+    static_assert(sizeof(VolumeUniformData) == 96);
+
     class VolumeData
     {
     public:
@@ -25,14 +47,29 @@ namespace en
         static void Shutdown(VkDevice device);
         static VkDescriptorSetLayout GetDescriptorSetLayout();
 
-        VolumeData(const vk::Texture3D* densityTex);
+        static constexpr uint32_t MAJORANT_BRICK_SIZE = 8;
+        static constexpr uint32_t OCCUPANCY_MACRO_SIZE = 4;
+        static constexpr uint32_t LIGHT_CACHE_CELL_SIZE = 2;
+
+        // density spans bounds and is only read by the constructor. densityTex is its dense texture, or the atlas of
+        // sparseVolume converted from it, then the shaders look up the bricks in its page table.
+        VolumeData(
+                const vk::Texture3D* densityTex,
+                const VolumeView& density,
+                const Aabb& bounds,
+                const cpu::SparseBrickVolume* sparseVolume = nullptr);
 
         void Update(bool cameraChanged);
+
+        // Recomputes the light transmittance cache of a light that moved since the last call, lights with a
+        // strength of 0 wait until they are turned on
+        void UpdateLightTransmittanceCache(ThreadPool& threadPool, const DirLight& dirLight, const PointLight& pointLight);
         void Destroy();
 
         void RenderImGui();
 
         VkDescriptorSet GetDescriptorSet() const;
+        Aabb GetBounds() const;
 
     private:
         static VkDescriptorSetLayout m_DescriptorSetLayout;
@@ -45,6 +82,22 @@ namespace en
         VolumeUniformData m_UniformData;
         vk::Buffer m_UniformBuffer;
 
+        cpu::MajorantGrid m_MajorantGrid;
+        vk::Buffer m_MajorantGridBuffer;
+
+        cpu::OccupancyGrid m_OccupancyGrid;
+        vk::Buffer m_OccupancyGridBuffer;
+
+        cpu::LightTransmittanceCache m_LightCache;
+        vk::Buffer m_LightCacheBuffer;
+        size_t m_DirLightVersion;
+        size_t m_PointLightVersion;
+
+        size_t m_SparseVolumeSize;
+        vk::Buffer m_SparseVolumeBuffer;
+
         void UpdateDescriptorSet();
+        void UploadOccupancyGrid();
+        void UploadLightCache();
     };
 }
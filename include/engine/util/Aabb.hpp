@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace en
+{
+    // Axis aligned box, the volume bounds of VolumeData and cpu::VolumePathTracer. The density texture spans it.
+    struct Aabb
+    {
+        glm::vec3 minCorner;
+        glm::vec3 maxCorner;
+
+        static Aabb FromCenterSize(const glm::vec3& center, const glm::vec3& size)
+        {
+            return { .minCorner = center - (size / 2.0f), .maxCorner = center + (size / 2.0f) };
+        }
+
+        glm::vec3 GetSize() const { return maxCorner - minCorner; }
+
+        // Position relative to the box, [0, 1] inside like the uvw of the density texture
+        glm::vec3 GetUvw(const glm::vec3& pos) const { return (pos - minCorner) / (maxCorner - minCorner); }
+
+        // Slab test, distances along dir where the ray enters and leaves the box. The entry is clamped to 0 so rays
+        // from inside enter at their origin. False if the ray misses the box or it lies behind the origin.
+        bool Intersect(const glm::vec3& origin, const glm::vec3& dir, float& tEntry, float& tExit) const
+        {
+            tEntry = 0.0f;
+            tExit = std::numeric_limits<float>::max();
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const float invDir = 1.0f / (dir[axis] == 0.0f ? 1e-20f : dir[axis]);
+                const float tLow = (minCorner[axis] - origin[axis]) * invDir;
+                const float tHigh = (maxCorner[axis] - origin[axis]) * invDir;
+                tEntry = std::max(tEntry, std::min(tLow, tHigh));
+                tExit = std::min(tExit, std::max(tLow, tHigh));
+            }
+            return tEntry <= tExit;
+        }
+    };
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <engine/util/Log.hpp>
+#include <atomic>
+#include <vector>
+#include <bit>
+#include <cstdint>
+
+namespace en
+{
+    // Bounded multi producer multi consumer queue without locks (Vyukov). Every cell carries a sequence number that
+    // tells whether it is free for the push or filled for the pop of the current lap, so producers and consumers
+    // only contend on their own cursor. Capacity has to be a power of two.
+    template<typename T>
+    class BoundedQueue
+    {
+    public:
+        explicit BoundedQueue(size_t capacity) :
+                m_Cells(capacity),
+                m_Mask(capacity - 1),
+                m_PushCursor(0),
+                m_PopCursor(0)
+        {
+            if (!std::has_single_bit(capacity))
+                Log::Error("BoundedQueue capacity has to be a power of two", true);
+
+            for (size_t i = 0; i < capacity; i++)
+            {
+                m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        // False if the queue is full
+        bool TryPush(const T& value)
+        {
+            size_t pos = m_PushCursor.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell& cell = m_Cells[pos & m_Mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (m_PushCursor.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = value;
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_PushCursor.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // False if the queue is empty
+        bool TryPop(T& value)
+        {
+            size_t pos = m_PopCursor.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell& cell = m_Cells[pos & m_Mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (m_PopCursor.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        value = cell.value;
+                        cell.sequence.store(pos + m_Mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_PopCursor.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        size_t GetCapacity() const { return m_Cells.size(); }
+
+    private:
+        static constexpr size_t CACHE_LINE = 64;
+
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        std::vector<Cell> m_Cells;
+        const size_t m_Mask;
+
+        // Separate lines, producers and consumers do not invalidate each other's cursor
+        alignas(CACHE_LINE) std::atomic<size_t> m_PushCursor;
+        alignas(CACHE_LINE) std::atomic<size_t> m_PopCursor;
+    };
+}
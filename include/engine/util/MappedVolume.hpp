@@ -0,0 +1,37 @@
+#pragma once
+
+#include <engine/util/VolumeView.hpp>
+#include <string>
+#include <cstddef>
+
+namespace en
+{
+    // Raw float density file of ReadFileDensity3D mapped read only into memory. The OS pages it in on first access,
+    // nothing is copied, GetView describes the mapping in the z fastest layout of the file. Views stay valid as long
+    // as the MappedVolume lives.
+    class MappedVolume
+    {
+    public:
+        MappedVolume(const std::string& fileName, size_t sizeX, size_t sizeY, size_t sizeZ);
+        ~MappedVolume();
+
+        MappedVolume(const MappedVolume&) = delete;
+        MappedVolume& operator=(const MappedVolume&) = delete;
+
+        VolumeView GetView() const;
+
+    private:
+        size_t m_SizeX;
+        size_t m_SizeY;
+        size_t m_SizeZ;
+        size_t m_FileSize;
+        const float* m_Data;
+
+#ifdef _WIN32
+        void* m_File;
+        void* m_Mapping;
+#else
+        int m_File;
+#endif
+    };
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+namespace en
+{
+    namespace rng
+    {
+        using uint = uint32_t;
+
+        // The shader code is compiled as is, so the host produces the same sequences as the shaders
+#define RNG_FUNC inline
+#define RNG_INOUT(type) type&
+#include "../../../data/shader/common/rng.glsl"
+#undef RNG_FUNC
+#undef RNG_INOUT
+    }
+
+    // Random sequence of one sample, same numbers as RngSeed / RngNextFloat in data/shader/common/rng.glsl
+    class Rng
+    {
+    public:
+        static constexpr uint32_t TRAIN_SAMPLE_OFFSET = RNG_TRAIN_SAMPLE_OFFSET;
+
+        Rng(uint32_t pixelX, uint32_t pixelY, uint32_t frameIndex, uint32_t sampleIndex) :
+                m_State(rng::RngSeed(pixelX, pixelY, frameIndex, sampleIndex))
+        {
+        }
+
+        uint32_t NextUint() { return rng::RngNextUint(m_State); }
+        float NextFloat() { return rng::RngNextFloat(m_State); }
+
+    private:
+        uint32_t m_State;
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+namespace en
+{
+    // Fixed set of worker threads for data parallel loops. The calling thread takes part as thread 0, so a pool
+    // with threadCount 1 runs everything inline.
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t GetThreadCount() const;
+
+        // Calls func(index, threadIndex) for every index in [0, count) and blocks until all calls returned.
+        // Indices are handed out dynamically. Not reentrant.
+        void ParallelFor(size_t count, const std::function<void(size_t, size_t)>& func);
+
+        // Same as ParallelFor, but every thread starts on its own contiguous share of [0, count) and idle threads
+        // steal half of the remaining indices of another thread. Neighbouring indices stay on one thread as long as
+        // the work is balanced, for items of very different cost. count has to fit into 32 bits.
+        void ParallelForStealing(size_t count, const std::function<void(size_t, size_t)>& func);
+
+    private:
+        // Remaining indices [begin, end) of one thread, packed as end << 32 | begin so owner and thieves can
+        // update them with a single compare exchange
+        struct alignas(64) StealRange
+        {
+            std::atomic<uint64_t> bounds;
+        };
+
+        std::vector<std::thread> m_Workers;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_StartCv;
+        std::condition_variable m_DoneCv;
+        bool m_Stop;
+        size_t m_Generation;
+        size_t m_ActiveWorkers;
+
+        const std::function<void(size_t, size_t)>* m_Func;
+        size_t m_Count;
+        std::atomic<size_t> m_Next;
+        bool m_Stealing;
+        std::vector<StealRange> m_StealRanges;
+
+        void Run(const std::function<void(size_t, size_t)>& func, size_t count, bool stealing);
+        void WorkerLoop(size_t threadIndex);
+        void RunItems(size_t threadIndex);
+        void RunStealing(size_t threadIndex);
+        bool PopIndex(StealRange& range, size_t& index);
+        bool StealHalf(size_t threadIndex);
+    };
+}
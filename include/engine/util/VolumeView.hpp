@@ -0,0 +1,35 @@
+#pragma once
+
+#include <span>
+#include <cstddef>
+
+namespace en
+{
+    // Read only view of a float volume, voxel (x, y, z) is data[x * strideX + y * strideY + z * strideZ]. Strides
+    // are in floats. Does not own the data, see MappedVolume.
+    struct VolumeView
+    {
+        std::span<const float> data;
+        size_t sizeX;
+        size_t sizeY;
+        size_t sizeZ;
+        size_t strideX;
+        size_t strideY;
+        size_t strideZ;
+
+        // Layout of the raw density files of ReadFileDensity3D
+        static VolumeView ZFastest(std::span<const float> data, size_t sizeX, size_t sizeY, size_t sizeZ)
+        {
+            return { .data = data, .sizeX = sizeX, .sizeY = sizeY, .sizeZ = sizeZ, .strideX = sizeY * sizeZ, .strideY = sizeZ, .strideZ = 1 };
+        }
+
+        // Layout of the texels of a Texture3D
+        static VolumeView XFastest(std::span<const float> data, size_t sizeX, size_t sizeY, size_t sizeZ)
+        {
+            return { .data = data, .sizeX = sizeX, .sizeY = sizeY, .sizeZ = sizeZ, .strideX = 1, .strideY = sizeX, .strideZ = sizeX * sizeY };
+        }
+
+        size_t GetVoxelCount() const { return sizeX * sizeY * sizeZ; }
+        float Get(size_t x, size_t y, size_t z) const { return data[(x * strideX) + (y * strideY) + (z * strideZ)]; }
+    };
+}
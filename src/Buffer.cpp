@@ -4,7 +4,7 @@
 
 namespace en::vk
 {
-    void Buffer::Copy(const Buffer* src, Buffer* dest, VkDeviceSize size)
+    void Buffer::Copy(const Buffer* src, Buffer* dest, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset)
     {
         VkQueue queue = VulkanAPI::GetGraphicsQueue();
 
@@ -22,8 +22,8 @@ namespace en::vk
         ASSERT_VULKAN(result);
 
         VkBufferCopy bufferCopy;
-        bufferCopy.srcOffset = 0;
-        bufferCopy.dstOffset = 0;
+        bufferCopy.srcOffset = srcOffset;
+        bufferCopy.dstOffset = dstOffset;
         bufferCopy.size = size;
 
         vkCmdCopyBuffer(commandBuffer, src->GetVulkanHandle(), dest->GetVulkanHandle(), 1, &bufferCopy);
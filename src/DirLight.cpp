@@ -84,7 +84,8 @@ namespace en
                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                     {}
-            ) }
+            ) },
+            m_DirVersion(0)
     {
         VkDevice device = VulkanAPI::GetDevice();
 
@@ -130,15 +131,13 @@ namespace en
     void DirLight::SetZenith(float z)
     {
         m_DirLightData.m_Zenith = z;
-        m_DirLightData.m_Dir = VecFromAngles(z, m_DirLightData.m_Azimuth);
-        m_UniformBuffer.SetData(sizeof(DirLightData), &m_DirLightData, 0, 0);
+        UpdateBuffer();
     }
 
     void DirLight::SetAzimuth(float a)
     {
         m_DirLightData.m_Azimuth = a;
-        m_DirLightData.m_Dir = VecFromAngles(m_DirLightData.m_Zenith, a);
-        m_UniformBuffer.SetData(sizeof(DirLightData), &m_DirLightData, 0, 0);
+        UpdateBuffer();
     }
 
     void DirLight::SetColor(glm::vec3 c)
@@ -152,6 +151,21 @@ namespace en
         return m_DescriptorSet;
     }
 
+    const glm::vec3& DirLight::GetDir() const
+    {
+        return m_DirLightData.m_Dir;
+    }
+
+    float DirLight::GetStrength() const
+    {
+        return m_DirLightData.m_Strenth;
+    }
+
+    size_t DirLight::GetDirVersion() const
+    {
+        return m_DirVersion;
+    }
+
     void DirLight::RenderImgui()
     {
         ImGui::Begin("Dir Light");
@@ -159,9 +173,20 @@ namespace en
         ImGui::DragFloat("azimuth", &m_DirLightData.m_Azimuth, 0.001);
         ImGui::DragFloat("Strength", &m_DirLightData.m_Strenth, 0.01);
 
-        m_DirLightData.m_Dir = VecFromAngles(m_DirLightData.m_Zenith, m_DirLightData.m_Azimuth);
-        m_UniformBuffer.SetData(sizeof(DirLightData), &m_DirLightData, 0, 0);
+        UpdateBuffer();
 
         ImGui::End();
     }
+
+    void DirLight::UpdateBuffer()
+    {
+        const glm::vec3 dir = VecFromAngles(m_DirLightData.m_Zenith, m_DirLightData.m_Azimuth);
+        if (dir != m_DirLightData.m_Dir)
+        {
+            m_DirLightData.m_Dir = dir;
+            m_DirVersion++;
+        }
+
+        m_UniformBuffer.SetData(sizeof(DirLightData), &m_DirLightData, 0, 0);
+    }
 }
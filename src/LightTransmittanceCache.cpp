@@ -0,0 +1,195 @@
+#include <engine/cpu/LightTransmittanceCache.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace en::cpu
+{
+    LightTransmittanceCache::LightTransmittanceCache(const VolumeView& density, const Aabb& bounds, uint32_t cellSize) :
+            m_Bounds(bounds)
+    {
+        if (cellSize == 0)
+            Log::Error("LightTransmittanceCache cell size has to be at least one", true);
+
+        if (density.GetVoxelCount() == 0)
+            Log::Error("LightTransmittanceCache density is empty", true);
+
+        m_SizeX = density.sizeX;
+        m_SizeY = density.sizeY;
+        m_SizeZ = density.sizeZ;
+
+        m_Header = {
+                .cellCountX = (m_SizeX + cellSize - 1) / cellSize,
+                .cellCountY = (m_SizeY + cellSize - 1) / cellSize,
+                .cellCountZ = (m_SizeZ + cellSize - 1) / cellSize,
+                .lightCellCount = 0 };
+        m_Header.lightCellCount = m_Header.cellCountX * m_Header.cellCountY * m_Header.cellCountZ;
+        m_Depth.resize(static_cast<size_t>(m_Header.lightCellCount) * 2, 0.0f);
+
+        const size_t paddedX = m_SizeX + 2;
+        const size_t paddedY = m_SizeY + 2;
+        m_Density.resize(paddedX * paddedY * (m_SizeZ + 2), 0.0f);
+        for (uint32_t x = 0; x < m_SizeX; x++)
+        {
+            for (uint32_t y = 0; y < m_SizeY; y++)
+            {
+                for (uint32_t z = 0; z < m_SizeZ; z++)
+                {
+                    const float value = static_cast<float>(static_cast<uint8_t>(density.Get(x, y, z) * 255.0f)) / 255.0f;
+                    m_Density[(x + 1) + ((y + 1) * paddedX) + ((z + 1) * paddedX * paddedY)] = value;
+                }
+            }
+        }
+
+        const glm::vec3 voxelSize = bounds.GetSize() / glm::vec3(m_SizeX, m_SizeY, m_SizeZ);
+        m_StepSize = std::min(voxelSize.x, std::min(voxelSize.y, voxelSize.z)) / 2.0f;
+    }
+
+    void LightTransmittanceCache::ComputeDirLight(ThreadPool& threadPool, const glm::vec3& dir)
+    {
+        const glm::vec3 toLight = -glm::normalize(dir);
+        float* depth = m_Depth.data() + (static_cast<size_t>(CachedLight::Dir) * m_Header.lightCellCount);
+
+        // One row of cells per item
+        threadPool.ParallelFor(static_cast<size_t>(m_Header.cellCountY) * m_Header.cellCountZ, [&](size_t row, size_t)
+        {
+            const uint32_t cellY = row % m_Header.cellCountY;
+            const uint32_t cellZ = row / m_Header.cellCountY;
+            for (uint32_t cellX = 0; cellX < m_Header.cellCountX; cellX++)
+            {
+                const glm::vec3 center = GetCellCenter(cellX, cellY, cellZ);
+                float tEntry;
+                float tExit;
+                m_Bounds.Intersect(center, toLight, tEntry, tExit);
+                depth[cellX + (row * m_Header.cellCountX)] = IntegrateDensity(center, toLight, tExit);
+            }
+        });
+    }
+
+    void LightTransmittanceCache::ComputePointLight(ThreadPool& threadPool, const glm::vec3& pos)
+    {
+        float* depth = m_Depth.data() + (static_cast<size_t>(CachedLight::Point) * m_Header.lightCellCount);
+
+        threadPool.ParallelFor(static_cast<size_t>(m_Header.cellCountY) * m_Header.cellCountZ, [&](size_t row, size_t)
+        {
+            const uint32_t cellY = row % m_Header.cellCountY;
+            const uint32_t cellZ = row / m_Header.cellCountY;
+            for (uint32_t cellX = 0; cellX < m_Header.cellCountX; cellX++)
+            {
+                const glm::vec3 center = GetCellCenter(cellX, cellY, cellZ);
+                const float distance = glm::length(pos - center);
+                float cellDepth = 0.0f;
+                if (distance > 0.0f)
+                {
+                    // Only the part of the segment inside the bounds has density
+                    const glm::vec3 toLight = (pos - center) / distance;
+                    float tEntry;
+                    float tExit;
+                    m_Bounds.Intersect(center, toLight, tEntry, tExit);
+                    cellDepth = IntegrateDensity(center, toLight, std::min(distance, tExit));
+                }
+                depth[cellX + (row * m_Header.cellCountX)] = cellDepth;
+            }
+        });
+    }
+
+    float LightTransmittanceCache::GetOpticalDepth(CachedLight light, const glm::vec3& pos) const
+    {
+        // Cell centers at integers, clamped to the outermost ones
+        const glm::vec3 uvw = m_Bounds.GetUvw(pos);
+        const float tx = std::clamp((uvw.x * static_cast<float>(m_Header.cellCountX)) - 0.5f, 0.0f, static_cast<float>(m_Header.cellCountX - 1));
+        const float ty = std::clamp((uvw.y * static_cast<float>(m_Header.cellCountY)) - 0.5f, 0.0f, static_cast<float>(m_Header.cellCountY - 1));
+        const float tz = std::clamp((uvw.z * static_cast<float>(m_Header.cellCountZ)) - 0.5f, 0.0f, static_cast<float>(m_Header.cellCountZ - 1));
+        const uint32_t x0 = static_cast<uint32_t>(tx);
+        const uint32_t y0 = static_cast<uint32_t>(ty);
+        const uint32_t z0 = static_cast<uint32_t>(tz);
+
+        // Neighbours along each axis, none past the last cell
+        const size_t strideY = m_Header.cellCountX;
+        const size_t strideZ = strideY * m_Header.cellCountY;
+        const size_t dx = x0 + 1 < m_Header.cellCountX ? 1 : 0;
+        const size_t dy = y0 + 1 < m_Header.cellCountY ? strideY : 0;
+        const size_t dz = z0 + 1 < m_Header.cellCountZ ? strideZ : 0;
+        const float* base = &m_Depth[
+                (static_cast<size_t>(light) * m_Header.lightCellCount) + x0 + (y0 * strideY) + (z0 * strideZ)];
+
+        const float lx = tx - static_cast<float>(x0);
+        const float ly = ty - static_cast<float>(y0);
+        const float lz = tz - static_cast<float>(z0);
+        const float y0z0 = base[0] + ((base[dx] - base[0]) * lx);
+        const float y1z0 = base[dy] + ((base[dy + dx] - base[dy]) * lx);
+        const float y0z1 = base[dz] + ((base[dz + dx] - base[dz]) * lx);
+        const float y1z1 = base[dz + dy] + ((base[dz + dy + dx] - base[dz + dy]) * lx);
+        const float zLow = y0z0 + ((y1z0 - y0z0) * ly);
+        const float zHigh = y0z1 + ((y1z1 - y0z1) * ly);
+        return zLow + ((zHigh - zLow) * lz);
+    }
+
+    std::vector<uint8_t> LightTransmittanceCache::GetGpuData() const
+    {
+        std::vector<uint8_t> data(GetGpuSize());
+        std::memcpy(data.data(), &m_Header, sizeof(GpuHeader));
+        std::memcpy(data.data() + sizeof(GpuHeader), m_Depth.data(), m_Depth.size() * sizeof(float));
+        return data;
+    }
+
+    glm::vec3 LightTransmittanceCache::GetCellCenter(uint32_t cellX, uint32_t cellY, uint32_t cellZ) const
+    {
+        const glm::vec3 cellCount(m_Header.cellCountX, m_Header.cellCountY, m_Header.cellCountZ);
+        return m_Bounds.minCorner + (((glm::vec3(cellX, cellY, cellZ) + 0.5f) / cellCount) * m_Bounds.GetSize());
+    }
+
+    float LightTransmittanceCache::GetDensity(const glm::vec3& pos) const
+    {
+        // Trilinear like VolumePathTracer::GetDensity, texel centers at integers
+        const glm::vec3 uvw = m_Bounds.GetUvw(pos);
+        const float tx = (uvw.x * static_cast<float>(m_SizeX)) - 0.5f;
+        const float ty = (uvw.y * static_cast<float>(m_SizeY)) - 0.5f;
+        const float tz = (uvw.z * static_cast<float>(m_SizeZ)) - 0.5f;
+        const float fx = std::floor(tx);
+        const float fy = std::floor(ty);
+        const float fz = std::floor(tz);
+
+        if (fx < -1.0f || fy < -1.0f || fz < -1.0f
+            || fx > static_cast<float>(m_SizeX - 1) || fy > static_cast<float>(m_SizeY - 1) || fz > static_cast<float>(m_SizeZ - 1))
+        {
+            return 0.0f;
+        }
+
+        const size_t strideY = m_SizeX + 2;
+        const size_t strideZ = strideY * (m_SizeY + 2);
+        const float* base = &m_Density[
+                static_cast<size_t>(fx + 1.0f)
+                + (static_cast<size_t>(fy + 1.0f) * strideY)
+                + (static_cast<size_t>(fz + 1.0f) * strideZ)];
+
+        const float lx = tx - fx;
+        const float ly = ty - fy;
+        const float lz = tz - fz;
+        const float y0z0 = base[0] + ((base[1] - base[0]) * lx);
+        const float y1z0 = base[strideY] + ((base[strideY + 1] - base[strideY]) * lx);
+        const float y0z1 = base[strideZ] + ((base[strideZ + 1] - base[strideZ]) * lx);
+        const float y1z1 = base[strideZ + strideY] + ((base[strideZ + strideY + 1] - base[strideZ + strideY]) * lx);
+        const float z0 = y0z0 + ((y1z0 - y0z0) * ly);
+        const float z1 = y0z1 + ((y1z1 - y0z1) * ly);
+        return z0 + ((z1 - z0) * lz);
+    }
+
+    float LightTransmittanceCache::IntegrateDensity(const glm::vec3& start, const glm::vec3& dir, float length) const
+    {
+        // Midpoint rule, dir is normalized
+        const uint32_t stepCount = static_cast<uint32_t>(std::ceil(length / m_StepSize));
+        if (stepCount == 0)
+            return 0.0f;
+
+        const float stepSize = length / static_cast<float>(stepCount);
+        float depth = 0.0f;
+        for (uint32_t i = 0; i < stepCount; i++)
+        {
+            depth += GetDensity(start + (dir * ((static_cast<float>(i) + 0.5f) * stepSize)));
+        }
+
+        return depth * stepSize;
+    }
+}
@@ -1,5 +1,7 @@
 #include <engine/graphics/MRHE.hpp>
+#include <engine/cpu/MrheEncoder.hpp>
 #include <random>
+#include <bit>
 
 namespace en
 {
@@ -30,7 +32,42 @@ namespace en
         deltaHashTablesBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
         deltaHashTablesBinding.pImmutableSamplers = nullptr;
 
-        std::vector<VkDescriptorSetLayoutBinding> bindings = { uniformBinding, hashTablesBinding, deltaHashTablesBinding };
+        VkDescriptorSetLayoutBinding optimizerBinding;
+        optimizerBinding.binding = 3;
+        optimizerBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        optimizerBinding.descriptorCount = 1;
+        optimizerBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        optimizerBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding momentsBinding;
+        momentsBinding.binding = 4;
+        momentsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        momentsBinding.descriptorCount = 1;
+        momentsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        momentsBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding touchedEntriesBinding;
+        touchedEntriesBinding.binding = 5;
+        touchedEntriesBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        touchedEntriesBinding.descriptorCount = 1;
+        touchedEntriesBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        touchedEntriesBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding touchedBitsBinding;
+        touchedBitsBinding.binding = 6;
+        touchedBitsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        touchedBitsBinding.descriptorCount = 1;
+        touchedBitsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        touchedBitsBinding.pImmutableSamplers = nullptr;
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings = {
+                uniformBinding,
+                hashTablesBinding,
+                deltaHashTablesBinding,
+                optimizerBinding,
+                momentsBinding,
+                touchedEntriesBinding,
+                touchedBitsBinding };
 
         VkDescriptorSetLayoutCreateInfo layoutCI;
         layoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -45,11 +82,11 @@ namespace en
         // Create desc pool
         VkDescriptorPoolSize uniformPoolSize;
         uniformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uniformPoolSize.descriptorCount = 1;
+        uniformPoolSize.descriptorCount = 2;
 
         VkDescriptorPoolSize storagePoolSize;
         storagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        storagePoolSize.descriptorCount = 2;
+        storagePoolSize.descriptorCount = 5;
 
         std::vector<VkDescriptorPoolSize> poolSizes = { uniformPoolSize, storagePoolSize };
 
@@ -77,11 +114,15 @@ namespace en
     }
 
     MRHE::MRHE(float learningRate, float weightDecay) :
+            MRHE(OptimizerConfig::Momentum(learningRate, weightDecay, 0.0f))
+    {
+    }
+
+    MRHE::MRHE(const OptimizerConfig& optimizerConfig) :
             m_UniformData({
-                                  .learningRate = learningRate,
-                                  .weightDecay = weightDecay,
                                   .levelCount = 16,
                                   .hashTableSize = 16384,
+                                  .hashTableMask = 16384 - 1,
                                   .featureCount = 2,
                                   .minRes = 16,
                                   .maxRes = 512 }),
@@ -90,6 +131,13 @@ namespace en
                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                     {}),
+            m_OptimizerConfig(optimizerConfig),
+            m_StepIndex(0),
+            m_OptimizerUniformBuffer(
+                    sizeof(OptimizerConfig),
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                    {}),
             m_HashTablesSize(
                     m_UniformData.levelCount *
                     m_UniformData.hashTableSize *
@@ -104,10 +152,29 @@ namespace en
                     m_HashTablesSize,
                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    {}),
+            m_MomentsBuffer(
+                    2 * m_HashTablesSize,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    {}),
+            m_EntryCount(m_UniformData.levelCount * m_UniformData.hashTableSize),
+            m_TouchedEntriesBuffer(
+                    sizeof(TouchedEntriesHeader) + (m_EntryCount * sizeof(uint32_t)),
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    {}),
+            m_TouchedBitsBuffer(
+                    ((m_EntryCount + 31) / 32) * sizeof(uint32_t),
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                     {})
     {
         VkDevice device = VulkanAPI::GetDevice();
 
+        if (!std::has_single_bit(m_UniformData.hashTableSize))
+            Log::Error("MRHE hash table size has to be a power of two", true);
+
         // Init mrhe resolutions
         float b = std::exp(
                 (std::log(static_cast<float>(m_UniformData.maxRes)) - std::log(static_cast<float>(m_UniformData.minRes))) /
@@ -120,39 +187,49 @@ namespace en
             m_UniformData.resolutions[i] = static_cast<uint32_t>(resF);
         }
 
+        // Coarse levels index their grid densely, report how much the hashed levels collide
+        m_CollisionRates.resize(m_UniformData.levelCount);
+        for (size_t i = 0; i < m_UniformData.levelCount; i++)
+        {
+            const uint32_t res = m_UniformData.resolutions[i];
+            const bool dense = cpu::MrheEncoder::IsDenseLevel(res, m_UniformData.hashTableSize);
+            m_UniformData.addressing[i] = dense ? Addressing::Dense : Addressing::Hashed;
+            m_CollisionRates[i] = cpu::MrheEncoder::MeasureCollisionRate(res, m_UniformData.hashTableSize);
+
+            Log::Info(
+                    "MRHE level " + std::to_string(i) + ": res " + std::to_string(res) + (dense ? ", dense" : ", hashed")
+                    + ", collision rate " + std::to_string(m_CollisionRates[i]));
+        }
+
         // Push uniform data to buffer
         m_UniformBuffer.SetData(sizeof(UniformData), &m_UniformData, 0, 0);
+        m_OptimizerUniformBuffer.SetData(sizeof(OptimizerConfig), &m_OptimizerConfig, 0, 0);
 
         // Setup hash tables buffer
         std::default_random_engine generator((std::random_device()()));
         std::normal_distribution<float> distribution(0.0f, 1.0);
 
-        float* hashTablesData = reinterpret_cast<float*>(malloc(m_HashTablesSize));
-
-        for (size_t i = 0; i < m_HashTablesSize / sizeof(float); i++)
+        std::vector<float> hashTablesData(m_HashTablesSize / sizeof(float));
+        for (float& feature : hashTablesData)
         {
-            hashTablesData[i] = distribution(generator) * 0.1f;
+            feature = distribution(generator) * 0.1f;
         }
 
         vk::Buffer stagingBuffer(
-                m_HashTablesSize,
+                2 * m_HashTablesSize,
                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                 {});
 
-        stagingBuffer.SetData(m_HashTablesSize, hashTablesData, 0, 0);
+        stagingBuffer.SetData(m_HashTablesSize, hashTablesData.data(), 0, 0);
         vk::Buffer::Copy(&stagingBuffer, &m_HashTablesBuffer, m_HashTablesSize);
 
-        // Setup delta hash tables buffer
-        float* deltaHashTablesData = reinterpret_cast<float*>(malloc(m_HashTablesSize));
-
-        for (size_t i = 0; i < m_HashTablesSize / sizeof(float); i++)
-        {
-            hashTablesData[i] = 0.0f;
-        }
-
-        stagingBuffer.SetData(m_HashTablesSize, deltaHashTablesData, 0, 0);
+        // Setup delta hash tables, moments and touched entry buffers, all zero
+        std::vector<float> zeroData(2 * m_HashTablesSize / sizeof(float), 0.0f);
+        stagingBuffer.SetData(2 * m_HashTablesSize, zeroData.data(), 0, 0);
         vk::Buffer::Copy(&stagingBuffer, &m_DeltaHashTablesBuffer, m_HashTablesSize);
+        vk::Buffer::Copy(&stagingBuffer, &m_MomentsBuffer, 2 * m_HashTablesSize);
+        vk::Buffer::Copy(&stagingBuffer, &m_TouchedBitsBuffer, ((m_EntryCount + 31) / 32) * sizeof(uint32_t));
 
         stagingBuffer.Destroy();
 
@@ -219,18 +296,103 @@ namespace en
         deltaHashTablesWrite.pBufferInfo = &deltaHashTablesBufferInfo;
         deltaHashTablesWrite.pTexelBufferView = nullptr;
 
-        std::vector<VkWriteDescriptorSet> writes = { uniformWrite, hashTablesWrite, deltaHashTablesWrite };
+        VkDescriptorBufferInfo optimizerBufferInfo;
+        optimizerBufferInfo.buffer = m_OptimizerUniformBuffer.GetVulkanHandle();
+        optimizerBufferInfo.offset = 0;
+        optimizerBufferInfo.range = sizeof(OptimizerConfig);
+
+        VkWriteDescriptorSet optimizerWrite;
+        optimizerWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        optimizerWrite.pNext = nullptr;
+        optimizerWrite.dstSet = m_DescSet;
+        optimizerWrite.dstBinding = 3;
+        optimizerWrite.dstArrayElement = 0;
+        optimizerWrite.descriptorCount = 1;
+        optimizerWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        optimizerWrite.pImageInfo = nullptr;
+        optimizerWrite.pBufferInfo = &optimizerBufferInfo;
+        optimizerWrite.pTexelBufferView = nullptr;
+
+        VkDescriptorBufferInfo momentsBufferInfo;
+        momentsBufferInfo.buffer = m_MomentsBuffer.GetVulkanHandle();
+        momentsBufferInfo.offset = 0;
+        momentsBufferInfo.range = 2 * m_HashTablesSize;
+
+        VkWriteDescriptorSet momentsWrite;
+        momentsWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        momentsWrite.pNext = nullptr;
+        momentsWrite.dstSet = m_DescSet;
+        momentsWrite.dstBinding = 4;
+        momentsWrite.dstArrayElement = 0;
+        momentsWrite.descriptorCount = 1;
+        momentsWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        momentsWrite.pImageInfo = nullptr;
+        momentsWrite.pBufferInfo = &momentsBufferInfo;
+        momentsWrite.pTexelBufferView = nullptr;
+
+        VkDescriptorBufferInfo touchedEntriesBufferInfo;
+        touchedEntriesBufferInfo.buffer = m_TouchedEntriesBuffer.GetVulkanHandle();
+        touchedEntriesBufferInfo.offset = 0;
+        touchedEntriesBufferInfo.range = sizeof(TouchedEntriesHeader) + (m_EntryCount * sizeof(uint32_t));
+
+        VkWriteDescriptorSet touchedEntriesWrite;
+        touchedEntriesWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        touchedEntriesWrite.pNext = nullptr;
+        touchedEntriesWrite.dstSet = m_DescSet;
+        touchedEntriesWrite.dstBinding = 5;
+        touchedEntriesWrite.dstArrayElement = 0;
+        touchedEntriesWrite.descriptorCount = 1;
+        touchedEntriesWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        touchedEntriesWrite.pImageInfo = nullptr;
+        touchedEntriesWrite.pBufferInfo = &touchedEntriesBufferInfo;
+        touchedEntriesWrite.pTexelBufferView = nullptr;
+
+        VkDescriptorBufferInfo touchedBitsBufferInfo;
+        touchedBitsBufferInfo.buffer = m_TouchedBitsBuffer.GetVulkanHandle();
+        touchedBitsBufferInfo.offset = 0;
+        touchedBitsBufferInfo.range = ((m_EntryCount + 31) / 32) * sizeof(uint32_t);
+
+        VkWriteDescriptorSet touchedBitsWrite;
+        touchedBitsWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        touchedBitsWrite.pNext = nullptr;
+        touchedBitsWrite.dstSet = m_DescSet;
+        touchedBitsWrite.dstBinding = 6;
+        touchedBitsWrite.dstArrayElement = 0;
+        touchedBitsWrite.descriptorCount = 1;
+        touchedBitsWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        touchedBitsWrite.pImageInfo = nullptr;
+        touchedBitsWrite.pBufferInfo = &touchedBitsBufferInfo;
+        touchedBitsWrite.pTexelBufferView = nullptr;
+
+        std::vector<VkWriteDescriptorSet> writes = {
+                uniformWrite,
+                hashTablesWrite,
+                deltaHashTablesWrite,
+                optimizerWrite,
+                momentsWrite,
+                touchedEntriesWrite,
+                touchedBitsWrite };
 
         vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
     }
 
     void MRHE::Destroy()
     {
+        m_TouchedBitsBuffer.Destroy();
+        m_TouchedEntriesBuffer.Destroy();
+        m_MomentsBuffer.Destroy();
         m_DeltaHashTablesBuffer.Destroy();
         m_HashTablesBuffer.Destroy();
+        m_OptimizerUniformBuffer.Destroy();
         m_UniformBuffer.Destroy();
     }
 
+    void MRHE::AdvanceOptimizer()
+    {
+        m_OptimizerConfig.Advance(++m_StepIndex);
+        m_OptimizerUniformBuffer.SetData(sizeof(OptimizerConfig), &m_OptimizerConfig, 0, 0);
+    }
+
     void MRHE::PrintHashTables() const
     {
         vk::Buffer stagingBuffer(
@@ -268,4 +430,24 @@ namespace en
     {
         return m_HashTablesSize;
     }
+
+    MRHE::Addressing MRHE::GetAddressing(uint32_t level) const
+    {
+        return m_UniformData.addressing[level];
+    }
+
+    float MRHE::GetCollisionRate(uint32_t level) const
+    {
+        return m_CollisionRates[level];
+    }
+
+    uint32_t MRHE::GetEntryCount() const
+    {
+        return m_EntryCount;
+    }
+
+    VkBuffer MRHE::GetTouchedEntriesBuffer() const
+    {
+        return m_TouchedEntriesBuffer.GetVulkanHandle();
+    }
 }
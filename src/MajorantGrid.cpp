@@ -0,0 +1,82 @@
+#include <engine/cpu/MajorantGrid.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace en::cpu
+{
+    MajorantGrid::MajorantGrid(const VolumeView& density, uint32_t brickSize)
+    {
+        if (brickSize == 0)
+            Log::Error("MajorantGrid brick size has to be at least one", true);
+
+        if (density.GetVoxelCount() == 0)
+            Log::Error("MajorantGrid density is empty", true);
+
+        const int voxelCountX = static_cast<int>(density.sizeX);
+        const int voxelCountY = static_cast<int>(density.sizeY);
+        const int voxelCountZ = static_cast<int>(density.sizeZ);
+
+        m_Header = {
+                .voxelCountX = static_cast<uint32_t>(voxelCountX),
+                .voxelCountY = static_cast<uint32_t>(voxelCountY),
+                .voxelCountZ = static_cast<uint32_t>(voxelCountZ),
+                .brickSize = brickSize,
+                .brickCountX = (static_cast<uint32_t>(voxelCountX) + brickSize - 1) / brickSize,
+                .brickCountY = (static_cast<uint32_t>(voxelCountY) + brickSize - 1) / brickSize,
+                .brickCountZ = (static_cast<uint32_t>(voxelCountZ) + brickSize - 1) / brickSize,
+                .padding = 0 };
+        m_MinMax.resize(static_cast<size_t>(m_Header.brickCountX) * m_Header.brickCountY * m_Header.brickCountZ * 2);
+
+        const int size = static_cast<int>(brickSize);
+        for (uint32_t brickZ = 0; brickZ < m_Header.brickCountZ; brickZ++)
+        {
+            for (uint32_t brickY = 0; brickY < m_Header.brickCountY; brickY++)
+            {
+                for (uint32_t brickX = 0; brickX < m_Header.brickCountX; brickX++)
+                {
+                    // The filter reaches one voxel past the brick on every side
+                    const int beginX = (static_cast<int>(brickX) * size) - 1;
+                    const int beginY = (static_cast<int>(brickY) * size) - 1;
+                    const int beginZ = (static_cast<int>(brickZ) * size) - 1;
+                    const int endX = beginX + size + 2;
+                    const int endY = beginY + size + 2;
+                    const int endZ = beginZ + size + 2;
+
+                    // Reaching into the border blends with 0
+                    const bool touchesBorder = beginX < 0 || beginY < 0 || beginZ < 0
+                                               || endX > voxelCountX || endY > voxelCountY || endZ > voxelCountZ;
+                    float minDensity = touchesBorder ? 0.0f : 1.0f;
+                    float maxDensity = 0.0f;
+
+                    for (int x = std::max(beginX, 0); x < std::min(endX, voxelCountX); x++)
+                    {
+                        for (int y = std::max(beginY, 0); y < std::min(endY, voxelCountY); y++)
+                        {
+                            for (int z = std::max(beginZ, 0); z < std::min(endZ, voxelCountZ); z++)
+                            {
+                                // R8_UNORM truncates, the float formats keep the value
+                                const float voxel = density.Get(x, y, z);
+                                const float value = static_cast<float>(static_cast<uint8_t>(voxel * 255.0f)) / 255.0f;
+                                minDensity = std::min(minDensity, value);
+                                maxDensity = std::max(maxDensity, voxel);
+                            }
+                        }
+                    }
+
+                    const size_t brickIndex = GetBrickIndex(brickX, brickY, brickZ);
+                    m_MinMax[brickIndex * 2] = minDensity;
+                    m_MinMax[(brickIndex * 2) + 1] = maxDensity;
+                }
+            }
+        }
+    }
+
+    std::vector<uint8_t> MajorantGrid::GetGpuData() const
+    {
+        std::vector<uint8_t> data(GetGpuSize());
+        std::memcpy(data.data(), &m_Header, sizeof(GpuHeader));
+        std::memcpy(data.data() + sizeof(GpuHeader), m_MinMax.data(), m_MinMax.size() * sizeof(float));
+        return data;
+    }
+}
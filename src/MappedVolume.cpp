@@ -0,0 +1,79 @@
+#include <engine/util/MappedVolume.hpp>
+#include <engine/util/Log.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace en
+{
+    MappedVolume::MappedVolume(const std::string& fileName, size_t sizeX, size_t sizeY, size_t sizeZ) :
+            m_SizeX(sizeX),
+            m_SizeY(sizeY),
+            m_SizeZ(sizeZ),
+            m_FileSize(0),
+            m_Data(nullptr)
+    {
+#ifdef _WIN32
+        m_File = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_File == INVALID_HANDLE_VALUE)
+            Log::Error("Failed to open file " + fileName, true);
+
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(m_File, &fileSize);
+        m_FileSize = static_cast<size_t>(fileSize.QuadPart);
+
+        m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_Mapping == nullptr)
+            Log::Error("Failed to map file " + fileName, true);
+
+        m_Data = static_cast<const float*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        m_File = open(fileName.c_str(), O_RDONLY);
+        if (m_File < 0)
+            Log::Error("Failed to open file " + fileName, true);
+
+        struct stat fileStat;
+        fstat(m_File, &fileStat);
+        m_FileSize = static_cast<size_t>(fileStat.st_size);
+
+        void* data = mmap(nullptr, m_FileSize, PROT_READ, MAP_PRIVATE, m_File, 0);
+        if (data != MAP_FAILED)
+        {
+            // Every voxel is read once front to back by the texture upload
+            madvise(data, m_FileSize, MADV_SEQUENTIAL);
+            m_Data = static_cast<const float*>(data);
+        }
+#endif
+
+        if (m_Data == nullptr)
+            Log::Error("Failed to map file " + fileName, true);
+
+        if (m_FileSize < sizeX * sizeY * sizeZ * sizeof(float))
+            Log::Error("File " + fileName + " is smaller than its volume", true);
+    }
+
+    MappedVolume::~MappedVolume()
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_Data);
+        CloseHandle(m_Mapping);
+        CloseHandle(m_File);
+#else
+        munmap(const_cast<float*>(m_Data), m_FileSize);
+        close(m_File);
+#endif
+    }
+
+    VolumeView MappedVolume::GetView() const
+    {
+        return VolumeView::ZFastest(std::span<const float>(m_Data, m_SizeX * m_SizeY * m_SizeZ), m_SizeX, m_SizeY, m_SizeZ);
+    }
+}
@@ -0,0 +1,274 @@
+#include <engine/cpu/MrheEncoder.hpp>
+#include <engine/cpu/Simd.hpp>
+#include <engine/util/Log.hpp>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <bit>
+
+namespace en::cpu
+{
+    // Same primes as HashFunc in nrc-train.comp
+    static constexpr uint32_t HASH_PRIME_Y = 19349663;
+    static constexpr uint32_t HASH_PRIME_Z = 83492791;
+
+    // Corner index is x * 4 + y * 2 + z like the neighbour index in the shaders
+    static constexpr size_t CORNER_COUNT = 8;
+
+    // Table offsets and trilinear weights of all corners of all levels for one block of simd::WIDTH positions
+    struct MrheEncoder::BlockCorners
+    {
+        alignas(64) uint32_t offsets[MAX_LEVEL_COUNT][CORNER_COUNT][simd::WIDTH];
+        alignas(64) float weights[MAX_LEVEL_COUNT][CORNER_COUNT][simd::WIDTH];
+    };
+
+    MrheEncoder::MrheEncoder(const Aabb& bounds, const Config& config) :
+            m_Bounds(bounds),
+            m_Config(config)
+    {
+        if (config.levelCount == 0 || config.levelCount > MAX_LEVEL_COUNT || !std::has_single_bit(config.hashTableSize))
+            Log::Error("MrheEncoder needs 1 to " + std::to_string(MAX_LEVEL_COUNT) + " levels and a power of two hash table size", true);
+
+        // Same resolutions as the MRHE constructor
+        const float b = config.levelCount > 1
+                ? std::exp((std::log(static_cast<float>(config.maxRes)) - std::log(static_cast<float>(config.minRes))) / static_cast<float>(config.levelCount - 1))
+                : 1.0f;
+        m_Resolutions.resize(config.levelCount);
+        for (uint32_t level = 0; level < config.levelCount; level++)
+        {
+            m_Resolutions[level] = static_cast<uint32_t>(static_cast<float>(config.minRes) * std::pow(b, static_cast<float>(level)));
+        }
+
+        m_Table.resize(static_cast<size_t>(config.levelCount) * config.hashTableSize * FEATURE_COUNT, 0.0f);
+    }
+
+    bool MrheEncoder::IsDenseLevel(uint32_t resolution, uint32_t hashTableSize)
+    {
+        const uint64_t side = static_cast<uint64_t>(resolution) + 1;
+        return side * side * side <= hashTableSize;
+    }
+
+    float MrheEncoder::MeasureCollisionRate(uint32_t resolution, uint32_t hashTableSize)
+    {
+        if (IsDenseLevel(resolution, hashTableSize))
+            return 0.0f;
+
+        // Vertices per entry, saturated at 2
+        std::vector<uint8_t> entryUse(hashTableSize, 0);
+        const uint32_t side = resolution + 1;
+        const uint32_t hashMask = hashTableSize - 1;
+        for (uint32_t z = 0; z < side; z++)
+        {
+            for (uint32_t y = 0; y < side; y++)
+            {
+                const uint32_t hashYZ = (y * HASH_PRIME_Y) + (z * HASH_PRIME_Z);
+                for (uint32_t x = 0; x < side; x++)
+                {
+                    uint8_t& use = entryUse[(hashYZ + x) & hashMask];
+                    if (use < 2)
+                        use++;
+                }
+            }
+        }
+
+        const size_t singleCount = std::count(entryUse.begin(), entryUse.end(), uint8_t(1));
+        const double vertexCount = static_cast<double>(side) * side * side;
+        return static_cast<float>(1.0 - (static_cast<double>(singleCount) / vertexCount));
+    }
+
+    void MrheEncoder::InitRandom(uint32_t seed)
+    {
+        // Same distribution as the MRHE constructor
+        std::default_random_engine generator(seed);
+        std::normal_distribution<float> distribution(0.0f, 1.0);
+
+        for (float& feature : m_Table)
+        {
+            feature = distribution(generator) * 0.1f;
+        }
+    }
+
+    void MrheEncoder::Encode(std::span<const glm::vec3> positions, std::span<float> features) const
+    {
+        const size_t count = positions.size();
+        if (features.size() < GetOutputWidth() * count)
+            Log::Error("MrheEncoder::Encode got a feature buffer that is too small for the batch", true);
+
+        BlockCorners corners;
+        alignas(64) float values[FEATURE_COUNT][simd::WIDTH];
+        alignas(64) float result[FEATURE_COUNT][simd::WIDTH];
+
+        for (size_t blockStart = 0; blockStart < count; blockStart += simd::WIDTH)
+        {
+            const size_t blockCount = std::min(simd::WIDTH, count - blockStart);
+            ComputeCorners(&positions[blockStart], blockCount, corners);
+
+            for (uint32_t level = 0; level < m_Config.levelCount; level++)
+            {
+                simd::Float acc[FEATURE_COUNT] = { simd::Zero(), simd::Zero() };
+
+                for (size_t corner = 0; corner < CORNER_COUNT; corner++)
+                {
+                    // Gather, the entries were prefetched by ComputeCorners
+                    const uint32_t* offsets = corners.offsets[level][corner];
+                    for (size_t i = 0; i < simd::WIDTH; i++)
+                    {
+                        values[0][i] = m_Table[offsets[i]];
+                        values[1][i] = m_Table[offsets[i] + 1];
+                    }
+
+                    const simd::Float weight = simd::Load(corners.weights[level][corner]);
+                    acc[0] = simd::Fmadd(weight, simd::Load(values[0]), acc[0]);
+                    acc[1] = simd::Fmadd(weight, simd::Load(values[1]), acc[1]);
+                }
+
+                for (uint32_t feature = 0; feature < FEATURE_COUNT; feature++)
+                {
+                    simd::Store(result[feature], acc[feature]);
+                    std::copy_n(result[feature], blockCount, &features[(((level * FEATURE_COUNT) + feature) * count) + blockStart]);
+                }
+            }
+        }
+    }
+
+    void MrheEncoder::Backward(std::span<const glm::vec3> positions, std::span<const float> featureGradients, std::span<float> tableGradients) const
+    {
+        const size_t count = positions.size();
+        if (featureGradients.size() < GetOutputWidth() * count || tableGradients.size() < m_Table.size())
+            Log::Error("MrheEncoder::Backward got buffers that are too small for the batch", true);
+
+        BlockCorners corners;
+        alignas(64) float gradients[FEATURE_COUNT][simd::WIDTH];
+        alignas(64) float deltas[FEATURE_COUNT][simd::WIDTH];
+
+        for (size_t blockStart = 0; blockStart < count; blockStart += simd::WIDTH)
+        {
+            const size_t blockCount = std::min(simd::WIDTH, count - blockStart);
+            ComputeCorners(&positions[blockStart], blockCount, corners);
+
+            for (uint32_t level = 0; level < m_Config.levelCount; level++)
+            {
+                for (uint32_t feature = 0; feature < FEATURE_COUNT; feature++)
+                {
+                    const float* src = &featureGradients[(((level * FEATURE_COUNT) + feature) * count) + blockStart];
+                    std::copy_n(src, blockCount, gradients[feature]);
+                    std::fill(&gradients[feature][blockCount], &gradients[feature][simd::WIDTH], 0.0f);
+                }
+
+                for (size_t corner = 0; corner < CORNER_COUNT; corner++)
+                {
+                    const simd::Float weight = simd::Load(corners.weights[level][corner]);
+                    simd::Store(deltas[0], simd::Mul(weight, simd::Load(gradients[0])));
+                    simd::Store(deltas[1], simd::Mul(weight, simd::Load(gradients[1])));
+
+                    // Scatter, rays of a block can share entries so this stays scalar
+                    const uint32_t* offsets = corners.offsets[level][corner];
+                    for (size_t i = 0; i < blockCount; i++)
+                    {
+                        tableGradients[offsets[i]] += deltas[0][i];
+                        tableGradients[offsets[i] + 1] += deltas[1][i];
+                    }
+                }
+            }
+        }
+    }
+
+    void MrheEncoder::ComputeCorners(const glm::vec3* positions, size_t count, BlockCorners& corners) const
+    {
+        // Transpose to structure of arrays and normalize to the bounds like EncodePosMrhe, padding lanes sit at the
+        // min corner
+        alignas(64) float normX[simd::WIDTH];
+        alignas(64) float normY[simd::WIDTH];
+        alignas(64) float normZ[simd::WIDTH];
+        for (size_t i = 0; i < simd::WIDTH; i++)
+        {
+            const glm::vec3 normPos = i < count ? m_Bounds.GetUvw(positions[i]) : glm::vec3(0.0f, 0.0f, 0.0f);
+            normX[i] = normPos.x;
+            normY[i] = normPos.y;
+            normZ[i] = normPos.z;
+        }
+
+        const simd::Float nx = simd::Load(normX);
+        const simd::Float ny = simd::Load(normY);
+        const simd::Float nz = simd::Load(normZ);
+        const simd::Float one = simd::Set1(1.0f);
+        const simd::Int primeY = simd::IntSet1(HASH_PRIME_Y);
+        const simd::Int primeZ = simd::IntSet1(HASH_PRIME_Z);
+        const simd::Int hashMask = simd::IntSet1(m_Config.hashTableSize - 1);
+        const simd::Int featureCount = simd::IntSet1(FEATURE_COUNT);
+
+        for (uint32_t level = 0; level < m_Config.levelCount; level++)
+        {
+            const simd::Float res = simd::Set1(static_cast<float>(m_Resolutions[level]));
+            const simd::Float resX = simd::Mul(nx, res);
+            const simd::Float resY = simd::Mul(ny, res);
+            const simd::Float resZ = simd::Mul(nz, res);
+            const simd::Float floorX = simd::Floor(resX);
+            const simd::Float floorY = simd::Floor(resY);
+            const simd::Float floorZ = simd::Floor(resZ);
+
+            // Trilinear weights of the lower and upper corner per axis
+            const simd::Float lerpX = simd::Sub(resX, floorX);
+            const simd::Float lerpY = simd::Sub(resY, floorY);
+            const simd::Float lerpZ = simd::Sub(resZ, floorZ);
+            const simd::Float weightX[2] = { simd::Sub(one, lerpX), lerpX };
+            const simd::Float weightY[2] = { simd::Sub(one, lerpY), lerpY };
+            const simd::Float weightZ[2] = { simd::Sub(one, lerpZ), lerpZ };
+
+            // Per axis index contribution of the lower and upper corner, summed up per corner below
+            simd::Int indexX[2];
+            simd::Int indexY[2];
+            simd::Int indexZ[2];
+            if (IsDenseLevel(level))
+            {
+                // index = x + y * side + z * side^2 with corners clamped to the grid
+                const uint32_t side = m_Resolutions[level] + 1;
+                const simd::Float zero = simd::Zero();
+                const simd::Float maxCoord = simd::Set1(static_cast<float>(m_Resolutions[level]));
+                const simd::Int strideY = simd::IntSet1(side);
+                const simd::Int strideZ = simd::IntSet1(side * side);
+                for (size_t i = 0; i < 2; i++)
+                {
+                    const simd::Float offset = simd::Set1(static_cast<float>(i));
+                    indexX[i] = simd::ToInt(simd::Min(simd::Max(simd::Add(floorX, offset), zero), maxCoord));
+                    indexY[i] = simd::IntMul(simd::ToInt(simd::Min(simd::Max(simd::Add(floorY, offset), zero), maxCoord)), strideY);
+                    indexZ[i] = simd::IntMul(simd::ToInt(simd::Min(simd::Max(simd::Add(floorZ, offset), zero), maxCoord)), strideZ);
+                }
+            }
+            else
+            {
+                // hash = x + y * primeY + z * primeZ, the upper corner only adds the prime
+                const simd::Int hashX0 = simd::ToInt(floorX);
+                const simd::Int hashY0 = simd::IntMul(simd::ToInt(floorY), primeY);
+                const simd::Int hashZ0 = simd::IntMul(simd::ToInt(floorZ), primeZ);
+                indexX[0] = hashX0;
+                indexX[1] = simd::IntAdd(hashX0, simd::IntSet1(1));
+                indexY[0] = hashY0;
+                indexY[1] = simd::IntAdd(hashY0, primeY);
+                indexZ[0] = hashZ0;
+                indexZ[1] = simd::IntAdd(hashZ0, primeZ);
+            }
+
+            const simd::Int levelStart = simd::IntSet1(level * m_Config.hashTableSize);
+
+            for (size_t corner = 0; corner < CORNER_COUNT; corner++)
+            {
+                const size_t x = corner / 4;
+                const size_t y = (corner / 2) % 2;
+                const size_t z = corner % 2;
+
+                simd::Store(corners.weights[level][corner], simd::Mul(simd::Mul(weightX[x], weightY[y]), weightZ[z]));
+
+                // Dense indices are below the table size, so the mask only affects hashed levels
+                uint32_t* offsets = corners.offsets[level][corner];
+                const simd::Int index = simd::IntAnd(simd::IntAdd(simd::IntAdd(indexX[x], indexY[y]), indexZ[z]), hashMask);
+                simd::IntStore(offsets, simd::IntMul(simd::IntAdd(index, levelStart), featureCount));
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    simd::Prefetch(&m_Table[offsets[i]]);
+                }
+            }
+        }
+    }
+}
@@ -1,5 +1,6 @@
 #include <engine/graphics/NeuralRadianceCache.hpp>
 #include <random>
+#include <cstddef>
 
 namespace en
 {
@@ -9,267 +10,17 @@ namespace en
     void NeuralRadianceCache::Init(VkDevice device)
     {
         // Create desc set layout
-        // Weights
-        VkDescriptorSetLayoutBinding weights0Binding;
-        weights0Binding.binding = 0;
-        weights0Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        weights0Binding.descriptorCount = 1;
-        weights0Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        weights0Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding weights1Binding;
-        weights1Binding.binding = 1;
-        weights1Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        weights1Binding.descriptorCount = 1;
-        weights1Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        weights1Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding weights2Binding;
-        weights2Binding.binding = 2;
-        weights2Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        weights2Binding.descriptorCount = 1;
-        weights2Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        weights2Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding weights3Binding;
-        weights3Binding.binding = 3;
-        weights3Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        weights3Binding.descriptorCount = 1;
-        weights3Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        weights3Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding weights4Binding;
-        weights4Binding.binding = 4;
-        weights4Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        weights4Binding.descriptorCount = 1;
-        weights4Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        weights4Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding weights5Binding;
-        weights5Binding.binding = 5;
-        weights5Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        weights5Binding.descriptorCount = 1;
-        weights5Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        weights5Binding.pImmutableSamplers = nullptr;
-
-        // Delta weights
-        VkDescriptorSetLayoutBinding deltaWeights0Binding;
-        deltaWeights0Binding.binding = 6;
-        deltaWeights0Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltaWeights0Binding.descriptorCount = 1;
-        deltaWeights0Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltaWeights0Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding deltaWeights1Binding;
-        deltaWeights1Binding.binding = 7;
-        deltaWeights1Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltaWeights1Binding.descriptorCount = 1;
-        deltaWeights1Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltaWeights1Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding deltaWeights2Binding;
-        deltaWeights2Binding.binding = 8;
-        deltaWeights2Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltaWeights2Binding.descriptorCount = 1;
-        deltaWeights2Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltaWeights2Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding deltaWeights3Binding;
-        deltaWeights3Binding.binding = 9;
-        deltaWeights3Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltaWeights3Binding.descriptorCount = 1;
-        deltaWeights3Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltaWeights3Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding deltaWeights4Binding;
-        deltaWeights4Binding.binding = 10;
-        deltaWeights4Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltaWeights4Binding.descriptorCount = 1;
-        deltaWeights4Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltaWeights4Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding deltaWeights5Binding;
-        deltaWeights5Binding.binding = 11;
-        deltaWeights5Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltaWeights5Binding.descriptorCount = 1;
-        deltaWeights5Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltaWeights5Binding.pImmutableSamplers = nullptr;
-
-        // Momentum 1 weights
-        VkDescriptorSetLayoutBinding momentum1Weights0Binding;
-        momentum1Weights0Binding.binding = 12;
-        momentum1Weights0Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Weights0Binding.descriptorCount = 1;
-        momentum1Weights0Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Weights0Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding momentum1Weights1Binding;
-        momentum1Weights1Binding.binding = 13;
-        momentum1Weights1Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Weights1Binding.descriptorCount = 1;
-        momentum1Weights1Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Weights1Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding momentum1Weights2Binding;
-        momentum1Weights2Binding.binding = 14;
-        momentum1Weights2Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Weights2Binding.descriptorCount = 1;
-        momentum1Weights2Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Weights2Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding momentum1Weights3Binding;
-        momentum1Weights3Binding.binding = 15;
-        momentum1Weights3Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Weights3Binding.descriptorCount = 1;
-        momentum1Weights3Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Weights3Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding momentum1Weights4Binding;
-        momentum1Weights4Binding.binding = 16;
-        momentum1Weights4Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Weights4Binding.descriptorCount = 1;
-        momentum1Weights4Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Weights4Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding momentum1Weights5Binding;
-        momentum1Weights5Binding.binding = 17;
-        momentum1Weights5Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Weights5Binding.descriptorCount = 1;
-        momentum1Weights5Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Weights5Binding.pImmutableSamplers = nullptr;
-
-        // Biases
-        VkDescriptorSetLayoutBinding biases0Binding;
-        biases0Binding.binding = 18;
-        biases0Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        biases0Binding.descriptorCount = 1;
-        biases0Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        biases0Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding biases1Binding;
-        biases1Binding.binding = 19;
-        biases1Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        biases1Binding.descriptorCount = 1;
-        biases1Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        biases1Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding biases2Binding;
-        biases2Binding.binding = 20;
-        biases2Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        biases2Binding.descriptorCount = 1;
-        biases2Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        biases2Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding biases3Binding;
-        biases3Binding.binding = 21;
-        biases3Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        biases3Binding.descriptorCount = 1;
-        biases3Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        biases3Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding biases4Binding;
-        biases4Binding.binding = 22;
-        biases4Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        biases4Binding.descriptorCount = 1;
-        biases4Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        biases4Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding biases5Binding;
-        biases5Binding.binding = 23;
-        biases5Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        biases5Binding.descriptorCount = 1;
-        biases5Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        biases5Binding.pImmutableSamplers = nullptr;
-
-        // Delta biases
-        VkDescriptorSetLayoutBinding deltabiases0Binding;
-        deltabiases0Binding.binding = 24;
-        deltabiases0Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltabiases0Binding.descriptorCount = 1;
-        deltabiases0Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltabiases0Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding deltabiases1Binding;
-        deltabiases1Binding.binding = 25;
-        deltabiases1Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltabiases1Binding.descriptorCount = 1;
-        deltabiases1Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltabiases1Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding deltabiases2Binding;
-        deltabiases2Binding.binding = 26;
-        deltabiases2Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltabiases2Binding.descriptorCount = 1;
-        deltabiases2Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltabiases2Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding deltabiases3Binding;
-        deltabiases3Binding.binding = 27;
-        deltabiases3Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltabiases3Binding.descriptorCount = 1;
-        deltabiases3Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltabiases3Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding deltabiases4Binding;
-        deltabiases4Binding.binding = 28;
-        deltabiases4Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltabiases4Binding.descriptorCount = 1;
-        deltabiases4Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltabiases4Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding deltabiases5Binding;
-        deltabiases5Binding.binding = 29;
-        deltabiases5Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        deltabiases5Binding.descriptorCount = 1;
-        deltabiases5Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        deltabiases5Binding.pImmutableSamplers = nullptr;
-
-        // Momentum 1 biases
-        VkDescriptorSetLayoutBinding momentum1Biases0Binding;
-        momentum1Biases0Binding.binding = 30;
-        momentum1Biases0Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Biases0Binding.descriptorCount = 1;
-        momentum1Biases0Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Biases0Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding momentum1Biases1Binding;
-        momentum1Biases1Binding.binding = 31;
-        momentum1Biases1Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Biases1Binding.descriptorCount = 1;
-        momentum1Biases1Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Biases1Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding momentum1Biases2Binding;
-        momentum1Biases2Binding.binding = 32;
-        momentum1Biases2Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Biases2Binding.descriptorCount = 1;
-        momentum1Biases2Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Biases2Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding momentum1Biases3Binding;
-        momentum1Biases3Binding.binding = 33;
-        momentum1Biases3Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Biases3Binding.descriptorCount = 1;
-        momentum1Biases3Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Biases3Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding momentum1Biases4Binding;
-        momentum1Biases4Binding.binding = 34;
-        momentum1Biases4Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Biases4Binding.descriptorCount = 1;
-        momentum1Biases4Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Biases4Binding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding momentum1Biases5Binding;
-        momentum1Biases5Binding.binding = 35;
-        momentum1Biases5Binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        momentum1Biases5Binding.descriptorCount = 1;
-        momentum1Biases5Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-        momentum1Biases5Binding.pImmutableSamplers = nullptr;
+        // Parameter arena
+        VkDescriptorSetLayoutBinding arenaBinding;
+        arenaBinding.binding = 0;
+        arenaBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        arenaBinding.descriptorCount = 1;
+        arenaBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        arenaBinding.pImmutableSamplers = nullptr;
 
         // Config uniform buffer
         VkDescriptorSetLayoutBinding configBinding;
-        configBinding.binding = 36;
+        configBinding.binding = 1;
         configBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         configBinding.descriptorCount = 1;
         configBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
@@ -277,51 +28,21 @@ namespace en
 
         // Stats buffer
         VkDescriptorSetLayoutBinding statsBinding;
-        statsBinding.binding = 37;
+        statsBinding.binding = 2;
         statsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
         statsBinding.descriptorCount = 1;
         statsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
         statsBinding.pImmutableSamplers = nullptr;
 
-        std::vector<VkDescriptorSetLayoutBinding> layoutBindings = {
-                weights0Binding,
-                weights1Binding,
-                weights2Binding,
-                weights3Binding,
-                weights4Binding,
-                weights5Binding,
-                deltaWeights0Binding,
-                deltaWeights1Binding,
-                deltaWeights2Binding,
-                deltaWeights3Binding,
-                deltaWeights4Binding,
-                deltaWeights5Binding,
-                momentum1Weights0Binding,
-                momentum1Weights1Binding,
-                momentum1Weights2Binding,
-                momentum1Weights3Binding,
-                momentum1Weights4Binding,
-                momentum1Weights5Binding,
-                biases0Binding,
-                biases1Binding,
-                biases2Binding,
-                biases3Binding,
-                biases4Binding,
-                biases5Binding,
-                deltabiases0Binding,
-                deltabiases1Binding,
-                deltabiases2Binding,
-                deltabiases3Binding,
-                deltabiases4Binding,
-                deltabiases5Binding,
-                momentum1Biases0Binding,
-                momentum1Biases1Binding,
-                momentum1Biases2Binding,
-                momentum1Biases3Binding,
-                momentum1Biases4Binding,
-                momentum1Biases5Binding,
-                configBinding,
-                statsBinding };
+        // OneBlob table buffer
+        VkDescriptorSetLayoutBinding oneBlobBinding;
+        oneBlobBinding.binding = 3;
+        oneBlobBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        oneBlobBinding.descriptorCount = 1;
+        oneBlobBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        oneBlobBinding.pImmutableSamplers = nullptr;
+
+        std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { arenaBinding, configBinding, statsBinding, oneBlobBinding };
 
         VkDescriptorSetLayoutCreateInfo layoutCI;
         layoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -336,7 +57,7 @@ namespace en
         // Create desc pool
         VkDescriptorPoolSize bufferPoolSize;
         bufferPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        bufferPoolSize.descriptorCount = 37;
+        bufferPoolSize.descriptorCount = 3;
 
         VkDescriptorPoolSize uniformPoolSize;
         uniformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -367,35 +88,90 @@ namespace en
         return m_DescSetLayout;
     }
 
+    MlpSpecData NeuralRadianceCache::GetMlpSpecData()
+    {
+        return MakeMlpSpecData<Topology>();
+    }
+
+    std::array<VkSpecializationMapEntry, 5> NeuralRadianceCache::GetMlpSpecMapEntries(uint32_t offset)
+    {
+        std::array<uint32_t, 5> memberOffsets = {
+                offsetof(MlpSpecData, inputWidth),
+                offsetof(MlpSpecData, width),
+                offsetof(MlpSpecData, outputWidth),
+                offsetof(MlpSpecData, hiddenLayers),
+                offsetof(MlpSpecData, maxWidth) };
+
+        std::array<VkSpecializationMapEntry, 5> entries;
+        for (uint32_t i = 0; i < entries.size(); i++)
+        {
+            entries[i].constantID = MLP_SPEC_CONSTANT_ID + i;
+            entries[i].offset = offset + memberOffsets[i];
+            entries[i].size = sizeof(uint32_t);
+        }
+
+        return entries;
+    }
+
+    VkSpecializationMapEntry NeuralRadianceCache::GetDirEncodingSpecMapEntry(uint32_t offset)
+    {
+        VkSpecializationMapEntry entry;
+        entry.constantID = DIR_ENCODING_SPEC_CONSTANT_ID;
+        entry.offset = offset;
+        entry.size = sizeof(uint32_t);
+        return entry;
+    }
+
     NeuralRadianceCache::NeuralRadianceCache(float learningRate, float weightDecay, float beta1) :
-            m_ConfigData({ .learningRate = learningRate, .weightDecay = weightDecay, .beta1 = beta1 }),
+            NeuralRadianceCache(OptimizerConfig::Momentum(learningRate, weightDecay, beta1))
+    {
+    }
+
+    NeuralRadianceCache::NeuralRadianceCache(
+            const OptimizerConfig& optimizerConfig,
+            const cpu::OneBlobEncoder::Config& oneBlobConfig) :
+            m_ConfigData(optimizerConfig),
+            m_StepIndex(0),
             m_StatsData({ .mseLoss = 0.0f }),
             m_ConfigUniformBuffer(
-                    sizeof(ConfigData),
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    sizeof(OptimizerConfig),
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                     {}),
             m_StatsBuffer(
                     sizeof(StatsData),
                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    {}),
+            m_ArenaBuffer(
+                    ARENA_REGION_COUNT * ARENA_REGION_SIZE,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    {}),
+            m_OneBlobData(cpu::OneBlobEncoder(GetOneBlobBinCount(DIR_ENCODING), oneBlobConfig).GetGpuData()),
+            m_OneBlobBuffer(
+                    m_OneBlobData.size(),
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                     {})
     {
-        // Set config
-        vk::Buffer stagingBuffer(
-                sizeof(ConfigData),
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                {});
-        stagingBuffer.SetData(sizeof(ConfigData), &m_ConfigData, 0, 0);
-        vk::Buffer::Copy(&stagingBuffer, &m_ConfigUniformBuffer, sizeof(ConfigData));
-        stagingBuffer.Destroy();
+        // Set config, host visible because the bias correction changes every step
+        m_ConfigUniformBuffer.SetData(sizeof(OptimizerConfig), &m_ConfigData, 0, 0);
 
         // Set stats
         m_StatsBuffer.SetData(sizeof(StatsData), &m_StatsData, 0, 0);
 
-        InitWeightBuffers();
-        InitBiasBuffers();
+        InitArena();
+
+        // Upload OneBlob table
+        vk::Buffer oneBlobStagingBuffer(
+                m_OneBlobData.size(),
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                {});
+        oneBlobStagingBuffer.SetData(m_OneBlobData.size(), m_OneBlobData.data(), 0, 0);
+        vk::Buffer::Copy(&oneBlobStagingBuffer, &m_OneBlobBuffer, m_OneBlobData.size());
+        oneBlobStagingBuffer.Destroy();
 
         // Allocate desc set
         VkDescriptorSetAllocateInfo descSetAI;
@@ -408,79 +184,34 @@ namespace en
         VkResult result = vkAllocateDescriptorSets(VulkanAPI::GetDevice(), &descSetAI, &m_DescSet);
         ASSERT_VULKAN(result);
 
-        // Sizes
-        std::array<size_t, 6> weightsSizes = {
-                64 * 64 * sizeof(float), // 32 mrhe + 2 dir
-                64 * 64 * sizeof(float),
-                64 * 64 * sizeof(float),
-                64 * 64 * sizeof(float),
-                64 * 64 * sizeof(float),
-                64 * 3 * sizeof(float) };
-
-        std::array<size_t, 6> biasesSizes = {
-                64 * sizeof(float), // 32 mrhe + 2 dir
-                64 * sizeof(float),
-                64 * sizeof(float),
-                64 * sizeof(float),
-                64 * sizeof(float),
-                3 * sizeof(float) };
-
         // Update descriptor set
-        // Set buffer infos
-        std::vector<VkDescriptorBufferInfo> bufferInfos(36);
-        for (size_t i = 0; i < m_Weights.size(); i++)
-        {
-            bufferInfos[i].buffer = m_Weights[i]->GetVulkanHandle();
-            bufferInfos[i].offset = 0;
-            bufferInfos[i].range = weightsSizes[i];
-
-            bufferInfos[i + 6].buffer = m_DeltaWeights[i]->GetVulkanHandle();
-            bufferInfos[i + 6].offset = 0;
-            bufferInfos[i + 6].range = weightsSizes[i];
-
-            bufferInfos[i + 12].buffer = m_Momentum1Weights[i]->GetVulkanHandle();
-            bufferInfos[i + 12].offset = 0;
-            bufferInfos[i + 12].range = weightsSizes[i];
-
-            bufferInfos[i + 18].buffer = m_Biases[i]->GetVulkanHandle();
-            bufferInfos[i + 18].offset = 0;
-            bufferInfos[i + 18].range = biasesSizes[i];
-
-            bufferInfos[i + 24].buffer = m_DeltaBiases[i]->GetVulkanHandle();
-            bufferInfos[i + 24].offset = 0;
-            bufferInfos[i + 24].range = biasesSizes[i];
-
-            bufferInfos[i + 30].buffer = m_Momentum1Biases[i]->GetVulkanHandle();
-            bufferInfos[i + 30].offset = 0;
-            bufferInfos[i + 30].range = biasesSizes[i];
-        }
-
-        // Set writes
-        std::vector<VkWriteDescriptorSet> writes(36);
-        for (size_t i = 0; i < writes.size(); i++)
-        {
-            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writes[i].pNext = nullptr;
-            writes[i].dstSet = m_DescSet;
-            writes[i].dstBinding = i;
-            writes[i].dstArrayElement = 0;
-            writes[i].descriptorCount = 1;
-            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            writes[i].pImageInfo = nullptr;
-            writes[i].pBufferInfo = &bufferInfos[i];
-            writes[i].pTexelBufferView = nullptr;
-        }
+        VkDescriptorBufferInfo arenaBufferInfo;
+        arenaBufferInfo.buffer = m_ArenaBuffer.GetVulkanHandle();
+        arenaBufferInfo.offset = 0;
+        arenaBufferInfo.range = ARENA_REGION_COUNT * ARENA_REGION_SIZE;
+
+        VkWriteDescriptorSet arenaWrite;
+        arenaWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        arenaWrite.pNext = nullptr;
+        arenaWrite.dstSet = m_DescSet;
+        arenaWrite.dstBinding = 0;
+        arenaWrite.dstArrayElement = 0;
+        arenaWrite.descriptorCount = 1;
+        arenaWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        arenaWrite.pImageInfo = nullptr;
+        arenaWrite.pBufferInfo = &arenaBufferInfo;
+        arenaWrite.pTexelBufferView = nullptr;
 
         VkDescriptorBufferInfo configBufferInfo;
         configBufferInfo.buffer = m_ConfigUniformBuffer.GetVulkanHandle();
         configBufferInfo.offset = 0;
-        configBufferInfo.range = sizeof(ConfigData);
+        configBufferInfo.range = sizeof(OptimizerConfig);
 
         VkWriteDescriptorSet configWrite;
         configWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         configWrite.pNext = nullptr;
         configWrite.dstSet = m_DescSet;
-        configWrite.dstBinding = 36;
+        configWrite.dstBinding = 1;
         configWrite.dstArrayElement = 0;
         configWrite.descriptorCount = 1;
         configWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -497,7 +228,7 @@ namespace en
         statsWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         statsWrite.pNext = nullptr;
         statsWrite.dstSet = m_DescSet;
-        statsWrite.dstBinding = 37;
+        statsWrite.dstBinding = 2;
         statsWrite.dstArrayElement = 0;
         statsWrite.descriptorCount = 1;
         statsWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -505,37 +236,34 @@ namespace en
         statsWrite.pBufferInfo = &statsBufferInfo;
         statsWrite.pTexelBufferView = nullptr;
 
-        writes.push_back(configWrite);
-        writes.push_back(statsWrite);
+        VkDescriptorBufferInfo oneBlobBufferInfo;
+        oneBlobBufferInfo.buffer = m_OneBlobBuffer.GetVulkanHandle();
+        oneBlobBufferInfo.offset = 0;
+        oneBlobBufferInfo.range = m_OneBlobData.size();
+
+        VkWriteDescriptorSet oneBlobWrite;
+        oneBlobWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        oneBlobWrite.pNext = nullptr;
+        oneBlobWrite.dstSet = m_DescSet;
+        oneBlobWrite.dstBinding = 3;
+        oneBlobWrite.dstArrayElement = 0;
+        oneBlobWrite.descriptorCount = 1;
+        oneBlobWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        oneBlobWrite.pImageInfo = nullptr;
+        oneBlobWrite.pBufferInfo = &oneBlobBufferInfo;
+        oneBlobWrite.pTexelBufferView = nullptr;
+
+        std::vector<VkWriteDescriptorSet> writes = { arenaWrite, configWrite, statsWrite, oneBlobWrite };
 
         vkUpdateDescriptorSets(VulkanAPI::GetDevice(), writes.size(), writes.data(), 0, nullptr);
     }
 
     void NeuralRadianceCache::Destroy()
     {
-        for (size_t i = 0; i < m_Weights.size(); i++)
-        {
-            m_Weights[i]->Destroy();
-            delete m_Weights[i];
-
-            m_DeltaWeights[i]->Destroy();
-            delete m_DeltaWeights[i];
-
-            m_Momentum1Weights[i]->Destroy();
-            delete m_Momentum1Weights[i];
-
-            m_Biases[i]->Destroy();
-            delete m_Biases[i];
-
-            m_DeltaBiases[i]->Destroy();
-            delete m_DeltaBiases[i];
-
-            m_Momentum1Biases[i]->Destroy();
-            delete m_Momentum1Biases[i];
-        }
-
+        m_ArenaBuffer.Destroy();
         m_ConfigUniformBuffer.Destroy();
         m_StatsBuffer.Destroy();
+        m_OneBlobBuffer.Destroy();
     }
 
     void NeuralRadianceCache::ResetStats()
@@ -544,6 +272,12 @@ namespace en
         m_StatsBuffer.SetData(sizeof(StatsData), &m_StatsData, 0, 0);
     }
 
+    void NeuralRadianceCache::AdvanceOptimizer()
+    {
+        m_ConfigData.Advance(++m_StepIndex);
+        m_ConfigUniformBuffer.SetData(sizeof(OptimizerConfig), &m_ConfigData, 0, 0);
+    }
+
     VkDescriptorSet NeuralRadianceCache::GetDescSet() const
     {
         return m_DescSet;
@@ -557,145 +291,75 @@ namespace en
 
     void NeuralRadianceCache::PrintWeights() const
     {
-        std::array<size_t, 6> sizes = {
-                64 * 64 * sizeof(float),
-                64 * 64 * sizeof(float),
-                64 * 64 * sizeof(float),
-                64 * 64 * sizeof(float),
-                64 * 64 * sizeof(float),
-                64 * 3 * sizeof(float) };
-
-        for (size_t i = 0; i < m_Weights.size(); i++)
-        {
-            vk::Buffer stagingBuffer(
-                    sizes[i],
-                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                    {});
-
-            vk::Buffer::Copy(m_Weights[i], &stagingBuffer, sizes[i]);
-
-            float* data = reinterpret_cast<float*>(malloc(sizes[i]));
+        const std::vector<float> params = DownloadParams();
 
-            stagingBuffer.GetData(sizes[i], data, 0, 0);
+        for (uint32_t layer = 0; layer < Topology::LAYER_COUNT; layer++)
+        {
+            const MlpTensor tensor = Topology::GetWeightTensor(layer);
 
-            std::string str = "Weights " + std::to_string(i) + ": [";
-            for (size_t weight = 0; weight < (sizes[i] / sizeof(float)); weight++)
+            std::string str = "Weights " + std::to_string(layer) + ": [";
+            for (uint32_t weight = 0; weight < tensor.count; weight++)
             {
-                str += std::to_string(data[weight]) + ", ";
+                str += std::to_string(params[tensor.offset + weight]) + ", ";
             }
             str += "]";
             Log::Info(str);
-
-            stagingBuffer.Destroy();
-
-            free(data);
         }
     }
 
-    void NeuralRadianceCache::InitWeightBuffers()
+    std::vector<float> NeuralRadianceCache::DownloadParams() const
     {
-        // Init weight sizes
-        std::array<size_t, 6> sizes = {
-                64 * 64 * sizeof(float), // 32 mrhe + 2 dir
-                64 * 64 * sizeof(float),
-                64 * 64 * sizeof(float),
-                64 * 64 * sizeof(float),
-                64 * 64 * sizeof(float),
-                64 * 3 * sizeof(float) };
-
-        // Init weights and delta weights buffer
-        for (size_t i = 0; i < m_Weights.size(); i++)
-        {
-            m_Weights[i] = new vk::Buffer(
-                    sizes[i],
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                    {});
-
-            m_DeltaWeights[i] = new vk::Buffer(
-                    sizes[i],
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                    {});
-
-            m_Momentum1Weights[i] = new vk::Buffer(sizes[i],
-                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                                   {});
-        }
-
-        // Set weights and delta weights
-        std::default_random_engine generator((std::random_device()()));
-        std::normal_distribution<float> distribution(0.0f, 1.0);
-
-        for (size_t i = 0; i < m_Weights.size(); i++)
-        {
-            vk::Buffer stagingBuffer = vk::Buffer(
-                    sizes[i],
-                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                    {});
-
-            float* data = reinterpret_cast<float*>(malloc(sizes[i]));
+        vk::Buffer stagingBuffer(
+                ARENA_REGION_SIZE,
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                {});
 
-            // Weights
-            for (size_t weight = 0; weight < (sizes[i] / sizeof(float)); weight++)
-            {
-                data[weight] = distribution(generator) * 0.01f;
-            }
+        vk::Buffer::Copy(&m_ArenaBuffer, &stagingBuffer, ARENA_REGION_SIZE, ARENA_PARAMS * ARENA_REGION_SIZE, 0);
 
-            stagingBuffer.SetData(sizes[i], data, 0, 0);
-            vk::Buffer::Copy(&stagingBuffer, m_Weights[i], sizes[i]);
+        std::vector<float> params(Topology::PARAM_COUNT);
+        stagingBuffer.GetData(ARENA_REGION_SIZE, params.data(), 0, 0);
+        stagingBuffer.Destroy();
 
-            // Delta weights and momentum 1 weights
-            for (size_t weight = 0; weight < (sizes[i] / sizeof(float)); weight++)
-            {
-                data[weight] = 0.0;
-            }
+        return params;
+    }
 
-            stagingBuffer.SetData(sizes[i], data, 0, 0);
-            vk::Buffer::Copy(&stagingBuffer, m_DeltaWeights[i], sizes[i]);
-            vk::Buffer::Copy(&stagingBuffer, m_Momentum1Weights[i], sizes[i]);
+    void NeuralRadianceCache::UploadParams(const std::vector<float>& params)
+    {
+        if (params.size() != Topology::PARAM_COUNT)
+            Log::Error("NeuralRadianceCache::UploadParams got " + std::to_string(params.size()) + " params", true);
 
-            free(data);
-            stagingBuffer.Destroy();
-        }
+        vk::Buffer stagingBuffer(
+                ARENA_REGION_SIZE,
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                {});
+        stagingBuffer.SetData(ARENA_REGION_SIZE, params.data(), 0, 0);
+        vk::Buffer::Copy(&stagingBuffer, &m_ArenaBuffer, ARENA_REGION_SIZE, 0, ARENA_PARAMS * ARENA_REGION_SIZE);
+        stagingBuffer.Destroy();
     }
 
-    void NeuralRadianceCache::InitBiasBuffers()
+    void NeuralRadianceCache::InitArena()
     {
-        // Init biases sizes
-        std::array<size_t, 6> biasesSizes = {
-                64 * sizeof(float), // 32 mrhe + 2 dir
-                64 * sizeof(float),
-                64 * sizeof(float),
-                64 * sizeof(float),
-                64 * sizeof(float),
-                3 * sizeof(float) };
-
-        // Init biases and delta biases buffer
-        for (size_t i = 0; i < m_Biases.size(); i++)
-        {
-            m_Biases[i] = new vk::Buffer(
-                    biasesSizes[i],
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                    {});
+        // Random weights, everything else (biases, gradients, moments) starts at zero
+        std::vector<float> data(ARENA_REGION_COUNT * Topology::PARAM_COUNT, 0.0f);
 
-            m_DeltaBiases[i] = new vk::Buffer(
-                    biasesSizes[i],
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                    {});
-
-            m_Momentum1Biases[i] = new vk::Buffer(
-                    biasesSizes[i],
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                    {});
+        std::default_random_engine generator((std::random_device()()));
+        std::normal_distribution<float> distribution(0.0f, 1.0);
+        for (uint32_t weight = 0; weight < Topology::WEIGHT_COUNT; weight++)
+        {
+            data[(ARENA_PARAMS * Topology::PARAM_COUNT) + weight] = distribution(generator) * 0.01f;
         }
 
-        // TODO: init biases
+        // Single upload
+        const VkDeviceSize size = data.size() * sizeof(float);
+        vk::Buffer stagingBuffer(
+                size,
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                {});
+        stagingBuffer.SetData(size, data.data(), 0, 0);
+        vk::Buffer::Copy(&stagingBuffer, &m_ArenaBuffer, size);
+        stagingBuffer.Destroy();
     }
 }
@@ -1,25 +1,24 @@
 #include <engine/graphics/renderer/NrcHpmRenderer.hpp>
 #include <engine/util/Log.hpp>
+#include <cstddef>
 
 namespace en
 {
     NrcHpmRenderer::NrcHpmRenderer(
             uint32_t width,
             uint32_t height,
-            uint32_t trainWidth,
-            uint32_t trainHeight,
             const Camera& camera,
             const VolumeData& volumeData,
             const DirLight& dirLight,
             const PointLight& pointLight,
             const HdrEnvMap& hdrEnvMap,
             const NeuralRadianceCache& nrc,
-            const MRHE& mrhe)
+            const MRHE& mrhe,
+            const TrainingSampleBuffer& trainingSamples,
+            const TrainingScheduler& trainingScheduler)
             :
             m_FrameWidth(width),
             m_FrameHeight(height),
-            m_TrainWidth(trainWidth),
-            m_TrainHeight(trainHeight),
             m_RenderVertShader("nrc-forward/nrc-forward.vert", false),
             m_RenderFragShader("nrc-forward/nrc-forward.frag", false),
             m_TrainShader("nrc-train/nrc-train.comp", false),
@@ -32,7 +31,9 @@ namespace en
             m_PointLight(pointLight),
             m_HdrEnvMap(hdrEnvMap),
             m_Nrc(nrc),
-            m_Mrhe(mrhe)
+            m_Mrhe(mrhe),
+            m_TrainingSamples(trainingSamples),
+            m_TrainingScheduler(trainingScheduler)
     {
         VkDevice device = VulkanAPI::GetDevice();
 
@@ -41,10 +42,26 @@ namespace en
         CreateRenderRenderPass(device);
         CreateRenderPipeline(device);
 
-        CreateTrainPipeline(device);
+        if (m_TrainingScheduler.GetGroupSize() != TRAIN_TILE_SIZE)
+            Log::Error("TrainingScheduler group size has to match TRAIN_TILE_SIZE", true);
+
+        if (TRAIN_SPLIT_GENERATION)
+        {
+            if (m_TrainingSamples.GetBatchSize() < m_TrainingScheduler.GetMaxSampleCount())
+                Log::Error("TrainingSampleBuffer batch is smaller than the TrainingScheduler sample count", true);
+
+            CreateTrainPipeline(device, TrainStage::Generate, &m_GeneratePipeline);
+            CreateTrainPipeline(device, TrainStage::Optimize, &m_TrainPipeline);
+        }
+        else
+        {
+            CreateTrainPipeline(device, TrainStage::Full, &m_TrainPipeline);
+        }
         CreateStepPipeline(device);
         CreateMrheStepPipeline(device);
 
+        CreateTrainQueryPool(device);
+
         CreateColorImage(device);
         CreateFramebuffer(device);
 
@@ -71,6 +88,24 @@ namespace en
         ASSERT_VULKAN(result);
     }
 
+    float NrcHpmRenderer::GetTrainTime() const
+    {
+        std::array<uint64_t, 2> timestamps;
+        VkResult result = vkGetQueryPoolResults(
+                VulkanAPI::GetDevice(),
+                m_TrainQueryPool,
+                0,
+                timestamps.size(),
+                timestamps.size() * sizeof(uint64_t),
+                timestamps.data(),
+                sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        ASSERT_VULKAN(result);
+
+        const double ticks = static_cast<double>(timestamps[1] - timestamps[0]);
+        return static_cast<float>(ticks * static_cast<double>(VulkanAPI::GetTimestampPeriod()) * 1e-6);
+    }
+
     void NrcHpmRenderer::Destroy()
     {
         VkDevice device = VulkanAPI::GetDevice();
@@ -82,6 +117,8 @@ namespace en
         vkFreeMemory(device, m_ColorImageMemory, nullptr);
         vkDestroyImage(device, m_ColorImage, nullptr);
 
+        vkDestroyQueryPool(device, m_TrainQueryPool, nullptr);
+
         vkDestroyPipeline(device, m_MrheStepPipeline, nullptr);
         m_MrheStepShader.Destroy();
 
@@ -89,6 +126,10 @@ namespace en
         m_StepShader.Destroy();
 
         vkDestroyPipeline(device, m_TrainPipeline, nullptr);
+        if (TRAIN_SPLIT_GENERATION)
+        {
+            vkDestroyPipeline(device, m_GeneratePipeline, nullptr);
+        }
         m_TrainShader.Destroy();
 
         vkDestroyPipeline(device, m_RenderPipeline, nullptr);
@@ -150,7 +191,9 @@ namespace en
                 NeuralRadianceCache::GetDescSetLayout(),
                 PointLight::GetDescriptorSetLayout(),
                 HdrEnvMap::GetDescriptorSetLayout(),
-                MRHE::GetDescriptorSetLayout() };
+                MRHE::GetDescriptorSetLayout(),
+                TrainingSampleBuffer::GetDescriptorSetLayout(),
+                TrainingScheduler::GetDescriptorSetLayout() };
 
         VkPipelineLayoutCreateInfo layoutCreateInfo;
         layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -226,6 +269,46 @@ namespace en
 
     void NrcHpmRenderer::CreateRenderPipeline(VkDevice device)
     {
+        // Mlp topology, direction encoding, transmittance estimator and empty space skipping
+        struct FragSpecData
+        {
+            MlpSpecData mlp;
+            uint32_t dirEncoding;
+            cpu::TransmittanceEstimator transmittanceEstimator;
+            uint32_t emptySpaceSkipping;
+        };
+
+        const FragSpecData fragSpecData = {
+                .mlp = NeuralRadianceCache::GetMlpSpecData(),
+                .dirEncoding = static_cast<uint32_t>(NeuralRadianceCache::DIR_ENCODING),
+                .transmittanceEstimator = TRANSMITTANCE_ESTIMATOR,
+                .emptySpaceSkipping = EMPTY_SPACE_SKIPPING ? 1u : 0u };
+
+        std::vector<VkSpecializationMapEntry> fragMapEntries;
+        for (const VkSpecializationMapEntry& mlpMapEntry : NeuralRadianceCache::GetMlpSpecMapEntries(offsetof(FragSpecData, mlp)))
+        {
+            fragMapEntries.push_back(mlpMapEntry);
+        }
+        fragMapEntries.push_back(NeuralRadianceCache::GetDirEncodingSpecMapEntry(offsetof(FragSpecData, dirEncoding)));
+
+        VkSpecializationMapEntry fragTransmittanceMapEntry;
+        fragTransmittanceMapEntry.constantID = 16;
+        fragTransmittanceMapEntry.offset = offsetof(FragSpecData, transmittanceEstimator);
+        fragTransmittanceMapEntry.size = sizeof(uint32_t);
+        fragMapEntries.push_back(fragTransmittanceMapEntry);
+
+        VkSpecializationMapEntry fragSkippingMapEntry;
+        fragSkippingMapEntry.constantID = 17;
+        fragSkippingMapEntry.offset = offsetof(FragSpecData, emptySpaceSkipping);
+        fragSkippingMapEntry.size = sizeof(uint32_t);
+        fragMapEntries.push_back(fragSkippingMapEntry);
+
+        VkSpecializationInfo fragSpecInfo;
+        fragSpecInfo.mapEntryCount = fragMapEntries.size();
+        fragSpecInfo.pMapEntries = fragMapEntries.data();
+        fragSpecInfo.dataSize = sizeof(FragSpecData);
+        fragSpecInfo.pData = &fragSpecData;
+
         // Shader stage
         VkPipelineShaderStageCreateInfo vertStageCreateInfo;
         vertStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -243,7 +326,7 @@ namespace en
         fragStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         fragStageCreateInfo.module = m_RenderFragShader.GetVulkanModule();
         fragStageCreateInfo.pName = "main";
-        fragStageCreateInfo.pSpecializationInfo = nullptr;
+        fragStageCreateInfo.pSpecializationInfo = &fragSpecInfo;
 
         std::vector<VkPipelineShaderStageCreateInfo> shaderStages = { vertStageCreateInfo, fragStageCreateInfo };
 
@@ -392,29 +475,133 @@ namespace en
         ASSERT_VULKAN(result);
     }
 
-    void NrcHpmRenderer::CreateTrainPipeline(VkDevice device)
+    uint32_t NrcHpmRenderer::GetFusedSharedMemorySize()
     {
-        VkSpecializationMapEntry widthMapEntry;
-        widthMapEntry.constantID = 0;
-        widthMapEntry.offset = 0;
-        widthMapEntry.size = sizeof(float);
+        using Topology = NeuralRadianceCache::Topology;
+        static_assert(TRAIN_FUSED_WEIGHT_COUNT >= Topology::MAX_WIDTH, "The shared weight chunk has to hold a layer row");
 
-        VkSpecializationMapEntry heightMapEntry;
-        heightMapEntry.constantID = 1;
-        heightMapEntry.offset = sizeof(float);
-        heightMapEntry.size = sizeof(float);
-
-        std::vector<VkSpecializationMapEntry> specMapEntries = { widthMapEntry, heightMapEntry };
+        // sWeights, sBiases and the staged input and error of the tile
+        const uint32_t floatCount =
+                TRAIN_FUSED_WEIGHT_COUNT + Topology::MAX_WIDTH + (2 * Topology::MAX_WIDTH * (TRAIN_TILE_SIZE + 1));
+        return floatCount * sizeof(float);
+    }
 
-        float specialData[] = {
-                1.0f / static_cast<float>(m_TrainWidth),
-                1.0f / static_cast<float>(m_TrainHeight) };
+    void NrcHpmRenderer::CreateTrainPipeline(VkDevice device, TrainStage stage, VkPipeline* pipeline)
+    {
+        struct TrainSpecData
+        {
+            uint32_t regionCountX;
+            uint32_t regionCountY;
+            uint32_t tileSize;
+            uint32_t fusedMlp;
+            uint32_t sparseMrhe;
+            uint32_t mrheStepGroupSize;
+            TrainStage stage;
+            uint32_t fusedWeightCount;
+            MlpSpecData mlp;
+            uint32_t dirEncoding;
+            cpu::TransmittanceEstimator transmittanceEstimator;
+            uint32_t emptySpaceSkipping;
+        };
+
+        VkSpecializationMapEntry regionCountXMapEntry;
+        regionCountXMapEntry.constantID = 0;
+        regionCountXMapEntry.offset = offsetof(TrainSpecData, regionCountX);
+        regionCountXMapEntry.size = sizeof(uint32_t);
+
+        VkSpecializationMapEntry regionCountYMapEntry;
+        regionCountYMapEntry.constantID = 1;
+        regionCountYMapEntry.offset = offsetof(TrainSpecData, regionCountY);
+        regionCountYMapEntry.size = sizeof(uint32_t);
+
+        VkSpecializationMapEntry tileSizeMapEntry;
+        tileSizeMapEntry.constantID = 2;
+        tileSizeMapEntry.offset = offsetof(TrainSpecData, tileSize);
+        tileSizeMapEntry.size = sizeof(uint32_t);
+
+        VkSpecializationMapEntry fusedMlpMapEntry;
+        fusedMlpMapEntry.constantID = 3;
+        fusedMlpMapEntry.offset = offsetof(TrainSpecData, fusedMlp);
+        fusedMlpMapEntry.size = sizeof(uint32_t);
+
+        VkSpecializationMapEntry sparseMrheMapEntry;
+        sparseMrheMapEntry.constantID = 4;
+        sparseMrheMapEntry.offset = offsetof(TrainSpecData, sparseMrhe);
+        sparseMrheMapEntry.size = sizeof(uint32_t);
+
+        VkSpecializationMapEntry mrheStepGroupSizeMapEntry;
+        mrheStepGroupSizeMapEntry.constantID = 5;
+        mrheStepGroupSizeMapEntry.offset = offsetof(TrainSpecData, mrheStepGroupSize);
+        mrheStepGroupSizeMapEntry.size = sizeof(uint32_t);
+
+        VkSpecializationMapEntry stageMapEntry;
+        stageMapEntry.constantID = 6;
+        stageMapEntry.offset = offsetof(TrainSpecData, stage);
+        stageMapEntry.size = sizeof(uint32_t);
+
+        VkSpecializationMapEntry fusedWeightCountMapEntry;
+        fusedWeightCountMapEntry.constantID = 7;
+        fusedWeightCountMapEntry.offset = offsetof(TrainSpecData, fusedWeightCount);
+        fusedWeightCountMapEntry.size = sizeof(uint32_t);
+
+        std::vector<VkSpecializationMapEntry> specMapEntries = {
+                regionCountXMapEntry,
+                regionCountYMapEntry,
+                tileSizeMapEntry,
+                fusedMlpMapEntry,
+                sparseMrheMapEntry,
+                mrheStepGroupSizeMapEntry,
+                stageMapEntry,
+                fusedWeightCountMapEntry };
+
+        for (const VkSpecializationMapEntry& mlpMapEntry : NeuralRadianceCache::GetMlpSpecMapEntries(offsetof(TrainSpecData, mlp)))
+        {
+            specMapEntries.push_back(mlpMapEntry);
+        }
+        specMapEntries.push_back(NeuralRadianceCache::GetDirEncodingSpecMapEntry(offsetof(TrainSpecData, dirEncoding)));
+
+        VkSpecializationMapEntry transmittanceMapEntry;
+        transmittanceMapEntry.constantID = 16;
+        transmittanceMapEntry.offset = offsetof(TrainSpecData, transmittanceEstimator);
+        transmittanceMapEntry.size = sizeof(uint32_t);
+        specMapEntries.push_back(transmittanceMapEntry);
+
+        VkSpecializationMapEntry skippingMapEntry;
+        skippingMapEntry.constantID = 17;
+        skippingMapEntry.offset = offsetof(TrainSpecData, emptySpaceSkipping);
+        skippingMapEntry.size = sizeof(uint32_t);
+        specMapEntries.push_back(skippingMapEntry);
+
+        // The fused mlp needs the shared memory of the whole topology, fall back instead of failing pipeline creation
+        const uint32_t sharedMemorySize = GetFusedSharedMemorySize();
+        const uint32_t maxSharedMemorySize = VulkanAPI::GetMaxComputeSharedMemorySize();
+        const bool fusedMlp = TRAIN_FUSED_MLP && sharedMemorySize <= maxSharedMemorySize;
+        if (TRAIN_FUSED_MLP && !fusedMlp && stage != TrainStage::Generate)
+        {
+            Log::Warn(
+                    "Fused training mlp needs " + std::to_string(sharedMemorySize) + " bytes of shared memory, the device has "
+                    + std::to_string(maxSharedMemorySize) + ". Training with the unfused mlp");
+        }
+
+        TrainSpecData specialData = {
+                .regionCountX = TrainingScheduler::REGION_COUNT_X,
+                .regionCountY = TrainingScheduler::REGION_COUNT_Y,
+                .tileSize = TRAIN_TILE_SIZE,
+                .fusedMlp = fusedMlp ? 1u : 0u,
+                .sparseMrhe = MRHE_SPARSE_STEP ? 1u : 0u,
+                .mrheStepGroupSize = STEP_GROUP_SIZE,
+                .stage = stage,
+                .fusedWeightCount = TRAIN_FUSED_WEIGHT_COUNT,
+                .mlp = NeuralRadianceCache::GetMlpSpecData(),
+                .dirEncoding = static_cast<uint32_t>(NeuralRadianceCache::DIR_ENCODING),
+                .transmittanceEstimator = TRANSMITTANCE_ESTIMATOR,
+                .emptySpaceSkipping = EMPTY_SPACE_SKIPPING ? 1u : 0u };
 
         VkSpecializationInfo specInfo;
         specInfo.mapEntryCount = specMapEntries.size();
         specInfo.pMapEntries = specMapEntries.data();
-        specInfo.dataSize = sizeof(float) * 2;
-        specInfo.pData = specialData;
+        specInfo.dataSize = sizeof(TrainSpecData);
+        specInfo.pData = &specialData;
 
         VkPipelineShaderStageCreateInfo shaderStage;
         shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -434,12 +621,39 @@ namespace en
         pipelineCI.basePipelineHandle = VK_NULL_HANDLE;
         pipelineCI.basePipelineIndex = 0;
 
-        VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &m_TrainPipeline);
+        VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, pipeline);
         ASSERT_VULKAN(result);
     }
 
     void NrcHpmRenderer::CreateStepPipeline(VkDevice device)
     {
+        struct StepSpecData
+        {
+            uint32_t groupSize;
+            MlpSpecData mlp;
+        };
+
+        VkSpecializationMapEntry groupSizeMapEntry;
+        groupSizeMapEntry.constantID = 2;
+        groupSizeMapEntry.offset = offsetof(StepSpecData, groupSize);
+        groupSizeMapEntry.size = sizeof(uint32_t);
+
+        std::vector<VkSpecializationMapEntry> specMapEntries = { groupSizeMapEntry };
+        for (const VkSpecializationMapEntry& mlpMapEntry : NeuralRadianceCache::GetMlpSpecMapEntries(offsetof(StepSpecData, mlp)))
+        {
+            specMapEntries.push_back(mlpMapEntry);
+        }
+
+        StepSpecData specialData = {
+                .groupSize = STEP_GROUP_SIZE,
+                .mlp = NeuralRadianceCache::GetMlpSpecData() };
+
+        VkSpecializationInfo specInfo;
+        specInfo.mapEntryCount = specMapEntries.size();
+        specInfo.pMapEntries = specMapEntries.data();
+        specInfo.dataSize = sizeof(StepSpecData);
+        specInfo.pData = &specialData;
+
         VkPipelineShaderStageCreateInfo shaderStage;
         shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStage.pNext = nullptr;
@@ -447,7 +661,7 @@ namespace en
         shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
         shaderStage.module = m_StepShader.GetVulkanModule();
         shaderStage.pName = "main";
-        shaderStage.pSpecializationInfo = nullptr;
+        shaderStage.pSpecializationInfo = &specInfo;
 
         VkComputePipelineCreateInfo pipelineCI;
         pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -464,6 +678,34 @@ namespace en
 
     void NrcHpmRenderer::CreateMrheStepPipeline(VkDevice device)
     {
+        struct MrheStepSpecData
+        {
+            uint32_t groupSize;
+            uint32_t sparseStep;
+        };
+
+        VkSpecializationMapEntry groupSizeMapEntry;
+        groupSizeMapEntry.constantID = 2;
+        groupSizeMapEntry.offset = offsetof(MrheStepSpecData, groupSize);
+        groupSizeMapEntry.size = sizeof(uint32_t);
+
+        VkSpecializationMapEntry sparseStepMapEntry;
+        sparseStepMapEntry.constantID = 3;
+        sparseStepMapEntry.offset = offsetof(MrheStepSpecData, sparseStep);
+        sparseStepMapEntry.size = sizeof(uint32_t);
+
+        std::vector<VkSpecializationMapEntry> specMapEntries = { groupSizeMapEntry, sparseStepMapEntry };
+
+        MrheStepSpecData specialData = {
+                .groupSize = STEP_GROUP_SIZE,
+                .sparseStep = MRHE_SPARSE_STEP ? 1u : 0u };
+
+        VkSpecializationInfo specInfo;
+        specInfo.mapEntryCount = specMapEntries.size();
+        specInfo.pMapEntries = specMapEntries.data();
+        specInfo.dataSize = sizeof(MrheStepSpecData);
+        specInfo.pData = &specialData;
+
         VkPipelineShaderStageCreateInfo shaderStage;
         shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStage.pNext = nullptr;
@@ -471,7 +713,7 @@ namespace en
         shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
         shaderStage.module = m_MrheStepShader.GetVulkanModule();
         shaderStage.pName = "main";
-        shaderStage.pSpecializationInfo = nullptr;
+        shaderStage.pSpecializationInfo = &specInfo;
 
         VkComputePipelineCreateInfo pipelineCI;
         pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -486,6 +728,20 @@ namespace en
         ASSERT_VULKAN(result);
     }
 
+    void NrcHpmRenderer::CreateTrainQueryPool(VkDevice device)
+    {
+        VkQueryPoolCreateInfo queryPoolCI;
+        queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolCI.pNext = nullptr;
+        queryPoolCI.flags = 0;
+        queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolCI.queryCount = 2;
+        queryPoolCI.pipelineStatistics = 0;
+
+        VkResult result = vkCreateQueryPool(device, &queryPoolCI, nullptr, &m_TrainQueryPool);
+        ASSERT_VULKAN(result);
+    }
+
     void NrcHpmRenderer::CreateColorImage(VkDevice device)
     {
         // Create Image
@@ -589,7 +845,9 @@ namespace en
                 m_Nrc.GetDescSet(),
                 m_PointLight.GetDescriptorSet(),
                 m_HdrEnvMap.GetDescriptorSet(),
-                m_Mrhe.GetDescriptorSet() };
+                m_Mrhe.GetDescriptorSet(),
+                m_TrainingSamples.GetDescriptorSet(),
+                m_TrainingScheduler.GetDescriptorSet() };
 
         // Bind descriptor sets
         vkCmdBindDescriptorSets(
@@ -597,23 +855,78 @@ namespace en
                 0, descSets.size(), descSets.data(),
                 0, nullptr);
 
+        // Reset touched mrhe entry list (bits are cleared by the sparse step itself)
+        if (MRHE_SPARSE_STEP)
+        {
+            const MRHE::TouchedEntriesHeader touchedHeader = {
+                    .groupCountX = 0,
+                    .groupCountY = 1,
+                    .groupCountZ = 1,
+                    .entryCount = 0 };
+            vkCmdUpdateBuffer(m_CommandBuffer, m_Mrhe.GetTouchedEntriesBuffer(), 0, sizeof(touchedHeader), &touchedHeader);
+
+            VkMemoryBarrier resetBarrier;
+            resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            resetBarrier.pNext = nullptr;
+            resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(
+                    m_CommandBuffer,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    0,
+                    1, &resetBarrier,
+                    0, nullptr,
+                    0, nullptr);
+        }
+
+        // Time the training
+        vkCmdResetQueryPool(m_CommandBuffer, m_TrainQueryPool, 0, 2);
+        vkCmdWriteTimestamp(m_CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_TrainQueryPool, 0);
+
+        // The TrainingScheduler sets the sample count of every frame, the train dispatches read it from its buffer
+        const VkBuffer scheduleBuffer = m_TrainingScheduler.GetScheduleBuffer();
+
+        // Generate the training batch first, the optimize dispatch then only runs full mlp tiles
+        if (TRAIN_SPLIT_GENERATION)
+        {
+            vkCmdBindPipeline(m_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_GeneratePipeline);
+            vkCmdDispatchIndirect(m_CommandBuffer, scheduleBuffer, 0);
+
+            VkMemoryBarrier batchBarrier;
+            batchBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            batchBarrier.pNext = nullptr;
+            batchBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            batchBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            vkCmdPipelineBarrier(
+                    m_CommandBuffer,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    0,
+                    1, &batchBarrier,
+                    0, nullptr,
+                    0, nullptr);
+        }
+
         // Bind train pipeline
         vkCmdBindPipeline(m_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_TrainPipeline);
 
-        // Dispatch training
-        vkCmdDispatch(m_CommandBuffer, 100, 100, 1);
+        // Dispatch training (one invocation per training sample, TRAIN_TILE_SIZE samples per workgroup)
+        vkCmdDispatchIndirect(m_CommandBuffer, scheduleBuffer, 0);
 
-        // Pipeline barrier
+        // Pipeline barrier, also makes the touched entry header readable as indirect dispatch
         VkMemoryBarrier memoryBarrier;
         memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
         memoryBarrier.pNext = nullptr;
         memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
-        memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
 
         vkCmdPipelineBarrier(
                 m_CommandBuffer,
                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
                 0,
                 1, &memoryBarrier,
                 0, nullptr,
@@ -628,8 +941,9 @@ namespace en
         // Bind nrc step pipeline
         vkCmdBindPipeline(m_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_StepPipeline);
 
-        // Dispatch nrc gradient step
-        vkCmdDispatch(m_CommandBuffer, 4096, 1, 1);
+        // Dispatch nrc gradient step, one invocation per parameter
+        const uint32_t paramCount = NeuralRadianceCache::Topology::PARAM_COUNT;
+        vkCmdDispatch(m_CommandBuffer, (paramCount + STEP_GROUP_SIZE - 1) / STEP_GROUP_SIZE, 1, 1);
 
         // Pipeline barrier
         memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
@@ -655,8 +969,18 @@ namespace en
         // Bind mrhe step pipeline
         vkCmdBindPipeline(m_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_MrheStepPipeline);
 
-        // Dispatch mrhe gradient step
-        vkCmdDispatch(m_CommandBuffer, m_Mrhe.GetHashTableSize() / sizeof(float), 1, 1);
+        // Dispatch mrhe gradient step, either over the touched entries or over every hash table float
+        if (MRHE_SPARSE_STEP)
+        {
+            vkCmdDispatchIndirect(m_CommandBuffer, m_Mrhe.GetTouchedEntriesBuffer(), 0);
+        }
+        else
+        {
+            const uint32_t floatCount = m_Mrhe.GetHashTableSize() / sizeof(float);
+            vkCmdDispatch(m_CommandBuffer, (floatCount + STEP_GROUP_SIZE - 1) / STEP_GROUP_SIZE, 1, 1);
+        }
+
+        vkCmdWriteTimestamp(m_CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_TrainQueryPool, 1);
 
         // Pipeline barrier
         memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
@@ -0,0 +1,6 @@
+#include <engine/cpu/NrcMlp.hpp>
+
+namespace en::cpu
+{
+    template class Mlp<NrcTopology>;
+}
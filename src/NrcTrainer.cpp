@@ -0,0 +1,6 @@
+#include <engine/cpu/NrcTrainer.hpp>
+
+namespace en::cpu
+{
+    template class MlpTrainer<NrcTopology>;
+}
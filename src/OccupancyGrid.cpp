@@ -0,0 +1,119 @@
+#include <engine/cpu/OccupancyGrid.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cstring>
+
+namespace en::cpu
+{
+    OccupancyGrid::OccupancyGrid(const MajorantGrid& majorantGrid, uint32_t macroSize, float densityFactor) :
+            m_DensityFactor(densityFactor),
+            m_OccupiedBrickCount(0)
+    {
+        if (macroSize == 0)
+            Log::Error("OccupancyGrid macro cell size has to be at least one", true);
+
+        const uint32_t brickCountX = majorantGrid.GetBrickCountX();
+        const uint32_t brickCountY = majorantGrid.GetBrickCountY();
+        const uint32_t brickCountZ = majorantGrid.GetBrickCountZ();
+        const uint32_t brickCount = brickCountX * brickCountY * brickCountZ;
+        const uint32_t macroCountX = (brickCountX + macroSize - 1) / macroSize;
+        const uint32_t macroCountY = (brickCountY + macroSize - 1) / macroSize;
+        const uint32_t macroCountZ = (brickCountZ + macroSize - 1) / macroSize;
+        const uint32_t macroCount = macroCountX * macroCountY * macroCountZ;
+
+        m_Header = {
+                .brickCountX = brickCountX,
+                .brickCountY = brickCountY,
+                .brickCountZ = brickCountZ,
+                .macroSize = macroSize,
+                .macroCountX = macroCountX,
+                .macroCountY = macroCountY,
+                .macroCountZ = macroCountZ,
+                .macroWordOffset = (brickCount + 31) / 32 };
+        m_Words.resize(m_Header.macroWordOffset + ((macroCount + 31) / 32), 0);
+        m_MacroOccupiedCounts.resize(macroCount, 0);
+
+        // Sort the bricks by their maximum, the minimum and maximum are interleaved
+        const std::span<const float> minMax = majorantGrid.GetMinMax();
+        m_SortedBricks.resize(brickCount);
+        std::iota(m_SortedBricks.begin(), m_SortedBricks.end(), 0);
+        std::stable_sort(m_SortedBricks.begin(), m_SortedBricks.end(), [&](uint32_t a, uint32_t b)
+        {
+            return minMax[(a * 2) + 1] < minMax[(b * 2) + 1];
+        });
+        m_SortedMax.resize(brickCount);
+        for (uint32_t i = 0; i < brickCount; i++)
+        {
+            m_SortedMax[i] = minMax[(m_SortedBricks[i] * 2) + 1];
+        }
+
+        for (size_t i = GetCutoffIndex(GetCutoff(densityFactor)); i < brickCount; i++)
+        {
+            SetBrickOccupied(m_SortedBricks[i], true);
+        }
+    }
+
+    size_t OccupancyGrid::SetDensityFactor(float densityFactor)
+    {
+        const size_t oldIndex = GetCutoffIndex(GetCutoff(m_DensityFactor));
+        const size_t newIndex = GetCutoffIndex(GetCutoff(densityFactor));
+        m_DensityFactor = densityFactor;
+
+        // A lower cutoff occupies the bricks between the two, a higher one empties them
+        const bool occupied = newIndex < oldIndex;
+        for (size_t i = std::min(oldIndex, newIndex); i < std::max(oldIndex, newIndex); i++)
+        {
+            SetBrickOccupied(m_SortedBricks[i], occupied);
+        }
+
+        return std::max(oldIndex, newIndex) - std::min(oldIndex, newIndex);
+    }
+
+    std::vector<uint8_t> OccupancyGrid::GetGpuData() const
+    {
+        std::vector<uint8_t> data(GetGpuSize());
+        std::memcpy(data.data(), &m_Header, sizeof(GpuHeader));
+        std::memcpy(data.data() + sizeof(GpuHeader), m_Words.data(), m_Words.size() * sizeof(uint32_t));
+        return data;
+    }
+
+    float OccupancyGrid::GetCutoff(float densityFactor)
+    {
+        // Bricks without any density stay empty even at a cutoff of 0
+        if (densityFactor <= 0.0f)
+            return std::numeric_limits<float>::infinity();
+        return std::max(EMPTY_DENSITY / densityFactor, std::numeric_limits<float>::min());
+    }
+
+    size_t OccupancyGrid::GetCutoffIndex(float cutoff) const
+    {
+        return std::lower_bound(m_SortedMax.begin(), m_SortedMax.end(), cutoff) - m_SortedMax.begin();
+    }
+
+    void OccupancyGrid::SetBrickOccupied(uint32_t brickIndex, bool occupied)
+    {
+        const uint32_t brickX = brickIndex % m_Header.brickCountX;
+        const uint32_t brickY = (brickIndex / m_Header.brickCountX) % m_Header.brickCountY;
+        const uint32_t brickZ = brickIndex / (m_Header.brickCountX * m_Header.brickCountY);
+        const uint32_t macroIndex = (brickX / m_Header.macroSize)
+                                    + (m_Header.macroCountX * ((brickY / m_Header.macroSize) + (m_Header.macroCountY * (brickZ / m_Header.macroSize))));
+        const size_t macroBit = (static_cast<size_t>(m_Header.macroWordOffset) * 32) + macroIndex;
+
+        if (occupied)
+        {
+            m_Words[brickIndex / 32] |= 1u << (brickIndex % 32);
+            m_OccupiedBrickCount++;
+            if (m_MacroOccupiedCounts[macroIndex]++ == 0)
+                m_Words[macroBit / 32] |= 1u << (macroBit % 32);
+        }
+        else
+        {
+            m_Words[brickIndex / 32] &= ~(1u << (brickIndex % 32));
+            m_OccupiedBrickCount--;
+            if (--m_MacroOccupiedCounts[macroIndex] == 0)
+                m_Words[macroBit / 32] &= ~(1u << (macroBit % 32));
+        }
+    }
+}
@@ -0,0 +1,160 @@
+#include <engine/cpu/OneBlobEncoder.hpp>
+#include <engine/util/Log.hpp>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace en::cpu
+{
+    static constexpr float PI = 3.14159265359f;
+
+    // Peak of the kernel, 1 / (sigma * sqrt(2 pi))
+    static constexpr float KERNEL_PEAK = 1.0f / (OneBlobEncoder::SIGMA * 2.50662827463f);
+
+    const OneBlobEncoder::Config OneBlobEncoder::DEFAULT_CONFIG = OneBlobEncoder::ForErrorBound(1e-3f);
+
+    OneBlobEncoder::Config OneBlobEncoder::ForErrorBound(float errorBound)
+    {
+        // Linear interpolation is off by at most h^2 / 8 * max|K''| and |K''| peaks at the center with peak / sigma^2
+        const float spacing = std::sqrt(8.0f * errorBound * SIGMA * SIGMA / KERNEL_PEAK);
+        return { .samplesPerBin = static_cast<uint32_t>(std::ceil(1.0f / spacing)), .errorBound = errorBound };
+    }
+
+    OneBlobEncoder::OneBlobEncoder(uint32_t binCount, const Config& config) :
+            m_BinCount(binCount),
+            m_Config(config),
+            m_Cutoff(0.0f)
+    {
+        if (config.samplesPerBin == 0)
+            return;
+
+        if (config.errorBound <= 0.0f)
+            Log::Error("OneBlobEncoder needs a positive error bound to build its table", true);
+
+        // Distance at which the kernel drops to the error bound
+        if (config.errorBound < KERNEL_PEAK)
+            m_Cutoff = SIGMA * std::sqrt(2.0f * std::log(KERNEL_PEAK / config.errorBound));
+
+        // One extra sample so the interpolation right below the cutoff stays in the table
+        const size_t sampleCount = static_cast<size_t>(m_Cutoff * static_cast<float>(config.samplesPerBin)) + 2;
+        m_Table.resize(sampleCount);
+        for (size_t i = 0; i < sampleCount; i++)
+        {
+            m_Table[i] = Kernel(static_cast<float>(i) / static_cast<float>(config.samplesPerBin));
+        }
+    }
+
+    float OneBlobEncoder::Kernel(float distance)
+    {
+        const float term = distance / SIGMA;
+        return KERNEL_PEAK * std::exp(-0.5f * term * term);
+    }
+
+    float OneBlobEncoder::LookupKernel(float distance) const
+    {
+        if (m_Table.empty())
+            return Kernel(distance);
+
+        const float absDistance = std::abs(distance);
+        if (absDistance >= m_Cutoff)
+            return 0.0f;
+
+        const float x = absDistance * static_cast<float>(m_Config.samplesPerBin);
+        const size_t i = static_cast<size_t>(x);
+        const float t = x - static_cast<float>(i);
+        return (m_Table[i] * (1.0f - t)) + (m_Table[i + 1] * t);
+    }
+
+    void OneBlobEncoder::Encode(std::span<const glm::vec3> dirs, std::span<float> features) const
+    {
+        if (m_Table.empty())
+        {
+            EncodeAnalytic(dirs, features);
+            return;
+        }
+
+        const size_t count = dirs.size();
+        if (features.size() < GetOutputWidth() * count)
+            Log::Error("OneBlobEncoder::Encode got a feature buffer that is too small for the batch", true);
+
+        // Most bins are outside the cutoff, clear everything once and only write the bins near each angle
+        std::fill_n(features.begin(), GetOutputWidth() * count, 0.0f);
+
+        for (size_t ray = 0; ray < count; ray++)
+        {
+            float angles[2];
+            GetBinPositions(dirs[ray], angles[0], angles[1]);
+
+            for (size_t angle = 0; angle < 2; angle++)
+            {
+                const float t = angles[angle];
+                const int firstBin = std::max(0, static_cast<int>(std::ceil(t - m_Cutoff)));
+                const int lastBin = std::min(static_cast<int>(m_BinCount) - 1, static_cast<int>(std::floor(t + m_Cutoff)));
+                for (int bin = firstBin; bin <= lastBin; bin++)
+                {
+                    features[(((angle * m_BinCount) + bin) * count) + ray] = LookupKernel(static_cast<float>(bin) - t);
+                }
+            }
+        }
+    }
+
+    void OneBlobEncoder::EncodeAnalytic(std::span<const glm::vec3> dirs, std::span<float> features) const
+    {
+        const size_t count = dirs.size();
+        if (features.size() < GetOutputWidth() * count)
+            Log::Error("OneBlobEncoder::EncodeAnalytic got a feature buffer that is too small for the batch", true);
+
+        for (size_t ray = 0; ray < count; ray++)
+        {
+            float theta;
+            float phi;
+            GetBinPositions(dirs[ray], theta, phi);
+
+            for (size_t bin = 0; bin < m_BinCount; bin++)
+            {
+                features[(bin * count) + ray] = Kernel(static_cast<float>(bin) - theta);
+                features[((bin + m_BinCount) * count) + ray] = Kernel(static_cast<float>(bin) - phi);
+            }
+        }
+    }
+
+    float OneBlobEncoder::MeasureMaxError() const
+    {
+        if (m_Table.empty())
+            return 0.0f;
+
+        // 16 points per table interval, past the cutoff to include the truncation
+        const size_t pointCount = (m_Table.size() + 1) * 16;
+        const float step = 1.0f / static_cast<float>(m_Config.samplesPerBin * 16);
+        float maxError = 0.0f;
+        for (size_t i = 0; i < pointCount; i++)
+        {
+            const float distance = static_cast<float>(i) * step;
+            maxError = std::max(maxError, std::abs(LookupKernel(distance) - Kernel(distance)));
+        }
+
+        return maxError;
+    }
+
+    std::vector<uint8_t> OneBlobEncoder::GetGpuData() const
+    {
+        const GpuHeader header = {
+                .sampleCount = static_cast<uint32_t>(m_Table.size()),
+                .samplesPerBin = static_cast<float>(m_Config.samplesPerBin),
+                .cutoff = m_Cutoff,
+                .padding = 0 };
+
+        std::vector<uint8_t> data(sizeof(GpuHeader) + (m_Table.size() * sizeof(float)));
+        std::memcpy(data.data(), &header, sizeof(GpuHeader));
+        std::memcpy(data.data() + sizeof(GpuHeader), m_Table.data(), m_Table.size() * sizeof(float));
+        return data;
+    }
+
+    void OneBlobEncoder::GetBinPositions(const glm::vec3& dir, float& theta, float& phi) const
+    {
+        // Same as the shaders, both angles in [0, 1] and bin i centered at (i + 0.5) / binCount
+        const float binCount = static_cast<float>(m_BinCount);
+        theta = ((((std::atan2(dir.z, dir.x) / PI) * 0.5f) + 0.5f) * binCount) - 0.5f;
+        phi = ((std::atan2(std::sqrt((dir.x * dir.x) + (dir.z * dir.z)), dir.y) / PI) * binCount) - 0.5f;
+    }
+}
@@ -65,7 +65,8 @@ namespace en
                     sizeof(UniformData),
                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                    {})
+                    {}),
+            m_PosVersion(0)
     {
         VkDevice device = VulkanAPI::GetDevice();
 
@@ -128,6 +129,11 @@ namespace en
             m_UniformData.strength = 0.0f;
         }
 
+        if (oldPos != m_UniformData.pos)
+        {
+            m_PosVersion++;
+        }
+
         if (oldPos != m_UniformData.pos ||
             oldColor != m_UniformData.color ||
             oldStrength != m_UniformData.strength)
@@ -140,4 +146,19 @@ namespace en
     {
         return m_DescSet;
     }
+
+    const glm::vec3& PointLight::GetPos() const
+    {
+        return m_UniformData.pos;
+    }
+
+    float PointLight::GetStrength() const
+    {
+        return m_UniformData.strength;
+    }
+
+    size_t PointLight::GetPosVersion() const
+    {
+        return m_PosVersion;
+    }
 }
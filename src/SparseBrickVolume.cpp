@@ -0,0 +1,183 @@
+#include <engine/cpu/SparseBrickVolume.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace en::cpu
+{
+    SparseBrickVolume::SparseBrickVolume(const VolumeView& density, uint32_t brickSize) :
+            m_StoredBrickCount(0)
+    {
+        if (brickSize == 0)
+            Log::Error("SparseBrickVolume brick size has to be at least one", true);
+
+        if (density.GetVoxelCount() == 0)
+            Log::Error("SparseBrickVolume density is empty", true);
+
+        const int voxelCountX = static_cast<int>(density.sizeX);
+        const int voxelCountY = static_cast<int>(density.sizeY);
+        const int voxelCountZ = static_cast<int>(density.sizeZ);
+        const uint32_t apronSize = brickSize + 2;
+
+        m_Header = {
+                .voxelCountX = static_cast<uint32_t>(voxelCountX),
+                .voxelCountY = static_cast<uint32_t>(voxelCountY),
+                .voxelCountZ = static_cast<uint32_t>(voxelCountZ),
+                .brickSize = brickSize,
+                .brickCountX = (static_cast<uint32_t>(voxelCountX) + brickSize - 1) / brickSize,
+                .brickCountY = (static_cast<uint32_t>(voxelCountY) + brickSize - 1) / brickSize,
+                .brickCountZ = (static_cast<uint32_t>(voxelCountZ) + brickSize - 1) / brickSize,
+                .padding = 0,
+                .atlasBrickCountX = 1,
+                .atlasBrickCountY = 1,
+                .atlasBrickCountZ = 1,
+                .atlasBrickSize = apronSize };
+        m_PageTable.resize(static_cast<size_t>(m_Header.brickCountX) * m_Header.brickCountY * m_Header.brickCountZ, EMPTY_PAGE);
+
+        // Voxels of a brick and its apron, the ones outside the volume are the zero border of the sampler
+        const size_t apronVoxelCount = static_cast<size_t>(apronSize) * apronSize * apronSize;
+        std::vector<uint8_t> brick(apronVoxelCount);
+        const int size = static_cast<int>(brickSize);
+        for (uint32_t brickZ = 0; brickZ < m_Header.brickCountZ; brickZ++)
+        {
+            for (uint32_t brickY = 0; brickY < m_Header.brickCountY; brickY++)
+            {
+                for (uint32_t brickX = 0; brickX < m_Header.brickCountX; brickX++)
+                {
+                    const int beginX = (static_cast<int>(brickX) * size) - 1;
+                    const int beginY = (static_cast<int>(brickY) * size) - 1;
+                    const int beginZ = (static_cast<int>(brickZ) * size) - 1;
+
+                    // Voxels outside the volume stay 0, the rest is walked in the z fastest order of the density files
+                    std::fill(brick.begin(), brick.end(), static_cast<uint8_t>(0));
+                    bool empty = true;
+                    for (int x = std::max(beginX, 0); x < std::min(beginX + size + 2, voxelCountX); x++)
+                    {
+                        for (int y = std::max(beginY, 0); y < std::min(beginY + size + 2, voxelCountY); y++)
+                        {
+                            for (int z = std::max(beginZ, 0); z < std::min(beginZ + size + 2, voxelCountZ); z++)
+                            {
+                                const uint8_t value = static_cast<uint8_t>(density.Get(x, y, z) * 255.0f);
+                                brick[(x - beginX) + (apronSize * ((y - beginY) + (apronSize * (z - beginZ))))] = value;
+                                empty &= value == 0;
+                            }
+                        }
+                    }
+
+                    if (empty)
+                        continue;
+
+                    m_PageTable[brickX + (m_Header.brickCountX * (brickY + (static_cast<size_t>(m_Header.brickCountY) * brickZ)))] =
+                            static_cast<uint32_t>(m_StoredBrickCount++);
+                    m_Bricks.insert(m_Bricks.end(), brick.begin(), brick.end());
+                }
+            }
+        }
+
+        // Roughly cubic atlas with room for all stored bricks
+        const size_t storedCount = std::max<size_t>(m_StoredBrickCount, 1);
+        while (static_cast<size_t>(m_Header.atlasBrickCountX) * m_Header.atlasBrickCountX * m_Header.atlasBrickCountX < storedCount)
+        {
+            m_Header.atlasBrickCountX++;
+        }
+        while (static_cast<size_t>(m_Header.atlasBrickCountX) * m_Header.atlasBrickCountY * m_Header.atlasBrickCountY < storedCount)
+        {
+            m_Header.atlasBrickCountY++;
+        }
+        const size_t sliceCount = static_cast<size_t>(m_Header.atlasBrickCountX) * m_Header.atlasBrickCountY;
+        m_Header.atlasBrickCountZ = static_cast<uint32_t>((storedCount + sliceCount - 1) / sliceCount);
+    }
+
+    float SparseBrickVolume::Sample(const glm::vec3& uvw) const
+    {
+        // Voxel space, all 8 texels of the filter are in the border outside of it
+        const float px = uvw.x * static_cast<float>(m_Header.voxelCountX);
+        const float py = uvw.y * static_cast<float>(m_Header.voxelCountY);
+        const float pz = uvw.z * static_cast<float>(m_Header.voxelCountZ);
+        if (px < -0.5f || py < -0.5f || pz < -0.5f
+            || px >= static_cast<float>(m_Header.voxelCountX) + 0.5f
+            || py >= static_cast<float>(m_Header.voxelCountY) + 0.5f
+            || pz >= static_cast<float>(m_Header.voxelCountZ) + 0.5f)
+        {
+            return 0.0f;
+        }
+
+        // The half voxel around the volume belongs to the outermost bricks, their apron holds the border
+        const float size = static_cast<float>(m_Header.brickSize);
+        const uint32_t brickX = static_cast<uint32_t>(std::clamp(std::floor(px / size), 0.0f, static_cast<float>(m_Header.brickCountX - 1)));
+        const uint32_t brickY = static_cast<uint32_t>(std::clamp(std::floor(py / size), 0.0f, static_cast<float>(m_Header.brickCountY - 1)));
+        const uint32_t brickZ = static_cast<uint32_t>(std::clamp(std::floor(pz / size), 0.0f, static_cast<float>(m_Header.brickCountZ - 1)));
+        const uint32_t page = m_PageTable[brickX + (m_Header.brickCountX * (brickY + (static_cast<size_t>(m_Header.brickCountY) * brickZ)))];
+        if (page == EMPTY_PAGE)
+            return 0.0f;
+
+        // Texel space of the brick with its apron, texel centers at integers
+        const float tx = px - (static_cast<float>(brickX) * size) + 0.5f;
+        const float ty = py - (static_cast<float>(brickY) * size) + 0.5f;
+        const float tz = pz - (static_cast<float>(brickZ) * size) + 0.5f;
+        const float fx = std::floor(tx);
+        const float fy = std::floor(ty);
+        const float fz = std::floor(tz);
+
+        const size_t strideY = m_Header.atlasBrickSize;
+        const size_t strideZ = strideY * m_Header.atlasBrickSize;
+        const uint8_t* base = &m_Bricks[
+                (page * strideZ * m_Header.atlasBrickSize)
+                + static_cast<size_t>(fx)
+                + (static_cast<size_t>(fy) * strideY)
+                + (static_cast<size_t>(fz) * strideZ)];
+
+        const float lx = tx - fx;
+        const float ly = ty - fy;
+        const float lz = tz - fz;
+        const float y0z0 = static_cast<float>(base[0]) + ((static_cast<float>(base[1]) - static_cast<float>(base[0])) * lx);
+        const float y1z0 = static_cast<float>(base[strideY]) + ((static_cast<float>(base[strideY + 1]) - static_cast<float>(base[strideY])) * lx);
+        const float y0z1 = static_cast<float>(base[strideZ]) + ((static_cast<float>(base[strideZ + 1]) - static_cast<float>(base[strideZ])) * lx);
+        const float y1z1 = static_cast<float>(base[strideZ + strideY])
+                           + ((static_cast<float>(base[strideZ + strideY + 1]) - static_cast<float>(base[strideZ + strideY])) * lx);
+        const float z0 = y0z0 + ((y1z0 - y0z0) * ly);
+        const float z1 = y0z1 + ((y1z1 - y0z1) * ly);
+        return (z0 + ((z1 - z0) * lz)) / 255.0f;
+    }
+
+    std::vector<uint8_t> SparseBrickVolume::GetGpuData() const
+    {
+        std::vector<uint8_t> data(GetGpuSize());
+        std::memcpy(data.data(), &m_Header, sizeof(GpuHeader));
+        std::memcpy(data.data() + sizeof(GpuHeader), m_PageTable.data(), m_PageTable.size() * sizeof(uint32_t));
+        return data;
+    }
+
+    std::vector<float> SparseBrickVolume::GetAtlas() const
+    {
+        const size_t atlasSizeX = GetAtlasSizeX();
+        const size_t atlasSizeY = GetAtlasSizeY();
+        std::vector<float> atlas(atlasSizeX * atlasSizeY * GetAtlasSizeZ(), 0.0f);
+
+        // Page p goes to slot p of the atlas bricks, x fastest like in the shaders
+        const uint32_t apronSize = m_Header.atlasBrickSize;
+        const size_t apronVoxelCount = static_cast<size_t>(apronSize) * apronSize * apronSize;
+        for (size_t page = 0; page < m_StoredBrickCount; page++)
+        {
+            const size_t beginX = (page % m_Header.atlasBrickCountX) * apronSize;
+            const size_t beginY = ((page / m_Header.atlasBrickCountX) % m_Header.atlasBrickCountY) * apronSize;
+            const size_t beginZ = (page / (static_cast<size_t>(m_Header.atlasBrickCountX) * m_Header.atlasBrickCountY)) * apronSize;
+            const uint8_t* brick = &m_Bricks[page * apronVoxelCount];
+            for (uint32_t z = 0; z < apronSize; z++)
+            {
+                for (uint32_t y = 0; y < apronSize; y++)
+                {
+                    float* row = &atlas[beginX + (atlasSizeX * ((beginY + y) + (atlasSizeY * (beginZ + z))))];
+                    for (uint32_t x = 0; x < apronSize; x++)
+                    {
+                        // Texture3D quantizes k / 255 back to k
+                        row[x] = static_cast<float>(brick[x + (apronSize * (y + (apronSize * z)))]) / 255.0f;
+                    }
+                }
+            }
+        }
+
+        return atlas;
+    }
+}
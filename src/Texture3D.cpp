@@ -3,6 +3,8 @@
 #include <engine/graphics/VulkanAPI.hpp>
 #include <engine/graphics/vulkan/CommandPool.hpp>
 #include <engine/graphics/vulkan/Buffer.hpp>
+#include <engine/cpu/VolumeTexels.hpp>
+#include <engine/util/Log.hpp>
 #include <array>
 
 namespace en::vk
@@ -17,6 +19,8 @@ namespace en::vk
             m_Height(data[0].size()),
             m_Depth(data[0][0].size()),
             m_RealChannelCount(4),
+            m_Format(VK_FORMAT_R8G8B8A8_UNORM),
+            m_TexelSize(4),
             m_ImageLayout(VK_IMAGE_LAYOUT_PREINITIALIZED)
     {
         // TODO: check for homogenous size
@@ -52,6 +56,8 @@ namespace en::vk
             m_Height(data[0][0].size()),
             m_Depth(data[0][0][0].size()),
             m_RealChannelCount(4),
+            m_Format(VK_FORMAT_R8G8B8A8_UNORM),
+            m_TexelSize(4),
             m_ImageLayout(VK_IMAGE_LAYOUT_PREINITIALIZED)
     {
         // TODO: check for homogenous size
@@ -77,6 +83,69 @@ namespace en::vk
         LoadToDevice(dataArray.data(), filter, addressMode, borderColor);
     }
 
+    Texture3D::Texture3D(
+            const VolumeView& volume,
+            VkFormat format,
+            ThreadPool& threadPool,
+            VkFilter filter,
+            VkSamplerAddressMode addressMode,
+            VkBorderColor borderColor)
+            :
+            m_Width(volume.sizeX),
+            m_Height(volume.sizeY),
+            m_Depth(volume.sizeZ),
+            m_RealChannelCount(1),
+            m_Format(format),
+            m_TexelSize(0),
+            m_ImageLayout(VK_IMAGE_LAYOUT_PREINITIALIZED)
+    {
+        // Linear filtering of R32_SFLOAT is optional, R8_UNORM and R16_SFLOAT always support it
+        VkFormatFeatureFlags featureFlags = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+        if (filter == VK_FILTER_LINEAR)
+            featureFlags |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+        if (m_Format == VK_FORMAT_R32_SFLOAT && !VulkanAPI::IsFormatSupported(m_Format, VK_IMAGE_TILING_OPTIMAL, featureFlags))
+        {
+            Log::Warn("Texture3D R32_SFLOAT can not be filtered linearly on this device, falling back to R16_SFLOAT");
+            m_Format = VK_FORMAT_R16_SFLOAT;
+        }
+
+        if (!VulkanAPI::IsFormatSupported(m_Format, VK_IMAGE_TILING_OPTIMAL, featureFlags))
+            Log::Error("Texture3D format is not supported for sampling with the requested filter", true);
+
+        cpu::TexelFormat texelFormat = cpu::TexelFormat::R8Unorm;
+        switch (m_Format)
+        {
+            case VK_FORMAT_R8_UNORM:
+                texelFormat = cpu::TexelFormat::R8Unorm;
+                break;
+            case VK_FORMAT_R16_SFLOAT:
+                texelFormat = cpu::TexelFormat::R16Sfloat;
+                break;
+            case VK_FORMAT_R32_SFLOAT:
+                texelFormat = cpu::TexelFormat::R32Sfloat;
+                break;
+            default:
+                Log::Error("Texture3D format has to be R8_UNORM, R16_SFLOAT or R32_SFLOAT", true);
+                break;
+        }
+        m_TexelSize = cpu::GetTexelSize(texelFormat);
+
+        // The texels are written straight into the mapped staging buffer
+        Buffer stagingBuffer(
+                GetRealSizeInBytes(),
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                {});
+
+        void* stagingMemory;
+        stagingBuffer.MapMemory(0, &stagingMemory);
+        cpu::WriteTexels(threadPool, volume, texelFormat, stagingMemory);
+        stagingBuffer.UnmapMemory();
+
+        LoadToDevice(stagingBuffer, filter, addressMode, borderColor);
+    }
+
     void Texture3D::Destroy()
     {
         VkDevice device = VulkanAPI::GetDevice();
@@ -109,7 +178,7 @@ namespace en::vk
 
     size_t Texture3D::GetRealSizeInBytes() const
     {
-        return m_Width * m_Height * m_Depth * m_RealChannelCount;
+        return static_cast<size_t>(m_Width) * m_Height * m_Depth * m_TexelSize;
     }
 
     VkImageView Texture3D::GetImageView() const
@@ -123,9 +192,22 @@ namespace en::vk
     }
 
     void Texture3D::LoadToDevice(void* data, VkFilter filter, VkSamplerAddressMode addressMode, VkBorderColor borderColor)
+    {
+        // Staging Buffer
+        Buffer stagingBuffer(
+                GetRealSizeInBytes(),
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                {});
+
+        stagingBuffer.SetData(static_cast<VkDeviceSize>(GetRealSizeInBytes()), data, 0, 0);
+
+        LoadToDevice(stagingBuffer, filter, addressMode, borderColor);
+    }
+
+    void Texture3D::LoadToDevice(Buffer& stagingBuffer, VkFilter filter, VkSamplerAddressMode addressMode, VkBorderColor borderColor)
     {
         VkDevice device = VulkanAPI::GetDevice();
-        VkDeviceSize size = static_cast<VkDeviceSize>(GetRealSizeInBytes());
         VkQueue queue = VulkanAPI::GetGraphicsQueue(); // TODO: GetTransferQueue
         VkResult result;
 
@@ -134,24 +216,13 @@ namespace en::vk
         commandPool.AllocateBuffers(1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
         VkCommandBuffer commandBuffer = commandPool.GetBuffer(0);
 
-        // Staging Buffer
-        Buffer stagingBuffer(
-                GetRealSizeInBytes(),
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                {});
-
-        stagingBuffer.SetData(size, data, 0, 0);
-
         // Create Image
-        VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
-
         VkImageCreateInfo imageCreateInfo;
         imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageCreateInfo.pNext = nullptr;
         imageCreateInfo.flags = 0;
         imageCreateInfo.imageType = VK_IMAGE_TYPE_3D;
-        imageCreateInfo.format = format;
+        imageCreateInfo.format = m_Format;
         imageCreateInfo.extent = { m_Width, m_Height, m_Depth };
         imageCreateInfo.mipLevels = 1;
         imageCreateInfo.arrayLayers = 1;
@@ -204,7 +275,7 @@ namespace en::vk
         imageViewCreateInfo.flags = 0;
         imageViewCreateInfo.image = m_Image;
         imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
-        imageViewCreateInfo.format = format;
+        imageViewCreateInfo.format = m_Format;
         imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -0,0 +1,204 @@
+#include <engine/util/ThreadPool.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+
+namespace en
+{
+    ThreadPool::ThreadPool(size_t threadCount) :
+            m_Stop(false),
+            m_Generation(0),
+            m_ActiveWorkers(0),
+            m_Func(nullptr),
+            m_Count(0),
+            m_Next(0),
+            m_Stealing(false),
+            m_StealRanges(std::max<size_t>(threadCount, 1))
+    {
+        if (threadCount == 0)
+            threadCount = 1;
+
+        for (size_t i = 1; i < threadCount; i++)
+        {
+            m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_StartCv.notify_all();
+
+        for (std::thread& worker : m_Workers)
+        {
+            worker.join();
+        }
+    }
+
+    size_t ThreadPool::GetThreadCount() const
+    {
+        return m_Workers.size() + 1;
+    }
+
+    void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t, size_t)>& func)
+    {
+        Run(func, count, false);
+    }
+
+    void ThreadPool::ParallelForStealing(size_t count, const std::function<void(size_t, size_t)>& func)
+    {
+        if (count > UINT32_MAX)
+            Log::Error("ThreadPool::ParallelForStealing count does not fit into 32 bits", true);
+
+        Run(func, count, true);
+    }
+
+    void ThreadPool::Run(const std::function<void(size_t, size_t)>& func, size_t count, bool stealing)
+    {
+        if (count == 0)
+            return;
+
+        // Nothing to distribute
+        if (m_Workers.empty() || count == 1)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                func(i, 0);
+            }
+            return;
+        }
+
+        // Wake workers
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Func = &func;
+            m_Count = count;
+            m_Next.store(0);
+            m_Stealing = stealing;
+            m_ActiveWorkers = m_Workers.size();
+            m_Generation++;
+
+            // Contiguous share per thread
+            if (stealing)
+            {
+                const uint64_t threadCount = GetThreadCount();
+                for (uint64_t thread = 0; thread < threadCount; thread++)
+                {
+                    const uint64_t begin = (count * thread) / threadCount;
+                    const uint64_t end = (count * (thread + 1)) / threadCount;
+                    m_StealRanges[thread].bounds.store((end << 32) | begin);
+                }
+            }
+        }
+        m_StartCv.notify_all();
+
+        if (stealing)
+            RunStealing(0);
+        else
+            RunItems(0);
+
+        // Wait for workers
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_DoneCv.wait(lock, [this]() { return m_ActiveWorkers == 0; });
+        m_Func = nullptr;
+    }
+
+    void ThreadPool::WorkerLoop(size_t threadIndex)
+    {
+        size_t generation = 0;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_StartCv.wait(lock, [&]() { return m_Stop || m_Generation != generation; });
+                if (m_Stop)
+                    return;
+                generation = m_Generation;
+            }
+
+            if (m_Stealing)
+                RunStealing(threadIndex);
+            else
+                RunItems(threadIndex);
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_ActiveWorkers--;
+                if (m_ActiveWorkers == 0)
+                    m_DoneCv.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::RunItems(size_t threadIndex)
+    {
+        size_t index;
+        while ((index = m_Next.fetch_add(1)) < m_Count)
+        {
+            (*m_Func)(index, threadIndex);
+        }
+    }
+
+    void ThreadPool::RunStealing(size_t threadIndex)
+    {
+        StealRange& ownRange = m_StealRanges[threadIndex];
+        size_t index;
+        do
+        {
+            while (PopIndex(ownRange, index))
+            {
+                (*m_Func)(index, threadIndex);
+            }
+        } while (StealHalf(threadIndex));
+    }
+
+    bool ThreadPool::PopIndex(StealRange& range, size_t& index)
+    {
+        uint64_t bounds = range.bounds.load();
+        while (true)
+        {
+            const uint64_t begin = bounds & UINT32_MAX;
+            const uint64_t end = bounds >> 32;
+            if (begin >= end)
+                return false;
+
+            // begin + 1 <= end, so the increment never carries into end
+            if (range.bounds.compare_exchange_weak(bounds, bounds + 1))
+            {
+                index = begin;
+                return true;
+            }
+        }
+    }
+
+    bool ThreadPool::StealHalf(size_t threadIndex)
+    {
+        const size_t threadCount = GetThreadCount();
+        for (size_t offset = 1; offset < threadCount; offset++)
+        {
+            StealRange& victim = m_StealRanges[(threadIndex + offset) % threadCount];
+            uint64_t bounds = victim.bounds.load();
+            while (true)
+            {
+                const uint64_t begin = bounds & UINT32_MAX;
+                const uint64_t end = bounds >> 32;
+                if (begin >= end)
+                    break;
+
+                // Take the back half, the victim keeps working on the indices next to its last one
+                const uint64_t split = end - ((end - begin + 1) / 2);
+                if (victim.bounds.compare_exchange_weak(bounds, (split << 32) | begin))
+                {
+                    // Nobody else writes an empty range, so a plain store is enough
+                    m_StealRanges[threadIndex].bounds.store((end << 32) | split);
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+}
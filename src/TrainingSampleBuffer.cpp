@@ -0,0 +1,325 @@
+#include <engine/graphics/TrainingSampleBuffer.hpp>
+#include <engine/graphics/VulkanAPI.hpp>
+#include <vector>
+#include <imgui.h>
+
+namespace en
+{
+    VkDescriptorSetLayout TrainingSampleBuffer::m_DescSetLayout;
+    VkDescriptorPool TrainingSampleBuffer::m_DescPool;
+
+    void TrainingSampleBuffer::Init(VkDevice device)
+    {
+        // Create desc set layout
+        VkDescriptorSetLayoutBinding uniformBinding;
+        uniformBinding.binding = 0;
+        uniformBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uniformBinding.descriptorCount = 1;
+        uniformBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        uniformBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding statsBinding;
+        statsBinding.binding = 1;
+        statsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        statsBinding.descriptorCount = 1;
+        statsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        statsBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding recordsBinding;
+        recordsBinding.binding = 2;
+        recordsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        recordsBinding.descriptorCount = 1;
+        recordsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        recordsBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding batchBinding;
+        batchBinding.binding = 3;
+        batchBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        batchBinding.descriptorCount = 1;
+        batchBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        batchBinding.pImmutableSamplers = nullptr;
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings = { uniformBinding, statsBinding, recordsBinding, batchBinding };
+
+        VkDescriptorSetLayoutCreateInfo layoutCI;
+        layoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutCI.pNext = nullptr;
+        layoutCI.flags = 0;
+        layoutCI.bindingCount = bindings.size();
+        layoutCI.pBindings = bindings.data();
+
+        VkResult result = vkCreateDescriptorSetLayout(device, &layoutCI, nullptr, &m_DescSetLayout);
+        ASSERT_VULKAN(result);
+
+        // Create desc pool
+        VkDescriptorPoolSize uniformPoolSize;
+        uniformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uniformPoolSize.descriptorCount = 1;
+
+        VkDescriptorPoolSize storagePoolSize;
+        storagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        storagePoolSize.descriptorCount = 3;
+
+        std::vector<VkDescriptorPoolSize> poolSizes = { uniformPoolSize, storagePoolSize };
+
+        VkDescriptorPoolCreateInfo poolCI;
+        poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolCI.pNext = nullptr;
+        poolCI.flags = 0;
+        poolCI.maxSets = 1;
+        poolCI.poolSizeCount = poolSizes.size();
+        poolCI.pPoolSizes = poolSizes.data();
+
+        result = vkCreateDescriptorPool(device, &poolCI, nullptr, &m_DescPool);
+        ASSERT_VULKAN(result);
+    }
+
+    void TrainingSampleBuffer::Shutdown(VkDevice device)
+    {
+        vkDestroyDescriptorPool(device, m_DescPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, m_DescSetLayout, nullptr);
+    }
+
+    VkDescriptorSetLayout TrainingSampleBuffer::GetDescriptorSetLayout()
+    {
+        return m_DescSetLayout;
+    }
+
+    TrainingSampleBuffer::TrainingSampleBuffer(uint32_t capacity, uint32_t batchSize, float replayRatio, uint32_t maxAge) :
+            m_UniformData({
+                                  .capacity = capacity,
+                                  .replayRatio = replayRatio,
+                                  .maxAge = maxAge,
+                                  .selfTrainLength = 0,
+                                  .bootstrapMix = 0.0f,
+                                  .frameCursor = 0,
+                                  .batchSize = batchSize,
+                                  .padding0 = 0 }),
+            m_UniformBuffer(
+                    sizeof(UniformData),
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                    {}),
+            m_StatsData({
+                                .writeCursor = 0,
+                                .newCount = 0,
+                                .replayCount = 0,
+                                .replayAgeSum = 0,
+                                .traceStepSum = 0,
+                                .cacheLookupCount = 0 }),
+            m_StatsBuffer(
+                    sizeof(StatsData),
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    {}),
+            m_RecordBuffer(
+                    capacity * sizeof(Record),
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    {}),
+            m_BatchSize(batchSize),
+            m_BatchBuffer(
+                    batchSize * sizeof(Record),
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    {})
+    {
+        if (capacity == 0 || batchSize == 0)
+            Log::Error("TrainingSampleBuffer needs a capacity and batch size of at least one record", true);
+
+        if (replayRatio < 0.0f || replayRatio >= 1.0f)
+            Log::Error("TrainingSampleBuffer replay ratio has to be in [0, 1)", true);
+
+        m_UniformBuffer.SetData(sizeof(UniformData), &m_UniformData, 0, 0);
+        m_StatsBuffer.SetData(sizeof(StatsData), &m_StatsData, 0, 0);
+
+        // All records start invalid, so the first frames trace everything
+        const Record invalidRecord = {
+                .pos = glm::vec3(0.0f),
+                .frameIndex = INVALID_FRAME,
+                .dir = glm::vec3(0.0f),
+                .padding0 = 0,
+                .target = glm::vec3(0.0f),
+                .padding1 = 0 };
+        std::vector<Record> records(capacity, invalidRecord);
+
+        vk::Buffer stagingBuffer(
+                capacity * sizeof(Record),
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                {});
+        stagingBuffer.SetData(capacity * sizeof(Record), records.data(), 0, 0);
+        vk::Buffer::Copy(&stagingBuffer, &m_RecordBuffer, capacity * sizeof(Record));
+        stagingBuffer.Destroy();
+
+        // Allocate desc set
+        VkDescriptorSetAllocateInfo descSetAI;
+        descSetAI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descSetAI.pNext = nullptr;
+        descSetAI.descriptorPool = m_DescPool;
+        descSetAI.descriptorSetCount = 1;
+        descSetAI.pSetLayouts = &m_DescSetLayout;
+
+        VkResult result = vkAllocateDescriptorSets(VulkanAPI::GetDevice(), &descSetAI, &m_DescSet);
+        ASSERT_VULKAN(result);
+
+        // Write desc set
+        VkDescriptorBufferInfo uniformBufferInfo;
+        uniformBufferInfo.buffer = m_UniformBuffer.GetVulkanHandle();
+        uniformBufferInfo.offset = 0;
+        uniformBufferInfo.range = sizeof(UniformData);
+
+        VkWriteDescriptorSet uniformWrite;
+        uniformWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        uniformWrite.pNext = nullptr;
+        uniformWrite.dstSet = m_DescSet;
+        uniformWrite.dstBinding = 0;
+        uniformWrite.dstArrayElement = 0;
+        uniformWrite.descriptorCount = 1;
+        uniformWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uniformWrite.pImageInfo = nullptr;
+        uniformWrite.pBufferInfo = &uniformBufferInfo;
+        uniformWrite.pTexelBufferView = nullptr;
+
+        VkDescriptorBufferInfo statsBufferInfo;
+        statsBufferInfo.buffer = m_StatsBuffer.GetVulkanHandle();
+        statsBufferInfo.offset = 0;
+        statsBufferInfo.range = sizeof(StatsData);
+
+        VkWriteDescriptorSet statsWrite;
+        statsWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        statsWrite.pNext = nullptr;
+        statsWrite.dstSet = m_DescSet;
+        statsWrite.dstBinding = 1;
+        statsWrite.dstArrayElement = 0;
+        statsWrite.descriptorCount = 1;
+        statsWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        statsWrite.pImageInfo = nullptr;
+        statsWrite.pBufferInfo = &statsBufferInfo;
+        statsWrite.pTexelBufferView = nullptr;
+
+        VkDescriptorBufferInfo recordsBufferInfo;
+        recordsBufferInfo.buffer = m_RecordBuffer.GetVulkanHandle();
+        recordsBufferInfo.offset = 0;
+        recordsBufferInfo.range = capacity * sizeof(Record);
+
+        VkWriteDescriptorSet recordsWrite;
+        recordsWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        recordsWrite.pNext = nullptr;
+        recordsWrite.dstSet = m_DescSet;
+        recordsWrite.dstBinding = 2;
+        recordsWrite.dstArrayElement = 0;
+        recordsWrite.descriptorCount = 1;
+        recordsWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        recordsWrite.pImageInfo = nullptr;
+        recordsWrite.pBufferInfo = &recordsBufferInfo;
+        recordsWrite.pTexelBufferView = nullptr;
+
+        VkDescriptorBufferInfo batchBufferInfo;
+        batchBufferInfo.buffer = m_BatchBuffer.GetVulkanHandle();
+        batchBufferInfo.offset = 0;
+        batchBufferInfo.range = batchSize * sizeof(Record);
+
+        VkWriteDescriptorSet batchWrite;
+        batchWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        batchWrite.pNext = nullptr;
+        batchWrite.dstSet = m_DescSet;
+        batchWrite.dstBinding = 3;
+        batchWrite.dstArrayElement = 0;
+        batchWrite.descriptorCount = 1;
+        batchWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        batchWrite.pImageInfo = nullptr;
+        batchWrite.pBufferInfo = &batchBufferInfo;
+        batchWrite.pTexelBufferView = nullptr;
+
+        std::vector<VkWriteDescriptorSet> writes = { uniformWrite, statsWrite, recordsWrite, batchWrite };
+
+        vkUpdateDescriptorSets(VulkanAPI::GetDevice(), writes.size(), writes.data(), 0, nullptr);
+    }
+
+    void TrainingSampleBuffer::Destroy()
+    {
+        m_BatchBuffer.Destroy();
+        m_RecordBuffer.Destroy();
+        m_StatsBuffer.Destroy();
+        m_UniformBuffer.Destroy();
+    }
+
+    void TrainingSampleBuffer::SetReplayRatio(float replayRatio)
+    {
+        if (replayRatio < 0.0f || replayRatio >= 1.0f)
+            Log::Error("TrainingSampleBuffer replay ratio has to be in [0, 1)", true);
+
+        m_UniformData.replayRatio = replayRatio;
+        m_UniformBuffer.SetData(sizeof(UniformData), &m_UniformData, 0, 0);
+    }
+
+    void TrainingSampleBuffer::SetMaxAge(uint32_t maxAge)
+    {
+        m_UniformData.maxAge = maxAge;
+        m_UniformBuffer.SetData(sizeof(UniformData), &m_UniformData, 0, 0);
+    }
+
+    void TrainingSampleBuffer::SetSelfTraining(uint32_t selfTrainLength, float bootstrapMix)
+    {
+        if (bootstrapMix < 0.0f || bootstrapMix > 1.0f)
+            Log::Error("TrainingSampleBuffer bootstrap mix has to be in [0, 1]", true);
+
+        m_UniformData.selfTrainLength = selfTrainLength;
+        m_UniformData.bootstrapMix = bootstrapMix;
+        m_UniformBuffer.SetData(sizeof(UniformData), &m_UniformData, 0, 0);
+    }
+
+    void TrainingSampleBuffer::BeginFrame()
+    {
+        m_StatsBuffer.GetData(sizeof(StatsData), &m_StatsData, 0, 0);
+        m_UniformData.frameCursor = m_StatsData.writeCursor;
+        m_UniformBuffer.SetData(sizeof(UniformData), &m_UniformData, 0, 0);
+    }
+
+    void TrainingSampleBuffer::ResetStats()
+    {
+        m_StatsBuffer.GetData(sizeof(StatsData), &m_StatsData, 0, 0);
+        m_StatsData.newCount = 0;
+        m_StatsData.replayCount = 0;
+        m_StatsData.replayAgeSum = 0;
+        m_StatsData.traceStepSum = 0;
+        m_StatsData.cacheLookupCount = 0;
+        m_StatsBuffer.SetData(sizeof(StatsData), &m_StatsData, 0, 0);
+    }
+
+    const TrainingSampleBuffer::StatsData& TrainingSampleBuffer::GetStats()
+    {
+        m_StatsBuffer.GetData(sizeof(StatsData), &m_StatsData, 0, 0);
+        return m_StatsData;
+    }
+
+    void TrainingSampleBuffer::RenderImGui()
+    {
+        ImGui::Begin("Training Samples");
+
+        ImGui::SliderFloat("Replay Ratio", &m_UniformData.replayRatio, 0.0f, 0.95f);
+        int maxAge = static_cast<int>(m_UniformData.maxAge);
+        ImGui::SliderInt("Max Age", &maxAge, 1, 256);
+        m_UniformData.maxAge = static_cast<uint32_t>(maxAge);
+
+        int selfTrainLength = static_cast<int>(m_UniformData.selfTrainLength);
+        ImGui::SliderInt("Self-Train Length", &selfTrainLength, 0, 16);
+        m_UniformData.selfTrainLength = static_cast<uint32_t>(selfTrainLength);
+        ImGui::SliderFloat("Bootstrap Mix", &m_UniformData.bootstrapMix, 0.0f, 1.0f);
+
+        ImGui::End();
+
+        m_UniformBuffer.SetData(sizeof(UniformData), &m_UniformData, 0, 0);
+    }
+
+    VkDescriptorSet TrainingSampleBuffer::GetDescriptorSet() const
+    {
+        return m_DescSet;
+    }
+
+    uint32_t TrainingSampleBuffer::GetBatchSize() const
+    {
+        return m_BatchSize;
+    }
+}
@@ -0,0 +1,94 @@
+#include <engine/cpu/TrainingSampleRing.hpp>
+#include <engine/util/Rng.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace en::cpu
+{
+    TrainingSampleRing::TrainingSampleRing(size_t capacity, float replayRatio, uint32_t maxAge) :
+            m_Records(capacity),
+            m_Next(0),
+            m_Size(0),
+            m_ReplayRatio(0.0f),
+            m_MaxAge(maxAge),
+            m_Step(0),
+            m_LastReplayAge(0.0f)
+    {
+        if (capacity == 0)
+            Log::Error("TrainingSampleRing needs a capacity of at least one record", true);
+
+        SetReplayRatio(replayRatio);
+    }
+
+    size_t TrainingSampleRing::GetNewRecordCount(size_t batchSize) const
+    {
+        const uint32_t oldestStep = m_Step > m_MaxAge ? m_Step - m_MaxAge : 0;
+        const size_t replayable = FindFirst(m_Step) - FindFirst(oldestStep);
+        const size_t replayCount = static_cast<size_t>(std::round(static_cast<float>(batchSize) * m_ReplayRatio));
+        return batchSize - std::min(replayCount, replayable);
+    }
+
+    void TrainingSampleRing::Push(const glm::vec3& pos, const glm::vec3& dir, const glm::vec3& target)
+    {
+        m_Records[m_Next] = { .pos = pos, .dir = dir, .target = target, .step = m_Step };
+        m_Next = (m_Next + 1) % m_Records.size();
+        m_Size = std::min(m_Size + 1, m_Records.size());
+    }
+
+    void TrainingSampleRing::Replay(size_t count, std::vector<Record>& batch)
+    {
+        const uint32_t oldestStep = m_Step > m_MaxAge ? m_Step - m_MaxAge : 0;
+        const size_t begin = FindFirst(oldestStep);
+        const size_t end = FindFirst(m_Step);
+        if (count > 0 && begin == end)
+            Log::Error("TrainingSampleRing::Replay has no records to replay, use GetNewRecordCount", true);
+
+        // Same generator as the shaders, keyed by the step so a run replays the same records
+        Rng rng(0, 0, m_Step, 0);
+        uint64_t ageSum = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const Record& record = GetOrdered(begin + (rng.NextUint() % (end - begin)));
+            ageSum += m_Step - record.step;
+            batch.push_back(record);
+        }
+
+        m_LastReplayAge = count > 0 ? static_cast<float>(ageSum) / static_cast<float>(count) : 0.0f;
+    }
+
+    void TrainingSampleRing::AdvanceStep()
+    {
+        m_Step++;
+    }
+
+    void TrainingSampleRing::SetReplayRatio(float replayRatio)
+    {
+        if (replayRatio < 0.0f || replayRatio >= 1.0f)
+            Log::Error("TrainingSampleRing replay ratio has to be in [0, 1)", true);
+
+        m_ReplayRatio = replayRatio;
+    }
+
+    const TrainingSampleRing::Record& TrainingSampleRing::GetOrdered(size_t index) const
+    {
+        const size_t oldest = (m_Next + m_Records.size() - m_Size) % m_Records.size();
+        return m_Records[(oldest + index) % m_Records.size()];
+    }
+
+    size_t TrainingSampleRing::FindFirst(uint32_t step) const
+    {
+        size_t low = 0;
+        size_t high = m_Size;
+        while (low < high)
+        {
+            const size_t mid = low + ((high - low) / 2);
+            if (GetOrdered(mid).step < step)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        return low;
+    }
+}
@@ -0,0 +1,152 @@
+#include <engine/cpu/TrainingSchedule.hpp>
+#include <engine/util/Rng.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace en::cpu
+{
+    TrainingSchedule::TrainingSchedule(
+            uint32_t regionCountX,
+            uint32_t regionCountY,
+            uint32_t minSampleCount,
+            uint32_t maxSampleCount,
+            float timeBudget)
+            :
+            m_RegionCountX(regionCountX),
+            m_RegionCountY(regionCountY),
+            m_MinSampleCount(minSampleCount),
+            m_MaxSampleCount(maxSampleCount),
+            m_TimeBudget(timeBudget),
+            m_UniformRatio(0.5f),
+            m_Step(0),
+            m_SampleCount(maxSampleCount),
+            m_RegionLoss(regionCountX * regionCountY, 1.0f),
+            m_RegionOffsets((regionCountX * regionCountY) + 1, 0),
+            m_JitterX(0.5f),
+            m_JitterY(0.5f),
+            m_StratumRotation(0)
+    {
+        if (regionCountX == 0 || regionCountY == 0)
+            Log::Error("TrainingSchedule needs at least one region", true);
+
+        if (minSampleCount == 0 || minSampleCount > maxSampleCount)
+            Log::Error("TrainingSchedule sample count range is empty", true);
+
+        Plan();
+    }
+
+    void TrainingSchedule::UpdateLoss(std::span<const float> lossSums, std::span<const uint32_t> sampleCounts)
+    {
+        for (size_t region = 0; region < m_RegionLoss.size(); region++)
+        {
+            if (sampleCounts[region] == 0 || !std::isfinite(lossSums[region]))
+                continue;
+
+            const float loss = lossSums[region] / static_cast<float>(sampleCounts[region]);
+            m_RegionLoss[region] += (loss - m_RegionLoss[region]) * LOSS_SMOOTHING;
+        }
+    }
+
+    void TrainingSchedule::UpdateCost(float time)
+    {
+        if (time <= 0.0f)
+            return;
+
+        // Damped multiplicative control, converges to the budget even with a fixed cost per step
+        const float growth = std::clamp(std::sqrt(m_TimeBudget / time), MIN_SAMPLE_COUNT_GROWTH, MAX_SAMPLE_COUNT_GROWTH);
+        const float sampleCount = std::round(static_cast<float>(m_SampleCount) * growth);
+        m_SampleCount = std::clamp(static_cast<uint32_t>(sampleCount), m_MinSampleCount, m_MaxSampleCount);
+    }
+
+    void TrainingSchedule::Plan()
+    {
+        Rng rng(0, 0, m_Step, 0);
+
+        // Region weights, the uniform part keeps every region trained
+        double totalLoss = 0.0;
+        for (float loss : m_RegionLoss)
+        {
+            totalLoss += loss;
+        }
+
+        const size_t regionCount = m_RegionLoss.size();
+        const double uniformWeight = static_cast<double>(m_UniformRatio) / static_cast<double>(regionCount);
+        const double lossWeight = totalLoss > 0.0 ? (1.0 - static_cast<double>(m_UniformRatio)) / totalLoss : 0.0;
+        const double fallbackWeight = totalLoss > 0.0 ? 0.0 : (1.0 - static_cast<double>(m_UniformRatio)) / static_cast<double>(regionCount);
+
+        // Systematic sampling: one random offset for all regions, so the counts sum up to the sample count and
+        // every region gets its expected count rounded up or down
+        const double offset = rng.NextFloat();
+        const double sampleCount = m_SampleCount;
+        double cumulativeWeight = 0.0;
+        m_RegionOffsets[0] = 0;
+        for (size_t region = 0; region < regionCount; region++)
+        {
+            cumulativeWeight += uniformWeight + fallbackWeight + (static_cast<double>(m_RegionLoss[region]) * lossWeight);
+            const double end = std::floor((sampleCount * cumulativeWeight) + offset);
+            m_RegionOffsets[region + 1] = std::min(static_cast<uint32_t>(end), m_SampleCount);
+        }
+        m_RegionOffsets[regionCount] = m_SampleCount;
+
+        // Same jitter for all strata of a step, a Halton sequence over the steps
+        m_JitterX = RadicalInverse(m_Step + 1, 2);
+        m_JitterY = RadicalInverse(m_Step + 1, 3);
+        m_StratumRotation = rng.NextUint();
+
+        m_Step++;
+    }
+
+    void TrainingSchedule::GetSampleUV(uint32_t sampleIndex, float& u, float& v) const
+    {
+        const uint32_t region = GetSampleRegion(sampleIndex);
+        const uint32_t regionSampleIndex = sampleIndex - m_RegionOffsets[region];
+        const uint32_t regionSampleCount = m_RegionOffsets[region + 1] - m_RegionOffsets[region];
+
+        // Smallest square grid of strata that fits the samples of the region, rotated so all strata get used
+        uint32_t strataPerSide = static_cast<uint32_t>(std::sqrt(static_cast<float>(regionSampleCount)));
+        if (strataPerSide * strataPerSide < regionSampleCount)
+            strataPerSide++;
+        const uint32_t strataCount = strataPerSide * strataPerSide;
+        const uint32_t stratum = (regionSampleIndex + (m_StratumRotation % strataCount)) % strataCount;
+
+        const float strataU = (static_cast<float>(stratum % strataPerSide) + m_JitterX) / static_cast<float>(strataPerSide);
+        const float strataV = (static_cast<float>(stratum / strataPerSide) + m_JitterY) / static_cast<float>(strataPerSide);
+        u = (static_cast<float>(region % m_RegionCountX) + strataU) / static_cast<float>(m_RegionCountX);
+        v = (static_cast<float>(region / m_RegionCountX) + strataV) / static_cast<float>(m_RegionCountY);
+    }
+
+    uint32_t TrainingSchedule::GetSampleRegion(uint32_t sampleIndex) const
+    {
+        // Last region starting at or before the sample, empty regions are skipped
+        const auto it = std::upper_bound(m_RegionOffsets.begin(), m_RegionOffsets.end() - 1, sampleIndex);
+        return static_cast<uint32_t>(std::distance(m_RegionOffsets.begin(), it)) - 1;
+    }
+
+    void TrainingSchedule::SetTimeBudget(float timeBudget)
+    {
+        m_TimeBudget = timeBudget;
+    }
+
+    void TrainingSchedule::SetUniformRatio(float uniformRatio)
+    {
+        if (uniformRatio < 0.0f || uniformRatio > 1.0f)
+            Log::Error("TrainingSchedule uniform ratio has to be in [0, 1]", true);
+
+        m_UniformRatio = uniformRatio;
+    }
+
+    float TrainingSchedule::RadicalInverse(uint32_t index, uint32_t base)
+    {
+        const float invBase = 1.0f / static_cast<float>(base);
+        float scale = invBase;
+        float result = 0.0f;
+        while (index > 0)
+        {
+            result += static_cast<float>(index % base) * scale;
+            index /= base;
+            scale *= invBase;
+        }
+        return result;
+    }
+}
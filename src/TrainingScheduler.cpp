@@ -0,0 +1,224 @@
+#include <engine/graphics/TrainingScheduler.hpp>
+#include <engine/graphics/VulkanAPI.hpp>
+#include <imgui.h>
+
+namespace en
+{
+    VkDescriptorSetLayout TrainingScheduler::m_DescSetLayout;
+    VkDescriptorPool TrainingScheduler::m_DescPool;
+
+    void TrainingScheduler::Init(VkDevice device)
+    {
+        // Create desc set layout
+        VkDescriptorSetLayoutBinding scheduleBinding;
+        scheduleBinding.binding = 0;
+        scheduleBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        scheduleBinding.descriptorCount = 1;
+        scheduleBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        scheduleBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding regionStatsBinding;
+        regionStatsBinding.binding = 1;
+        regionStatsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        regionStatsBinding.descriptorCount = 1;
+        regionStatsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        regionStatsBinding.pImmutableSamplers = nullptr;
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings = { scheduleBinding, regionStatsBinding };
+
+        VkDescriptorSetLayoutCreateInfo layoutCI;
+        layoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutCI.pNext = nullptr;
+        layoutCI.flags = 0;
+        layoutCI.bindingCount = bindings.size();
+        layoutCI.pBindings = bindings.data();
+
+        VkResult result = vkCreateDescriptorSetLayout(device, &layoutCI, nullptr, &m_DescSetLayout);
+        ASSERT_VULKAN(result);
+
+        // Create desc pool
+        VkDescriptorPoolSize storagePoolSize;
+        storagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        storagePoolSize.descriptorCount = 2;
+
+        VkDescriptorPoolCreateInfo poolCI;
+        poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolCI.pNext = nullptr;
+        poolCI.flags = 0;
+        poolCI.maxSets = 1;
+        poolCI.poolSizeCount = 1;
+        poolCI.pPoolSizes = &storagePoolSize;
+
+        result = vkCreateDescriptorPool(device, &poolCI, nullptr, &m_DescPool);
+        ASSERT_VULKAN(result);
+    }
+
+    void TrainingScheduler::Shutdown(VkDevice device)
+    {
+        vkDestroyDescriptorPool(device, m_DescPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, m_DescSetLayout, nullptr);
+    }
+
+    VkDescriptorSetLayout TrainingScheduler::GetDescriptorSetLayout()
+    {
+        return m_DescSetLayout;
+    }
+
+    TrainingScheduler::TrainingScheduler(uint32_t groupSize, uint32_t minSampleCount, uint32_t maxSampleCount, float trainBudget) :
+            m_GroupSize(groupSize),
+            m_Schedule(REGION_COUNT_X, REGION_COUNT_Y, minSampleCount, maxSampleCount, trainBudget),
+            m_ScheduleBuffer(
+                    sizeof(ScheduleHeader) + ((REGION_COUNT + 1) * sizeof(uint32_t)),
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                    {}),
+            m_RegionStats(REGION_COUNT, { .lossSum = 0.0f, .sampleCount = 0 }),
+            m_RegionLossSums(REGION_COUNT),
+            m_RegionSampleCounts(REGION_COUNT),
+            m_RegionStatsBuffer(
+                    REGION_COUNT * sizeof(RegionStats),
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    {})
+    {
+        if (groupSize == 0)
+            Log::Error("TrainingScheduler group size has to be at least one", true);
+
+        m_RegionStatsBuffer.SetData(REGION_COUNT * sizeof(RegionStats), m_RegionStats.data(), 0, 0);
+        UploadSchedule();
+
+        // Allocate desc set
+        VkDescriptorSetAllocateInfo descSetAI;
+        descSetAI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descSetAI.pNext = nullptr;
+        descSetAI.descriptorPool = m_DescPool;
+        descSetAI.descriptorSetCount = 1;
+        descSetAI.pSetLayouts = &m_DescSetLayout;
+
+        VkResult result = vkAllocateDescriptorSets(VulkanAPI::GetDevice(), &descSetAI, &m_DescSet);
+        ASSERT_VULKAN(result);
+
+        // Write desc set
+        VkDescriptorBufferInfo scheduleBufferInfo;
+        scheduleBufferInfo.buffer = m_ScheduleBuffer.GetVulkanHandle();
+        scheduleBufferInfo.offset = 0;
+        scheduleBufferInfo.range = sizeof(ScheduleHeader) + ((REGION_COUNT + 1) * sizeof(uint32_t));
+
+        VkWriteDescriptorSet scheduleWrite;
+        scheduleWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        scheduleWrite.pNext = nullptr;
+        scheduleWrite.dstSet = m_DescSet;
+        scheduleWrite.dstBinding = 0;
+        scheduleWrite.dstArrayElement = 0;
+        scheduleWrite.descriptorCount = 1;
+        scheduleWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        scheduleWrite.pImageInfo = nullptr;
+        scheduleWrite.pBufferInfo = &scheduleBufferInfo;
+        scheduleWrite.pTexelBufferView = nullptr;
+
+        VkDescriptorBufferInfo regionStatsBufferInfo;
+        regionStatsBufferInfo.buffer = m_RegionStatsBuffer.GetVulkanHandle();
+        regionStatsBufferInfo.offset = 0;
+        regionStatsBufferInfo.range = REGION_COUNT * sizeof(RegionStats);
+
+        VkWriteDescriptorSet regionStatsWrite;
+        regionStatsWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        regionStatsWrite.pNext = nullptr;
+        regionStatsWrite.dstSet = m_DescSet;
+        regionStatsWrite.dstBinding = 1;
+        regionStatsWrite.dstArrayElement = 0;
+        regionStatsWrite.descriptorCount = 1;
+        regionStatsWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        regionStatsWrite.pImageInfo = nullptr;
+        regionStatsWrite.pBufferInfo = &regionStatsBufferInfo;
+        regionStatsWrite.pTexelBufferView = nullptr;
+
+        std::vector<VkWriteDescriptorSet> writes = { scheduleWrite, regionStatsWrite };
+
+        vkUpdateDescriptorSets(VulkanAPI::GetDevice(), writes.size(), writes.data(), 0, nullptr);
+    }
+
+    void TrainingScheduler::Destroy()
+    {
+        m_RegionStatsBuffer.Destroy();
+        m_ScheduleBuffer.Destroy();
+    }
+
+    void TrainingScheduler::Update(float trainTime)
+    {
+        // Region losses of the frame, then clear them for the next one
+        m_RegionStatsBuffer.GetData(REGION_COUNT * sizeof(RegionStats), m_RegionStats.data(), 0, 0);
+        for (uint32_t region = 0; region < REGION_COUNT; region++)
+        {
+            m_RegionLossSums[region] = m_RegionStats[region].lossSum;
+            m_RegionSampleCounts[region] = m_RegionStats[region].sampleCount;
+            m_RegionStats[region] = { .lossSum = 0.0f, .sampleCount = 0 };
+        }
+        m_RegionStatsBuffer.SetData(REGION_COUNT * sizeof(RegionStats), m_RegionStats.data(), 0, 0);
+
+        m_Schedule.UpdateLoss(m_RegionLossSums, m_RegionSampleCounts);
+        m_Schedule.UpdateCost(trainTime);
+        m_Schedule.Plan();
+        UploadSchedule();
+    }
+
+    void TrainingScheduler::RenderImGui()
+    {
+        ImGui::Begin("Training Scheduler");
+
+        float trainBudget = m_Schedule.GetTimeBudget();
+        ImGui::SliderFloat("Train Budget (ms)", &trainBudget, 0.5f, 50.0f);
+        m_Schedule.SetTimeBudget(trainBudget);
+
+        float uniformRatio = m_Schedule.GetUniformRatio();
+        ImGui::SliderFloat("Uniform Ratio", &uniformRatio, 0.0f, 1.0f);
+        m_Schedule.SetUniformRatio(uniformRatio);
+
+        ImGui::Text("Samples: %u / %u", m_Schedule.GetSampleCount(), m_Schedule.GetMaxSampleCount());
+
+        ImGui::End();
+    }
+
+    VkDescriptorSet TrainingScheduler::GetDescriptorSet() const
+    {
+        return m_DescSet;
+    }
+
+    VkBuffer TrainingScheduler::GetScheduleBuffer() const
+    {
+        return m_ScheduleBuffer.GetVulkanHandle();
+    }
+
+    uint32_t TrainingScheduler::GetGroupSize() const
+    {
+        return m_GroupSize;
+    }
+
+    uint32_t TrainingScheduler::GetMaxSampleCount() const
+    {
+        return m_Schedule.GetMaxSampleCount();
+    }
+
+    uint32_t TrainingScheduler::GetSampleCount() const
+    {
+        return m_Schedule.GetSampleCount();
+    }
+
+    void TrainingScheduler::UploadSchedule()
+    {
+        const uint32_t sampleCount = m_Schedule.GetSampleCount();
+        const ScheduleHeader header = {
+                .groupCountX = (sampleCount + m_GroupSize - 1) / m_GroupSize,
+                .groupCountY = 1,
+                .groupCountZ = 1,
+                .sampleCount = sampleCount,
+                .jitterX = m_Schedule.GetJitterX(),
+                .jitterY = m_Schedule.GetJitterY(),
+                .stratumRotation = m_Schedule.GetStratumRotation(),
+                .padding = 0 };
+        m_ScheduleBuffer.SetData(sizeof(ScheduleHeader), &header, 0, 0);
+
+        const std::span<const uint32_t> regionOffsets = m_Schedule.GetRegionOffsets();
+        m_ScheduleBuffer.SetData(regionOffsets.size_bytes(), regionOffsets.data(), sizeof(ScheduleHeader), 0);
+    }
+}
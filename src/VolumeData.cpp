@@ -3,6 +3,7 @@
 #include <vector>
 #include <imgui.h>
 #include <glm/gtc/random.hpp>
+#include <limits>
 
 namespace en
 {
@@ -26,7 +27,41 @@ namespace en
         uniformBufferBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
         uniformBufferBinding.pImmutableSamplers = nullptr;
 
-        std::vector<VkDescriptorSetLayoutBinding> bindings = { densityTexBinding, uniformBufferBinding };
+        VkDescriptorSetLayoutBinding majorantGridBinding;
+        majorantGridBinding.binding = 2;
+        majorantGridBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        majorantGridBinding.descriptorCount = 1;
+        majorantGridBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        majorantGridBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding occupancyGridBinding;
+        occupancyGridBinding.binding = 3;
+        occupancyGridBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        occupancyGridBinding.descriptorCount = 1;
+        occupancyGridBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        occupancyGridBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding lightCacheBinding;
+        lightCacheBinding.binding = 4;
+        lightCacheBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        lightCacheBinding.descriptorCount = 1;
+        lightCacheBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        lightCacheBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding sparseVolumeBinding;
+        sparseVolumeBinding.binding = 5;
+        sparseVolumeBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        sparseVolumeBinding.descriptorCount = 1;
+        sparseVolumeBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        sparseVolumeBinding.pImmutableSamplers = nullptr;
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings = {
+                densityTexBinding,
+                uniformBufferBinding,
+                majorantGridBinding,
+                occupancyGridBinding,
+                lightCacheBinding,
+                sparseVolumeBinding };
 
         VkDescriptorSetLayoutCreateInfo layoutCI;
         layoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -47,7 +82,11 @@ namespace en
         uniformBufferPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         uniformBufferPoolSize.descriptorCount = 1;
 
-        std::vector<VkDescriptorPoolSize> poolSizes = { densityTexPoolSize, uniformBufferPoolSize };
+        VkDescriptorPoolSize storageBufferPoolSize;
+        storageBufferPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        storageBufferPoolSize.descriptorCount = 4;
+
+        std::vector<VkDescriptorPoolSize> poolSizes = { densityTexPoolSize, uniformBufferPoolSize, storageBufferPoolSize };
 
         VkDescriptorPoolCreateInfo poolCI;
         poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -72,7 +111,11 @@ namespace en
         return m_DescriptorSetLayout;
     }
 
-    VolumeData::VolumeData(const vk::Texture3D* densityTex) :
+    VolumeData::VolumeData(
+            const vk::Texture3D* densityTex,
+            const VolumeView& density,
+            const Aabb& bounds,
+            const cpu::SparseBrickVolume* sparseVolume) :
             m_DensityTex(densityTex),
             m_UniformBuffer(
                     sizeof(VolumeUniformData),
@@ -86,8 +129,57 @@ namespace en
                                   .densityFactor = 0.4f,
                                   .g = 0.7f,
                                   .noNnSpp = 1,
-                                  .withNnSpp = 1 })
+                                  .withNnSpp = 1,
+                                  .frameIndex = 0,
+                                  .padding0 = 0,
+                                  .boundsMin = glm::vec4(bounds.minCorner, 0.0f),
+                                  .boundsMax = glm::vec4(bounds.maxCorner, 0.0f),
+                                  .useLightCache = 1,
+                                  .padding1 = { 0, 0, 0 } }),
+            m_MajorantGrid(density, MAJORANT_BRICK_SIZE),
+            m_MajorantGridBuffer(
+                    m_MajorantGrid.GetGpuSize(),
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    {}),
+            m_OccupancyGrid(m_MajorantGrid, OCCUPANCY_MACRO_SIZE, m_UniformData.densityFactor),
+            m_OccupancyGridBuffer(
+                    m_OccupancyGrid.GetGpuSize(),
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    {}),
+            m_LightCache(density, bounds, LIGHT_CACHE_CELL_SIZE),
+            m_LightCacheBuffer(
+                    m_LightCache.GetGpuSize(),
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    {}),
+            m_DirLightVersion(std::numeric_limits<size_t>::max()),
+            m_PointLightVersion(std::numeric_limits<size_t>::max()),
+            m_SparseVolumeSize(sparseVolume == nullptr ? sizeof(cpu::SparseBrickVolume::GpuHeader) : sparseVolume->GetGpuSize()),
+            m_SparseVolumeBuffer(
+                    m_SparseVolumeSize,
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    {})
     {
+        const std::vector<uint8_t> majorantGridData = m_MajorantGrid.GetGpuData();
+        m_MajorantGridBuffer.SetData(majorantGridData.size(), majorantGridData.data(), 0, 0);
+        UploadOccupancyGrid();
+        UploadLightCache();
+
+        // A brick size of 0 keeps the shaders on the dense texture
+        if (sparseVolume == nullptr)
+        {
+            const cpu::SparseBrickVolume::GpuHeader denseHeader = {};
+            m_SparseVolumeBuffer.SetData(sizeof(denseHeader), &denseHeader, 0, 0);
+        }
+        else
+        {
+            const std::vector<uint8_t> sparseVolumeData = sparseVolume->GetGpuData();
+            m_SparseVolumeBuffer.SetData(sparseVolumeData.size(), sparseVolumeData.data(), 0, 0);
+        }
+
         // Create and update descriptor set
         VkDescriptorSetAllocateInfo descSetAI;
         descSetAI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -105,11 +197,41 @@ namespace en
     void VolumeData::Update(bool cameraChanged)
     {
         m_UniformData.random = glm::linearRand(glm::vec4(0.0f), glm::vec4(1.0f));
+        m_UniformData.frameIndex++;
         m_UniformBuffer.SetData(sizeof(VolumeUniformData), &m_UniformData, 0, 0);
+
+        // Only the bricks around the old and new cutoff change
+        if (m_UniformData.densityFactor != m_OccupancyGrid.GetDensityFactor() && m_OccupancyGrid.SetDensityFactor(m_UniformData.densityFactor) > 0)
+            UploadOccupancyGrid();
+    }
+
+    void VolumeData::UpdateLightTransmittanceCache(ThreadPool& threadPool, const DirLight& dirLight, const PointLight& pointLight)
+    {
+        bool changed = false;
+        if (dirLight.GetDirVersion() != m_DirLightVersion && dirLight.GetStrength() > 0.0f)
+        {
+            m_LightCache.ComputeDirLight(threadPool, dirLight.GetDir());
+            m_DirLightVersion = dirLight.GetDirVersion();
+            changed = true;
+        }
+
+        if (pointLight.GetPosVersion() != m_PointLightVersion && pointLight.GetStrength() > 0.0f)
+        {
+            m_LightCache.ComputePointLight(threadPool, pointLight.GetPos());
+            m_PointLightVersion = pointLight.GetPosVersion();
+            changed = true;
+        }
+
+        if (changed)
+            UploadLightCache();
     }
 
     void VolumeData::Destroy()
     {
+        m_SparseVolumeBuffer.Destroy();
+        m_LightCacheBuffer.Destroy();
+        m_OccupancyGridBuffer.Destroy();
+        m_MajorantGridBuffer.Destroy();
         m_UniformBuffer.Destroy();
     }
 
@@ -123,6 +245,7 @@ namespace en
         ImGui::SliderFloat("G", &m_UniformData.g, 0.0f, 1.0f);
         ImGui::SliderInt("No NN SPP", &m_UniformData.noNnSpp, 1, 32);
         ImGui::SliderInt("With NN SPP", &m_UniformData.withNnSpp, 1, 32);
+        ImGui::Checkbox("Light Transmittance Cache", reinterpret_cast<bool*>(&m_UniformData.useLightCache));
 
         ImGui::End();
     }
@@ -132,6 +255,11 @@ namespace en
         return m_DescriptorSet;
     }
 
+    Aabb VolumeData::GetBounds() const
+    {
+        return { .minCorner = glm::vec3(m_UniformData.boundsMin), .maxCorner = glm::vec3(m_UniformData.boundsMax) };
+    }
+
     void VolumeData::UpdateDescriptorSet()
     {
         // Density tex
@@ -170,9 +298,99 @@ namespace en
         uniformBufferWrite.pBufferInfo = &uniformBufferInfo;
         uniformBufferWrite.pTexelBufferView = nullptr;
 
+        // Majorant grid
+        VkDescriptorBufferInfo majorantGridBufferInfo;
+        majorantGridBufferInfo.buffer = m_MajorantGridBuffer.GetVulkanHandle();
+        majorantGridBufferInfo.offset = 0;
+        majorantGridBufferInfo.range = m_MajorantGrid.GetGpuSize();
+
+        VkWriteDescriptorSet majorantGridWrite;
+        majorantGridWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        majorantGridWrite.pNext = nullptr;
+        majorantGridWrite.dstSet = m_DescriptorSet;
+        majorantGridWrite.dstBinding = 2;
+        majorantGridWrite.dstArrayElement = 0;
+        majorantGridWrite.descriptorCount = 1;
+        majorantGridWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        majorantGridWrite.pImageInfo = nullptr;
+        majorantGridWrite.pBufferInfo = &majorantGridBufferInfo;
+        majorantGridWrite.pTexelBufferView = nullptr;
+
+        // Occupancy grid
+        VkDescriptorBufferInfo occupancyGridBufferInfo;
+        occupancyGridBufferInfo.buffer = m_OccupancyGridBuffer.GetVulkanHandle();
+        occupancyGridBufferInfo.offset = 0;
+        occupancyGridBufferInfo.range = m_OccupancyGrid.GetGpuSize();
+
+        VkWriteDescriptorSet occupancyGridWrite;
+        occupancyGridWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        occupancyGridWrite.pNext = nullptr;
+        occupancyGridWrite.dstSet = m_DescriptorSet;
+        occupancyGridWrite.dstBinding = 3;
+        occupancyGridWrite.dstArrayElement = 0;
+        occupancyGridWrite.descriptorCount = 1;
+        occupancyGridWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        occupancyGridWrite.pImageInfo = nullptr;
+        occupancyGridWrite.pBufferInfo = &occupancyGridBufferInfo;
+        occupancyGridWrite.pTexelBufferView = nullptr;
+
+        // Light transmittance cache
+        VkDescriptorBufferInfo lightCacheBufferInfo;
+        lightCacheBufferInfo.buffer = m_LightCacheBuffer.GetVulkanHandle();
+        lightCacheBufferInfo.offset = 0;
+        lightCacheBufferInfo.range = m_LightCache.GetGpuSize();
+
+        VkWriteDescriptorSet lightCacheWrite;
+        lightCacheWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        lightCacheWrite.pNext = nullptr;
+        lightCacheWrite.dstSet = m_DescriptorSet;
+        lightCacheWrite.dstBinding = 4;
+        lightCacheWrite.dstArrayElement = 0;
+        lightCacheWrite.descriptorCount = 1;
+        lightCacheWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        lightCacheWrite.pImageInfo = nullptr;
+        lightCacheWrite.pBufferInfo = &lightCacheBufferInfo;
+        lightCacheWrite.pTexelBufferView = nullptr;
+
+        // Sparse volume
+        VkDescriptorBufferInfo sparseVolumeBufferInfo;
+        sparseVolumeBufferInfo.buffer = m_SparseVolumeBuffer.GetVulkanHandle();
+        sparseVolumeBufferInfo.offset = 0;
+        sparseVolumeBufferInfo.range = m_SparseVolumeSize;
+
+        VkWriteDescriptorSet sparseVolumeWrite;
+        sparseVolumeWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        sparseVolumeWrite.pNext = nullptr;
+        sparseVolumeWrite.dstSet = m_DescriptorSet;
+        sparseVolumeWrite.dstBinding = 5;
+        sparseVolumeWrite.dstArrayElement = 0;
+        sparseVolumeWrite.descriptorCount = 1;
+        sparseVolumeWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        sparseVolumeWrite.pImageInfo = nullptr;
+        sparseVolumeWrite.pBufferInfo = &sparseVolumeBufferInfo;
+        sparseVolumeWrite.pTexelBufferView = nullptr;
+
         // Update
-        std::vector<VkWriteDescriptorSet> writes = { densityTexWrite, uniformBufferWrite };
+        std::vector<VkWriteDescriptorSet> writes = {
+                densityTexWrite,
+                uniformBufferWrite,
+                majorantGridWrite,
+                occupancyGridWrite,
+                lightCacheWrite,
+                sparseVolumeWrite };
 
         vkUpdateDescriptorSets(VulkanAPI::GetDevice(), writes.size(), writes.data(), 0, nullptr);
     }
+
+    void VolumeData::UploadOccupancyGrid()
+    {
+        const std::vector<uint8_t> occupancyGridData = m_OccupancyGrid.GetGpuData();
+        m_OccupancyGridBuffer.SetData(occupancyGridData.size(), occupancyGridData.data(), 0, 0);
+    }
+
+    void VolumeData::UploadLightCache()
+    {
+        const std::vector<uint8_t> lightCacheData = m_LightCache.GetGpuData();
+        m_LightCacheBuffer.SetData(lightCacheData.size(), lightCacheData.data(), 0, 0);
+    }
 }
@@ -0,0 +1,660 @@
+#include <engine/cpu/VolumePathTracer.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace en::cpu
+{
+    // Constants of nrc-forward.frag
+    static constexpr float MAX_RAY_DISTANCE = 100000.0f;
+    static constexpr float LEAP_EPSILON = 0.001f;
+    static constexpr float PI = 3.14159265359f;
+
+    // rotationMatrix(axis, angle) * vec4(v, 1.0), the matrix is built column major so this rotates by -angle
+    static glm::vec3 Rotate(const glm::vec3& v, glm::vec3 axis, float angle)
+    {
+        axis = glm::normalize(axis);
+        const float s = std::sin(angle);
+        const float c = std::cos(angle);
+        const float oc = 1.0f - c;
+
+        const glm::vec3 col0(oc * axis.x * axis.x + c, oc * axis.x * axis.y - axis.z * s, oc * axis.z * axis.x + axis.y * s);
+        const glm::vec3 col1(oc * axis.x * axis.y + axis.z * s, oc * axis.y * axis.y + c, oc * axis.y * axis.z - axis.x * s);
+        const glm::vec3 col2(oc * axis.z * axis.x - axis.y * s, oc * axis.y * axis.z + axis.x * s, oc * axis.z * axis.z + c);
+        return (col0 * v.x) + (col1 * v.y) + (col2 * v.z);
+    }
+
+    VolumePathTracer::VolumePathTracer(const VolumeView& density, const Aabb& bounds, float densityFactor, float g) :
+            m_Bounds(bounds),
+            m_SizeX(density.sizeX),
+            m_SizeY(density.sizeY),
+            m_SizeZ(density.sizeZ),
+            m_SparseVolume(nullptr),
+            m_DensityFactor(densityFactor),
+            m_G(g),
+            m_MajorantGrid(density, MAJORANT_BRICK_SIZE),
+            m_TransmittanceEstimator(TransmittanceEstimator::FixedStep),
+            m_OccupancyGrid(m_MajorantGrid, OCCUPANCY_MACRO_SIZE, densityFactor),
+            m_EmptySpaceSkipping(false),
+            m_LightCache(density, bounds, LIGHT_CACHE_CELL_SIZE),
+            m_LightCacheEnabled(false),
+            m_DirLightCacheStale(true),
+            m_PointLightCacheStale(true),
+            m_DirLightDir(0.0f, 1.0f, 0.0f),
+            m_DirLightStrength(0.0f),
+            m_PointLightPos(0.0f),
+            m_PointLightColor(1.0f),
+            m_PointLightStrength(0.0f),
+            m_HdrWidth(0),
+            m_HdrHeight(0),
+            m_HdrDirectStrength(0.0f),
+            m_HdrHpmStrength(0.0f),
+            m_CameraPos(0.0f),
+            m_CameraForward(0.0f, 0.0f, 1.0f),
+            m_CameraRight(1.0f, 0.0f, 0.0f),
+            m_CameraUp(0.0f, 1.0f, 0.0f)
+    {
+        if (m_SizeX == 0 || m_SizeY == 0 || m_SizeZ == 0)
+            Log::Error("VolumePathTracer density is empty", true);
+
+        const size_t paddedX = m_SizeX + 2;
+        const size_t paddedY = m_SizeY + 2;
+        m_Density.resize(paddedX * paddedY * (m_SizeZ + 2), 0.0f);
+        for (uint32_t x = 0; x < m_SizeX; x++)
+        {
+            for (uint32_t y = 0; y < m_SizeY; y++)
+            {
+                for (uint32_t z = 0; z < m_SizeZ; z++)
+                {
+                    const float value = static_cast<float>(static_cast<uint8_t>(density.Get(x, y, z) * 255.0f)) / 255.0f;
+                    m_Density[(x + 1) + ((y + 1) * paddedX) + ((z + 1) * paddedX * paddedY)] = value;
+                }
+            }
+        }
+    }
+
+    void VolumePathTracer::SetDirLight(float zenith, float azimuth, float strength)
+    {
+        // VecFromAngles of DirLight
+        m_DirLightDir = glm::vec3(std::sin(zenith) * std::sin(azimuth), std::cos(zenith), std::sin(zenith) * std::cos(azimuth));
+        m_DirLightStrength = strength;
+        m_DirLightCacheStale = true;
+    }
+
+    void VolumePathTracer::SetPointLight(const glm::vec3& pos, const glm::vec3& color, float strength)
+    {
+        m_PointLightCacheStale |= pos != m_PointLightPos;
+        m_PointLightPos = pos;
+        m_PointLightColor = color;
+        m_PointLightStrength = strength;
+    }
+
+    void VolumePathTracer::SetHdrEnvMap(uint32_t width, uint32_t height, const std::vector<float>& hdr4f, float directStrength, float hpmStrength)
+    {
+        if (hdr4f.size() != static_cast<size_t>(width) * height * 4)
+            Log::Error("VolumePathTracer env map size does not match its data", true);
+
+        m_HdrWidth = width;
+        m_HdrHeight = height;
+        m_Hdr4f = hdr4f;
+        m_HdrDirectStrength = directStrength;
+        m_HdrHpmStrength = hpmStrength;
+    }
+
+    void VolumePathTracer::SetCamera(const glm::vec3& pos, const glm::vec3& viewDir, const glm::vec3& up, float aspectRatio, float fov)
+    {
+        // Basis of glm::lookAt, scaled to the image plane of glm::perspective at distance 1
+        const float tanHalfFov = std::tan(fov / 2.0f);
+        m_CameraPos = pos;
+        m_CameraForward = glm::normalize(viewDir);
+        m_CameraRight = glm::normalize(glm::cross(m_CameraForward, up));
+        m_CameraUp = glm::cross(m_CameraRight, m_CameraForward) * tanHalfFov;
+        m_CameraRight *= tanHalfFov * aspectRatio;
+    }
+
+    void VolumePathTracer::SetTransmittanceEstimator(TransmittanceEstimator estimator)
+    {
+        m_TransmittanceEstimator = estimator;
+    }
+
+    void VolumePathTracer::SetEmptySpaceSkipping(bool enabled)
+    {
+        m_EmptySpaceSkipping = enabled;
+    }
+
+    void VolumePathTracer::UpdateLightTransmittanceCache(ThreadPool& threadPool)
+    {
+        if (m_DirLightCacheStale)
+            m_LightCache.ComputeDirLight(threadPool, m_DirLightDir);
+        if (m_PointLightCacheStale)
+            m_LightCache.ComputePointLight(threadPool, m_PointLightPos);
+
+        m_LightCacheEnabled = true;
+        m_DirLightCacheStale = false;
+        m_PointLightCacheStale = false;
+    }
+
+    void VolumePathTracer::DisableLightTransmittanceCache()
+    {
+        m_LightCacheEnabled = false;
+    }
+
+    void VolumePathTracer::SetSparseVolume(const SparseBrickVolume* sparseVolume)
+    {
+        m_SparseVolume = sparseVolume;
+    }
+
+    VolumePathTracer::RenderStats VolumePathTracer::Render(
+            ThreadPool& threadPool,
+            uint32_t width,
+            uint32_t height,
+            uint32_t sampleCount,
+            uint32_t frameIndex,
+            std::vector<float>& rgba) const
+    {
+        if (m_LightCacheEnabled && (m_DirLightCacheStale || m_PointLightCacheStale))
+            Log::Error("VolumePathTracer light transmittance cache is stale, call UpdateLightTransmittanceCache", true);
+
+        rgba.resize(static_cast<size_t>(width) * height * 4);
+
+        // Row major tiles, so the contiguous start shares of the threads are bands of the image and stealing
+        // balances the bands through the cloud against the ones that only see the sky
+        const uint32_t tileCountX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        const uint32_t tileCountY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        std::atomic<size_t> pathCount = 0;
+        std::atomic<size_t> stepCount = 0;
+        std::atomic<size_t> scatterCount = 0;
+        threadPool.ParallelForStealing(static_cast<size_t>(tileCountX) * tileCountY, [&](size_t tile, size_t)
+        {
+            const uint32_t startX = static_cast<uint32_t>(tile % tileCountX) * TILE_SIZE;
+            const uint32_t startY = static_cast<uint32_t>(tile / tileCountX) * TILE_SIZE;
+            const uint32_t endX = std::min(startX + TILE_SIZE, width);
+            const uint32_t endY = std::min(startY + TILE_SIZE, height);
+
+            RenderStats tileStats = { .pathCount = 0, .stepCount = 0, .scatterCount = 0 };
+            for (uint32_t y = startY; y < endY; y++)
+            {
+                for (uint32_t x = startX; x < endX; x++)
+                {
+                    const glm::vec4 color = TracePixel(x, y, width, height, sampleCount, frameIndex, tileStats);
+                    float* pixel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+                    pixel[0] = color.x;
+                    pixel[1] = color.y;
+                    pixel[2] = color.z;
+                    pixel[3] = color.w;
+                }
+            }
+            pathCount.fetch_add(tileStats.pathCount);
+            stepCount.fetch_add(tileStats.stepCount);
+            scatterCount.fetch_add(tileStats.scatterCount);
+        });
+
+        return { .pathCount = pathCount.load(), .stepCount = stepCount.load(), .scatterCount = scatterCount.load() };
+    }
+
+    glm::vec4 VolumePathTracer::TracePixel(
+            uint32_t x,
+            uint32_t y,
+            uint32_t width,
+            uint32_t height,
+            uint32_t sampleCount,
+            uint32_t frameIndex,
+            RenderStats& stats) const
+    {
+        const glm::vec3 ro = m_CameraPos;
+        const glm::vec3 rd = GetRayDir(x, y, width, height);
+
+        float tEntry;
+        float tExit;
+        const glm::vec3 envMapColor = SampleHdrEnvMap(rd, false);
+        if (!m_Bounds.Intersect(ro, rd, tEntry, tExit))
+            return glm::vec4(envMapColor, 1.0f);
+
+        // TracePathMultiple
+        stats.pathCount += sampleCount;
+        glm::vec4 average(0.0f);
+        for (uint32_t i = 0; i < sampleCount; i++)
+        {
+            Rng rng(x, y, frameIndex, i);
+            average += TracePath(ro, rd, rng, stats);
+        }
+        average /= static_cast<float>(sampleCount);
+
+        if (average.w == 1.0f)
+            return glm::vec4(envMapColor, 1.0f);
+
+        return average;
+    }
+
+    glm::vec3 VolumePathTracer::GetRayDir(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const
+    {
+        // Pixel center in clip space, nrc-forward.vert flips y
+        const float screenX = (((static_cast<float>(x) + 0.5f) / static_cast<float>(width)) * 2.0f) - 1.0f;
+        const float screenY = 1.0f - (((static_cast<float>(y) + 0.5f) / static_cast<float>(height)) * 2.0f);
+        return glm::normalize(m_CameraForward + (m_CameraRight * screenX) + (m_CameraUp * screenY));
+    }
+
+    glm::vec3 VolumePathTracer::FindExit(const glm::vec3& pos, const glm::vec3& dir) const
+    {
+        // find_entry_exit, only the exit
+        float tEntry;
+        float tExit;
+        m_Bounds.Intersect(pos, dir, tEntry, tExit);
+        return pos + (dir * tExit);
+    }
+
+    float VolumePathTracer::GetDensity(const glm::vec3& pos) const
+    {
+        if (m_SparseVolume != nullptr)
+            return m_DensityFactor * m_SparseVolume->Sample(m_Bounds.GetUvw(pos));
+
+        // Texel space of the linear sampler, texel centers at integers
+        const glm::vec3 uvw = m_Bounds.GetUvw(pos);
+        const float tx = (uvw.x * static_cast<float>(m_SizeX)) - 0.5f;
+        const float ty = (uvw.y * static_cast<float>(m_SizeY)) - 0.5f;
+        const float tz = (uvw.z * static_cast<float>(m_SizeZ)) - 0.5f;
+        const float fx = std::floor(tx);
+        const float fy = std::floor(ty);
+        const float fz = std::floor(tz);
+
+        // All 8 texels in the border
+        if (fx < -1.0f || fy < -1.0f || fz < -1.0f
+            || fx > static_cast<float>(m_SizeX - 1) || fy > static_cast<float>(m_SizeY - 1) || fz > static_cast<float>(m_SizeZ - 1))
+        {
+            return 0.0f;
+        }
+
+        const size_t strideY = m_SizeX + 2;
+        const size_t strideZ = strideY * (m_SizeY + 2);
+        const float* base = &m_Density[
+                static_cast<size_t>(fx + 1.0f)
+                + (static_cast<size_t>(fy + 1.0f) * strideY)
+                + (static_cast<size_t>(fz + 1.0f) * strideZ)];
+
+        const float lx = tx - fx;
+        const float ly = ty - fy;
+        const float lz = tz - fz;
+        const float y0z0 = base[0] + ((base[1] - base[0]) * lx);
+        const float y1z0 = base[strideY] + ((base[strideY + 1] - base[strideY]) * lx);
+        const float y0z1 = base[strideZ] + ((base[strideZ + 1] - base[strideZ]) * lx);
+        const float y1z1 = base[strideZ + strideY] + ((base[strideZ + strideY + 1] - base[strideZ + strideY]) * lx);
+        const float z0 = y0z0 + ((y1z0 - y0z0) * ly);
+        const float z1 = y0z1 + ((y1z1 - y0z1) * ly);
+        return m_DensityFactor * (z0 + ((z1 - z0) * lz));
+    }
+
+    float VolumePathTracer::GetPhase(float cosTheta) const
+    {
+        const float g2 = m_G * m_G;
+        return 0.5f * (1.0f - g2) / std::pow(1.0f + g2 - (2.0f * m_G * cosTheta), 1.5f);
+    }
+
+    glm::vec3 VolumePathTracer::NewRayDir(glm::vec3 oldRayDir, Rng& rng) const
+    {
+        oldRayDir = glm::normalize(oldRayDir);
+
+        // Get any orthogonal vector
+        glm::vec3 orthoDir = oldRayDir.z < oldRayDir.x
+                             ? glm::vec3(oldRayDir.y, -oldRayDir.x, 0.0f)
+                             : glm::vec3(0.0f, -oldRayDir.z, oldRayDir.y);
+        orthoDir = glm::normalize(orthoDir);
+
+        // Rotate around that orthoDir
+        float cosTheta;
+        if (std::abs(m_G) < 0.001f)
+        {
+            cosTheta = 1.0f - (2.0f * rng.NextFloat());
+        }
+        else
+        {
+            const float sqrTerm = (1.0f - (m_G * m_G)) / (1.0f - m_G + (2.0f * m_G * rng.NextFloat()));
+            cosTheta = (1.0f + (m_G * m_G) - (sqrTerm * sqrTerm)) / (2.0f * m_G);
+        }
+        // Rounding can leave [-1, 1] at the ends of the distribution, acos would return nan
+        float angle = std::acos(std::clamp(cosTheta, -1.0f, 1.0f));
+        glm::vec3 newRayDir = Rotate(oldRayDir, orthoDir, angle);
+
+        // Rotate around oldRayDir
+        angle = rng.NextFloat() * 2.0f * PI;
+        newRayDir = Rotate(newRayDir, oldRayDir, angle);
+
+        return glm::normalize(newRayDir);
+    }
+
+    float VolumePathTracer::GetTransmittance(const glm::vec3& start, const glm::vec3& end, uint32_t count, Rng& rng) const
+    {
+        switch (m_TransmittanceEstimator)
+        {
+            case TransmittanceEstimator::Ratio:
+                return GetTransmittanceTracked(start, end, false, rng);
+            case TransmittanceEstimator::ResidualRatio:
+                return GetTransmittanceTracked(start, end, true, rng);
+            default:
+                return GetTransmittanceFixedStep(start, end, count);
+        }
+    }
+
+    float VolumePathTracer::GetTransmittanceFixedStep(const glm::vec3& start, const glm::vec3& end, uint32_t count) const
+    {
+        const glm::vec3 dir = end - start;
+        const float stepSize = glm::length(dir) / static_cast<float>(count);
+
+        if (stepSize == 0.0f)
+            return 1.0f;
+
+        float transmittance = 1.0f;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const float factor = static_cast<float>(i) / static_cast<float>(count);
+            const float density = GetDensity(start + (factor * dir));
+            transmittance *= std::exp(-density * stepSize);
+        }
+
+        return transmittance;
+    }
+
+    float VolumePathTracer::GetTransmittanceTracked(const glm::vec3& start, const glm::vec3& end, bool residual, Rng& rng) const
+    {
+        const float segmentLength = glm::length(end - start);
+        if (segmentLength == 0.0f)
+            return 1.0f;
+
+        // Voxel space of the segment, parametrized by t in [0, 1]
+        const glm::vec3 voxelCount(
+                static_cast<float>(m_MajorantGrid.GetVoxelCountX()),
+                static_cast<float>(m_MajorantGrid.GetVoxelCountY()),
+                static_cast<float>(m_MajorantGrid.GetVoxelCountZ()));
+        const glm::vec3 gridStart = m_Bounds.GetUvw(start) * voxelCount;
+        const glm::vec3 gridDir = (m_Bounds.GetUvw(end) * voxelCount) - gridStart;
+
+        // Clip to the grid
+        float t = 0.0f;
+        float tEnd = 1.0f;
+        glm::vec3 invDir;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            invDir[axis] = 1.0f / (gridDir[axis] == 0.0f ? 1e-20f : gridDir[axis]);
+            const float tLow = -gridStart[axis] * invDir[axis];
+            const float tHigh = (voxelCount[axis] - gridStart[axis]) * invDir[axis];
+            t = std::max(t, std::min(tLow, tHigh));
+            tEnd = std::min(tEnd, std::max(tLow, tHigh));
+        }
+        if (t >= tEnd)
+            return 1.0f;
+
+        // Brick DDA
+        const float brickSize = static_cast<float>(m_MajorantGrid.GetBrickSize());
+        const int brickCount[3] = {
+                static_cast<int>(m_MajorantGrid.GetBrickCountX()),
+                static_cast<int>(m_MajorantGrid.GetBrickCountY()),
+                static_cast<int>(m_MajorantGrid.GetBrickCountZ()) };
+        int brick[3];
+        int brickStep[3];
+        float tDelta[3];
+        float tNext[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const float pos = gridStart[axis] + (gridDir[axis] * t);
+            brick[axis] = std::clamp(static_cast<int>(std::floor(pos / brickSize)), 0, brickCount[axis] - 1);
+            brickStep[axis] = invDir[axis] < 0.0f ? -1 : 1;
+            tDelta[axis] = std::abs(brickSize * invDir[axis]);
+            tNext[axis] = ((static_cast<float>(brick[axis] + (brickStep[axis] > 0 ? 1 : 0)) * brickSize) - gridStart[axis]) * invDir[axis];
+        }
+
+        float transmittance = 1.0f;
+        uint32_t stepCount = 0;
+        while (t < tEnd && stepCount < MAX_TRACKING_STEPS)
+        {
+            const float tBrickEnd = std::min(std::min(tNext[0], std::min(tNext[1], tNext[2])), tEnd);
+            const float control = residual ? m_DensityFactor * m_MajorantGrid.GetMin(brick[0], brick[1], brick[2]) : 0.0f;
+            const float majorant = (m_DensityFactor * m_MajorantGrid.GetMax(brick[0], brick[1], brick[2])) - control;
+
+            transmittance *= std::exp(-control * (tBrickEnd - t) * segmentLength);
+
+            // Tentative collisions against the (residual) majorant, each weighted by its null collision probability
+            if (majorant > 0.0f)
+            {
+                float tCollision = t;
+                while (stepCount < MAX_TRACKING_STEPS)
+                {
+                    tCollision -= std::log(1.0f - rng.NextFloat()) / (majorant * segmentLength);
+                    if (tCollision >= tBrickEnd)
+                        break;
+
+                    stepCount++;
+                    const float density = GetDensity(start + ((end - start) * tCollision));
+                    transmittance *= 1.0f - ((density - control) / majorant);
+                }
+            }
+
+            if (transmittance <= 0.0f)
+                return 0.0f;
+
+            // Next brick
+            t = tBrickEnd;
+            const int axis = tNext[0] <= tNext[1] && tNext[0] <= tNext[2] ? 0 : (tNext[1] <= tNext[2] ? 1 : 2);
+            brick[axis] += brickStep[axis];
+            tNext[axis] += tDelta[axis];
+            if (brick[axis] < 0 || brick[axis] >= brickCount[axis])
+                break;
+        }
+
+        return transmittance;
+    }
+
+    float VolumePathTracer::GetEmptyDistance(const glm::vec3& pos, const glm::vec3& dir) const
+    {
+        // Voxel space of the ray, parametrized by the distance along dir
+        const glm::vec3 voxelCount(
+                static_cast<float>(m_MajorantGrid.GetVoxelCountX()),
+                static_cast<float>(m_MajorantGrid.GetVoxelCountY()),
+                static_cast<float>(m_MajorantGrid.GetVoxelCountZ()));
+        const glm::vec3 gridPos = m_Bounds.GetUvw(pos) * voxelCount;
+
+        // Most path steps start in an occupied brick, they skip the DDA setup
+        const float brickSize = static_cast<float>(m_MajorantGrid.GetBrickSize());
+        if (gridPos.x >= 0.0f && gridPos.y >= 0.0f && gridPos.z >= 0.0f
+            && gridPos.x < voxelCount.x && gridPos.y < voxelCount.y && gridPos.z < voxelCount.z
+            && m_OccupancyGrid.IsBrickOccupied(
+                    static_cast<uint32_t>(gridPos.x / brickSize),
+                    static_cast<uint32_t>(gridPos.y / brickSize),
+                    static_cast<uint32_t>(gridPos.z / brickSize)))
+        {
+            return 0.0f;
+        }
+
+        const glm::vec3 gridDir = (dir / m_Bounds.GetSize()) * voxelCount;
+
+        // Clip to the grid
+        float t = 0.0f;
+        float tEnd = MAX_RAY_DISTANCE;
+        glm::vec3 invDir;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            invDir[axis] = 1.0f / (gridDir[axis] == 0.0f ? 1e-20f : gridDir[axis]);
+            const float tLow = -gridPos[axis] * invDir[axis];
+            const float tHigh = (voxelCount[axis] - gridPos[axis]) * invDir[axis];
+            t = std::max(t, std::min(tLow, tHigh));
+            tEnd = std::min(tEnd, std::max(tLow, tHigh));
+        }
+
+        // Walk empty macro cells whole and the bricks of occupied ones, restarting from the exit of every cell
+        const uint32_t macroSize = m_OccupancyGrid.GetMacroSize();
+        const int brickCount[3] = {
+                static_cast<int>(m_OccupancyGrid.GetBrickCountX()),
+                static_cast<int>(m_OccupancyGrid.GetBrickCountY()),
+                static_cast<int>(m_OccupancyGrid.GetBrickCountZ()) };
+        for (uint32_t i = 0; i < MAX_LEAP_STEPS && t < tEnd; i++)
+        {
+            uint32_t brick[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const float cellPos = (gridPos[axis] + (gridDir[axis] * t)) / brickSize;
+                brick[axis] = static_cast<uint32_t>(std::clamp(static_cast<int>(std::floor(cellPos)), 0, brickCount[axis] - 1));
+            }
+
+            uint32_t cell[3] = { brick[0], brick[1], brick[2] };
+            float cellSize = brickSize;
+            if (m_OccupancyGrid.IsMacroOccupied(brick[0] / macroSize, brick[1] / macroSize, brick[2] / macroSize))
+            {
+                if (m_OccupancyGrid.IsBrickOccupied(brick[0], brick[1], brick[2]))
+                    return t;
+            }
+            else
+            {
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    cell[axis] /= macroSize;
+                }
+                cellSize *= static_cast<float>(macroSize);
+            }
+
+            // Exit of the cell, nudged into the next one
+            float tExit = MAX_RAY_DISTANCE;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const float face = static_cast<float>(cell[axis] + (invDir[axis] >= 0.0f ? 1 : 0)) * cellSize;
+                tExit = std::min(tExit, (face - gridPos[axis]) * invDir[axis]);
+            }
+            t = std::max(tExit, t) + LEAP_EPSILON;
+        }
+
+        return t < tEnd ? t : -1.0f;
+    }
+
+    glm::vec3 VolumePathTracer::TraceDirLight(const glm::vec3& pos, const glm::vec3& dir, Rng& rng) const
+    {
+        if (m_DirLightStrength == 0.0f)
+            return glm::vec3(0.0f);
+
+        const float transmittance = m_LightCacheEnabled
+                                    ? std::exp(-m_DensityFactor * m_LightCache.GetOpticalDepth(CachedLight::Dir, pos))
+                                    : GetTransmittance(pos, FindExit(pos, -glm::normalize(m_DirLightDir)), 32, rng);
+        const float phase = GetPhase(glm::dot(m_DirLightDir, -dir));
+        return glm::vec3(transmittance * m_DirLightStrength * phase);
+    }
+
+    glm::vec3 VolumePathTracer::TracePointLight(const glm::vec3& pos, const glm::vec3& dir, Rng& rng) const
+    {
+        if (m_PointLightStrength == 0.0f)
+            return glm::vec3(0.0f);
+
+        const float transmittance = m_LightCacheEnabled
+                                    ? std::exp(-m_DensityFactor * m_LightCache.GetOpticalDepth(CachedLight::Point, pos))
+                                    : GetTransmittance(m_PointLightPos, pos, 32, rng);
+        const float phase = GetPhase(glm::dot(glm::normalize(m_PointLightPos - pos), -dir));
+        return m_PointLightColor * (m_PointLightStrength * transmittance * phase);
+    }
+
+    glm::vec3 VolumePathTracer::SampleHdrEnvMap(const glm::vec3& dir, bool hpm) const
+    {
+        if (m_Hdr4f.empty())
+            return glm::vec3(0.0f);
+
+        // Equirectangular uv like the shader, then bilinear with clamp to edge like the HdrEnvMap sampler
+        const float u = (std::atan2(dir.z, dir.x) * 0.1591f) + 0.5f;
+        const float v = (std::asin(std::clamp(dir.y, -1.0f, 1.0f)) * 0.3183f) + 0.5f;
+        const float tx = (u * static_cast<float>(m_HdrWidth)) - 0.5f;
+        const float ty = (v * static_cast<float>(m_HdrHeight)) - 0.5f;
+        const float fx = std::floor(tx);
+        const float fy = std::floor(ty);
+        const float lx = tx - fx;
+        const float ly = ty - fy;
+
+        const int maxX = static_cast<int>(m_HdrWidth) - 1;
+        const int maxY = static_cast<int>(m_HdrHeight) - 1;
+        const int x0 = std::clamp(static_cast<int>(fx), 0, maxX);
+        const int x1 = std::clamp(static_cast<int>(fx) + 1, 0, maxX);
+        const int y0 = std::clamp(static_cast<int>(fy), 0, maxY);
+        const int y1 = std::clamp(static_cast<int>(fy) + 1, 0, maxY);
+
+        const float* p00 = &m_Hdr4f[((static_cast<size_t>(y0) * m_HdrWidth) + x0) * 4];
+        const float* p10 = &m_Hdr4f[((static_cast<size_t>(y0) * m_HdrWidth) + x1) * 4];
+        const float* p01 = &m_Hdr4f[((static_cast<size_t>(y1) * m_HdrWidth) + x0) * 4];
+        const float* p11 = &m_Hdr4f[((static_cast<size_t>(y1) * m_HdrWidth) + x1) * 4];
+
+        const float strength = hpm ? m_HdrHpmStrength : m_HdrDirectStrength;
+        glm::vec3 color;
+        for (int c = 0; c < 3; c++)
+        {
+            const float row0 = p00[c] + ((p10[c] - p00[c]) * lx);
+            const float row1 = p01[c] + ((p11[c] - p01[c]) * lx);
+            color[c] = (row0 + ((row1 - row0) * ly)) * strength;
+        }
+        return color;
+    }
+
+    glm::vec3 VolumePathTracer::SampleHdrEnvMap(const glm::vec3& pos, const glm::vec3& dir, uint32_t sampleCount, Rng& rng) const
+    {
+        // Only the phase sampled half, the shader gives all samples to it and skips the env map importance sampling
+        glm::vec3 light(0.0f);
+        for (uint32_t i = 0; i < sampleCount; i++)
+        {
+            const glm::vec3 randomDir = NewRayDir(dir, rng);
+            const float transmittance = GetTransmittance(pos, FindExit(pos, randomDir), 16, rng);
+            light += SampleHdrEnvMap(randomDir, true) * transmittance;
+        }
+
+        return light / static_cast<float>(sampleCount);
+    }
+
+    glm::vec3 VolumePathTracer::TraceScene(const glm::vec3& pos, const glm::vec3& dir, Rng& rng) const
+    {
+        return TraceDirLight(pos, dir, rng) + TracePointLight(pos, dir, rng) + SampleHdrEnvMap(pos, dir, ENV_SAMPLE_COUNT, rng);
+    }
+
+    glm::vec4 VolumePathTracer::TracePath(const glm::vec3& rayOrigin, const glm::vec3& rayDir, Rng& rng, RenderStats& stats) const
+    {
+        glm::vec3 scatteredLight(0.0f);
+        float transmittance = 1.0f;
+
+        float tEntry;
+        float tExit;
+        m_Bounds.Intersect(rayOrigin, rayDir, tEntry, tExit);
+        const glm::vec3 entry = rayOrigin + (rayDir * tEntry);
+
+        glm::vec3 currentPoint = entry;
+        glm::vec3 lastPoint = entry;
+        glm::vec3 currentDir = rayDir;
+
+        for (uint32_t i = 0; i < PATH_STEP_COUNT; i++)
+        {
+            // Leap over the empty bricks, no point in them scatters
+            if (m_EmptySpaceSkipping)
+            {
+                const float emptyDistance = GetEmptyDistance(currentPoint, currentDir);
+                if (emptyDistance < 0.0f)
+                    break;
+                currentPoint += currentDir * emptyDistance;
+            }
+
+            stats.stepCount++;
+            const float density = GetDensity(currentPoint);
+
+            if (density > 0.0f)
+            {
+                stats.scatterCount++;
+
+                // Scene lighting, the phase is importance sampled
+                const glm::vec3 sceneLighting = TraceScene(currentPoint, currentDir, rng);
+
+                const glm::vec3 sInt = sceneLighting * density;
+                const float tR = GetTransmittance(currentPoint, lastPoint, 32, rng);
+
+                scatteredLight += sInt * transmittance;
+                transmittance *= tR;
+
+                lastPoint = currentPoint;
+                currentDir = NewRayDir(currentDir, rng);
+            }
+
+            // Generate new point
+            const float maxDistance = glm::distance(FindExit(currentPoint, currentDir), currentPoint) * 0.1f;
+            const float nextDistance = rng.NextFloat() * maxDistance;
+            currentPoint = currentPoint + (currentDir * nextDistance);
+        }
+
+        return glm::vec4(scatteredLight, transmittance);
+    }
+}
@@ -0,0 +1,107 @@
+#include <engine/cpu/VolumeTexels.hpp>
+#include <engine/cpu/Simd.hpp>
+#include <engine/util/Log.hpp>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace en::cpu
+{
+    size_t GetTexelSize(TexelFormat format)
+    {
+        switch (format)
+        {
+            case TexelFormat::R8Unorm:
+                return 1;
+            case TexelFormat::R16Sfloat:
+                return 2;
+            case TexelFormat::R32Sfloat:
+                return 4;
+        }
+        return 0;
+    }
+
+    // Rows of x of the slices [zBegin, zBegin + zCount) at y, row i holds z = zBegin + i
+    static void GatherRows(const VolumeView& volume, size_t y, size_t zBegin, size_t zCount, float* rows)
+    {
+        const float* data = volume.data.data();
+        const size_t sizeX = volume.sizeX;
+        if (volume.strideX == 1)
+        {
+            for (size_t i = 0; i < zCount; i++)
+            {
+                std::memcpy(rows + (i * sizeX), data + (y * volume.strideY) + ((zBegin + i) * volume.strideZ), sizeX * sizeof(float));
+            }
+            return;
+        }
+
+        // Blocks of TRANSPOSE_SIZE voxels along x, the rest one at a time
+        size_t x = 0;
+        if (volume.strideZ == 1 && zCount == simd::TRANSPOSE_SIZE)
+        {
+            for (; x + simd::TRANSPOSE_SIZE <= sizeX; x += simd::TRANSPOSE_SIZE)
+            {
+                simd::TransposeBlock(data + (x * volume.strideX) + (y * volume.strideY) + zBegin, volume.strideX, rows + x, sizeX);
+            }
+        }
+
+        for (; x < sizeX; x++)
+        {
+            for (size_t i = 0; i < zCount; i++)
+            {
+                rows[(i * sizeX) + x] = volume.Get(x, y, zBegin + i);
+            }
+        }
+    }
+
+    static void ConvertRow(const float* row, size_t count, TexelFormat format, uint8_t* texels)
+    {
+        switch (format)
+        {
+            case TexelFormat::R8Unorm:
+                for (size_t i = 0; i < count; i++)
+                {
+                    texels[i] = static_cast<uint8_t>(std::clamp(row[i], 0.0f, 1.0f) * 255.0f);
+                }
+                break;
+            case TexelFormat::R16Sfloat:
+                for (size_t i = 0; i < count; i++)
+                {
+                    const uint16_t value = static_cast<uint16_t>(glm::packHalf1x16(row[i]));
+                    std::memcpy(texels + (i * sizeof(uint16_t)), &value, sizeof(uint16_t));
+                }
+                break;
+            case TexelFormat::R32Sfloat:
+                std::memcpy(texels, row, count * sizeof(float));
+                break;
+        }
+    }
+
+    void WriteTexels(ThreadPool& threadPool, const VolumeView& volume, TexelFormat format, void* texels)
+    {
+        if (volume.GetVoxelCount() == 0)
+            return;
+
+        const size_t lastIndex = ((volume.sizeX - 1) * volume.strideX) + ((volume.sizeY - 1) * volume.strideY) + ((volume.sizeZ - 1) * volume.strideZ);
+        if (lastIndex >= volume.data.size())
+            Log::Error("VolumeView reaches past its data", true);
+
+        const size_t rowSize = volume.sizeX * GetTexelSize(format);
+        uint8_t* texelBytes = static_cast<uint8_t*>(texels);
+        std::vector<std::vector<float>> rowBuffers(threadPool.GetThreadCount(), std::vector<float>(simd::TRANSPOSE_SIZE * volume.sizeX));
+        threadPool.ParallelFor(volume.sizeY, [&](size_t y, size_t threadIndex)
+        {
+            float* rows = rowBuffers[threadIndex].data();
+            for (size_t zBegin = 0; zBegin < volume.sizeZ; zBegin += simd::TRANSPOSE_SIZE)
+            {
+                const size_t zCount = std::min(simd::TRANSPOSE_SIZE, volume.sizeZ - zBegin);
+                GatherRows(volume, y, zBegin, zCount, rows);
+                for (size_t i = 0; i < zCount; i++)
+                {
+                    ConvertRow(rows + (i * volume.sizeX), volume.sizeX, format, texelBytes + ((y + (volume.sizeY * (zBegin + i))) * rowSize));
+                }
+            }
+        });
+    }
+}
@@ -12,6 +12,8 @@
 #include <engine/graphics/PointLight.hpp>
 #include <engine/graphics/HdrEnvMap.hpp>
 #include <engine/graphics/MRHE.hpp>
+#include <engine/graphics/TrainingSampleBuffer.hpp>
+#include <engine/graphics/TrainingScheduler.hpp>
 
 namespace en
 {
@@ -49,12 +51,16 @@ namespace en
         PointLight::Init(m_Device);
         HdrEnvMap::Init(m_Device);
         MRHE::Init(m_Device);
+        TrainingSampleBuffer::Init(m_Device);
+        TrainingScheduler::Init(m_Device);
     }
 
     void VulkanAPI::Shutdown()
     {
         Log::Info("Shutting down VulkanAPI");
 
+        TrainingScheduler::Shutdown(m_Device);
+        TrainingSampleBuffer::Shutdown(m_Device);
         MRHE::Shutdown(m_Device);
         HdrEnvMap::Shutdown(m_Device);
         PointLight::Shutdown(m_Device);
@@ -134,6 +140,16 @@ namespace en
         return m_PhysicalDeviceInfo.vulkanHandle;
     }
 
+    float VulkanAPI::GetTimestampPeriod()
+    {
+        return m_PhysicalDeviceInfo.properties.limits.timestampPeriod;
+    }
+
+    uint32_t VulkanAPI::GetMaxComputeSharedMemorySize()
+    {
+        return m_PhysicalDeviceInfo.properties.limits.maxComputeSharedMemorySize;
+    }
+
     uint32_t VulkanAPI::GetGraphicsQFI()
     {
         return m_GraphicsQFI;
@@ -0,0 +1,2142 @@
+#include <engine/cpu/benchmark.hpp>
+#include <engine/cpu/NrcMlp.hpp>
+#include <engine/cpu/NrcTrainer.hpp>
+#include <engine/cpu/OptimizerKernels.hpp>
+#include <engine/cpu/MrheEncoder.hpp>
+#include <engine/cpu/OneBlobEncoder.hpp>
+#include <engine/cpu/DirEncoder.hpp>
+#include <engine/cpu/TrainingSampleRing.hpp>
+#include <engine/cpu/AsyncTrainer.hpp>
+#include <engine/cpu/TrainingSchedule.hpp>
+#include <engine/cpu/VolumePathTracer.hpp>
+#include <engine/cpu/LightTransmittanceCache.hpp>
+#include <engine/cpu/SparseBrickVolume.hpp>
+#include <engine/cpu/VolumeTexels.hpp>
+#include <engine/util/Log.hpp>
+#include <engine/util/Rng.hpp>
+#include <engine/util/Aabb.hpp>
+#include <engine/util/MappedVolume.hpp>
+#include <engine/util/read_file.hpp>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace en::cpu
+{
+    static double SecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        std::chrono::nanoseconds delta = std::chrono::high_resolution_clock::now() - start;
+        return static_cast<double>(delta.count()) / 1000000000.0;
+    }
+
+    // Box of data/cloud_sixteenth in RunNrcHpm, the synthetic cloud spans it
+    static const Aabb CLOUD_BOUNDS = Aabb::FromCenterSize(glm::vec3(0.0f), glm::vec3(125.0f, 85.0f, 153.0f) / 2.0f);
+
+    // One ray at a time, same loops as ApplyWeights0-5 in the shaders
+    static void ForwardReference(const NrcMlp& mlp, const float* input, size_t inputStride, float* output)
+    {
+        std::vector<float> in(NrcMlp::INPUT_WIDTH);
+        for (size_t i = 0; i < NrcMlp::INPUT_WIDTH; i++)
+        {
+            in[i] = input[i * inputStride];
+        }
+
+        for (size_t layer = 0; layer < NrcMlp::LAYER_COUNT; layer++)
+        {
+            const size_t outCount = NrcMlp::GetLayerOutputCount(layer);
+            const size_t inCount = NrcMlp::GetLayerInputCount(layer);
+            std::span<const float> weights = mlp.GetWeights(layer);
+            std::span<const float> biases = mlp.GetBiases(layer);
+
+            std::vector<float> out(outCount);
+            for (size_t outRow = 0; outRow < outCount; outRow++)
+            {
+                float sum = 0.0f;
+                for (size_t inCol = 0; inCol < inCount; inCol++)
+                {
+                    sum += in[inCol] * weights[outRow * inCount + inCol];
+                }
+                out[outRow] = std::max(0.0f, sum + biases[outRow]);
+            }
+            in = out;
+        }
+
+        for (size_t i = 0; i < NrcMlp::OUTPUT_WIDTH; i++)
+        {
+            output[i] = in[i];
+        }
+    }
+
+    static void BenchmarkMlpForward()
+    {
+        const size_t rayCount = 1 << 16;
+        const size_t iterations = 20;
+
+        NrcMlp mlp;
+        mlp.InitRandom(42);
+
+        // Larger weights than the training init so the outputs are not all clamped to 0
+        for (size_t layer = 0; layer < NrcMlp::LAYER_COUNT; layer++)
+        {
+            std::vector<float> weights(mlp.GetWeights(layer).begin(), mlp.GetWeights(layer).end());
+            std::vector<float> biases(mlp.GetBiases(layer).begin(), mlp.GetBiases(layer).end());
+            for (float& weight : weights) { weight *= 20.0f; }
+            for (float& bias : biases) { bias = 0.01f; }
+            mlp.SetLayer(layer, weights, biases);
+        }
+
+        std::default_random_engine generator(7);
+        std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+        std::vector<float> input(NrcMlp::INPUT_WIDTH * rayCount);
+        for (float& value : input) { value = distribution(generator); }
+        std::vector<float> output(NrcMlp::OUTPUT_WIDTH * rayCount);
+
+        // Validate against the per ray reference
+        mlp.Forward(input, output, rayCount);
+        float maxError = 0.0f;
+        for (size_t ray = 0; ray < rayCount; ray += 997)
+        {
+            float reference[NrcMlp::OUTPUT_WIDTH];
+            ForwardReference(mlp, &input[ray], rayCount, reference);
+            for (size_t channel = 0; channel < NrcMlp::OUTPUT_WIDTH; channel++)
+            {
+                maxError = std::max(maxError, std::abs(reference[channel] - output[channel * rayCount + ray]));
+            }
+        }
+        if (maxError > 1e-4f)
+            Log::Warn("NrcMlp::Forward differs from reference by " + std::to_string(maxError));
+
+        // Reference throughput
+        auto start = std::chrono::high_resolution_clock::now();
+        const size_t referenceRayCount = rayCount / 16;
+        for (size_t ray = 0; ray < referenceRayCount; ray++)
+        {
+            ForwardReference(mlp, &input[ray], rayCount, &output[ray * NrcMlp::OUTPUT_WIDTH]);
+        }
+        const double referenceRaysPerSec = static_cast<double>(referenceRayCount) / SecondsSince(start);
+
+        // Batched throughput
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            mlp.Forward(input, output, rayCount);
+        }
+        const double seconds = SecondsSince(start);
+        const double raysPerSec = static_cast<double>(rayCount * iterations) / seconds;
+        const double gflops = raysPerSec * static_cast<double>(NrcMlp::GetFlopsPerRay()) / 1e9;
+
+        Log::Info(
+                "NrcMlp forward (simd width " + std::to_string(simd::WIDTH) + "): "
+                + std::to_string(raysPerSec / 1e6) + " MRays/s, "
+                + std::to_string(gflops) + " GFLOP/s, "
+                + "scalar reference " + std::to_string(referenceRaysPerSec / 1e6) + " MRays/s, "
+                + "max error " + std::to_string(maxError));
+
+        // Fused tiles
+        std::vector<float> fusedOutput(NrcMlp::OUTPUT_WIDTH * rayCount);
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            mlp.ForwardFused(input, fusedOutput, rayCount);
+        }
+        const double fusedRaysPerSec = static_cast<double>(rayCount * iterations) / SecondsSince(start);
+
+        mlp.Forward(input, output, rayCount);
+        float fusedError = 0.0f;
+        for (size_t i = 0; i < output.size(); i++)
+        {
+            fusedError = std::max(fusedError, std::abs(output[i] - fusedOutput[i]));
+        }
+
+        // Weight loads per ray: the shaders read every weight for every ray, the cpu kernels broadcast each weight
+        // once per register block of rays
+        const double weightCount = static_cast<double>(NrcMlp::GetWeightCount());
+        Log::Info(
+                "NrcMlp forward fused (tile " + std::to_string(NrcMlp::FUSED_TILE) + "): "
+                + std::to_string(fusedRaysPerSec / 1e6) + " MRays/s, "
+                + "weight loads/ray shader " + std::to_string(weightCount)
+                + ", batched " + std::to_string(weightCount / static_cast<double>(NrcMlp::RAY_BLOCK))
+                + ", fused " + std::to_string(weightCount / static_cast<double>(NrcMlp::FUSED_TILE))
+                + ", activation working set batched " + std::to_string(2 * NrcMlp::WIDTH * NrcMlp::RAY_CHUNK * sizeof(float) / 1024)
+                + "KiB, fused " + std::to_string(2 * NrcMlp::WIDTH * NrcMlp::FUSED_TILE * sizeof(float) / 1024) + "KiB"
+                + ", max difference " + std::to_string(fusedError));
+    }
+
+    static void BenchmarkTrainerScaling()
+    {
+        // Same batch as the 100 x 100 training dispatch of NrcHpmRenderer
+        const size_t rayCount = 100 * 100;
+        const size_t iterations = 10;
+
+        std::default_random_engine generator(11);
+        std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+        std::vector<float> input(NrcMlp::INPUT_WIDTH * rayCount);
+        for (float& value : input) { value = distribution(generator); }
+
+        // Smooth target so the loss has something to learn
+        std::vector<float> target(NrcMlp::OUTPUT_WIDTH * rayCount);
+        for (size_t ray = 0; ray < rayCount; ray++)
+        {
+            for (size_t channel = 0; channel < NrcMlp::OUTPUT_WIDTH; channel++)
+            {
+                target[channel * rayCount + ray] = 0.5f + 0.5f * input[channel * rayCount + ray];
+            }
+        }
+
+        const size_t maxThreadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+        std::vector<size_t> threadCounts;
+        for (size_t threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+        {
+            threadCounts.push_back(threadCount);
+        }
+        threadCounts.push_back(maxThreadCount);
+
+        double singleThreadRaysPerSec = 0.0;
+        for (size_t threadCount : threadCounts)
+        {
+            ThreadPool threadPool(threadCount);
+            NrcMlp mlp;
+            mlp.InitRandom(42);
+            NrcTrainer trainer(mlp, threadPool, 0.01f, 0.0f, 0.5f);
+
+            const float firstLoss = trainer.TrainBatch(input, target, rayCount);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            float loss = firstLoss;
+            for (size_t i = 0; i < iterations; i++)
+            {
+                loss = trainer.TrainBatch(input, target, rayCount);
+            }
+            const double seconds = SecondsSince(start);
+            const double raysPerSec = static_cast<double>(rayCount * iterations) / seconds;
+            if (threadCount == 1)
+                singleThreadRaysPerSec = raysPerSec;
+
+            Log::Info(
+                    "NrcTrainer " + std::to_string(threadCount) + " threads: "
+                    + std::to_string(raysPerSec / 1e6) + " MRays/s, "
+                    + std::to_string(1000.0 * seconds / static_cast<double>(iterations)) + " ms/batch, "
+                    + "speedup " + std::to_string(raysPerSec / singleThreadRaysPerSec) + ", "
+                    + "loss " + std::to_string(firstLoss) + " -> " + std::to_string(loss));
+        }
+    }
+
+    static void BenchmarkOptimizerStep()
+    {
+        // Arena of the nrc network, stepped many times so the timing is stable
+        const size_t count = NrcTopology::PARAM_COUNT;
+        const size_t iterations = 2000;
+        const OptimizerConfig config = OptimizerConfig::Momentum(0.01f, 0.001f, 0.9f);
+
+        std::default_random_engine generator(7);
+        std::normal_distribution<float> distribution(0.0f, 1.0f);
+        std::vector<float> params(count);
+        for (float& value : params) { value = distribution(generator); }
+        std::vector<float> gradients(count, 0.0f);
+        std::vector<float> momentum1(count, 0.0f);
+
+        std::vector<float> scalarParams = params;
+        std::vector<float> scalarGradients = gradients;
+        std::vector<float> scalarMomentum1 = momentum1;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            gradients[i % count] = 1.0f;
+            MomentumStep<true>(params.data(), gradients.data(), momentum1.data(), count, -0.5f, config);
+        }
+        const double simdSeconds = SecondsSince(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            scalarGradients[i % count] = 1.0f;
+            for (size_t j = 0; j < count; j++)
+            {
+                MomentumStepScalar(scalarParams[j], scalarGradients[j], scalarMomentum1[j], -0.5f, true, config);
+            }
+        }
+        const double scalarSeconds = SecondsSince(start);
+
+        float maxError = 0.0f;
+        for (size_t i = 0; i < count; i++)
+        {
+            maxError = std::max(maxError, std::abs(params[i] - scalarParams[i]));
+        }
+
+        // Every element reads and writes param, gradient and momentum once
+        const double bytes = static_cast<double>(6 * sizeof(float) * count * iterations);
+        Log::Info(
+                "Optimizer step (" + std::to_string(count) + " params): simd "
+                + std::to_string(bytes / simdSeconds / 1e9) + " GB/s, scalar "
+                + std::to_string(bytes / scalarSeconds / 1e9) + " GB/s, speedup "
+                + std::to_string(scalarSeconds / simdSeconds) + ", max difference " + std::to_string(maxError));
+    }
+
+    // Batches until the loss drops below lossTarget, or maxBatches if it never does
+    static size_t BatchesToLoss(
+            const OptimizerConfig& config,
+            std::span<const float> input,
+            std::span<const float> target,
+            size_t rayCount,
+            float lossTarget,
+            size_t maxBatches,
+            float& finalLoss)
+    {
+        ThreadPool threadPool;
+        NrcMlp mlp;
+        mlp.InitRandom(42);
+        NrcTrainer trainer(mlp, threadPool, config);
+
+        for (size_t batch = 0; batch < maxBatches; batch++)
+        {
+            finalLoss = trainer.TrainBatch(input, target, rayCount);
+            if (finalLoss < lossTarget)
+                return batch;
+        }
+        return maxBatches;
+    }
+
+    static void BenchmarkOptimizerConvergence()
+    {
+        const size_t rayCount = 4096;
+        const size_t maxBatches = 300;
+        const float lossTarget = 0.02f;
+
+        std::default_random_engine generator(13);
+        std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+        std::vector<float> input(NrcMlp::INPUT_WIDTH * rayCount);
+        for (float& value : input) { value = distribution(generator); }
+
+        std::vector<float> target(NrcMlp::OUTPUT_WIDTH * rayCount);
+        for (size_t ray = 0; ray < rayCount; ray++)
+        {
+            for (size_t channel = 0; channel < NrcMlp::OUTPUT_WIDTH; channel++)
+            {
+                target[channel * rayCount + ray] = 0.5f + 0.5f * input[channel * rayCount + ray];
+            }
+        }
+
+        // Momentum with the settings of main.cpp against Adam and AdamW
+        const std::array<std::pair<const char*, OptimizerConfig>, 3> configs = { {
+                { "momentum", OptimizerConfig::Momentum(0.001f, 0.0f, 0.5f) },
+                { "adam", OptimizerConfig::Adam(0.001f, 0.0f, false) },
+                { "adamw", OptimizerConfig::Adam(0.001f, 0.0001f, true) } } };
+
+        for (const auto& [name, config] : configs)
+        {
+            float finalLoss = 0.0f;
+            const size_t batches = BatchesToLoss(config, input, target, rayCount, lossTarget, maxBatches, finalLoss);
+            Log::Info(
+                    "Optimizer " + std::string(name) + ": "
+                    + (batches < maxBatches ? std::to_string(batches) : ">" + std::to_string(maxBatches))
+                    + " batches to loss " + std::to_string(lossTarget) + ", loss " + std::to_string(finalLoss));
+        }
+    }
+
+    static void BenchmarkMrheStep()
+    {
+        // 16 levels of 2 features, one 100 x 100 training batch touching 8 entries per level and ray
+        const size_t levelCount = 16;
+        const size_t featureCount = 2;
+        const size_t touchCount = 100 * 100 * levelCount * 8;
+        const size_t iterations = 5;
+        const OptimizerConfig config = OptimizerConfig::Adam(0.01f);
+
+        for (size_t log2TableSize = 12; log2TableSize <= 20; log2TableSize += 2)
+        {
+            const size_t tableSize = size_t(1) << log2TableSize;
+            const size_t entryCount = levelCount * tableSize;
+            const size_t floatCount = entryCount * featureCount;
+
+            std::vector<float> params(floatCount, 0.1f);
+            std::vector<float> gradients(floatCount, 0.0f);
+            std::vector<float> momentum1(floatCount, 0.0f);
+            std::vector<float> momentum2(floatCount, 0.0f);
+            std::vector<uint32_t> touchedBits((entryCount + 31) / 32, 0);
+
+            // Hashed corners are spread uniformly over each level
+            std::default_random_engine generator(17);
+            std::uniform_int_distribution<uint32_t> distribution(0, static_cast<uint32_t>(tableSize - 1));
+            std::vector<uint32_t> touches(touchCount);
+            for (size_t i = 0; i < touchCount; i++)
+            {
+                const uint32_t level = static_cast<uint32_t>((i / 8) % levelCount);
+                touches[i] = (level * static_cast<uint32_t>(tableSize)) + distribution(generator);
+            }
+
+            double denseSeconds = 0.0;
+            double markSeconds = 0.0;
+            double sparseSeconds = 0.0;
+            size_t touchedCount = 0;
+            for (size_t iteration = 0; iteration < iterations; iteration++)
+            {
+                for (uint32_t entry : touches)
+                {
+                    gradients[entry * featureCount] += 1.0f;
+                }
+                auto start = std::chrono::high_resolution_clock::now();
+                AdamStep<true>(params.data(), gradients.data(), momentum1.data(), momentum2.data(), floatCount, -1.0f, config);
+                denseSeconds += SecondsSince(start);
+
+                // Marking, on the gpu this rides along with the delta atomics of nrc-train.comp
+                for (uint32_t entry : touches)
+                {
+                    gradients[entry * featureCount] += 1.0f;
+                }
+                start = std::chrono::high_resolution_clock::now();
+                for (uint32_t entry : touches)
+                {
+                    touchedBits[entry / 32] |= 1u << (entry % 32);
+                }
+                markSeconds += SecondsSince(start);
+
+                touchedCount = 0;
+                for (uint32_t bits : touchedBits)
+                {
+                    touchedCount += std::popcount(bits);
+                }
+
+                start = std::chrono::high_resolution_clock::now();
+                SparseStep(params.data(), gradients.data(), momentum1.data(), momentum2.data(), touchedBits, featureCount, -1.0f, config);
+                sparseSeconds += SecondsSince(start);
+            }
+
+            const double toMs = 1000.0 / static_cast<double>(iterations);
+            Log::Info(
+                    "Mrhe step (" + std::to_string(levelCount) + " x " + std::to_string(tableSize) + " entries, "
+                    + std::to_string(100.0 * static_cast<double>(touchedCount) / static_cast<double>(entryCount)) + "% touched): dense "
+                    + std::to_string(denseSeconds * toMs) + " ms, sparse "
+                    + std::to_string(sparseSeconds * toMs) + " ms (+ "
+                    + std::to_string(markSeconds * toMs) + " ms marking)");
+        }
+    }
+
+    // One position at a time, same math as EncodePosMrhe in the shaders
+    static void EncodeReference(const MrheEncoder& encoder, glm::vec3 pos, float* features)
+    {
+        const glm::vec3 uvw = encoder.GetBounds().GetUvw(pos);
+        const float normPos[3] = { uvw.x, uvw.y, uvw.z };
+        const uint32_t primes[3] = { 1, 19349663, 83492791 };
+        const MrheEncoder::Config& config = encoder.GetConfig();
+
+        for (uint32_t level = 0; level < config.levelCount; level++)
+        {
+            float resPos[3];
+            uint32_t floorPos[3];
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                resPos[axis] = normPos[axis] * static_cast<float>(encoder.GetResolution(level));
+                floorPos[axis] = static_cast<uint32_t>(static_cast<int32_t>(std::floor(resPos[axis])));
+            }
+
+            features[level * 2] = 0.0f;
+            features[(level * 2) + 1] = 0.0f;
+            for (uint32_t corner = 0; corner < 8; corner++)
+            {
+                const uint32_t offset[3] = { corner / 4, (corner / 2) % 2, corner % 2 };
+                const uint32_t res = encoder.GetResolution(level);
+                uint32_t entry = 0;
+                float weight = 1.0f;
+                for (size_t axis = 0; axis < 3; axis++)
+                {
+                    if (encoder.IsDenseLevel(level))
+                    {
+                        const uint32_t strides[3] = { 1, res + 1, (res + 1) * (res + 1) };
+                        const int32_t coord = static_cast<int32_t>(floorPos[axis] + offset[axis]);
+                        entry += static_cast<uint32_t>(std::clamp(coord, 0, static_cast<int32_t>(res))) * strides[axis];
+                    }
+                    else
+                    {
+                        entry += (floorPos[axis] + offset[axis]) * primes[axis];
+                    }
+                    const float lerp = resPos[axis] - std::floor(resPos[axis]);
+                    weight *= offset[axis] == 1 ? lerp : 1.0f - lerp;
+                }
+
+                const size_t index = ((level * config.hashTableSize) + (entry % config.hashTableSize)) * 2;
+                features[level * 2] += weight * encoder.GetTable()[index];
+                features[(level * 2) + 1] += weight * encoder.GetTable()[index + 1];
+            }
+        }
+    }
+
+    static void BenchmarkMrheCollisions()
+    {
+        const MrheEncoder::Config& config = MrheEncoder::DEFAULT_CONFIG;
+        const MrheEncoder encoder(CLOUD_BOUNDS, config);
+        for (uint32_t level = 0; level < config.levelCount; level++)
+        {
+            const uint32_t res = encoder.GetResolution(level);
+            Log::Info(
+                    "MRHE level " + std::to_string(level) + " res " + std::to_string(res)
+                    + (encoder.IsDenseLevel(level) ? " dense" : " hashed") + ", collision rate "
+                    + std::to_string(MrheEncoder::MeasureCollisionRate(res, config.hashTableSize)));
+        }
+    }
+
+    static void BenchmarkMrheEncoder()
+    {
+        const size_t positionCount = 1 << 16;
+        const size_t iterations = 5;
+
+        std::default_random_engine generator(19);
+        std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+        std::vector<glm::vec3> positions(positionCount);
+        for (glm::vec3& pos : positions)
+        {
+            pos = glm::vec3(distribution(generator) * 62.5f, distribution(generator) * 42.5f, distribution(generator) * 76.5f);
+        }
+
+        for (uint32_t levelCount : { 4u, 8u, 16u })
+        {
+            for (uint32_t log2TableSize : { 14u, 17u, 20u })
+            {
+                MrheEncoder encoder(CLOUD_BOUNDS, { .levelCount = levelCount, .hashTableSize = 1u << log2TableSize, .minRes = 16, .maxRes = 512 });
+                encoder.InitRandom(23);
+
+                std::vector<float> features(encoder.GetOutputWidth() * positionCount);
+                auto start = std::chrono::high_resolution_clock::now();
+                for (size_t i = 0; i < iterations; i++)
+                {
+                    encoder.Encode(positions, features);
+                }
+                const double encodePerSec = static_cast<double>(positionCount * iterations) / SecondsSince(start);
+
+                // Backward with the features as gradient, the encoding is linear in the table so
+                // sum(tableGradients * table) has to match sum(features * features)
+                std::vector<float> tableGradients(encoder.GetParamCount(), 0.0f);
+                start = std::chrono::high_resolution_clock::now();
+                for (size_t i = 0; i < iterations; i++)
+                {
+                    encoder.Backward(positions, features, tableGradients);
+                }
+                const double backwardPerSec = static_cast<double>(positionCount * iterations) / SecondsSince(start);
+
+                double featureDot = 0.0;
+                for (float feature : features) { featureDot += static_cast<double>(feature) * feature; }
+                double tableDot = 0.0;
+                for (size_t i = 0; i < tableGradients.size(); i++) { tableDot += static_cast<double>(tableGradients[i]) * encoder.GetTable()[i]; }
+                const double backwardError = std::abs((tableDot / static_cast<double>(iterations)) - featureDot) / featureDot;
+
+                float maxError = 0.0f;
+                std::vector<float> reference(encoder.GetOutputWidth());
+                for (size_t ray = 0; ray < positionCount; ray += 97)
+                {
+                    EncodeReference(encoder, positions[ray], reference.data());
+                    for (size_t feature = 0; feature < reference.size(); feature++)
+                    {
+                        maxError = std::max(maxError, std::abs(reference[feature] - features[feature * positionCount + ray]));
+                    }
+                }
+
+                Log::Info(
+                        "MrheEncoder " + std::to_string(levelCount) + " levels x " + std::to_string(1u << log2TableSize) + " entries: encode "
+                        + std::to_string(encodePerSec / 1e6) + " MPos/s, backward "
+                        + std::to_string(backwardPerSec / 1e6) + " MPos/s, max error " + std::to_string(maxError)
+                        + ", backward relative error " + std::to_string(backwardError));
+            }
+        }
+    }
+
+    static void BenchmarkOneBlobEncoder()
+    {
+        const size_t dirCount = 1 << 16;
+        const size_t iterations = 5;
+
+        std::default_random_engine generator(29);
+        std::normal_distribution<float> distribution(0.0f, 1.0f);
+        std::vector<glm::vec3> dirs(dirCount);
+        for (glm::vec3& dir : dirs)
+        {
+            dir = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+        }
+
+        const OneBlobEncoder analyticEncoder(16, OneBlobEncoder::ANALYTIC_CONFIG);
+        std::vector<float> reference(analyticEncoder.GetOutputWidth() * dirCount);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            analyticEncoder.EncodeAnalytic(dirs, reference);
+        }
+        const double analyticNs = SecondsSince(start) * 1e9 / static_cast<double>(dirCount * iterations);
+        Log::Info("OneBlob analytic: " + std::to_string(analyticNs) + " ns/query");
+
+        for (float errorBound : { 1e-2f, 1e-3f, 1e-4f, 1e-5f })
+        {
+            const OneBlobEncoder encoder(16, OneBlobEncoder::ForErrorBound(errorBound));
+
+            std::vector<float> features(encoder.GetOutputWidth() * dirCount);
+            start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < iterations; i++)
+            {
+                encoder.Encode(dirs, features);
+            }
+            const double tableNs = SecondsSince(start) * 1e9 / static_cast<double>(dirCount * iterations);
+
+            float maxFeatureError = 0.0f;
+            for (size_t i = 0; i < features.size(); i++)
+            {
+                maxFeatureError = std::max(maxFeatureError, std::abs(features[i] - reference[i]));
+            }
+
+            Log::Info(
+                    "OneBlob table, error bound " + std::to_string(errorBound) + ": "
+                    + std::to_string(encoder.GetConfig().samplesPerBin) + " samples per bin, "
+                    + std::to_string(encoder.GetSampleCount()) + " floats, " + std::to_string(tableNs) + " ns/query ("
+                    + std::to_string(analyticNs / tableNs) + "x), kernel error " + std::to_string(encoder.MeasureMaxError())
+                    + ", feature error " + std::to_string(maxFeatureError));
+        }
+    }
+
+    // Synthetic radiance: a sun lobe and a sky gradient, slowly varying with the position
+    static glm::vec3 DirEncodingTarget(const glm::vec3& pos, const glm::vec3& dir)
+    {
+        const float length = std::sqrt((dir.x * dir.x) + (dir.y * dir.y) + (dir.z * dir.z));
+        const float cosSun = ((0.6f * dir.x) + (0.7f * dir.y) + (0.387f * dir.z)) / length;
+        const float sun = std::pow(std::max(cosSun, 0.0f), 16.0f);
+        const float sky = 0.5f + (0.5f * dir.y / length);
+        const float shadow = 0.5f + (0.5f * std::sin(pos.x * 0.1f));
+        return glm::vec3((0.8f * sun * shadow) + (0.1f * sky), (0.7f * sun * shadow) + (0.2f * sky), (0.4f * sun * shadow) + (0.5f * sky));
+    }
+
+    template<DirEncoding ENCODING>
+    static void BenchmarkDirEncoding(const char* name)
+    {
+        using Encoder = DirEncoder<ENCODING>;
+        using Topology = MlpTopology<64, 5, Activation::Relu, NRC_POS_INPUT_WIDTH + Encoder::INPUT_WIDTH, 3>;
+
+        const size_t rayCount = 4096;
+        const size_t batchCount = 100;
+        const size_t iterations = 5;
+
+        // Training set and a held out set, both encoded like EncodeRay
+        const MrheEncoder posEncoder(CLOUD_BOUNDS);
+        const Encoder dirEncoder;
+        std::default_random_engine generator(31);
+        std::uniform_real_distribution<float> posDistribution(-0.5f, 0.5f);
+        std::normal_distribution<float> dirDistribution(0.0f, 1.0f);
+
+        std::array<std::vector<float>, 2> inputs;
+        std::array<std::vector<float>, 2> targets;
+        std::vector<glm::vec3> dirs(rayCount, glm::vec3(0.0f, 0.0f, 0.0f));
+        for (size_t set = 0; set < 2; set++)
+        {
+            std::vector<glm::vec3> positions(rayCount, glm::vec3(0.0f, 0.0f, 0.0f));
+            targets[set].resize(Topology::OUTPUT_WIDTH * rayCount);
+            for (size_t ray = 0; ray < rayCount; ray++)
+            {
+                positions[ray] = glm::vec3(posDistribution(generator) * 125.0f, posDistribution(generator) * 85.0f, posDistribution(generator) * 153.0f);
+                dirs[ray] = glm::vec3(dirDistribution(generator), dirDistribution(generator), dirDistribution(generator));
+                const glm::vec3 target = DirEncodingTarget(positions[ray], dirs[ray]);
+                targets[set][ray] = target.x;
+                targets[set][rayCount + ray] = target.y;
+                targets[set][(2 * rayCount) + ray] = target.z;
+            }
+
+            inputs[set].resize(Topology::INPUT_WIDTH * rayCount);
+            posEncoder.Encode(positions, std::span<float>(inputs[set]).first(NRC_POS_INPUT_WIDTH * rayCount));
+            dirEncoder.Encode(dirs, std::span<float>(inputs[set]).subspan(NRC_POS_INPUT_WIDTH * rayCount));
+        }
+
+        std::vector<float> dirFeatures(Encoder::INPUT_WIDTH * rayCount);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            dirEncoder.Encode(dirs, dirFeatures);
+        }
+        const double encodeNs = SecondsSince(start) * 1e9 / static_cast<double>(rayCount * iterations);
+
+        Mlp<Topology> mlp;
+        mlp.InitRandom(42);
+        std::vector<float> output(Topology::OUTPUT_WIDTH * rayCount);
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            mlp.ForwardFused(inputs[1], output, rayCount);
+        }
+        const double forwardRaysPerSec = static_cast<double>(rayCount * iterations) / SecondsSince(start);
+
+        ThreadPool threadPool;
+        MlpTrainer<Topology> trainer(mlp, threadPool, OptimizerConfig::Adam(0.001f));
+        float trainLoss = 0.0f;
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t batch = 0; batch < batchCount; batch++)
+        {
+            trainLoss = trainer.TrainBatch(inputs[0], targets[0], rayCount);
+        }
+        const double trainMs = SecondsSince(start) * 1e3 / static_cast<double>(batchCount);
+
+        mlp.ForwardFused(inputs[1], output, rayCount);
+        double testLoss = 0.0;
+        for (size_t i = 0; i < output.size(); i++)
+        {
+            const double diff = static_cast<double>(std::max(output[i], 0.0f)) - targets[1][i];
+            testLoss += diff * diff;
+        }
+        testLoss /= static_cast<double>(output.size());
+
+        Log::Info(
+                "Dir encoding " + std::string(name) + " (" + std::to_string(Encoder::FEATURE_COUNT) + " features, input "
+                + std::to_string(Topology::INPUT_WIDTH) + "): encode " + std::to_string(encodeNs) + " ns/query, forward "
+                + std::to_string(forwardRaysPerSec / 1e6) + " MRays/s, train " + std::to_string(trainMs) + " ms/batch, loss after "
+                + std::to_string(batchCount) + " batches " + std::to_string(trainLoss) + " train / " + std::to_string(testLoss) + " test");
+    }
+
+    static void BenchmarkDirEncodings()
+    {
+        BenchmarkDirEncoding<DirEncoding::OneBlob16>("OneBlob-16");
+        BenchmarkDirEncoding<DirEncoding::OneBlob32>("OneBlob-32");
+        BenchmarkDirEncoding<DirEncoding::SphericalHarmonics2>("SH-2");
+        BenchmarkDirEncoding<DirEncoding::SphericalHarmonics3>("SH-3");
+        BenchmarkDirEncoding<DirEncoding::SphericalHarmonics4>("SH-4");
+    }
+
+    template<uint32_t WIDTH, uint32_t HIDDEN_LAYERS>
+    static void BenchmarkTopology()
+    {
+        using Topology = MlpTopology<WIDTH, HIDDEN_LAYERS, Activation::Relu, 64, 3>;
+
+        const size_t rayCount = 16384;
+        const size_t iterations = 5;
+
+        std::default_random_engine generator(5);
+        std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+        std::vector<float> input(Topology::INPUT_WIDTH * rayCount);
+        for (float& value : input) { value = distribution(generator); }
+        std::vector<float> target(Topology::OUTPUT_WIDTH * rayCount, 0.5f);
+        std::vector<float> output(Topology::OUTPUT_WIDTH * rayCount);
+
+        Mlp<Topology> mlp;
+        mlp.InitRandom(42);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            mlp.ForwardFused(input, output, rayCount);
+        }
+        const double forwardRaysPerSec = static_cast<double>(rayCount * iterations) / SecondsSince(start);
+
+        ThreadPool threadPool;
+        MlpTrainer<Topology> trainer(mlp, threadPool, 0.01f, 0.0f, 0.5f);
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            trainer.TrainBatch(input, target, rayCount);
+        }
+        const double trainRaysPerSec = static_cast<double>(rayCount * iterations) / SecondsSince(start);
+
+        Log::Info(
+                "Mlp " + std::to_string(WIDTH) + " x " + std::to_string(HIDDEN_LAYERS) + " ("
+                + std::to_string(Topology::WEIGHT_COUNT) + " weights): forward "
+                + std::to_string(forwardRaysPerSec / 1e6) + " MRays/s ("
+                + std::to_string(forwardRaysPerSec * static_cast<double>(Topology::FLOPS_PER_RAY) / 1e9) + " GFLOP/s), train "
+                + std::to_string(trainRaysPerSec / 1e6) + " MRays/s");
+    }
+
+    static void BenchmarkTopologySweep()
+    {
+        BenchmarkTopology<32, 3>();
+        BenchmarkTopology<32, 5>();
+        BenchmarkTopology<64, 3>();
+        BenchmarkTopology<64, 5>();
+        BenchmarkTopology<64, 7>();
+        BenchmarkTopology<128, 3>();
+        BenchmarkTopology<128, 5>();
+    }
+
+    // The chain the shaders used before rng.glsl
+    static float SinHashRand(float& preRand, float& prePreRand)
+    {
+        const float value = std::sin((preRand * 12.9898f) + (prePreRand * 78.233f)) * 43758.5453f;
+        const float result = value - std::floor(value);
+        prePreRand = preRand;
+        preRand = result;
+        return result;
+    }
+
+    // Chi square over 256 bins of the first sample of each pixel, and the correlation of neighbouring pixels
+    static void ReportRngQuality(const std::string& name, const std::vector<float>& values)
+    {
+        const size_t binCount = 256;
+        std::vector<size_t> bins(binCount, 0);
+        for (float value : values)
+        {
+            bins[std::min(binCount - 1, static_cast<size_t>(value * static_cast<float>(binCount)))]++;
+        }
+
+        const double expected = static_cast<double>(values.size()) / static_cast<double>(binCount);
+        double chiSquare = 0.0;
+        for (size_t count : bins)
+        {
+            const double diff = static_cast<double>(count) - expected;
+            chiSquare += diff * diff / expected;
+        }
+
+        double covariance = 0.0;
+        for (size_t i = 1; i < values.size(); i++)
+        {
+            covariance += (values[i] - 0.5) * (values[i - 1] - 0.5);
+        }
+        const double correlation = covariance / static_cast<double>(values.size() - 1) * 12.0;
+
+        Log::Info(
+                name + ": chi square " + std::to_string(chiSquare) + " (255 expected), neighbour correlation "
+                + std::to_string(correlation));
+    }
+
+    static void BenchmarkRng()
+    {
+        const uint32_t width = 512;
+        const uint32_t height = 512;
+        const size_t samplesPerPixel = 16;
+        const float random[2] = { 0.37f, 0.81f }; // VolumeData::random of one frame
+
+        std::vector<float> firstSamples(width * height);
+        float sum = 0.0f;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                float preRand = random[0] * (static_cast<float>(x) / static_cast<float>(width));
+                float prePreRand = random[1] * (static_cast<float>(y) / static_cast<float>(height));
+                firstSamples[(y * width) + x] = SinHashRand(preRand, prePreRand);
+                for (size_t i = 1; i < samplesPerPixel; i++)
+                {
+                    sum += SinHashRand(preRand, prePreRand);
+                }
+            }
+        }
+        const double sinNs = SecondsSince(start) * 1e9 / static_cast<double>(width * height * samplesPerPixel);
+        Log::Info("Sin hash: " + std::to_string(sinNs) + " ns/sample");
+        ReportRngQuality("Sin hash", firstSamples);
+
+        start = std::chrono::high_resolution_clock::now();
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                Rng rng(x, y, 0, 0);
+                firstSamples[(y * width) + x] = rng.NextFloat();
+                for (size_t i = 1; i < samplesPerPixel; i++)
+                {
+                    sum += rng.NextFloat();
+                }
+            }
+        }
+        const double pcgNs = SecondsSince(start) * 1e9 / static_cast<double>(width * height * samplesPerPixel);
+        Log::Info(
+                "PCG: " + std::to_string(pcgNs) + " ns/sample (" + std::to_string(sinNs / pcgNs) + "x), mean "
+                + std::to_string(sum / static_cast<float>(width * height * (samplesPerPixel - 1) * 2)));
+        ReportRngQuality("PCG", firstSamples);
+
+        // Same key, same sequence
+        Rng first(7, 11, 13, Rng::TRAIN_SAMPLE_OFFSET);
+        Rng second(7, 11, 13, Rng::TRAIN_SAMPLE_OFFSET);
+        for (size_t i = 0; i < 64; i++)
+        {
+            if (first.NextUint() != second.NextUint())
+                Log::Error("Rng sequences with the same key differ", true);
+        }
+    }
+
+    // Encodes positions and directions like EncodeRay and writes the targets channel major
+    static void EncodeNrcBatch(
+            const MrheEncoder& posEncoder,
+            const DirEncoder<NRC_DIR_ENCODING>& dirEncoder,
+            const std::vector<TrainingSampleRing::Record>& records,
+            std::vector<float>& input,
+            std::vector<float>& target)
+    {
+        const size_t count = records.size();
+        std::vector<glm::vec3> positions(count, glm::vec3(0.0f, 0.0f, 0.0f));
+        std::vector<glm::vec3> dirs(count, glm::vec3(0.0f, 0.0f, 0.0f));
+        input.resize(NrcTopology::INPUT_WIDTH * count);
+        target.resize(NrcTopology::OUTPUT_WIDTH * count);
+        for (size_t ray = 0; ray < count; ray++)
+        {
+            positions[ray] = records[ray].pos;
+            dirs[ray] = records[ray].dir;
+            target[ray] = records[ray].target.x;
+            target[count + ray] = records[ray].target.y;
+            target[(2 * count) + ray] = records[ray].target.z;
+        }
+
+        posEncoder.Encode(positions, std::span<float>(input).first(NRC_POS_INPUT_WIDTH * count));
+        dirEncoder.Encode(dirs, std::span<float>(input).subspan(NRC_POS_INPUT_WIDTH * count));
+    }
+
+    // Trains on noisy targets averaged over TracePathForTraining's 8 paths, a fraction of every batch replayed
+    static void BenchmarkReplayBuffer()
+    {
+        const size_t batchSize = 1024;
+        const size_t stepCount = 300;
+        const size_t pathsPerTarget = 8;
+        const size_t testCount = 4096;
+
+        const MrheEncoder posEncoder(CLOUD_BOUNDS);
+        const DirEncoder<NRC_DIR_ENCODING> dirEncoder;
+        std::uniform_real_distribution<float> posDistribution(-0.5f, 0.5f);
+        std::normal_distribution<float> dirDistribution(0.0f, 1.0f);
+        std::exponential_distribution<float> pathDistribution(1.0f);
+
+        // Held out set with exact targets
+        std::default_random_engine testGenerator(37);
+        std::vector<TrainingSampleRing::Record> testRecords(testCount);
+        for (TrainingSampleRing::Record& record : testRecords)
+        {
+            record.pos = glm::vec3(posDistribution(testGenerator) * 125.0f, posDistribution(testGenerator) * 85.0f, posDistribution(testGenerator) * 153.0f);
+            record.dir = glm::vec3(dirDistribution(testGenerator), dirDistribution(testGenerator), dirDistribution(testGenerator));
+            record.target = DirEncodingTarget(record.pos, record.dir);
+        }
+        std::vector<float> testInput;
+        std::vector<float> testTarget;
+        EncodeNrcBatch(posEncoder, dirEncoder, testRecords, testInput, testTarget);
+
+        ThreadPool threadPool;
+        for (float replayRatio : { 0.0f, 0.5f, 0.75f })
+        {
+            TrainingSampleRing sampleRing(8 * batchSize, replayRatio, 16);
+            Mlp<NrcTopology> mlp;
+            mlp.InitRandom(42);
+            MlpTrainer<NrcTopology> trainer(mlp, threadPool, OptimizerConfig::Adam(0.001f));
+
+            std::default_random_engine generator(41);
+            std::vector<TrainingSampleRing::Record> batch;
+            std::vector<float> input;
+            std::vector<float> target;
+            size_t tracedPaths = 0;
+            float replayAge = 0.0f;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t step = 0; step < stepCount; step++)
+            {
+                // Monte carlo estimate: every path is the radiance scaled by an exponential with mean 1
+                batch.clear();
+                const size_t newCount = sampleRing.GetNewRecordCount(batchSize);
+                for (size_t i = 0; i < newCount; i++)
+                {
+                    const glm::vec3 pos(posDistribution(generator) * 125.0f, posDistribution(generator) * 85.0f, posDistribution(generator) * 153.0f);
+                    const glm::vec3 dir(dirDistribution(generator), dirDistribution(generator), dirDistribution(generator));
+                    const glm::vec3 radiance = DirEncodingTarget(pos, dir);
+                    glm::vec3 estimate(0.0f, 0.0f, 0.0f);
+                    for (size_t path = 0; path < pathsPerTarget; path++)
+                    {
+                        const float weight = pathDistribution(generator) / static_cast<float>(pathsPerTarget);
+                        estimate = glm::vec3(estimate.x + (radiance.x * weight), estimate.y + (radiance.y * weight), estimate.z + (radiance.z * weight));
+                    }
+                    tracedPaths += pathsPerTarget;
+
+                    sampleRing.Push(pos, dir, estimate);
+                    batch.push_back({ .pos = pos, .dir = dir, .target = estimate, .step = sampleRing.GetStep() });
+                }
+                sampleRing.Replay(batchSize - newCount, batch);
+                replayAge += sampleRing.GetLastReplayAge();
+                sampleRing.AdvanceStep();
+
+                EncodeNrcBatch(posEncoder, dirEncoder, batch, input, target);
+                trainer.TrainBatch(input, target, batchSize);
+            }
+            const double stepMs = SecondsSince(start) * 1e3 / static_cast<double>(stepCount);
+
+            std::vector<float> output(NrcTopology::OUTPUT_WIDTH * testCount);
+            mlp.ForwardFused(testInput, output, testCount);
+            double testLoss = 0.0;
+            for (size_t i = 0; i < output.size(); i++)
+            {
+                const double diff = static_cast<double>(std::max(output[i], 0.0f)) - testTarget[i];
+                testLoss += diff * diff;
+            }
+            testLoss /= static_cast<double>(output.size());
+
+            Log::Info(
+                    "Replay ratio " + std::to_string(replayRatio) + ": "
+                    + std::to_string(static_cast<double>(tracedPaths) / static_cast<double>(stepCount)) + " traced paths/step, mean replay age "
+                    + std::to_string(replayAge / static_cast<float>(stepCount)) + " steps, " + std::to_string(stepMs) + " ms/step, test loss after "
+                    + std::to_string(stepCount) + " steps " + std::to_string(testLoss));
+        }
+    }
+
+    // Stand-in for TracePathForTraining: 8 random walks of 64 steps, the radiance scaled by their mean throughput
+    static glm::vec3 SimulateTrainingTarget(const glm::vec3& pos, const glm::vec3& dir, Rng& rng)
+    {
+        float throughputSum = 0.0f;
+        for (size_t path = 0; path < 8; path++)
+        {
+            float throughput = 1.0f;
+            for (size_t step = 0; step < 64; step++)
+            {
+                throughput *= 0.98f + (0.04f * rng.NextFloat());
+            }
+            throughputSum += throughput;
+        }
+
+        const glm::vec3 radiance = DirEncodingTarget(pos, dir);
+        const float scale = throughputSum / 8.0f;
+        return glm::vec3(radiance.x * scale, radiance.y * scale, radiance.z * scale);
+    }
+
+    // Generating and encoding before every step vs producer threads feeding the trainer through AsyncTrainer
+    static void BenchmarkAsyncTrainer()
+    {
+        using Trainer = AsyncTrainer<NrcTopology>;
+        constexpr size_t CHUNK = Trainer::CHUNK_SIZE;
+
+        const size_t batchSize = 4 * CHUNK;
+        const size_t stepCount = 100;
+
+        const MrheEncoder posEncoder(CLOUD_BOUNDS);
+        const DirEncoder<NRC_DIR_ENCODING> dirEncoder;
+        const size_t maxProducerCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        std::vector<uint32_t> chunkCounters(maxProducerCount, 0);
+
+        // Every producer has its own sequence, keyed by producer and chunk
+        const Trainer::Generator generator = [&](size_t producerIndex, float* input, float* target)
+        {
+            Rng rng(static_cast<uint32_t>(producerIndex), chunkCounters[producerIndex]++, 0, 0);
+            std::vector<glm::vec3> positions(CHUNK, glm::vec3(0.0f, 0.0f, 0.0f));
+            std::vector<glm::vec3> dirs(CHUNK, glm::vec3(0.0f, 0.0f, 0.0f));
+            for (size_t ray = 0; ray < CHUNK; ray++)
+            {
+                positions[ray] = glm::vec3((rng.NextFloat() - 0.5f) * 125.0f, (rng.NextFloat() - 0.5f) * 85.0f, (rng.NextFloat() - 0.5f) * 153.0f);
+                dirs[ray] = glm::vec3((rng.NextFloat() * 2.0f) - 1.0f, (rng.NextFloat() * 2.0f) - 1.0f, (rng.NextFloat() * 2.0f) - 1.0f);
+                const glm::vec3 value = SimulateTrainingTarget(positions[ray], dirs[ray], rng);
+                target[ray] = value.x;
+                target[CHUNK + ray] = value.y;
+                target[(2 * CHUNK) + ray] = value.z;
+            }
+
+            posEncoder.Encode(positions, std::span<float>(input, NRC_POS_INPUT_WIDTH * CHUNK));
+            dirEncoder.Encode(dirs, std::span<float>(input + (NRC_POS_INPUT_WIDTH * CHUNK), (NrcTopology::INPUT_WIDTH - NRC_POS_INPUT_WIDTH) * CHUNK));
+        };
+
+        // Synchronous: generate the batch with the trainer's pool, then train
+        {
+            ThreadPool threadPool;
+            Mlp<NrcTopology> mlp;
+            mlp.InitRandom(42);
+            MlpTrainer<NrcTopology> trainer(mlp, threadPool, OptimizerConfig::Adam(0.001f));
+
+            const size_t chunksPerBatch = batchSize / CHUNK;
+            std::vector<float> chunkInput(NrcTopology::INPUT_WIDTH * batchSize);
+            std::vector<float> chunkTarget(NrcTopology::OUTPUT_WIDTH * batchSize);
+            std::vector<float> input(NrcTopology::INPUT_WIDTH * batchSize);
+            std::vector<float> target(NrcTopology::OUTPUT_WIDTH * batchSize);
+            double generateSeconds = 0.0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t step = 0; step < stepCount; step++)
+            {
+                const auto generateStart = std::chrono::high_resolution_clock::now();
+                threadPool.ParallelFor(chunksPerBatch, [&](size_t chunk, size_t threadIndex)
+                {
+                    float* chunkIn = &chunkInput[chunk * NrcTopology::INPUT_WIDTH * CHUNK];
+                    float* chunkOut = &chunkTarget[chunk * NrcTopology::OUTPUT_WIDTH * CHUNK];
+                    generator(threadIndex, chunkIn, chunkOut);
+                    for (size_t feature = 0; feature < NrcTopology::INPUT_WIDTH; feature++)
+                    {
+                        std::memcpy(&input[(feature * batchSize) + (chunk * CHUNK)], &chunkIn[feature * CHUNK], CHUNK * sizeof(float));
+                    }
+                    for (size_t channel = 0; channel < NrcTopology::OUTPUT_WIDTH; channel++)
+                    {
+                        std::memcpy(&target[(channel * batchSize) + (chunk * CHUNK)], &chunkOut[channel * CHUNK], CHUNK * sizeof(float));
+                    }
+                });
+                generateSeconds += SecondsSince(generateStart);
+
+                trainer.TrainBatch(input, target, batchSize);
+            }
+            const double seconds = SecondsSince(start);
+
+            Log::Info(
+                    "Training sync: " + std::to_string(static_cast<double>(stepCount * batchSize) / seconds / 1e3) + " KSamples/s, "
+                    + std::to_string(generateSeconds / seconds * 100.0) + "% of the time generating");
+        }
+
+        // Async: half of the threads produce, the trainer pool gets the rest
+        {
+            const size_t producerCount = std::max<size_t>(maxProducerCount / 2, 1);
+            ThreadPool threadPool(std::max<size_t>(maxProducerCount - producerCount, 1));
+            Mlp<NrcTopology> mlp;
+            mlp.InitRandom(42);
+            MlpTrainer<NrcTopology> trainer(mlp, threadPool, OptimizerConfig::Adam(0.001f));
+
+            std::fill(chunkCounters.begin(), chunkCounters.end(), 0);
+            Trainer asyncTrainer(trainer, producerCount, 16, generator);
+            const auto start = std::chrono::high_resolution_clock::now();
+            asyncTrainer.Train(stepCount, batchSize);
+            const double seconds = SecondsSince(start);
+
+            const Trainer::Stats& stats = asyncTrainer.GetStats();
+            Log::Info(
+                    "Training async, " + std::to_string(producerCount) + " producers: "
+                    + std::to_string(static_cast<double>(stepCount * batchSize) / seconds / 1e3) + " KSamples/s, trainer waiting "
+                    + std::to_string(stats.trainerWaitSeconds / seconds * 100.0) + "%, producers waiting "
+                    + std::to_string(stats.producerWaitSeconds / seconds / static_cast<double>(producerCount) * 100.0) + "%");
+        }
+    }
+
+    // Toy volume for self-training. Every vertex emits DirEncodingTarget, shadowed by a march through a procedural
+    // density like TraceScene, and scatters with albedo SELF_TRAIN_ALBEDO to a uniform random vertex. The expected
+    // radiance after the first vertex is then the mean emission, which makes the exact radiance cheap to get.
+    static constexpr float SELF_TRAIN_ALBEDO = 0.8f;
+    static constexpr size_t SELF_TRAIN_PATH_STEPS = 64;
+    static constexpr size_t SELF_TRAIN_SHADOW_STEPS = 16;
+
+    static glm::vec3 RandomVolumeVertex(Rng& rng, glm::vec3& dir)
+    {
+        dir = glm::vec3((rng.NextFloat() * 2.0f) - 1.0f, (rng.NextFloat() * 2.0f) - 1.0f, (rng.NextFloat() * 2.0f) - 1.0f);
+        return glm::vec3((rng.NextFloat() - 0.5f) * 125.0f, (rng.NextFloat() - 0.5f) * 85.0f, (rng.NextFloat() - 0.5f) * 153.0f);
+    }
+
+    static glm::vec3 SelfTrainEmission(const glm::vec3& pos, const glm::vec3& dir)
+    {
+        float opticalDepth = 0.0f;
+        for (size_t step = 0; step < SELF_TRAIN_SHADOW_STEPS; step++)
+        {
+            const float t = static_cast<float>(step) * 4.0f;
+            opticalDepth += 0.01f * (1.0f + std::sin((pos.x + (0.6f * t)) * 0.05f) * std::cos((pos.z + (0.387f * t)) * 0.05f));
+        }
+
+        const glm::vec3 radiance = DirEncodingTarget(pos, dir);
+        const float transmittance = std::exp(-opticalDepth * 4.0f);
+        return glm::vec3(radiance.x * transmittance, radiance.y * transmittance, radiance.z * transmittance);
+    }
+
+    // Like TracePath in nrc-train.comp: maxScatterCount 0 walks all steps, otherwise the path stops at that vertex
+    // and returns its throughput in tailWeight, to be multiplied with the cache prediction at tailPos and tailDir
+    static glm::vec3 TraceSelfTrainPath(
+            glm::vec3 pos,
+            glm::vec3 dir,
+            size_t maxScatterCount,
+            Rng& rng,
+            float& tailWeight,
+            glm::vec3& tailPos,
+            glm::vec3& tailDir,
+            size_t& stepCount)
+    {
+        glm::vec3 light(0.0f, 0.0f, 0.0f);
+        float throughput = 1.0f;
+        tailWeight = 0.0f;
+        for (size_t step = 0; step < SELF_TRAIN_PATH_STEPS; step++)
+        {
+            stepCount++;
+            if (maxScatterCount > 0 && step == maxScatterCount)
+            {
+                tailWeight = throughput;
+                tailPos = pos;
+                tailDir = dir;
+                break;
+            }
+
+            const glm::vec3 emission = SelfTrainEmission(pos, dir);
+            const float weight = throughput * (1.0f - SELF_TRAIN_ALBEDO);
+            light = glm::vec3(light.x + (emission.x * weight), light.y + (emission.y * weight), light.z + (emission.z * weight));
+            throughput *= SELF_TRAIN_ALBEDO;
+            pos = RandomVolumeVertex(rng, dir);
+        }
+
+        return light;
+    }
+
+    // Full 64 step training paths vs paths cut after a few vertices and bootstrapped from the cache, as in the
+    // self-training scheme of the NRC paper. Cost per target includes the cache lookups.
+    static void BenchmarkSelfTraining()
+    {
+        const size_t batchSize = 512;
+        const size_t stepCount = 200;
+        const size_t pathsPerTarget = 4;
+        const size_t testCount = 2048;
+
+        const MrheEncoder posEncoder(CLOUD_BOUNDS);
+        const DirEncoder<NRC_DIR_ENCODING> dirEncoder;
+
+        // Mean emission of a uniform random vertex, the expected radiance of every path after its first vertex
+        Rng meanRng(0, 0, 0, 1);
+        double meanEmission[3] = { 0.0, 0.0, 0.0 };
+        const size_t meanSampleCount = 1 << 18;
+        for (size_t i = 0; i < meanSampleCount; i++)
+        {
+            glm::vec3 dir;
+            const glm::vec3 pos = RandomVolumeVertex(meanRng, dir);
+            const glm::vec3 emission = SelfTrainEmission(pos, dir);
+            meanEmission[0] += emission.x;
+            meanEmission[1] += emission.y;
+            meanEmission[2] += emission.z;
+        }
+
+        // Held out set with exact targets
+        Rng testRng(0, 0, 0, 2);
+        std::vector<TrainingSampleRing::Record> testRecords(testCount);
+        for (TrainingSampleRing::Record& record : testRecords)
+        {
+            record.pos = RandomVolumeVertex(testRng, record.dir);
+            const glm::vec3 emission = SelfTrainEmission(record.pos, record.dir);
+            const float emissionWeight = 1.0f - SELF_TRAIN_ALBEDO;
+            const float meanWeight = SELF_TRAIN_ALBEDO / static_cast<float>(meanSampleCount);
+            record.target = glm::vec3(
+                    (emission.x * emissionWeight) + (static_cast<float>(meanEmission[0]) * meanWeight),
+                    (emission.y * emissionWeight) + (static_cast<float>(meanEmission[1]) * meanWeight),
+                    (emission.z * emissionWeight) + (static_cast<float>(meanEmission[2]) * meanWeight));
+        }
+        std::vector<float> testInput;
+        std::vector<float> testTarget;
+        EncodeNrcBatch(posEncoder, dirEncoder, testRecords, testInput, testTarget);
+
+        struct SelfTrainConfig
+        {
+            size_t selfTrainLength;
+            float bootstrapMix;
+        };
+
+        ThreadPool threadPool;
+        for (const SelfTrainConfig& config : { SelfTrainConfig{ 0, 0.0f }, SelfTrainConfig{ 4, 15.0f / 16.0f }, SelfTrainConfig{ 2, 15.0f / 16.0f }, SelfTrainConfig{ 2, 1.0f } })
+        {
+            Mlp<NrcTopology> mlp;
+            mlp.InitRandom(42);
+            MlpTrainer<NrcTopology> trainer(mlp, threadPool, OptimizerConfig::Adam(0.001f));
+
+            std::vector<TrainingSampleRing::Record> batch(batchSize);
+            std::vector<TrainingSampleRing::Record> tails;
+            std::vector<size_t> tailTargets;
+            std::vector<float> tailWeights;
+            std::vector<float> tailInput;
+            std::vector<float> tailTarget;
+            std::vector<float> tailOutput;
+            std::vector<float> input;
+            std::vector<float> target;
+            size_t pathStepCount = 0;
+            double generateSeconds = 0.0;
+            for (size_t step = 0; step < stepCount; step++)
+            {
+                const auto generateStart = std::chrono::high_resolution_clock::now();
+                Rng rng(0, 0, static_cast<uint32_t>(step), 0);
+                tails.clear();
+                tailTargets.clear();
+                tailWeights.clear();
+                for (size_t i = 0; i < batchSize; i++)
+                {
+                    TrainingSampleRing::Record& record = batch[i];
+                    record.pos = RandomVolumeVertex(rng, record.dir);
+                    record.target = glm::vec3(0.0f, 0.0f, 0.0f);
+                    for (size_t path = 0; path < pathsPerTarget; path++)
+                    {
+                        const bool bootstrap = rng.NextFloat() < config.bootstrapMix;
+                        float tailWeight;
+                        glm::vec3 tailPos;
+                        glm::vec3 tailDir;
+                        const glm::vec3 light = TraceSelfTrainPath(record.pos, record.dir, bootstrap ? config.selfTrainLength : 0, rng, tailWeight, tailPos, tailDir, pathStepCount);
+                        record.target = glm::vec3(record.target.x + light.x, record.target.y + light.y, record.target.z + light.z);
+                        if (tailWeight > 0.0f)
+                        {
+                            tails.push_back({ .pos = tailPos, .dir = tailDir, .target = glm::vec3(0.0f, 0.0f, 0.0f), .step = 0 });
+                            tailTargets.push_back(i);
+                            tailWeights.push_back(tailWeight);
+                        }
+                    }
+                }
+
+                // Terminate the cut paths into the current cache, in one batch
+                if (!tails.empty())
+                {
+                    EncodeNrcBatch(posEncoder, dirEncoder, tails, tailInput, tailTarget);
+                    tailOutput.resize(NrcTopology::OUTPUT_WIDTH * tails.size());
+                    mlp.ForwardFused(tailInput, tailOutput, tails.size());
+                    for (size_t tail = 0; tail < tails.size(); tail++)
+                    {
+                        glm::vec3& value = batch[tailTargets[tail]].target;
+                        const float weight = tailWeights[tail];
+                        value.x += std::max(tailOutput[tail], 0.0f) * weight;
+                        value.y += std::max(tailOutput[tails.size() + tail], 0.0f) * weight;
+                        value.z += std::max(tailOutput[(2 * tails.size()) + tail], 0.0f) * weight;
+                    }
+                }
+
+                for (TrainingSampleRing::Record& record : batch)
+                {
+                    const float scale = 1.0f / static_cast<float>(pathsPerTarget);
+                    record.target = glm::vec3(record.target.x * scale, record.target.y * scale, record.target.z * scale);
+                }
+                generateSeconds += SecondsSince(generateStart);
+
+                EncodeNrcBatch(posEncoder, dirEncoder, batch, input, target);
+                trainer.TrainBatch(input, target, batchSize);
+            }
+
+            std::vector<float> output(NrcTopology::OUTPUT_WIDTH * testCount);
+            mlp.ForwardFused(testInput, output, testCount);
+            double testLoss = 0.0;
+            for (size_t i = 0; i < output.size(); i++)
+            {
+                const double diff = static_cast<double>(std::max(output[i], 0.0f)) - testTarget[i];
+                testLoss += diff * diff;
+            }
+            testLoss /= static_cast<double>(output.size());
+
+            const double targetCount = static_cast<double>(stepCount * batchSize);
+            Log::Info(
+                    "Self-training length " + std::to_string(config.selfTrainLength) + ", bootstrap mix " + std::to_string(config.bootstrapMix) + ": "
+                    + std::to_string(static_cast<double>(pathStepCount) / targetCount) + " path steps/target, "
+                    + std::to_string(generateSeconds * 1e6 / targetCount) + " us/target, test loss after "
+                    + std::to_string(stepCount) + " steps " + std::to_string(testLoss));
+        }
+    }
+
+    // Screen of the scheduling benchmark: the radiance of the camera ray through uv, with fine detail in one corner
+    static glm::vec3 ScheduleTarget(float u, float v, glm::vec3& pos, glm::vec3& dir)
+    {
+        pos = glm::vec3((u - 0.5f) * 125.0f, (v - 0.5f) * 85.0f, 0.0f);
+        dir = glm::vec3(u - 0.5f, v - 0.5f, 1.0f);
+        const glm::vec3 radiance = DirEncodingTarget(pos, dir);
+        if (u >= 0.25f || v >= 0.25f)
+            return radiance;
+
+        const float detail = 0.3f * (1.0f + (std::sin(pos.x * 0.7f) * std::sin(pos.y * 0.7f)));
+        return glm::vec3(radiance.x + detail, radiance.y + detail, radiance.z + detail);
+    }
+
+    // Fixed training lattice vs TrainingSchedule with uniform and loss weighted regions, same batch size. Also runs
+    // the time budget control against a step cost with a fixed part.
+    static void BenchmarkTrainingSchedule()
+    {
+        const uint32_t latticeSize = 32;
+        const uint32_t batchSize = latticeSize * latticeSize;
+        const size_t stepCount = 300;
+        const size_t pathsPerTarget = 4;
+        const size_t testCount = 4096;
+
+        const MrheEncoder posEncoder(CLOUD_BOUNDS);
+        const DirEncoder<NRC_DIR_ENCODING> dirEncoder;
+
+        // Held out set over the whole screen with exact targets
+        Rng testRng(0, 0, 0, 3);
+        std::vector<TrainingSampleRing::Record> testRecords(testCount);
+        for (TrainingSampleRing::Record& record : testRecords)
+        {
+            const float u = testRng.NextFloat();
+            const float v = testRng.NextFloat();
+            record.target = ScheduleTarget(u, v, record.pos, record.dir);
+        }
+        std::vector<float> testInput;
+        std::vector<float> testTarget;
+        EncodeNrcBatch(posEncoder, dirEncoder, testRecords, testInput, testTarget);
+
+        struct ScheduleConfig
+        {
+            const char* name;
+            bool lattice;
+            float uniformRatio;
+        };
+
+        ThreadPool threadPool;
+        for (const ScheduleConfig& config : {
+                ScheduleConfig{ "fixed lattice", true, 1.0f },
+                ScheduleConfig{ "stratified", false, 1.0f },
+                ScheduleConfig{ "stratified + loss weighted", false, 0.3f } })
+        {
+            TrainingSchedule schedule(16, 16, batchSize, batchSize, 1.0f);
+            schedule.SetUniformRatio(config.uniformRatio);
+            Mlp<NrcTopology> mlp;
+            mlp.InitRandom(42);
+            MlpTrainer<NrcTopology> trainer(mlp, threadPool, OptimizerConfig::Adam(0.001f));
+
+            std::vector<TrainingSampleRing::Record> batch(batchSize);
+            std::vector<uint32_t> batchRegions(batchSize);
+            std::vector<float> input;
+            std::vector<float> target;
+            std::vector<float> output(NrcTopology::OUTPUT_WIDTH * batchSize);
+            std::vector<float> regionLossSums(schedule.GetRegionCount());
+            std::vector<uint32_t> regionSampleCounts(schedule.GetRegionCount());
+            for (size_t step = 0; step < stepCount; step++)
+            {
+                Rng rng(0, 0, static_cast<uint32_t>(step), 1);
+                for (uint32_t i = 0; i < batchSize; i++)
+                {
+                    float u;
+                    float v;
+                    if (config.lattice)
+                    {
+                        u = static_cast<float>(i % latticeSize) / static_cast<float>(latticeSize);
+                        v = static_cast<float>(i / latticeSize) / static_cast<float>(latticeSize);
+                    }
+                    else
+                    {
+                        schedule.GetSampleUV(i, u, v);
+                    }
+                    batchRegions[i] = schedule.GetSampleRegion(i);
+
+                    // Monte carlo estimate like in BenchmarkReplayBuffer
+                    TrainingSampleRing::Record& record = batch[i];
+                    const glm::vec3 radiance = ScheduleTarget(u, v, record.pos, record.dir);
+                    float weight = 0.0f;
+                    for (size_t path = 0; path < pathsPerTarget; path++)
+                    {
+                        weight -= std::log(1.0f - rng.NextFloat());
+                    }
+                    weight /= static_cast<float>(pathsPerTarget);
+                    record.target = glm::vec3(radiance.x * weight, radiance.y * weight, radiance.z * weight);
+                }
+
+                EncodeNrcBatch(posEncoder, dirEncoder, batch, input, target);
+
+                // Per sample loss for the regions, the train shader gets it from its own forward pass
+                if (!config.lattice)
+                {
+                    mlp.ForwardFused(input, output, batchSize);
+                    std::fill(regionLossSums.begin(), regionLossSums.end(), 0.0f);
+                    std::fill(regionSampleCounts.begin(), regionSampleCounts.end(), 0);
+                    for (uint32_t i = 0; i < batchSize; i++)
+                    {
+                        float loss = 0.0f;
+                        for (size_t channel = 0; channel < NrcTopology::OUTPUT_WIDTH; channel++)
+                        {
+                            const float diff = std::max(output[(channel * batchSize) + i], 0.0f) - target[(channel * batchSize) + i];
+                            loss += diff * diff;
+                        }
+                        regionLossSums[batchRegions[i]] += loss / static_cast<float>(NrcTopology::OUTPUT_WIDTH);
+                        regionSampleCounts[batchRegions[i]]++;
+                    }
+                    schedule.UpdateLoss(regionLossSums, regionSampleCounts);
+                }
+
+                trainer.TrainBatch(input, target, batchSize);
+                schedule.Plan();
+            }
+
+            std::vector<float> testOutput(NrcTopology::OUTPUT_WIDTH * testCount);
+            mlp.ForwardFused(testInput, testOutput, testCount);
+            double testLoss = 0.0;
+            for (size_t i = 0; i < testOutput.size(); i++)
+            {
+                const double diff = static_cast<double>(std::max(testOutput[i], 0.0f)) - testTarget[i];
+                testLoss += diff * diff;
+            }
+            testLoss /= static_cast<double>(testOutput.size());
+
+            Log::Info(
+                    "Training schedule " + std::string(config.name) + ": test loss after " + std::to_string(stepCount)
+                    + " steps of " + std::to_string(batchSize) + " samples " + std::to_string(testLoss));
+        }
+
+        // Budget control: 1 ms fixed plus 4 us per sample against a 4 ms budget settles at 750 samples
+        TrainingSchedule schedule(16, 16, 256, 16384, 4.0f);
+        for (size_t frame = 0; frame < 30; frame++)
+        {
+            schedule.UpdateCost(1.0f + (0.004f * static_cast<float>(schedule.GetSampleCount())));
+            schedule.Plan();
+        }
+        Log::Info("Training schedule budget: " + std::to_string(schedule.GetSampleCount()) + " samples after 30 frames, expected 750");
+    }
+
+    // Density in the z fastest layout of the raw density files
+    struct SyntheticVolume
+    {
+        std::vector<float> data;
+        size_t sizeX;
+        size_t sizeY;
+        size_t sizeZ;
+
+        float& operator()(size_t x, size_t y, size_t z) { return data[(((x * sizeY) + y) * sizeZ) + z]; }
+        VolumeView GetView() const { return VolumeView::ZFastest(data, sizeX, sizeY, sizeZ); }
+    };
+
+    // Lumpy sphere in [0, 1], stands in for data/cloud_sixteenth so the benchmark runs without the data files
+    static SyntheticVolume SyntheticCloud(size_t sizeX, size_t sizeY, size_t sizeZ)
+    {
+        SyntheticVolume density = { .data = std::vector<float>(sizeX * sizeY * sizeZ), .sizeX = sizeX, .sizeY = sizeY, .sizeZ = sizeZ };
+        for (size_t x = 0; x < sizeX; x++)
+        {
+            for (size_t y = 0; y < sizeY; y++)
+            {
+                for (size_t z = 0; z < sizeZ; z++)
+                {
+                    const float px = ((2.0f * (static_cast<float>(x) + 0.5f)) / static_cast<float>(sizeX)) - 1.0f;
+                    const float py = ((2.0f * (static_cast<float>(y) + 0.5f)) / static_cast<float>(sizeY)) - 1.0f;
+                    const float pz = ((2.0f * (static_cast<float>(z) + 0.5f)) / static_cast<float>(sizeZ)) - 1.0f;
+                    const float radius = std::sqrt((px * px) + (py * py) + (pz * pz));
+                    const float lumps = 0.15f * std::sin(7.0f * px) * std::sin((5.0f * py) + 1.0f) * std::sin((6.0f * pz) + 2.0f);
+                    density(x, y, z) = std::clamp((0.8f - radius + lumps) * 4.0f, 0.0f, 1.0f);
+                }
+            }
+        }
+        return density;
+    }
+
+    // Scene of RunNrcHpm with the defaults of VolumeData and HdrEnvMap, a sky gradient and the sun on
+    static void SetBenchmarkScene(VolumePathTracer& pathTracer)
+    {
+        const uint32_t hdrWidth = 64;
+        const uint32_t hdrHeight = 32;
+        std::vector<float> hdr4f(hdrWidth * hdrHeight * 4);
+        for (uint32_t y = 0; y < hdrHeight; y++)
+        {
+            const float v = (static_cast<float>(y) + 0.5f) / static_cast<float>(hdrHeight);
+            for (uint32_t x = 0; x < hdrWidth; x++)
+            {
+                float* texel = &hdr4f[((y * hdrWidth) + x) * 4];
+                texel[0] = 0.2f + (0.8f * v);
+                texel[1] = 0.3f + (0.7f * v);
+                texel[2] = 0.5f + (0.5f * v);
+                texel[3] = 1.0f;
+            }
+        }
+        pathTracer.SetHdrEnvMap(hdrWidth, hdrHeight, hdr4f, 1.0f, 8.0f);
+        pathTracer.SetDirLight(-1.0f, 0.5f, 1.0f);
+        pathTracer.SetCamera(glm::vec3(0.0f, 0.0f, -64.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, glm::radians(60.0f));
+    }
+
+    static void BenchmarkVolumePathTracer()
+    {
+        const uint32_t width = 128;
+        const uint32_t height = 128;
+        const uint32_t sampleCount = 2;
+
+        VolumePathTracer pathTracer(SyntheticCloud(63, 43, 77).GetView(), CLOUD_BOUNDS, 0.4f, 0.7f);
+        SetBenchmarkScene(pathTracer);
+
+        const size_t maxThreadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+        std::vector<size_t> threadCounts;
+        for (size_t threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+        {
+            threadCounts.push_back(threadCount);
+        }
+        threadCounts.push_back(maxThreadCount);
+
+        // Paths per second against the thread count, every thread count has to render the same image
+        std::vector<float> reference;
+        double singleThreadPathsPerSec = 0.0;
+        for (size_t threadCount : threadCounts)
+        {
+            ThreadPool threadPool(threadCount);
+            std::vector<float> image;
+            auto start = std::chrono::high_resolution_clock::now();
+            const VolumePathTracer::RenderStats stats = pathTracer.Render(threadPool, width, height, sampleCount, 0, image);
+            const double pathsPerSec = static_cast<double>(stats.pathCount) / SecondsSince(start);
+            if (threadCount == 1)
+            {
+                reference = image;
+                singleThreadPathsPerSec = pathsPerSec;
+            }
+
+            Log::Info(
+                    "VolumePathTracer " + std::to_string(threadCount) + " threads: " + std::to_string(pathsPerSec / 1e3)
+                    + " kPaths/s, speedup " + std::to_string(pathsPerSec / singleThreadPathsPerSec) + ", "
+                    + (image == reference ? "same image as 1 thread" : "image differs from 1 thread"));
+        }
+
+        // Tile schedules on all threads: one band per thread, one shared tile counter, work stealing
+        const uint32_t tileCountX = (width + VolumePathTracer::TILE_SIZE - 1) / VolumePathTracer::TILE_SIZE;
+        const uint32_t tileCount = tileCountX * ((height + VolumePathTracer::TILE_SIZE - 1) / VolumePathTracer::TILE_SIZE);
+        std::vector<float> image(width * height * 4);
+        const auto renderTile = [&](size_t tile)
+        {
+            const uint32_t startX = static_cast<uint32_t>(tile % tileCountX) * VolumePathTracer::TILE_SIZE;
+            const uint32_t startY = static_cast<uint32_t>(tile / tileCountX) * VolumePathTracer::TILE_SIZE;
+            VolumePathTracer::RenderStats stats{};
+            for (uint32_t y = startY; y < std::min(startY + VolumePathTracer::TILE_SIZE, height); y++)
+            {
+                for (uint32_t x = startX; x < std::min(startX + VolumePathTracer::TILE_SIZE, width); x++)
+                {
+                    const glm::vec4 color = pathTracer.TracePixel(x, y, width, height, sampleCount, 0, stats);
+                    float* pixel = &image[((y * width) + x) * 4];
+                    pixel[0] = color.x;
+                    pixel[1] = color.y;
+                    pixel[2] = color.z;
+                    pixel[3] = color.w;
+                }
+            }
+        };
+
+        ThreadPool threadPool(maxThreadCount);
+        const size_t threadCount = threadPool.GetThreadCount();
+        auto start = std::chrono::high_resolution_clock::now();
+        threadPool.ParallelFor(threadCount, [&](size_t band, size_t)
+        {
+            for (size_t tile = (tileCount * band) / threadCount; tile < (tileCount * (band + 1)) / threadCount; tile++)
+            {
+                renderTile(tile);
+            }
+        });
+        const double bandSeconds = SecondsSince(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        threadPool.ParallelFor(tileCount, [&](size_t tile, size_t) { renderTile(tile); });
+        const double sharedSeconds = SecondsSince(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        threadPool.ParallelForStealing(tileCount, [&](size_t tile, size_t) { renderTile(tile); });
+        const double stealingSeconds = SecondsSince(start);
+
+        Log::Info(
+                "VolumePathTracer tiles on " + std::to_string(threadCount) + " threads: bands "
+                + std::to_string(1000.0 * bandSeconds) + " ms, shared counter " + std::to_string(1000.0 * sharedSeconds)
+                + " ms, work stealing " + std::to_string(1000.0 * stealingSeconds) + " ms");
+    }
+
+    static void BenchmarkEmptySpaceSkipping()
+    {
+        const uint32_t width = 128;
+        const uint32_t height = 128;
+        const uint32_t sampleCount = 2;
+
+        VolumePathTracer pathTracer(SyntheticCloud(63, 43, 77).GetView(), CLOUD_BOUNDS, 0.4f, 0.7f);
+        SetBenchmarkScene(pathTracer);
+
+        const OccupancyGrid& occupancyGrid = pathTracer.GetOccupancyGrid();
+        const size_t brickCount = static_cast<size_t>(occupancyGrid.GetBrickCountX()) * occupancyGrid.GetBrickCountY() * occupancyGrid.GetBrickCountZ();
+        Log::Info("Occupancy grid: " + std::to_string(occupancyGrid.GetOccupiedBrickCount()) + " / " + std::to_string(brickCount) + " bricks occupied");
+
+        // Steps per path and frame time with and without leaping over the empty bricks, best of a few frames
+        ThreadPool threadPool;
+        for (bool skipping : { false, true })
+        {
+            pathTracer.SetEmptySpaceSkipping(skipping);
+            std::vector<float> image;
+            VolumePathTracer::RenderStats stats{};
+            double seconds = 0.0;
+            for (uint32_t frame = 0; frame < 3; frame++)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                stats = pathTracer.Render(threadPool, width, height, sampleCount, 0, image);
+                const double frameSeconds = SecondsSince(start);
+                seconds = frame == 0 ? frameSeconds : std::min(seconds, frameSeconds);
+            }
+
+            Log::Info(
+                    std::string("VolumePathTracer ") + (skipping ? "with" : "without") + " empty space skipping: "
+                    + std::to_string(static_cast<double>(stats.stepCount) / static_cast<double>(stats.pathCount))
+                    + " steps per path, " + std::to_string(static_cast<double>(stats.scatterCount) / static_cast<double>(stats.pathCount))
+                    + " scatter events per path, " + std::to_string(1000.0 * seconds) + " ms per frame, "
+                    + std::to_string(1e6 * seconds / static_cast<double>(stats.scatterCount)) + " us per scatter event");
+        }
+
+        // Incremental rebuild over a densityFactor sweep against building the grid from scratch, both have to
+        // occupy the same bricks
+        const uint32_t sweepCount = 100;
+        OccupancyGrid sweepGrid(pathTracer.GetMajorantGrid(), VolumePathTracer::OCCUPANCY_MACRO_SIZE, 0.4f);
+        size_t flippedCount = 0;
+        size_t incrementalOccupiedSum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < sweepCount; i++)
+        {
+            flippedCount += sweepGrid.SetDensityFactor(0.0005f * static_cast<float>(i));
+            incrementalOccupiedSum += sweepGrid.GetOccupiedBrickCount();
+        }
+        const double incrementalSeconds = SecondsSince(start);
+
+        size_t rebuiltOccupiedSum = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < sweepCount; i++)
+        {
+            const OccupancyGrid rebuiltGrid(pathTracer.GetMajorantGrid(), VolumePathTracer::OCCUPANCY_MACRO_SIZE, 0.0005f * static_cast<float>(i));
+            rebuiltOccupiedSum += rebuiltGrid.GetOccupiedBrickCount();
+        }
+        const double rebuildSeconds = SecondsSince(start);
+
+        Log::Info(
+                "Occupancy grid densityFactor sweep: " + std::to_string(flippedCount) + " bricks flipped, incremental "
+                + std::to_string(1e6 * incrementalSeconds / sweepCount) + " us, rebuild "
+                + std::to_string(1e6 * rebuildSeconds / sweepCount) + " us per update, "
+                + (incrementalOccupiedSum == rebuiltOccupiedSum ? "same occupancy" : "occupancy differs"));
+    }
+
+    static void BenchmarkTransmittance()
+    {
+        const size_t segmentCount = 20000;
+        const uint32_t referenceStepCount = 2048;
+
+        VolumePathTracer pathTracer(SyntheticCloud(63, 43, 77).GetView(), CLOUD_BOUNDS, 0.4f, 0.7f);
+
+        // Segments from a point in the cloud box to its exit, like the light and env map samples of TraceScene
+        const glm::vec3 boundsSize = CLOUD_BOUNDS.GetSize();
+        Rng segmentRng(0, 0, 0, 4);
+        std::vector<glm::vec3> starts(segmentCount);
+        std::vector<glm::vec3> ends(segmentCount);
+        for (size_t i = 0; i < segmentCount; i++)
+        {
+            const glm::vec3 start(
+                    CLOUD_BOUNDS.minCorner.x + (boundsSize.x * segmentRng.NextFloat()),
+                    CLOUD_BOUNDS.minCorner.y + (boundsSize.y * segmentRng.NextFloat()),
+                    CLOUD_BOUNDS.minCorner.z + (boundsSize.z * segmentRng.NextFloat()));
+            const float cosTheta = (2.0f * segmentRng.NextFloat()) - 1.0f;
+            const float sinTheta = std::sqrt(1.0f - (cosTheta * cosTheta));
+            const float phi = 6.28318530718f * segmentRng.NextFloat();
+            const glm::vec3 dir(sinTheta * std::cos(phi), cosTheta, sinTheta * std::sin(phi));
+
+            float entryDistance;
+            float exitDistance;
+            CLOUD_BOUNDS.Intersect(start, dir, entryDistance, exitDistance);
+            starts[i] = start;
+            ends[i] = glm::vec3(start.x + (dir.x * exitDistance), start.y + (dir.y * exitDistance), start.z + (dir.z * exitDistance));
+        }
+
+        pathTracer.SetTransmittanceEstimator(TransmittanceEstimator::FixedStep);
+        std::vector<float> reference(segmentCount);
+        Rng unusedRng(0, 0, 0, 0);
+        for (size_t i = 0; i < segmentCount; i++)
+        {
+            reference[i] = pathTracer.GetTransmittance(starts[i], ends[i], referenceStepCount, unusedRng);
+        }
+
+        struct EstimatorConfig
+        {
+            const char* name;
+            TransmittanceEstimator estimator;
+            uint32_t stepCount;
+        };
+
+        for (const EstimatorConfig& config : {
+                EstimatorConfig{ "fixed 16 steps", TransmittanceEstimator::FixedStep, 16 },
+                EstimatorConfig{ "fixed 32 steps", TransmittanceEstimator::FixedStep, 32 },
+                EstimatorConfig{ "ratio tracking", TransmittanceEstimator::Ratio, 0 },
+                EstimatorConfig{ "residual ratio tracking", TransmittanceEstimator::ResidualRatio, 0 } })
+        {
+            pathTracer.SetTransmittanceEstimator(config.estimator);
+
+            // Error of single estimates, and bias of the mean over all segments
+            double squaredError = 0.0;
+            double error = 0.0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < segmentCount; i++)
+            {
+                Rng rng(static_cast<uint32_t>(i), 0, 0, 5);
+                const double diff = static_cast<double>(pathTracer.GetTransmittance(starts[i], ends[i], config.stepCount, rng)) - reference[i];
+                squaredError += diff * diff;
+                error += diff;
+            }
+            const double seconds = SecondsSince(start);
+
+            // Mean squared error times the time per evaluation, lower is better at equal time
+            const double meanSquaredError = squaredError / static_cast<double>(segmentCount);
+            const double equalTimeError = meanSquaredError * seconds / static_cast<double>(segmentCount) * 1e6;
+
+            Log::Info(
+                    "Transmittance " + std::string(config.name) + ": "
+                    + std::to_string(static_cast<double>(segmentCount) / seconds / 1e6) + " M evaluations/s, rmse "
+                    + std::to_string(std::sqrt(meanSquaredError)) + ", mean error "
+                    + std::to_string(error / static_cast<double>(segmentCount)) + ", mse x us per evaluation "
+                    + std::to_string(equalTimeError));
+        }
+    }
+
+    static void BenchmarkLightTransmittanceCache()
+    {
+        const size_t pointCount = 20000;
+        const uint32_t referenceStepCount = 2048;
+        const uint32_t width = 128;
+        const uint32_t height = 128;
+        const uint32_t sampleCount = 2;
+        const float densityFactor = 0.4f;
+
+        VolumePathTracer pathTracer(SyntheticCloud(63, 43, 77).GetView(), CLOUD_BOUNDS, densityFactor, 0.7f);
+        SetBenchmarkScene(pathTracer);
+        pathTracer.SetPointLight(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(1.0f), 1.0f);
+        const LightTransmittanceCache& cache = pathTracer.GetLightTransmittanceCache();
+
+        // Both lights, then only the moved point light
+        ThreadPool threadPool;
+        auto start = std::chrono::high_resolution_clock::now();
+        pathTracer.UpdateLightTransmittanceCache(threadPool);
+        const double bothSeconds = SecondsSince(start);
+
+        pathTracer.SetPointLight(glm::vec3(10.0f, 0.0f, 0.0f), glm::vec3(1.0f), 1.0f);
+        start = std::chrono::high_resolution_clock::now();
+        pathTracer.UpdateLightTransmittanceCache(threadPool);
+        const double pointSeconds = SecondsSince(start);
+
+        Log::Info(
+                "Light transmittance cache: " + std::to_string(cache.GetCellCountX()) + "x" + std::to_string(cache.GetCellCountY())
+                + "x" + std::to_string(cache.GetCellCountZ()) + " cells per light on " + std::to_string(threadPool.GetThreadCount())
+                + " threads, both lights " + std::to_string(1000.0 * bothSeconds) + " ms, moved point light "
+                + std::to_string(1000.0 * pointSeconds) + " ms");
+
+        // Shadow rays from points in the cloud box against fine fixed steps, cached and tracked
+        const glm::vec3 boundsSize = CLOUD_BOUNDS.GetSize();
+        // VecFromAngles of the dir light of SetBenchmarkScene
+        const glm::vec3 toDirLight = -glm::normalize(glm::vec3(std::sin(-1.0f) * std::sin(0.5f), std::cos(-1.0f), std::sin(-1.0f) * std::cos(0.5f)));
+        const glm::vec3 pointLightPos(10.0f, 0.0f, 0.0f);
+        Rng pointRng(0, 0, 0, 6);
+        std::vector<glm::vec3> points(pointCount);
+        for (size_t i = 0; i < pointCount; i++)
+        {
+            points[i] = CLOUD_BOUNDS.minCorner + (boundsSize * glm::vec3(pointRng.NextFloat(), pointRng.NextFloat(), pointRng.NextFloat()));
+        }
+
+        for (CachedLight light : { CachedLight::Dir, CachedLight::Point })
+        {
+            std::vector<glm::vec3> ends(pointCount);
+            for (size_t i = 0; i < pointCount; i++)
+            {
+                float entryDistance;
+                float exitDistance;
+                CLOUD_BOUNDS.Intersect(points[i], toDirLight, entryDistance, exitDistance);
+                ends[i] = light == CachedLight::Dir ? points[i] + (toDirLight * exitDistance) : pointLightPos;
+            }
+
+            pathTracer.SetTransmittanceEstimator(TransmittanceEstimator::FixedStep);
+            std::vector<float> reference(pointCount);
+            Rng unusedRng(0, 0, 0, 0);
+            for (size_t i = 0; i < pointCount; i++)
+            {
+                reference[i] = pathTracer.GetTransmittance(points[i], ends[i], referenceStepCount, unusedRng);
+            }
+            pathTracer.SetTransmittanceEstimator(TransmittanceEstimator::ResidualRatio);
+
+            for (bool cached : { false, true })
+            {
+                double squaredError = 0.0;
+                double error = 0.0;
+                start = std::chrono::high_resolution_clock::now();
+                for (size_t i = 0; i < pointCount; i++)
+                {
+                    Rng rng(static_cast<uint32_t>(i), 0, 0, 7);
+                    const float transmittance = cached
+                                                ? std::exp(-densityFactor * cache.GetOpticalDepth(light, points[i]))
+                                                : pathTracer.GetTransmittance(points[i], ends[i], 0, rng);
+                    const double diff = static_cast<double>(transmittance) - reference[i];
+                    squaredError += diff * diff;
+                    error += diff;
+                }
+                const double seconds = SecondsSince(start);
+
+                Log::Info(
+                        std::string(light == CachedLight::Dir ? "Dir" : "Point") + " light shadow rays "
+                        + (cached ? "from the cache: " : "with residual ratio tracking: ")
+                        + std::to_string(static_cast<double>(pointCount) / seconds / 1e6) + " M evaluations/s, rmse "
+                        + std::to_string(std::sqrt(squaredError / static_cast<double>(pointCount))) + ", mean error "
+                        + std::to_string(error / static_cast<double>(pointCount)));
+            }
+        }
+
+        // Frame time with both lights
+        for (bool cached : { false, true })
+        {
+            if (cached)
+                pathTracer.UpdateLightTransmittanceCache(threadPool);
+            else
+                pathTracer.DisableLightTransmittanceCache();
+
+            std::vector<float> image;
+            start = std::chrono::high_resolution_clock::now();
+            pathTracer.Render(threadPool, width, height, sampleCount, 0, image);
+            const double seconds = SecondsSince(start);
+
+            Log::Info(
+                    std::string("VolumePathTracer ") + (cached ? "with" : "without") + " light transmittance cache: "
+                    + std::to_string(1000.0 * seconds) + " ms per frame");
+        }
+    }
+
+    // Small lumpy puffs scattered over a large mostly empty box, like the production clouds
+    static SyntheticVolume SyntheticCloudField(size_t sizeX, size_t sizeY, size_t sizeZ, size_t puffCount)
+    {
+        SyntheticVolume density = { .data = std::vector<float>(sizeX * sizeY * sizeZ, 0.0f), .sizeX = sizeX, .sizeY = sizeY, .sizeZ = sizeZ };
+        Rng puffRng(0, 0, 0, 8);
+        for (size_t puff = 0; puff < puffCount; puff++)
+        {
+            const float radius = 6.0f + (8.0f * puffRng.NextFloat());
+            const float centerX = static_cast<float>(sizeX) * (0.1f + (0.8f * puffRng.NextFloat()));
+            const float centerY = static_cast<float>(sizeY) * (0.1f + (0.8f * puffRng.NextFloat()));
+            const float centerZ = static_cast<float>(sizeZ) * (0.1f + (0.8f * puffRng.NextFloat()));
+            const size_t beginX = static_cast<size_t>(std::max(centerX - radius, 0.0f));
+            const size_t beginY = static_cast<size_t>(std::max(centerY - radius, 0.0f));
+            const size_t beginZ = static_cast<size_t>(std::max(centerZ - radius, 0.0f));
+            const size_t endX = std::min(static_cast<size_t>(centerX + radius) + 1, sizeX);
+            const size_t endY = std::min(static_cast<size_t>(centerY + radius) + 1, sizeY);
+            const size_t endZ = std::min(static_cast<size_t>(centerZ + radius) + 1, sizeZ);
+            for (size_t x = beginX; x < endX; x++)
+            {
+                for (size_t y = beginY; y < endY; y++)
+                {
+                    for (size_t z = beginZ; z < endZ; z++)
+                    {
+                        const float px = (static_cast<float>(x) + 0.5f - centerX) / radius;
+                        const float py = (static_cast<float>(y) + 0.5f - centerY) / radius;
+                        const float pz = (static_cast<float>(z) + 0.5f - centerZ) / radius;
+                        const float distance = std::sqrt((px * px) + (py * py) + (pz * pz));
+                        const float lumps = 0.15f * std::sin(7.0f * px) * std::sin((5.0f * py) + 1.0f) * std::sin((6.0f * pz) + 2.0f);
+                        density(x, y, z) = std::max(density(x, y, z), std::clamp((0.8f - distance + lumps) * 4.0f, 0.0f, 1.0f));
+                    }
+                }
+            }
+        }
+        return density;
+    }
+
+    static void BenchmarkSparseBrickVolume()
+    {
+        const size_t segmentCount = 20000;
+        const uint32_t stepCount = 64;
+        const uint32_t brickSize = 8;
+
+        struct VolumeConfig
+        {
+            const char* name;
+            size_t sizeX;
+            size_t sizeY;
+            size_t sizeZ;
+            size_t puffCount; // 0 for SyntheticCloud
+        };
+
+        for (const VolumeConfig& config : {
+                VolumeConfig{ "synthetic cloud 125x85x153", 125, 85, 153, 0 },
+                VolumeConfig{ "synthetic cloud field 250x170x306", 250, 170, 306, 48 } })
+        {
+            const SyntheticVolume density = config.puffCount == 0
+                    ? SyntheticCloud(config.sizeX, config.sizeY, config.sizeZ)
+                    : SyntheticCloudField(config.sizeX, config.sizeY, config.sizeZ, config.puffCount);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            const SparseBrickVolume sparseVolume(density.GetView(), brickSize);
+            const double convertSeconds = SecondsSince(start);
+
+            // Both textures are R8_UNORM
+            const size_t denseBytes = config.sizeX * config.sizeY * config.sizeZ;
+            const size_t atlasBytes = static_cast<size_t>(sparseVolume.GetAtlasSizeX()) * sparseVolume.GetAtlasSizeY() * sparseVolume.GetAtlasSizeZ();
+            const size_t sparseBytes = atlasBytes + sparseVolume.GetGpuSize();
+            Log::Info(
+                    "Sparse brick volume " + std::string(config.name) + ": " + std::to_string(sparseVolume.GetStoredBrickCount()) + " of "
+                    + std::to_string(sparseVolume.GetBrickCount()) + " bricks stored, converted in " + std::to_string(1000.0 * convertSeconds)
+                    + " ms, dense " + std::to_string(static_cast<double>(denseBytes) / 1e6) + " MB, sparse "
+                    + std::to_string(static_cast<double>(sparseBytes) / 1e6) + " MB ("
+                    + std::to_string(static_cast<double>(sparseVolume.GetGpuSize()) / 1e3) + " kB page table)");
+
+            // Same segments as BenchmarkTransmittance, dense and sparse lookups have to agree
+            VolumePathTracer pathTracer(density.GetView(), CLOUD_BOUNDS, 0.4f, 0.7f);
+            pathTracer.SetTransmittanceEstimator(TransmittanceEstimator::FixedStep);
+            const glm::vec3 boundsSize = CLOUD_BOUNDS.GetSize();
+            Rng segmentRng(0, 0, 0, 4);
+            std::vector<glm::vec3> starts(segmentCount);
+            std::vector<glm::vec3> ends(segmentCount);
+            for (size_t i = 0; i < segmentCount; i++)
+            {
+                starts[i] = CLOUD_BOUNDS.minCorner + (boundsSize * glm::vec3(segmentRng.NextFloat(), segmentRng.NextFloat(), segmentRng.NextFloat()));
+                ends[i] = CLOUD_BOUNDS.minCorner + (boundsSize * glm::vec3(segmentRng.NextFloat(), segmentRng.NextFloat(), segmentRng.NextFloat()));
+            }
+
+            std::vector<float> denseTransmittance(segmentCount);
+            float maxDiff = 0.0f;
+            Rng unusedRng(0, 0, 0, 0);
+            for (bool sparse : { false, true })
+            {
+                pathTracer.SetSparseVolume(sparse ? &sparseVolume : nullptr);
+                start = std::chrono::high_resolution_clock::now();
+                for (size_t i = 0; i < segmentCount; i++)
+                {
+                    const float transmittance = pathTracer.GetTransmittance(starts[i], ends[i], stepCount, unusedRng);
+                    if (sparse)
+                        maxDiff = std::max(maxDiff, std::abs(transmittance - denseTransmittance[i]));
+                    else
+                        denseTransmittance[i] = transmittance;
+                }
+                const double seconds = SecondsSince(start);
+
+                Log::Info(
+                        std::string(sparse ? "Sparse" : "Dense") + " density samples: "
+                        + std::to_string(static_cast<double>(segmentCount * stepCount) / seconds / 1e6) + " M samples/s"
+                        + (sparse ? ", max transmittance difference to dense " + std::to_string(maxDiff) : ""));
+            }
+        }
+    }
+
+    // Resident set size of the process in MB, 0 where it is unknown
+    static double GetRssMb()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return static_cast<double>(counters.WorkingSetSize) / 1e6;
+#else
+        std::ifstream statm("/proc/self/statm");
+        size_t totalPages = 0;
+        size_t residentPages = 0;
+        statm >> totalPages >> residentPages;
+        return static_cast<double>(residentPages) * static_cast<double>(sysconf(_SC_PAGESIZE)) / 1e6;
+#endif
+    }
+
+    static void BenchmarkVolumeLoading()
+    {
+        const size_t sizeX = 250;
+        const size_t sizeY = 170;
+        const size_t sizeZ = 306;
+        const size_t voxelCount = sizeX * sizeY * sizeZ;
+
+        // Raw file in the z fastest layout of data/cloud_sixteenth, read back from the page cache by both paths
+        const std::filesystem::path fileName = std::filesystem::temp_directory_path() / "nrc_benchmark_density.raw";
+        {
+            const SyntheticVolume density = SyntheticCloudField(sizeX, sizeY, sizeZ, 48);
+            std::ofstream file(fileName, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(density.data.data()), static_cast<std::streamsize>(voxelCount * sizeof(float)));
+        }
+
+        // Memory mapped file transposed straight into the staging memory
+        ThreadPool threadPool;
+        std::vector<uint8_t> mappedStaging(voxelCount);
+        double baseRss = GetRssMb();
+        double mappedRss = 0.0;
+        auto start = std::chrono::high_resolution_clock::now();
+        {
+            const MappedVolume mappedVolume(fileName.string(), sizeX, sizeY, sizeZ);
+            WriteTexels(threadPool, mappedVolume.GetView(), TexelFormat::R8Unorm, mappedStaging.data());
+
+            // Includes the file pages of the mapping, they stay shared with the page cache
+            mappedRss = GetRssMb() - baseRss;
+        }
+        const double mappedSeconds = SecondsSince(start);
+
+        // ReadFileBinary, the nested vectors of ReadFileDensity3D and the RGBA8 staging data of the old Texture3D
+        baseRss = GetRssMb();
+        double copiedRss = 0.0;
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<uint8_t> copiedStaging(voxelCount * 4);
+        {
+            std::vector<std::vector<std::vector<float>>> density3D(sizeX);
+            {
+                const std::vector<char> binaryData = ReadFileBinary(fileName.string());
+                const float* rawData = reinterpret_cast<const float*>(binaryData.data());
+                for (size_t x = 0; x < sizeX; x++)
+                {
+                    density3D[x].resize(sizeY);
+                    for (size_t y = 0; y < sizeY; y++)
+                    {
+                        density3D[x][y].resize(sizeZ);
+                        for (size_t z = 0; z < sizeZ; z++)
+                        {
+                            density3D[x][y][z] = rawData[(x * sizeY * sizeZ) + (y * sizeZ) + z];
+                        }
+                    }
+                }
+                copiedRss = GetRssMb() - baseRss;
+            }
+
+            for (size_t x = 0; x < sizeX; x++)
+            {
+                for (size_t y = 0; y < sizeY; y++)
+                {
+                    for (size_t z = 0; z < sizeZ; z++)
+                    {
+                        const uint8_t value = static_cast<uint8_t>(density3D[x][y][z] * 255.0f);
+                        const size_t index = 4 * (x + (sizeX * y) + (sizeX * sizeY * z));
+                        copiedStaging[index + 0] = value;
+                        copiedStaging[index + 1] = value;
+                        copiedStaging[index + 2] = value;
+                        copiedStaging[index + 3] = 1;
+                    }
+                }
+            }
+            copiedRss = std::max(copiedRss, GetRssMb() - baseRss);
+        }
+        const double copiedSeconds = SecondsSince(start);
+
+        size_t mismatchCount = 0;
+        for (size_t i = 0; i < voxelCount; i++)
+        {
+            mismatchCount += mappedStaging[i] != copiedStaging[i * 4] ? 1 : 0;
+        }
+
+        Log::Info(
+                "Volume loading " + std::to_string(sizeX) + "x" + std::to_string(sizeY) + "x" + std::to_string(sizeZ) + ": copied RGBA8 "
+                + std::to_string(1000.0 * copiedSeconds) + " ms, +" + std::to_string(copiedRss) + " MB RSS, mapped R8 on "
+                + std::to_string(threadPool.GetThreadCount()) + " threads " + std::to_string(1000.0 * mappedSeconds) + " ms, +"
+                + std::to_string(mappedRss) + " MB RSS, " + std::to_string(mismatchCount) + " texels differ");
+
+        // Majorant grid and light cache of VolumeData straight from the mapping, without the nested copy
+        baseRss = GetRssMb();
+        double gridRss = 0.0;
+        start = std::chrono::high_resolution_clock::now();
+        {
+            const MappedVolume mappedVolume(fileName.string(), sizeX, sizeY, sizeZ);
+            const MajorantGrid majorantGrid(mappedVolume.GetView(), VolumePathTracer::MAJORANT_BRICK_SIZE);
+            const LightTransmittanceCache lightCache(mappedVolume.GetView(), CLOUD_BOUNDS, VolumePathTracer::LIGHT_CACHE_CELL_SIZE);
+            gridRss = GetRssMb() - baseRss;
+        }
+        const double gridSeconds = SecondsSince(start);
+
+        Log::Info(
+                "Volume grids from the mapped file: " + std::to_string(1000.0 * gridSeconds) + " ms, +" + std::to_string(gridRss)
+                + " MB RSS");
+
+        // Layout conversion alone, strided gather against SIMD block transposes
+        const MappedVolume mappedVolume(fileName.string(), sizeX, sizeY, sizeZ);
+        const VolumeView volume = mappedVolume.GetView();
+        std::vector<float> texels(voxelCount);
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t z = 0; z < sizeZ; z++)
+        {
+            for (size_t y = 0; y < sizeY; y++)
+            {
+                for (size_t x = 0; x < sizeX; x++)
+                {
+                    texels[x + (sizeX * (y + (sizeY * z)))] = volume.Get(x, y, z);
+                }
+            }
+        }
+        const double gatherSeconds = SecondsSince(start);
+
+        ThreadPool singleThreadPool(1);
+        std::vector<float> transposedTexels(voxelCount);
+        start = std::chrono::high_resolution_clock::now();
+        WriteTexels(singleThreadPool, volume, TexelFormat::R32Sfloat, transposedTexels.data());
+        const double transposeSeconds = SecondsSince(start);
+
+        Log::Info(
+                "Volume transpose to x fastest on 1 thread: strided gather " + std::to_string(1000.0 * gatherSeconds) + " ms, SIMD blocks "
+                + std::to_string(1000.0 * transposeSeconds) + " ms, " + (texels == transposedTexels ? "same" : "different") + " texels");
+
+        for (TexelFormat format : { TexelFormat::R8Unorm, TexelFormat::R16Sfloat, TexelFormat::R32Sfloat })
+        {
+            std::vector<uint8_t> staging(voxelCount * GetTexelSize(format));
+            start = std::chrono::high_resolution_clock::now();
+            WriteTexels(threadPool, volume, format, staging.data());
+            const double seconds = SecondsSince(start);
+
+            Log::Info(
+                    "WriteTexels " + std::string(format == TexelFormat::R8Unorm ? "R8_UNORM" : (format == TexelFormat::R16Sfloat ? "R16_SFLOAT" : "R32_SFLOAT"))
+                    + ": " + std::to_string(1000.0 * seconds) + " ms, " + std::to_string(static_cast<double>(staging.size()) / 1e6) + " MB staging");
+        }
+
+        std::filesystem::remove(fileName);
+    }
+
+    void RunBenchmarks()
+    {
+        Log::Info("Running CPU benchmarks");
+
+        BenchmarkMlpForward();
+        BenchmarkTrainerScaling();
+        BenchmarkOptimizerStep();
+        BenchmarkOptimizerConvergence();
+        BenchmarkMrheStep();
+        BenchmarkMrheCollisions();
+        BenchmarkMrheEncoder();
+        BenchmarkOneBlobEncoder();
+        BenchmarkDirEncodings();
+        BenchmarkTopologySweep();
+        BenchmarkRng();
+        BenchmarkReplayBuffer();
+        BenchmarkAsyncTrainer();
+        BenchmarkSelfTraining();
+        BenchmarkTrainingSchedule();
+        BenchmarkVolumePathTracer();
+        BenchmarkTransmittance();
+        BenchmarkEmptySpaceSkipping();
+        BenchmarkLightTransmittanceCache();
+        BenchmarkSparseBrickVolume();
+        BenchmarkVolumeLoading();
+    }
+}
@@ -26,9 +26,28 @@
 #include <engine/graphics/PointLight.hpp>
 #include <engine/graphics/HdrEnvMap.hpp>
 #include <engine/graphics/MRHE.hpp>
+#include <engine/graphics/TrainingSampleBuffer.hpp>
+#include <engine/graphics/TrainingScheduler.hpp>
+#include <engine/cpu/benchmark.hpp>
+#include <engine/cpu/VolumePathTracer.hpp>
+#include <engine/cpu/SparseBrickVolume.hpp>
+#include <engine/util/ThreadPool.hpp>
+#include <engine/util/Aabb.hpp>
+#include <engine/util/MappedVolume.hpp>
+#include <chrono>
+#include <string_view>
+#include <algorithm>
+#include <optional>
+#include <cctype>
 
 en::NrcHpmRenderer* nrcHpmRenderer = nullptr;
 
+// World space box of data/cloud_sixteenth, half a unit per voxel
+const en::Aabb cloudBounds = en::Aabb::FromCenterSize(glm::vec3(0.0f), glm::vec3(125.0f, 85.0f, 153.0f) / 2.0f);
+
+// Voxels per brick edge of the sparse density volume
+const uint32_t sparseBrickSize = 8;
+
 void RecordSwapchainCommandBuffer(VkCommandBuffer commandBuffer, VkImage image)
 {
     uint32_t width = en::Window::GetWidth();
@@ -106,7 +125,7 @@ void SwapchainResizeCallback()
     en::ImGuiRenderer::SetBackgroundImageView(nrcHpmRenderer->GetImageView());
 }
 
-void RunNrcHpm()
+void RunNrcHpm(bool sparseVolume, VkFormat densityFormat)
 {
     std::string appName("Neural-Radiance-Cache");
     uint32_t width = 800;
@@ -120,13 +139,47 @@ void RunNrcHpm()
     en::VulkanAPI::Init(appName);
 
     // Load data
-    auto density3D = en::ReadFileDensity3D("data/cloud_sixteenth", 125, 85, 153);
-    en::vk::Texture3D density3DTex(
-            density3D,
-            VK_FILTER_LINEAR,
-            VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
-            VK_BORDER_COLOR_INT_OPAQUE_BLACK);
-    en::VolumeData volumeData(&density3DTex);
+    en::ThreadPool threadPool;
+    std::optional<en::MappedVolume> mappedDensity;
+    mappedDensity.emplace("data/cloud_sixteenth", 125, 85, 153);
+    std::optional<en::cpu::SparseBrickVolume> sparseBrickVolume;
+    if (sparseVolume)
+    {
+        sparseBrickVolume.emplace(mappedDensity->GetView(), sparseBrickSize);
+        en::Log::Info(
+                "Sparse density volume stores " + std::to_string(sparseBrickVolume->GetStoredBrickCount()) + " of "
+                + std::to_string(sparseBrickVolume->GetBrickCount()) + " bricks");
+    }
+
+    // The dense texture is transposed from the mapped file into the staging buffer. The atlas has no border of its
+    // own, the apron of the bricks holds it, and its bricks are 8 bit already. It only lives until the upload.
+    en::vk::Texture3D density3DTex = sparseBrickVolume.has_value()
+            ? en::vk::Texture3D(
+                    en::VolumeView::XFastest(
+                            sparseBrickVolume->GetAtlas(),
+                            sparseBrickVolume->GetAtlasSizeX(),
+                            sparseBrickVolume->GetAtlasSizeY(),
+                            sparseBrickVolume->GetAtlasSizeZ()),
+                    VK_FORMAT_R8_UNORM,
+                    threadPool,
+                    VK_FILTER_LINEAR,
+                    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                    VK_BORDER_COLOR_INT_OPAQUE_BLACK)
+            : en::vk::Texture3D(
+                    mappedDensity->GetView(),
+                    densityFormat,
+                    threadPool,
+                    VK_FILTER_LINEAR,
+                    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+                    VK_BORDER_COLOR_INT_OPAQUE_BLACK);
+    en::VolumeData volumeData(
+            &density3DTex,
+            mappedDensity->GetView(),
+            cloudBounds,
+            sparseBrickVolume.has_value() ? &sparseBrickVolume.value() : nullptr);
+
+    // The grids, the sparse volume and the texture hold their own copies, the file is no longer needed
+    mappedDensity.reset();
 
     int hdrWidth, hdrHeight;
     std::vector<float> hdr4fData = en::ReadFileHdr4f("data/image/photostudio_4k.hdr", hdrWidth, hdrHeight);
@@ -153,17 +206,20 @@ void RunNrcHpm()
 
     en::vk::Swapchain swapchain(width, height, RecordSwapchainCommandBuffer, SwapchainResizeCallback);
 
-    en::NeuralRadianceCache nrc(0.001f, 0.0f, 0.5f);
-    en::MRHE mrhe(0.01f, 0.0f);
+    en::NeuralRadianceCache nrc(en::OptimizerConfig::Adam(0.001f));
+    en::MRHE mrhe(en::OptimizerConfig::Adam(0.01f));
+    en::TrainingSampleBuffer trainingSamples(8 * 100 * 100, 100 * 100, 0.5f, 16);
+    en::TrainingScheduler trainingScheduler(en::NrcHpmRenderer::TRAIN_TILE_SIZE, 1024, 100 * 100, 8.0f);
 
     nrcHpmRenderer = new en::NrcHpmRenderer(
             width, height,
-            100, 100,
             camera,
             volumeData,
             dirLight, pointLight, hdrEnvMap,
             nrc,
-            mrhe);
+            mrhe,
+            trainingSamples,
+            trainingScheduler);
 
     en::ImGuiRenderer::Init(width, height);
     en::ImGuiRenderer::SetBackgroundImageView(nrcHpmRenderer->GetImageView());
@@ -213,14 +269,41 @@ void RunNrcHpm()
         camera.UpdateUniformBuffer();
 
         nrc.ResetStats();
+        if (counter % 25 == 0)
+        {
+            trainingSamples.ResetStats();
+        }
+        trainingSamples.BeginFrame();
+        nrc.AdvanceOptimizer();
+        mrhe.AdvanceOptimizer();
         nrcHpmRenderer->Render(graphicsQueue);
         result = vkQueueWaitIdle(graphicsQueue);
         ASSERT_VULKAN(result);
 
+        const uint32_t trainSampleCount = trainingScheduler.GetSampleCount();
+        const float trainTime = nrcHpmRenderer->GetTrainTime();
+        trainingScheduler.Update(trainTime);
+
         if (counter % 25 == 0)
         {
             const en::NeuralRadianceCache::StatsData& nrcStats = nrc.GetStats();
-            en::Log::Info("NRC MSE Loss: " + std::to_string(nrcStats.mseLoss));
+            en::Log::Info(
+                    "NRC MSE Loss: " + std::to_string(nrcStats.mseLoss) + ", " + std::to_string(trainSampleCount)
+                    + " training samples in " + std::to_string(trainTime) + " ms");
+        }
+
+        if (counter % 25 == 24)
+        {
+            const en::TrainingSampleBuffer::StatsData& sampleStats = trainingSamples.GetStats();
+            const float replayAge = sampleStats.replayCount > 0
+                                    ? static_cast<float>(sampleStats.replayAgeSum) / static_cast<float>(sampleStats.replayCount)
+                                    : 0.0f;
+            const float newCount = static_cast<float>(std::max(sampleStats.newCount, 1u));
+            en::Log::Info(
+                    "Training samples (25 frames): " + std::to_string(sampleStats.newCount) + " traced, "
+                    + std::to_string(sampleStats.replayCount) + " replayed, mean replay age " + std::to_string(replayAge)
+                    + ", " + std::to_string(static_cast<float>(sampleStats.traceStepSum) / newCount) + " path steps and "
+                    + std::to_string(static_cast<float>(sampleStats.cacheLookupCount) / newCount) + " cache lookups per traced sample");
         }
 
         // ImGui
@@ -230,7 +313,10 @@ void RunNrcHpm()
         volumeData.Update(camera.HasChanged());
         dirLight.RenderImgui();
         pointLight.RenderImGui();
+        volumeData.UpdateLightTransmittanceCache(threadPool, dirLight, pointLight);
         hdrEnvMap.RenderImGui();
+        trainingSamples.RenderImGui();
+        trainingScheduler.RenderImGui();
 
         ImGui::Begin("Train Nrc");
 
@@ -259,6 +345,8 @@ void RunNrcHpm()
     nrcHpmRenderer->Destroy();
     delete nrcHpmRenderer;
 
+    trainingScheduler.Destroy();
+    trainingSamples.Destroy();
     mrhe.Destroy();
     nrc.Destroy();
 
@@ -276,9 +364,97 @@ void RunNrcHpm()
     en::Log::Info("Ending " + appName);
 }
 
-int main()
+// Reference image of the RunNrcHpm scene without NN, rendered on all cores without a Vulkan device
+void RunCpuRender(uint32_t sampleCount)
 {
-    RunNrcHpm();
+    const uint32_t width = 800;
+    const uint32_t height = width;
+
+    en::Log::Info("Rendering CPU reference with " + std::to_string(sampleCount) + " samples per pixel");
+
+    // Scene of RunNrcHpm with the defaults of VolumeData and HdrEnvMap
+    const en::MappedVolume mappedDensity("data/cloud_sixteenth", 125, 85, 153);
+    en::cpu::VolumePathTracer pathTracer(mappedDensity.GetView(), cloudBounds, 0.4f, 0.7f);
+
+    int hdrWidth, hdrHeight;
+    std::vector<float> hdr4fData = en::ReadFileHdr4f("data/image/photostudio_4k.hdr", hdrWidth, hdrHeight);
+    pathTracer.SetHdrEnvMap(hdrWidth, hdrHeight, hdr4fData, 1.0f, 8.0f);
+
+    pathTracer.SetDirLight(-1.57f, 0.0f, 0.0f);
+    pathTracer.SetPointLight(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), 0.0f);
+    pathTracer.SetCamera(
+            glm::vec3(0.0f, 0.0f, -64.0f),
+            glm::vec3(0.0f, 0.0f, 1.0f),
+            glm::vec3(0.0f, 1.0f, 0.0f),
+            static_cast<float>(width) / static_cast<float>(height),
+            glm::radians(60.0f));
+
+    en::ThreadPool threadPool;
+    std::vector<float> image;
+    auto start = std::chrono::high_resolution_clock::now();
+    const en::cpu::VolumePathTracer::RenderStats stats = pathTracer.Render(threadPool, width, height, sampleCount, 0, image);
+    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    const double pathCount = static_cast<double>(std::max(stats.pathCount, size_t{ 1 }));
+
+    en::Log::Info(
+            "Rendered " + std::to_string(stats.pathCount) + " paths on " + std::to_string(threadPool.GetThreadCount())
+            + " threads in " + std::to_string(seconds) + " s (" + std::to_string(static_cast<double>(stats.pathCount) / seconds)
+            + " paths/s, " + std::to_string(static_cast<double>(stats.stepCount) / pathCount)
+            + " steps per path)");
+
+    en::WriteEXR("cpu_reference.exr", image.data(), width, height);
+}
+
+int main(int argc, char** argv)
+{
+    bool sparseVolume = false;
+    VkFormat densityFormat = VK_FORMAT_R8_UNORM;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string_view(argv[i]) == "--cpu-bench")
+        {
+            en::cpu::RunBenchmarks();
+            return 0;
+        }
+
+        // --cpu-render [samples per pixel], 64 unless the next argument is a positive number
+        if (std::string_view(argv[i]) == "--cpu-render")
+        {
+            uint32_t sampleCount = 64;
+            if (i + 1 < argc)
+            {
+                const std::string_view count(argv[i + 1]);
+                if (!count.empty() && count.size() <= 9 && std::all_of(count.begin(), count.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }))
+                {
+                    const uint32_t parsedCount = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+                    if (parsedCount > 0)
+                        sampleCount = parsedCount;
+                    else
+                        en::Log::Warn("--cpu-render needs at least one sample per pixel, using " + std::to_string(sampleCount));
+                }
+            }
+            RunCpuRender(sampleCount);
+            return 0;
+        }
+
+        // Density as SparseBrickVolume instead of the dense texture
+        if (std::string_view(argv[i]) == "--sparse-volume")
+            sparseVolume = true;
+
+        // --density-format r8|r16f|r32f of the dense density texture
+        if (std::string_view(argv[i]) == "--density-format" && i + 1 < argc)
+        {
+            const std::string_view format(argv[i + 1]);
+            if (format == "r16f")
+                densityFormat = VK_FORMAT_R16_SFLOAT;
+            else if (format == "r32f")
+                densityFormat = VK_FORMAT_R32_SFLOAT;
+            else if (format != "r8")
+                en::Log::Error("Unknown density format " + std::string(format), true);
+        }
+    }
+
+    RunNrcHpm(sparseVolume, densityFormat);
 
     return 0;
 }
@@ -1,6 +1,7 @@
 #include <engine/util/read_file.hpp>
 #include <stb_image.h>
 #include <engine/util/Log.hpp>
+#include <engine/util/MappedVolume.hpp>
 #include <fstream>
 #include <thread>
 #include <array>
@@ -49,13 +50,9 @@ namespace en
 
     std::vector<std::vector<std::vector<float>>> ReadFileDensity3D(const std::string& fileName, size_t xSize, size_t ySize, size_t zSize)
     {
-        size_t totalSize = xSize * ySize * zSize;
-
-        // Load raw data
-        std::vector<char> binaryData = ReadFileBinary(fileName);
-        float* rawData = reinterpret_cast<float*>(binaryData.data());
-
-        // Create and fill 3d array
+        // Copied once from the mapping into the nested vectors
+        const MappedVolume mappedVolume(fileName, xSize, ySize, zSize);
+        const VolumeView volume = mappedVolume.GetView();
         std::vector<std::vector<std::vector<float>>> density3D(xSize);
 
         for (size_t x = 0; x < xSize; x++)
@@ -63,14 +60,8 @@ namespace en
             density3D[x].resize(ySize);
             for (size_t y = 0; y < ySize; y++)
             {
-                density3D[x][y].resize(zSize);
-                for (size_t z = 0; z < zSize; z++)
-                {
-                    size_t index = x * ySize * zSize + y * zSize + z;
-                    float value = rawData[index];
-                    //en::Log::Info(std::to_string(value));
-                    density3D[x][y][z] = value;
-                }
+                const float* row = volume.data.data() + (x * volume.strideX) + (y * volume.strideY);
+                density3D[x][y].assign(row, row + zSize);
             }
         }
 